@@ -4,6 +4,9 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 namespace element {
 
@@ -76,6 +79,64 @@ private:
     Val values[2];
 };
 
+/** A small value written by one thread at a time and read without locking.
+
+    Readers copy the value and retry if a write landed meanwhile, so they
+    always see a whole value and never block the writer. Callers serialize
+    writers themselves.
+ */
+template <typename Val>
+class SeqLockValue {
+public:
+    static_assert (std::is_trivially_copyable<Val>::value, "SeqLockValue needs a trivially copyable type");
+
+    explicit SeqLockValue (const Val& initial = Val()) { store (initial); }
+
+    /** Returns a consistent copy of the value. */
+    inline Val load() const noexcept
+    {
+        Word words[numWords];
+        for (;;) {
+            const auto begin = sequence.load (std::memory_order_acquire);
+            if ((begin & 1u) != 0)
+                continue; // write in progress
+
+            for (std::size_t i = 0; i < numWords; ++i)
+                words[i] = data[i].load (std::memory_order_relaxed);
+
+            std::atomic_thread_fence (std::memory_order_acquire);
+            if (sequence.load (std::memory_order_relaxed) == begin)
+                break;
+        }
+
+        Val value;
+        std::memcpy (&value, words, sizeof (Val));
+        return value;
+    }
+
+    /** Publishes a new value. */
+    inline void store (const Val& value) noexcept
+    {
+        Word words[numWords] = {};
+        std::memcpy (words, &value, sizeof (Val));
+
+        const auto begin = sequence.load (std::memory_order_relaxed);
+        sequence.store (begin + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+
+        for (std::size_t i = 0; i < numWords; ++i)
+            data[i].store (words[i], std::memory_order_relaxed);
+
+        sequence.store (begin + 2, std::memory_order_release);
+    }
+
+private:
+    using Word = std::uint32_t;
+    static constexpr std::size_t numWords = (sizeof (Val) + sizeof (Word) - 1) / sizeof (Word);
+    std::atomic<std::uint32_t> sequence { 0 };
+    std::atomic<Word> data[numWords];
+};
+
 class AtomicLock {
 public:
     AtomicLock()
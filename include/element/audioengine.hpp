@@ -42,6 +42,37 @@ public:
 
     void applySettings (Settings&);
 
+    /** Limit graph rendering to blocks of at most blockSize samples. Larger
+        host buffers get split into sub-blocks. Pass 0 to follow the host
+        block size. When fixed is true every render gets exactly blockSize
+        samples at the cost of one block of added latency. A running device
+        is stopped and restarted around the change; plugins apply it the
+        next time the host prepares them.
+     */
+    void setRenderBlockSize (int blockSize, bool fixed = false);
+
+    /** Returns the block size graphs are currently prepared with. */
+    int getRenderBlockSize() const;
+
+    /** Render graphs with 64-bit buffers. Plugins that support it process
+        doubles directly, everything else is converted at its edges. Like
+        setRenderBlockSize, a running device is restarted around the change
+        and plugins apply it the next time the host prepares them.
+     */
+    void setDoublePrecision (bool useDouble);
+
+    /** True if graphs are set to render with 64-bit buffers. */
+    bool isUsingDoublePrecision() const;
+
+    /** Render this many device blocks ahead on a worker thread. The added
+        latency is numBlocks device blocks. Only used by the standalone app
+        and only while no graph uses live audio input. Pass 0 to disable.
+     */
+    void setRenderLookahead (int numBlocks);
+
+    /** Returns the number of blocks rendered ahead. */
+    int getRenderLookahead() const;
+
     bool isUsingExternalClock() const;
 
     void setSession (SessionPtr);
@@ -89,7 +120,7 @@ public:
         friend class AudioEngine;
 
         Atomic<float> _level { 0 };
-        void updateLevel (const float* const*, int numChannels, int numSamples) noexcept;
+        void updateLevel (float blockPeak, int numSamples) noexcept;
     };
 
     using LevelMeterPtr = ReferenceCountedObjectPtr<LevelMeter>;
@@ -19,6 +19,7 @@ class Log;
 class PluginManager;
 class PresetManager;
 class Settings;
+class ThreadPools;
 
 class Context {
 public:
@@ -39,6 +40,10 @@ public:
 
     Settings& settings();
 
+    /** Returns the threads, configured from settings(). Contexts in one
+        process share them, and they stop with the last Context. */
+    ThreadPools& threads();
+
     //=========================================================================
     void openModule (const std::string& path);
     void loadModules();
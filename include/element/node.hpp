@@ -401,6 +401,12 @@ public:
     /** Saves the node state from Processor to state property */
     void savePluginState();
 
+    /** Same as savePluginState() but skips re-serializing plugins whose
+        state hasn't changed since it was last saved or restored. Plugins
+        with an open editor are always saved.
+     */
+    void savePluginStateIfChanged();
+
     /** Reads state property and applies to Processor */
     void restorePluginState();
 
@@ -511,6 +517,10 @@ public:
     /** Removes properties that can't be saved to a file. e.g. object properties */
     static void sanitizeProperties (ValueTree node, const bool recursive = false);
 
+    /** Returns true if sanitizeProperties removes a property from trees of
+        the given type. */
+    static bool isRuntimeProperty (const Identifier& type, const Identifier& property);
+
     /** This is just an alias right now */
     static void sanitizeRuntimeProperties (ValueTree node, const bool recursive = false);
 
@@ -526,6 +536,7 @@ public:
 private:
     void setMissingProperties();
     void forEach (const juce::ValueTree tree, std::function<void (const juce::ValueTree& tree)>) const;
+    void saveState (bool onlyIfChanged);
 };
 
 class NodeObjectSync final : private ValueTree::Listener {
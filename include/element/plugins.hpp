@@ -120,6 +120,20 @@ public:
     /** Returns the last saved default node state */
     Node getDefaultNode (const juce::PluginDescription& desc) const;
 
+    //==========================================================================
+    /** Keeps the node's plugin instance alive so a following graph reload
+        can reuse it instead of instantiating the plugin again.
+     */
+    void retainProcessorForReuse (const Node& node);
+
+    /** Takes a retained plugin instance matching the node's UUID and plugin
+        identity, or nullptr if there isn't one.
+     */
+    juce::ReferenceCountedObjectPtr<Processor> takeReusableProcessor (const Node& node);
+
+    /** Releases any retained instances which weren't reused */
+    void clearReusableProcessors();
+
 private:
     juce::PropertiesFile* props = nullptr;
     class Private;
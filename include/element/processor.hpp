@@ -24,6 +24,7 @@ class ProcessBufferOp;
 }
 
 class GraphNode;
+class MidiProgramBank;
 class ProcessBufferOp;
 
 class Processor : public ReferenceCountedObject {
@@ -91,6 +92,32 @@ public:
     virtual void render (AudioSampleBuffer&, MidiPipe&) {}
     virtual void renderBypassed (AudioSampleBuffer&, MidiPipe&);
 
+    /** Return true if render64() and renderBypassed64() are implemented.
+        Graphs rendering in double precision convert to and from float
+        around nodes that don't. Only used with wantsMidiPipe().
+     */
+    virtual bool supportsDoublePrecision() const { return false; }
+    virtual void render64 (AudioBuffer<double>&, MidiPipe&) {}
+    virtual void renderBypassed64 (AudioBuffer<double>&, MidiPipe&) {}
+
+    /** Return true if render() never changes its MIDI input buffers. The
+        graph can then pass a MIDI output that fans out to several nodes
+        straight through instead of copying it.
+     */
+    virtual bool wantsReadOnlyMidi() const { return false; }
+
+    /** Return true to read and write Control and CV ports straight from
+        the graph's buffers with setPortData(). Otherwise connected control
+        inputs are applied to parameters once per block.
+     */
+    virtual bool wantsPortData() const { return false; }
+
+    /** Point a Control or CV port at graph memory. Called on the render
+        thread before each render(). Control ports get one value per block,
+        CV ports one value per sample. nullptr means the port isn't connected.
+     */
+    virtual void setPortData (uint32 port, float* data) { ignoreUnused (port, data); }
+
     /** Returns the total number of audio inputs */
     int getNumAudioInputs() const;
 
@@ -226,6 +253,41 @@ public:
     float getInputRMS (int chan) const { return (chan < inRMS.size()) ? inRMS.getUnchecked (chan)->get() : 0.0f; }
     void setOutputRMS (int chan, float val);
     float getOutputRMS (int chan) const { return (chan < outRMS.size()) ? outRMS.getUnchecked (chan)->get() : 0.0f; }
+    void setInputPeak (int chan, float val);
+    float getInputPeak (int chan) const { return (chan < inPeak.size()) ? inPeak.getUnchecked (chan)->get() : 0.0f; }
+    void setOutputPeak (int chan, float val);
+    float getOutputPeak (int chan) const { return (chan < outPeak.size()) ? outPeak.getUnchecked (chan)->get() : 0.0f; }
+
+    /** Register interest in this node's levels. Input and output levels are
+        only measured while at least one meter is subscribed. Every call
+        must be balanced with removeMeterSubscriber().
+     */
+    void addMeterSubscriber() noexcept { ++meterSubscribers; }
+
+    /** Unregister a meter added with addMeterSubscriber(). */
+    void removeMeterSubscriber() noexcept;
+
+    /** Returns true if any meter is subscribed to this node's levels. */
+    bool isMetering() const noexcept { return meterSubscribers.get() > 0; }
+
+    /** Returns the smoothed fraction of each audio block spent rendering
+        this node. 1.0 means the node alone used the whole block period.
+     */
+    float getCpuLoad() const noexcept { return cpuLoad.get(); }
+
+    //=========================================================================
+    /** Returns a counter which is bumped whenever this processor's state
+        may have changed. Used to skip re-serializing unchanged state.
+     */
+    uint32 getStateRevision() const noexcept { return (uint32) stateRevision.get(); }
+
+    /** Flag the processor's state as changed. Safe to call from any thread. */
+    void markStateChanged() noexcept { ++stateRevision; }
+
+    /** Returns true if the state changed since it was last saved to or
+        restored from a Node.
+     */
+    bool hasStateChangedSinceSave() const noexcept { return getStateRevision() != savedStateRevision; }
 
     //=========================================================================
     /** Connect this node's output audio to another node's input audio */
@@ -246,6 +308,7 @@ public:
         jassert (isPositiveAndBelow (high, 128));
         keyRangeLow.set (low);
         keyRangeHigh.set (high);
+        publishRenderState();
     }
 
     inline void setKeyRange (const Range<int>& range) { setKeyRange (range.getStart(), range.getEnd()); }
@@ -257,12 +320,32 @@ public:
     {
         jassert (value >= -24 && value <= 24);
         transposeOffset.set (value);
+        publishRenderState();
     }
 
     inline int getTransposeOffset() const { return transposeOffset.get(); }
 
+    /** Serializes property writes. The render thread never takes it. */
     const CriticalSection& getPropertyLock() const { return propertyLock; }
 
+    //=========================================================================
+    /** The MIDI properties the render thread reads every block. */
+    struct RenderState {
+        int keyLow = 0, keyHigh = 127;
+        int transposeOffset = 0;
+        uint32 midiChannels = 1; ///< bit 0 is omni, bits 1 to 16 the channels
+        bool midiProgramsEnabled = false;
+
+        inline Range<int> getKeyRange() const noexcept { return { keyLow, keyHigh }; }
+        inline bool isOmni() const noexcept { return (midiChannels & 1u) != 0; }
+        inline bool isChannelOff (int channel) const noexcept { return (midiChannels & (1u | (1u << channel))) == 0; }
+    };
+
+    /** Returns a consistent copy of the render state without locking.
+        Setters publish a new one whenever a property changes.
+     */
+    inline RenderState getRenderState() const noexcept { return renderState.load(); }
+
     //=========================================================================
     /** Returns the file used for the current global MIDI Program */
     File getMidiProgramFile (int program = -1) const;
@@ -278,7 +361,11 @@ public:
     inline bool areMidiProgramsEnabled() const { return midiProgramsEnabled.get() == 1; }
 
     /** Enable or disable changing midi programs */
-    inline void setMidiProgramsEnabled (bool enabled) { midiProgramsEnabled.set (enabled ? 1 : 0); }
+    inline void setMidiProgramsEnabled (bool enabled)
+    {
+        midiProgramsEnabled.set (enabled ? 1 : 0);
+        publishRenderState();
+    }
 
     /** Returns the active midi program */
     inline int getMidiProgram() const { return midiProgram.get(); }
@@ -295,6 +382,13 @@ public:
     /** Reloads the active MIDI program */
     void reloadMidiProgram();
 
+    /** Reload the cache of decoded MIDI program states. Global program files
+        are read here instead of on every program change, so call this after
+        enabling programs, switching between global and local programs, or
+        writing a program file.
+     */
+    void refreshMidiProgramBank();
+
     /** Save the current MIDI program */
     void saveMidiProgram();
 
@@ -316,8 +410,10 @@ public:
     {
         ScopedLock sl (propertyLock);
         midiChannels.setChannels (ch);
+        publishRenderState();
     }
 
+    /** Returns the MIDI channels. Not for the render thread, see getRenderState() */
     inline const MidiChannels& getMidiChannels() const { return midiChannels; }
 
     //=========================================================================
@@ -421,6 +517,25 @@ protected:
     //==========================================================================
     virtual ParameterPtr getParameter (const PortDescription& port) { return nullptr; }
 
+    //==========================================================================
+    /** Copies the cached state of a MIDI program. Don't call this from the
+        audio thread. Returns false if the program has no state.
+     */
+    bool getMidiProgramState (int program, MemoryBlock& state) const;
+
+    /** Called on the audio thread when a program change arrives. Return true
+        if the node loads the program itself, in which case the message thread
+        only sends change notifications.
+     */
+    virtual bool switchMidiProgram (int program)
+    {
+        ignoreUnused (program);
+        return false;
+    }
+
+    /** Called on the message thread after the program bank was reloaded. */
+    virtual void midiProgramBankChanged() {}
+
     //==========================================================================
     void triggerPortReset();
 
@@ -451,7 +566,12 @@ private:
     ParameterArray parameters, parametersOut;
 
     Atomic<float> gain, lastGain, inputGain, lastInputGain;
-    OwnedArray<AtomicValue<float>> inRMS, outRMS;
+    OwnedArray<AtomicValue<float>> inRMS, outRMS, inPeak, outPeak;
+    Atomic<int> meterSubscribers { 0 };
+    Atomic<float> cpuLoad { 0.f };
+    Atomic<int> stateRevision { 1 };
+    uint32 savedStateRevision = 0;
+    int64 savedStateHash = 0;
 
     Atomic<int> keyRangeLow { 0 };
     Atomic<int> keyRangeHigh { 127 };
@@ -462,8 +582,12 @@ private:
     Atomic<int> lastMidiProgram { -1 };
     Atomic<int> midiProgramsEnabled { 0 };
     Atomic<int> globalMidiPrograms { 0 };
+    Atomic<int> standbyMidiProgram { -1 };
 
     CriticalSection propertyLock;
+    SeqLockValue<RenderState> renderState;
+    void publishRenderState();
+
     struct EnablementUpdater : public AsyncUpdater {
         EnablementUpdater (Processor& g) : graph (g) {}
         ~EnablementUpdater() {}
@@ -493,6 +617,8 @@ private:
     };
     mutable OwnedArray<MidiProgram> midiPrograms;
     MidiProgram* getMidiProgram (int) const;
+    std::unique_ptr<MidiProgramBank> programBank;
+    CriticalSection programBankLock;
 
     void setParentGraph (GraphNode*);
     void prepare (double sampleRate, int blockSize, GraphNode*, bool willBeEnabled = false);
@@ -65,6 +65,9 @@ public:
     std::unique_ptr<XmlElement> createXml() const;
 
     void saveGraphState();
+
+    /** Like saveGraphState() but only re-serializes plugins which changed. */
+    void saveChangedGraphState();
     void restoreGraphState();
 
     inline int getNumControllers() const { return getControllersValueTree().getNumChildren(); }
@@ -102,6 +105,9 @@ public:
 
     /** Writes an encoded file */
     bool writeToFile (const File&) const;
+
+    /** Writes the session as uncompressed binary ValueTree data */
+    void writeToStream (OutputStream&) const;
     static ValueTree readFromFile (const File&);
 
     Value getActiveGraphIndexObject (bool syncUpdate = false) const
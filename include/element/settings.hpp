@@ -43,6 +43,14 @@ public:
     static const char* devicesKey;
     static const char* keymappingsKey;
     static const char* clockSourceKey;
+    static const char* renderBlockSizeKey;
+    static const char* fixedRenderBlockKey;
+    static const char* renderLookaheadKey;
+    static const char* doublePrecisionKey;
+    static const char* realtimePriorityKey;
+    static const char* workerThreadsKey;
+    static const char* ioThreadsKey;
+    static const char* threadAffinityKey;
 
     std::unique_ptr<juce::XmlElement> getLastGraph() const;
     void setLastGraph (const juce::ValueTree& data);
@@ -116,6 +124,38 @@ public:
     juce::String getClockSource() const;
     void setClockSource (const juce::String&);
 
+    /** Maximum samples rendered per graph call, 0 follows the host */
+    int getRenderBlockSize() const;
+    void setRenderBlockSize (int);
+
+    /** True if graphs render a fixed block size with one block of latency */
+    bool isRenderBlockSizeFixed() const;
+    void setRenderBlockSizeFixed (bool);
+
+    /** Number of blocks rendered ahead of the device, 0 disables */
+    int getRenderLookahead() const;
+    void setRenderLookahead (int);
+
+    /** True if graphs render with 64-bit buffers */
+    bool useDoublePrecision() const;
+    void setUseDoublePrecision (bool);
+
+    /** SCHED_FIFO priority of audio threads 1-99, 0 leaves it to the system */
+    int getRealtimePriority() const;
+    void setRealtimePriority (int);
+
+    /** Number of background worker threads, 0 picks one from the CPU count */
+    int getWorkerThreads() const;
+    void setWorkerThreads (int);
+
+    /** Number of disk IO threads, 0 picks the default */
+    int getIOThreads() const;
+    void setIOThreads (int);
+
+    /** CPU mask of a thread pool ("realtime", "worker" or "io"), 0 leaves it alone */
+    juce::uint64 getThreadAffinity (const juce::String& pool) const;
+    void setThreadAffinity (const juce::String& pool, juce::uint64 mask);
+
 private:
     juce::PropertiesFile* getProps() const;
 };
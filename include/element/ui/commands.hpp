@@ -60,6 +60,9 @@ public:
         panic,
         importSession,
 
+        recordRenderTrace,
+        exportRenderTrace,
+
         checkNewerVersion = 0x0500,
 
         signIn,
@@ -142,6 +145,9 @@ public:
             panic,
             importSession,
 
+            recordRenderTrace,
+            exportRenderTrace,
+
             checkNewerVersion,
 
             signIn,
@@ -235,6 +241,12 @@ public:
             case Commands::panic:
                 return "panic";
                 break;
+            case Commands::recordRenderTrace:
+                return "recordRenderTrace";
+                break;
+            case Commands::exportRenderTrace:
+                return "exportRenderTrace";
+                break;
             case Commands::graphNew:
                 return "graphNew";
                 break;
@@ -305,6 +317,10 @@ public:
 
         if (str == "panic")
             return Commands::panic;
+        if (str == "recordRenderTrace")
+            return Commands::recordRenderTrace;
+        if (str == "exportRenderTrace")
+            return Commands::exportRenderTrace;
 
         if (str == "graphNew")
             return Commands::graphNew;
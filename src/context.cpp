@@ -18,6 +18,7 @@
 #include "log.hpp"
 #include "module.hpp"
 #include "scripting.hpp"
+#include "threadpools.hpp"
 
 namespace element {
 
@@ -31,6 +32,9 @@ public:
 
     Context& owner;
 
+    // freed last, everything below may be using its threads
+    std::shared_ptr<ThreadPools> threads;
+
     std::unique_ptr<Services> services;
 
     AudioEnginePtr engine;
@@ -55,6 +59,8 @@ private:
 
         devices.reset (new DeviceManager());
         settings.reset (new Settings());
+        threads = ThreadPools::acquire();
+        threads->applySettings (*settings);
         mapping.reset (new MappingEngine());
         midi.reset (new MidiEngine());
         presets.reset (new PresetManager());
@@ -86,6 +92,9 @@ private:
         presets = nullptr;
         lua = nullptr;
         log = nullptr;
+
+        // stops the threads if no other Context holds them
+        threads = nullptr;
     }
 };
 
@@ -157,6 +166,12 @@ Settings& Context::settings()
     return *impl->settings;
 }
 
+ThreadPools& Context::threads()
+{
+    jassert (impl != nullptr && impl->threads != nullptr);
+    return *impl->threads;
+}
+
 SessionPtr Context::session()
 {
     return (impl) ? impl->session : nullptr;
@@ -70,6 +70,12 @@ public:
         return (t1 - t0);
     }
 
+    /** Return the filtered period, without this update's phase correction */
+    inline double period() const
+    {
+        return e2;
+    }
+
 private:
     double samplerate, periodSize;
     double e2, t0, t1;
@@ -2,16 +2,24 @@
 // SPDX-License-Identifier: GPL3-or-later
 
 #include <element/audioengine.hpp>
+#include "engine/denormals.hpp"
+#include "engine/deviceio.hpp"
 #include "engine/internalformat.hpp"
 #include "engine/midiclock.hpp"
 #include "engine/midichannelmap.hpp"
 #include "engine/midiengine.hpp"
+#include "engine/midikernel.hpp"
 #include "engine/miditranspose.hpp"
+#include "engine/lookaheadrenderer.hpp"
+#include "engine/renderadapter.hpp"
+#include "engine/rendertrace.hpp"
 #include <element/transport.hpp>
 #include "engine/rootgraph.hpp"
 #include <element/context.hpp>
+#include <element/devices.hpp>
 #include <element/settings.hpp>
 #include "tempo.hpp"
+#include "threadpools.hpp"
 
 #include "engine/trace.hpp"
 
@@ -34,14 +42,16 @@ struct RootGraphRender : public AsyncUpdater
 
     const int setCurrentGraph (const int index)
     {
-        if (index == currentGraph)
-            return currentGraph;
+        if (index == getCurrentGraphIndex())
+            return index;
+        pendingGraph = -1;
         currentGraph = index;
         triggerAsyncUpdate();
         return currentGraph;
     }
 
-    const int getCurrentGraphIndex() const { return currentGraph; }
+    /** Returns the requested graph, which may still be warming up. */
+    const int getCurrentGraphIndex() const { return pendingGraph >= 0 ? pendingGraph : currentGraph; }
 
     RootGraph* getCurrentGraph() const
     {
@@ -55,6 +65,9 @@ struct RootGraphRender : public AsyncUpdater
         numOutputChans = numOuts;
         audioTemp.setSize (jmax (numIns, numOuts), numSamples);
         audioOut.setSize (audioTemp.getNumChannels(), audioTemp.getNumSamples());
+        // the input is swapped with midiOut each block, so all three get storage
+        MidiKernel::reserve (midiOut);
+        MidiKernel::reserve (midiTemp);
     }
 
     void releaseBuffers()
@@ -80,6 +93,24 @@ struct RootGraphRender : public AsyncUpdater
             program.reset();
         }
 
+        if (pendingGraph >= 0)
+        {
+            currentGraph = pendingGraph;
+            pendingGraph = -1;
+        }
+        else if (currentGraph != lastGraph && isPositiveAndBelow (lastGraph, graphs.size()))
+        {
+            // wake a sleeping graph and let it render one block before it
+            // fades in, so the switch starts from a running graph.
+            auto* const next = getCurrentGraph();
+            if (next != nullptr && next->asleep)
+            {
+                wakeGraph (next);
+                pendingGraph = currentGraph;
+                currentGraph = lastGraph;
+            }
+        }
+
         auto* const current = getCurrentGraph();
         auto* const last = (lastGraph >= 0 && lastGraph < graphs.size()) ? getGraph (lastGraph) : nullptr;
 
@@ -97,7 +128,12 @@ struct RootGraphRender : public AsyncUpdater
         const RootGraph::RenderMode mode = current->getRenderMode();
         const bool modeChanged = graphChanged && mode != last->getRenderMode();
 
-        if (shouldProcess)
+        if (shouldProcess && ! graphChanged && isOnlyAudibleGraph (current))
+        {
+            // nothing to mix or fade, skip the temp and mix buffers
+            renderInPlace (current, buffer, midi);
+        }
+        else if (shouldProcess)
         {
             audioOut.setSize (numChans, numSamples, false, false, true);
             audioTemp.setSize (numChans, numSamples, false, false, true);
@@ -107,8 +143,28 @@ struct RootGraphRender : public AsyncUpdater
                 audioOut.clear (i, 0, numSamples);
             midiOut.clear();
 
+            // sleeping graphs render blocks with notes or controllers, so
+            // MIDI inputs inside them don't miss note offs
+            const bool midiArrived = hasNotesOrControllers (midi);
+
             for (auto* const graph : graphs)
             {
+                const bool heard = graph == current || (! graph->isSingle() && ! current->isSingle());
+                const bool fading = graphChanged && (graph == last || graph == current);
+                const bool canSleep = ! heard && ! fading && graph->engineIndex != pendingGraph;
+                const bool sendKill = (last == graph && graphChanged && last->isSingle())
+                                      || (graphChanged && current != nullptr && current->isSingle() && graph != current);
+                if (canSleep && graph->asleep)
+                {
+                    if (! sendKill && ! midiArrived)
+                        continue;
+                    // back to sleep after this block unless it makes sound
+                    graph->asleep = false;
+                }
+
+                if (! canSleep)
+                    wakeGraph (graph);
+
                 // copy inputs, clear outs if more than input count
                 for (int i = 0; i < numInputChans; ++i)
                     audioTemp.copyFrom (i, 0, buffer, i, 0, numSamples);
@@ -119,8 +175,7 @@ struct RootGraphRender : public AsyncUpdater
                 // connected to IO node outs
                 midiTemp.clear (0, numSamples);
 
-                if ((last == graph && graphChanged && last->isSingle())
-                    || (graphChanged && current != nullptr && current->isSingle() && graph != current))
+                if (sendKill)
                 {
                     // send kill messages to the last graph(s) when the graph changes
                     // see http://nickfever.com/music/midi-cc-list
@@ -147,7 +202,6 @@ struct RootGraphRender : public AsyncUpdater
                     MidiBuffer* tmpArray[] = { &midiTemp };
                     MidiPipe midiPipe (tmpArray, 1);
 
-                    const ScopedLock sl (graph->getPropertyLock());
                     if (graph->isSuspended())
                     {
                         graph->renderBypassed (audioTemp, midiPipe);
@@ -158,6 +212,9 @@ struct RootGraphRender : public AsyncUpdater
                     }
                 }
 
+                if (canSleep)
+                    updateSleepState (graph, numSamples);
+
                 if (graphChanged && ((current->isSingle() && current != graph) || (modeChanged && ! current->isSingle() && graph->isSingle())))
 
                 {
@@ -187,17 +244,7 @@ struct RootGraphRender : public AsyncUpdater
             for (int i = 0; i < numChans; ++i)
                 buffer.copyFrom (i, 0, audioOut, i, 0, numSamples);
 
-            // setup a program change if present
-            for (auto m : midi)
-            {
-                auto msg = m.getMessage();
-                if (m.samplePosition >= numSamples)
-                    break;
-                if (! msg.isProgramChange())
-                    continue;
-                program.program = msg.getProgramChangeNumber();
-                program.channel = msg.getChannel();
-            }
+            collectProgramChange (midi, numSamples);
 
             // done with input, swap it with the rendered output
             midi.swapWith (midiOut);
@@ -231,6 +278,11 @@ struct RootGraphRender : public AsyncUpdater
     void removeGraph (RootGraph* graph)
     {
         jassert (graphs.contains (graph));
+        if (pendingGraph >= 0)
+        {
+            currentGraph = pendingGraph;
+            pendingGraph = -1;
+        }
         graphs.removeFirstMatchingValue (graph);
         graph->engineIndex = -1;
         updateIndexes();
@@ -243,13 +295,106 @@ struct RootGraphRender : public AsyncUpdater
     int size() const { return graphs.size(); }
 
     RootGraph* getGraph (const int i) const { return graphs.getUnchecked (i); }
-    int getGraphIndex() const { return currentGraph; }
+    int getGraphIndex() const { return getCurrentGraphIndex(); }
     const Array<RootGraph*>& getGraphs() const { return graphs; }
 
 private:
     Array<RootGraph*> graphs;
     int currentGraph = -1;
     int lastGraph = -1;
+    int pendingGraph = -1;
+
+    /** Peak level below which an unheard graph counts as silent (-100 dB) */
+    static constexpr float sleepThreshold = 1.0e-5f;
+    /** How long an unheard graph must stay silent before it sleeps */
+    static constexpr double sleepHoldSeconds = 0.25;
+
+    /** Returns true if no graph but the current one renders this block. */
+    bool isOnlyAudibleGraph (RootGraph* current) const noexcept
+    {
+        if (pendingGraph >= 0)
+            return false;
+        for (auto* const graph : graphs)
+            if (graph != current && ! (graph->asleep && (graph->isSingle() || current->isSingle())))
+                return false;
+        return true;
+    }
+
+    /** Renders a graph straight into the host buffer and MIDI. Channels
+        past the inputs arrive cleared, by DeviceIO::begin or the plugin.
+     */
+    void renderInPlace (RootGraph* graph, AudioSampleBuffer& buffer, MidiBuffer& midi)
+    {
+        const int numSamples = buffer.getNumSamples();
+        const int numChans = buffer.getNumChannels();
+
+        // scan before rendering replaces the input
+        collectProgramChange (midi, numSamples);
+        wakeGraph (graph);
+
+        {
+            MidiBuffer* tmpArray[] = { &midi };
+            MidiPipe midiPipe (tmpArray, 1);
+
+            if (graph->isSuspended())
+                graph->renderBypassed (buffer, midiPipe);
+            else
+                graph->render (buffer, midiPipe);
+        }
+
+        for (int i = numOutputChans; i < numChans; ++i)
+            buffer.clear (i, 0, numSamples);
+    }
+
+    /** Setup a program change if present. */
+    void collectProgramChange (const MidiBuffer& midi, int numSamples) noexcept
+    {
+        for (auto m : midi)
+        {
+            if (m.samplePosition >= numSamples)
+                break;
+            auto msg = m.getMessage();
+            if (! msg.isProgramChange())
+                continue;
+            program.program = msg.getProgramChangeNumber();
+            program.channel = msg.getChannel();
+        }
+    }
+
+    static bool hasNotesOrControllers (const MidiBuffer& midi) noexcept
+    {
+        for (const auto meta : midi)
+        {
+            const int status = meta.data[0] & 0xf0;
+            if (meta.numBytes >= 3 && (status == 0x80 || status == 0x90 || status == 0xb0))
+                return true;
+        }
+        return false;
+    }
+
+    static void wakeGraph (RootGraph* graph) noexcept
+    {
+        graph->asleep = false;
+        graph->silentSamples = 0;
+    }
+
+    /** Put unheard graphs to sleep once their tail has decayed. */
+    void updateSleepState (RootGraph* graph, int numSamples) noexcept
+    {
+        bool silent = midiTemp.isEmpty();
+        for (int i = 0; silent && i < jmin (numOutputChans, audioTemp.getNumChannels()); ++i)
+            silent = audioTemp.getMagnitude (i, 0, numSamples) < sleepThreshold;
+
+        if (! silent)
+        {
+            graph->silentSamples = 0;
+            return;
+        }
+
+        graph->silentSamples += numSamples;
+        if (graph->silentSamples >= roundToInt (graph->getSampleRate() * sleepHoldSeconds))
+            graph->asleep = true;
+    }
 
     struct ProgramRequest
     {
@@ -305,8 +450,7 @@ public:
           blockSize (0),
           isPrepared (false),
           numInputChans (0),
-          numOutputChans (0),
-          tempBuffer (1, 1)
+          numOutputChans (0)
     {
         tempoValue.addListener (this);
         externalClockValue.addListener (this);
@@ -316,11 +460,13 @@ public:
         midiClock.addListener (this);
         graphs.onActiveGraphChanged = std::bind (&AudioEngine::Private::onCurrentGraphChanged, this);
         midiIOMonitor = new MidiIOMonitor();
+        blockTraceLabel = RenderTrace::getInstance().registerLabel ("Audio Block");
         startTimerHz (90);
     }
 
     ~Private()
     {
+        lookahead.stop();
         graphs.onActiveGraphChanged = nullptr;
         midiClock.removeListener (this);
         tempoValue.removeListener (this);
@@ -368,52 +514,19 @@ public:
                                            const AudioIODeviceCallbackContext& context) override
     {
         jassert (sampleRate > 0 && blockSize > 0);
-        int totalNumChans = 0;
-        ScopedNoDenormals denormals;
-
+        // timestamp MIDI output from the start of the callback so render time doesn't add jitter
+        const double callbackStartMs = Time::getMillisecondCounterHiRes();
+        const ScopedFlushDenormals flushDenormals;
+        // the device owns this thread, give it the user's priority and cpus once per start
+        if (threadOptionsPending.exchange (false, std::memory_order_acquire))
+            engine.context().threads().applyToCurrentThread (ThreadPools::realtime);
+
+        // inputs are copied to the outputs and metered in one pass, graphs render in place
+        auto buffer = deviceIO.begin (inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numSamples);
         for (int c = 0; c < numInputChannels; ++c)
-            inMeters.getObjectPointerUnchecked (c)->updateLevel (inputChannelData, c, numSamples);
-
-        if (numInputChannels > numOutputChannels)
-        {
-            // if there aren't enough output channels for the number of
-            // inputs, we need to create some temporary extra ones (can't
-            // use the input data in case it gets written to)
-            tempBuffer.setSize (numInputChannels - numOutputChannels, numSamples, false, false, true);
-
-            for (int i = 0; i < numOutputChannels; ++i)
-            {
-                channels[totalNumChans] = outputChannelData[i];
-                memcpy (channels[totalNumChans], inputChannelData[i], sizeof (float) * (size_t) numSamples);
-                ++totalNumChans;
-            }
-
-            for (int i = numOutputChannels; i < numInputChannels; ++i)
-            {
-                channels[totalNumChans] = tempBuffer.getWritePointer (i - numOutputChannels, 0);
-                memcpy (channels[totalNumChans], inputChannelData[i], sizeof (float) * (size_t) numSamples);
-                ++totalNumChans;
-            }
-        }
-        else
-        {
-            for (int i = 0; i < numInputChannels; ++i)
-            {
-                channels[totalNumChans] = outputChannelData[i];
-                memcpy (channels[totalNumChans], inputChannelData[i], sizeof (float) * (size_t) numSamples);
-                ++totalNumChans;
-            }
-
-            for (int i = numInputChannels; i < numOutputChannels; ++i)
-            {
-                channels[totalNumChans] = outputChannelData[i];
-                zeromem (channels[totalNumChans], sizeof (float) * (size_t) numSamples);
-                ++totalNumChans;
-            }
-        }
+            inMeters.getObjectPointerUnchecked (c)->updateLevel (deviceIO.getPeak (c, true), numSamples);
 
         const bool wasPlaying = transport.isPlaying();
-        AudioSampleBuffer buffer (channels, totalNumChans, numSamples);
         processCurrentGraph (buffer, incomingMidi);
 
         {
@@ -446,26 +559,70 @@ public:
                 {
                     midiIOMonitor->sent();
 #if JUCE_WINDOWS
-                    midiOut->sendBlockOfMessagesNow (incomingMidi);
-#else
-                    midiOut->sendBlockOfMessages (incomingMidi, delayMs + Time::getMillisecondCounterHiRes(), sampleRate);
+                    if (generateMidiClock.get() != 1)
+                        midiOut->sendBlockOfMessagesNow (incomingMidi);
+                    else
 #endif
+                        midiOut->sendBlockOfMessages (incomingMidi, delayMs + callbackStartMs, sampleRate);
                 }
             }
         }
 
+        deviceIO.end (outputChannelData, numOutputChannels, numSamples);
         for (int c = 0; c < numOutputChannels; ++c)
-            outMeters.getObjectPointerUnchecked (c)->updateLevel (outputChannelData, c, numSamples);
+            outMeters.getObjectPointerUnchecked (c)->updateLevel (deviceIO.getPeak (c, false), numSamples);
         incomingMidi.clear();
     }
 
     void processCurrentGraph (AudioBuffer<float>& buffer, MidiBuffer& midi)
     {
-        const int numSamples = buffer.getNumSamples();
-        messageCollector.removeNextBlockOfMessages (midi, numSamples);
+        // plugin hosts don't all flush denormals, a no-op from the device callback
+        const ScopedFlushDenormals flushDenormals;
+        const ScopedRenderTrace blockTrace (blockTraceLabel);
+        messageCollector.removeNextBlockOfMessages (midi, buffer.getNumSamples());
         // element::traceMidi (midi);
 
+        if (lookahead.process (buffer, midi))
+            return;
+
+        if (lookahead.isActive())
+        {
+            // the lookahead thread holds the lock through whole blocks, so
+            // rather than wait for it the block goes back to the ring
+            const ScopedTryLock sl (lock);
+            if (! sl.isLocked())
+            {
+                lookahead.defer (buffer, midi);
+                return;
+            }
+
+            renderLocked (buffer, midi);
+            return;
+        }
+
+        renderBuffers (buffer, midi);
+    }
+
+    /** Renders a host sized buffer. Called directly from the audio callback
+        or ahead of time on the lookahead thread.
+     */
+    void renderBuffers (AudioBuffer<float>& buffer, MidiBuffer& midi)
+    {
         const ScopedLock sl (lock);
+        renderLocked (buffer, midi);
+    }
+
+    void renderLocked (AudioBuffer<float>& buffer, MidiBuffer& midi)
+    {
+        renderAdapter.process (buffer, midi, [this] (AudioBuffer<float>& block, MidiBuffer& blockMidi) {
+            renderBlock (block, blockMidi);
+        });
+    }
+
+    /** Renders one block no larger than the prepared block size. */
+    void renderBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
+    {
+        const int numSamples = buffer.getNumSamples();
         const bool shouldProcess = shouldBeLocked.get() == 0;
         const bool wasPlaying = transport.isPlaying();
         transport.preProcess (numSamples);
@@ -523,21 +680,34 @@ public:
         const int numChansIn = device->getActiveInputChannels().countNumberOfSetBits();
         const int numChansOut = device->getActiveOutputChannels().countNumberOfSetBits();
         audioAboutToStart (newSampleRate, newBlockSize, numChansIn, numChansOut);
+        threadOptionsPending.store (true, std::memory_order_release);
+        runningOnDevice = true;
     }
 
     void audioAboutToStart (const double newSampleRate, const int newBlockSize, const int numChansIn, const int numChansOut)
+    {
+        // the lookahead thread renders under the lock, stop it first
+        lookahead.stop();
+        prepareLocked (newSampleRate, newBlockSize, numChansIn, numChansOut);
+        updateLookahead();
+    }
+
+    void prepareLocked (const double newSampleRate, const int newBlockSize, const int numChansIn, const int numChansOut)
     {
         const ScopedLock sl (lock);
 
         sampleRate = newSampleRate;
-        blockSize = newBlockSize;
+        hostBlockSize = newBlockSize;
+        blockSize = jlimit (1, maxRenderBlockSize, renderBlockSize > 0 ? renderBlockSize : newBlockSize);
         numInputChans = numChansIn;
         numOutputChans = numChansOut;
+        renderAdapter.prepare (jmax (numChansIn, numChansOut), blockSize, fixedRenderBlock);
 
         midiClock.reset (sampleRate, blockSize);
         messageCollector.reset (sampleRate);
         keyboardState.addListener (&messageCollector);
-        channels.calloc ((size_t) jmax (numChansIn, numChansOut) + 2);
+        deviceIO.prepare (numChansIn, numChansOut, hostBlockSize);
+        MidiKernel::reserve (incomingMidi);
 
         graphs.prepareBuffers (numInputChans, numOutputChans, blockSize);
 
@@ -558,20 +728,102 @@ public:
 
     void audioDeviceStopped() override
     {
+        runningOnDevice = false;
         audioStopped();
     }
 
     void audioStopped()
     {
+        lookahead.stop();
         const ScopedLock sl (lock);
         keyboardState.removeListener (&messageCollector);
         if (isPrepared)
             releaseResources();
         isPrepared = false;
         sampleRate = 0.0;
-        blockSize = 0;
-        tempBuffer.setSize (1, 1);
+        blockSize = hostBlockSize = 0;
+        deviceIO.release();
         graphs.releaseBuffers();
+        renderAdapter.release();
+    }
+
+    /** Stops and starts this callback on the device so settings that need
+        a prepare take effect. The device callback uses buffers a prepare
+        reallocates, so the engine is never prepared under it. Hosts pick
+        the settings up the next time they prepare the plugin.
+     */
+    void restartOnDevice()
+    {
+        if (! runningOnDevice || engine.getRunMode() != RunMode::Standalone)
+            return;
+        auto& devices = engine.context().devices();
+        devices.removeAudioCallback (this);
+        devices.addAudioCallback (this);
+    }
+
+    void setRenderBlockSize (int newBlockSize, bool fixed)
+    {
+        {
+            const ScopedLock sl (lock);
+            if (newBlockSize == renderBlockSize && fixed == fixedRenderBlock)
+                return;
+            renderBlockSize = newBlockSize;
+            fixedRenderBlock = fixed;
+        }
+
+        restartOnDevice();
+    }
+
+    void setDoublePrecision (bool useDouble)
+    {
+        {
+            const ScopedLock sl (lock);
+            if (useDouble == doublePrecision)
+                return;
+            doublePrecision = useDouble;
+        }
+
+        restartOnDevice();
+    }
+
+    /** Like syncLookahead, then reports the latency if the lookahead
+        changed it. Do not call with the lock held.
+     */
+    void updateLookahead()
+    {
+        syncLookahead();
+        if (lookahead.getLatencySamples() != reportedLookaheadLatency)
+            engine.updateExternalLatencySamples();
+    }
+
+    /** Starts, restarts or stops the lookahead thread to match settings and
+        the current graphs. Graphs fed by live audio input keep the engine on
+        the direct path. Do not call with the lock held.
+     */
+    void syncLookahead()
+    {
+        bool liveInput = false;
+        for (auto* const graph : graphs.getGraphs())
+            liveInput |= graph->usesLiveAudioInput();
+
+        const bool wanted = lookaheadDepth > 0 && isPrepared && hostBlockSize > 0
+                            && engine.getRunMode() == RunMode::Standalone
+                            && ! liveInput;
+        const int numChans = jmax (numInputChans, numOutputChans);
+
+        if (! wanted)
+        {
+            lookahead.stop();
+            return;
+        }
+
+        if (lookahead.isActive() && lookahead.getDepth() == lookaheadDepth
+            && lookahead.getBlockSize() == hostBlockSize && lookahead.getNumChannels() == jmax (1, numChans))
+            return;
+
+        lookahead.start (numChans, hostBlockSize, lookaheadDepth, [this] (AudioBuffer<float>& buffer, MidiBuffer& midi) {
+            renderBuffers (buffer, midi);
+        });
     }
 
     void handleIncomingMidiMessage (MidiInput*, const MidiMessage& message) override
@@ -580,7 +832,7 @@ public:
             midiIOMonitor->received();
         messageCollector.addMessageToQueue (message);
         const bool clockWanted = processMidiClock.get() > 0 && sessionWantsExternalClock.get() > 0;
-        if (clockWanted && message.isMidiClock())
+        if (clockWanted && (message.isMidiClock() || message.isSongPositionPointer()))
         {
             midiClock.process (message);
         }
@@ -684,6 +936,15 @@ public:
     void midiClockSignalAcquired() override {}
     void midiClockSignalDropped() override {}
 
+    void midiClockSongPositionChanged (const int midiBeats) override
+    {
+        if (sessionWantsExternalClock.get() <= 0 || processMidiClock.get() <= 0 || sampleRate <= 0.0)
+            return;
+        const double bpm = midiClock.getTempo() > 0.0 ? midiClock.getTempo() : (double) transport.getTempo();
+        const double quarterNotes = (double) midiBeats * 0.25;
+        transport.requestAudioFrame ((int64) (quarterNotes * (60.0 / bpm) * sampleRate));
+    }
+
     bool isUsingExternalClock() const
     {
         if (engine.getRunMode() == RunMode::Plugin)
@@ -704,12 +965,24 @@ private:
     CriticalSection lock;
     double sampleRate = 0.0;
     int blockSize = 0;
+    int hostBlockSize = 0;
     bool isPrepared = false;
+
+    // graphs never render more than this per call, see GraphNode::buildRenderingSequence
+    static constexpr int maxRenderBlockSize = 4096;
+    int renderBlockSize = 0;
+    bool fixedRenderBlock = false;
+    bool doublePrecision = false;
+    RenderAdapter renderAdapter;
+    int lookaheadDepth = 0;
+    LookaheadRenderer lookahead;
     Atomic<int> currentGraph;
 
     int numInputChans, numOutputChans;
-    HeapBlock<float*> channels;
-    AudioSampleBuffer tempBuffer;
+    std::atomic<bool> threadOptionsPending { false };
+    bool runningOnDevice = false;
+    int reportedLookaheadLatency = 0;
+    DeviceIO deviceIO;
     MidiBuffer incomingMidi;
     MidiMessageCollector messageCollector;
     MidiKeyboardState keyboardState;
@@ -727,6 +1000,7 @@ private:
     MidiClockMaster midiClockMaster;
 
     int latencySamples = 0;
+    uint32 blockTraceLabel = 0;
 
     // GraphRender::locked must match this default value
     Atomic<int> shouldBeLocked { 0 };
@@ -741,6 +1015,7 @@ private:
     {
         graph->setRenderDetails (sampleRate, blockSize);
         graph->setPlayHead (&transport);
+        graph->setDoublePrecision (doublePrecision);
         graph->prepareToRender (sampleRate, estimatedBlockSize);
     }
 
@@ -818,6 +1093,48 @@ void AudioEngine::applySettings (Settings& settings)
     priv->generateMidiClock.set (settings.generateMidiClock() ? 1 : 0);
     priv->sendMidiClockToInput.set (settings.sendMidiClockToInput() ? 1 : 0);
     priv->midiOutLatency.set (settings.getMidiOutLatency());
+    setRenderBlockSize (settings.getRenderBlockSize(), settings.isRenderBlockSizeFixed());
+    setRenderLookahead (settings.getRenderLookahead());
+    setDoublePrecision (settings.useDoublePrecision());
+}
+
+void AudioEngine::setRenderLookahead (int numBlocks)
+{
+    if (priv == nullptr || priv->lookaheadDepth == jmax (0, numBlocks))
+        return;
+    priv->lookaheadDepth = jmax (0, numBlocks);
+    updateExternalLatencySamples();
+}
+
+int AudioEngine::getRenderLookahead() const
+{
+    return priv != nullptr ? priv->lookaheadDepth : 0;
+}
+
+void AudioEngine::setRenderBlockSize (int blockSize, bool fixed)
+{
+    if (priv == nullptr)
+        return;
+    const bool latencyChanged = fixed || priv->fixedRenderBlock;
+    priv->setRenderBlockSize (blockSize, fixed);
+    if (latencyChanged)
+        updateExternalLatencySamples();
+}
+
+int AudioEngine::getRenderBlockSize() const
+{
+    return priv != nullptr ? priv->blockSize : 0;
+}
+
+void AudioEngine::setDoublePrecision (bool useDouble)
+{
+    if (priv != nullptr)
+        priv->setDoublePrecision (useDouble);
+}
+
+bool AudioEngine::isUsingDoublePrecision() const
+{
+    return priv != nullptr && priv->doublePrecision;
 }
 
 bool AudioEngine::removeGraph (RootGraph* graph)
@@ -910,7 +1227,11 @@ void AudioEngine::seekToAudioFrame (const int64 frame)
 void AudioEngine::prepareExternalPlayback (const double sampleRate, const int blockSize, const int numIns, const int numOuts)
 {
     if (priv)
+    {
         priv->audioAboutToStart (sampleRate, blockSize, numIns, numOuts);
+        if (priv->fixedRenderBlock)
+            updateExternalLatencySamples();
+    }
 }
 
 void AudioEngine::processExternalBuffers (AudioBuffer<float>& buffer, MidiBuffer& midi)
@@ -959,6 +1280,7 @@ Context& AudioEngine::context() const { return world; }
 
 void AudioEngine::updateExternalLatencySamples()
 {
+    priv->syncLookahead();
     int latencySamples = 0;
 
     {
@@ -980,7 +1302,10 @@ void AudioEngine::updateExternalLatencySamples()
         }
     }
 
-    priv->latencySamples = latencySamples;
+    priv->reportedLookaheadLatency = priv->lookahead.getLatencySamples();
+    priv->latencySamples = latencySamples
+                           + priv->renderAdapter.getLatencySamples()
+                           + priv->reportedLookaheadLatency;
     sampleLatencyChanged();
 }
 
@@ -1005,37 +1330,18 @@ AudioEngine::LevelMeterPtr AudioEngine::getLevelMeter (int channel, bool input)
     return larr[channel];
 }
 
-void AudioEngine::LevelMeter::updateLevel (const float* const* channelData, int numChannels, int numSamples) noexcept
+void AudioEngine::LevelMeter::updateLevel (float blockPeak, int numSamples) noexcept
 {
     if (getReferenceCount() <= 1)
         return;
 
-    auto localLevel = _level.get();
-
-    if (numChannels >= 0)
-    {
-        for (int j = 0; j < numSamples; ++j)
-        {
-            float s = 0;
-
-            s += std::abs (channelData[numChannels][j]);
-
-            // s /= (float) numChannels;
-
-            const float decayFactor = 0.99992f;
-
-            if (s > localLevel)
-                localLevel = s;
-            else if (localLevel > 0.001f)
-                localLevel *= decayFactor;
-            else
-                localLevel = 0;
-        }
-    }
-    else
-    {
+    // same ballistics as decaying once per sample, from the block's peak
+    const float decayFactor = 0.99992f;
+    auto localLevel = _level.get() * std::pow (decayFactor, (float) numSamples);
+    if (blockPeak > localLevel)
+        localLevel = blockPeak;
+    else if (localLevel <= 0.001f)
         localLevel = 0;
-    }
 
     _level.set (localLevel);
 }
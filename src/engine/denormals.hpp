@@ -0,0 +1,52 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/audio_basics.hpp>
+
+namespace element {
+
+/** Flushes denormals to zero on the calling thread while in scope.
+
+    Every entry point that renders graphs or calls into plugins holds one,
+    so decaying feedback in reverbs and filters never falls into slow
+    denormal arithmetic. Guards nest cheaply: if the thread already
+    flushes, nothing is changed or restored.
+ */
+class ScopedFlushDenormals final
+{
+public:
+    ScopedFlushDenormals() noexcept
+        : changed (! juce::FloatVectorOperations::areDenormalsDisabled())
+    {
+        if (changed)
+            juce::FloatVectorOperations::disableDenormalisedNumberSupport (true);
+    }
+
+    ~ScopedFlushDenormals() noexcept
+    {
+        if (changed)
+            juce::FloatVectorOperations::disableDenormalisedNumberSupport (false);
+    }
+
+private:
+    const bool changed;
+    JUCE_DECLARE_NON_COPYABLE (ScopedFlushDenormals)
+};
+
+/** Flushes denormals to zero for the rest of the calling thread's life.
+    For threads that only render or run plugin work.
+ */
+inline void flushDenormalsOnThisThread() noexcept
+{
+    juce::FloatVectorOperations::disableDenormalisedNumberSupport (true);
+}
+
+/** Returns true if the calling thread flushes denormals to zero. */
+inline bool isFlushingDenormals() noexcept
+{
+    return juce::FloatVectorOperations::areDenormalsDisabled();
+}
+
+} // namespace element
@@ -0,0 +1,100 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/deviceio.hpp"
+#include "engine/gainkernel.hpp"
+
+using namespace juce;
+
+namespace element {
+
+void DeviceIO::prepare (int numIns, int numOuts, int blockSize)
+{
+    reserve (numIns, numOuts);
+    spare.setSize (jmax (1, numIns - numOuts), jmax (1, blockSize));
+    bytesMoved = 0;
+}
+
+void DeviceIO::release()
+{
+    channels.free();
+    inPeaks.free();
+    outPeaks.free();
+    spare.setSize (1, 1);
+    maxIns = maxOuts = 0;
+    bytesMoved = 0;
+}
+
+void DeviceIO::reserve (int numIns, int numOuts)
+{
+    maxIns = jmax (0, numIns);
+    maxOuts = jmax (0, numOuts);
+    channels.calloc ((size_t) jmax (maxIns, maxOuts) + 2);
+    inPeaks.calloc ((size_t) maxIns + 1);
+    outPeaks.calloc ((size_t) maxOuts + 1);
+}
+
+AudioBuffer<float> DeviceIO::begin (const float* const* inputs, int numIns, float* const* outputs, int numOuts, int numSamples) noexcept
+{
+    // prepare() runs when the device starts, never allocate here. Anything
+    // beyond what it was given is left out and its outputs silenced.
+    jassert (numIns <= maxIns && numOuts <= maxOuts);
+    const int numOutsUsed = jmin (numOuts, maxOuts);
+    const int numInsUsed = jmin (numIns, maxIns);
+    const int numShared = jmin (numInsUsed, numOutsUsed);
+    const int numSpare = numSamples <= spare.getNumSamples()
+                             ? jlimit (0, spare.getNumChannels(), numInsUsed - numOutsUsed)
+                             : 0;
+
+    const auto blockBytes = sizeof (float) * (size_t) numSamples;
+    int numChans = 0;
+    bytesMoved = 0;
+
+    for (int i = 0; i < numShared; ++i)
+    {
+        channels[numChans++] = outputs[i];
+        inPeaks[i] = GainKernel::copyAndMeasure (outputs[i], inputs[i], numSamples).peak;
+        bytesMoved += blockBytes * 2;
+    }
+
+    // can't render in the input buffers, the device may reuse them
+    for (int i = numShared; i < numInsUsed; ++i)
+    {
+        if (i - numShared >= numSpare)
+        {
+            inPeaks[i] = 0.f;
+            continue;
+        }
+
+        auto* const dest = spare.getWritePointer (i - numShared);
+        channels[numChans++] = dest;
+        inPeaks[i] = GainKernel::copyAndMeasure (dest, inputs[i], numSamples).peak;
+        bytesMoved += blockBytes * 2;
+    }
+
+    for (int i = numShared; i < numOuts; ++i)
+    {
+        if (i < numOutsUsed)
+            channels[numChans++] = outputs[i];
+        FloatVectorOperations::clear (outputs[i], numSamples);
+        bytesMoved += blockBytes;
+    }
+
+    return { channels.getData(), numChans, numSamples };
+}
+
+void DeviceIO::end (const float* const* outputs, int numOuts, int numSamples) noexcept
+{
+    for (int i = 0; i < jmin (numOuts, maxOuts); ++i)
+        outPeaks[i] = GainKernel::measure (outputs[i], numSamples).peak;
+    bytesMoved += sizeof (float) * (size_t) numSamples * (size_t) jmin (numOuts, maxOuts);
+}
+
+float DeviceIO::getPeak (int channel, bool input) const noexcept
+{
+    if (input)
+        return isPositiveAndBelow (channel, maxIns) ? inPeaks[channel] : 0.f;
+    return isPositiveAndBelow (channel, maxOuts) ? outPeaks[channel] : 0.f;
+}
+
+} // namespace element
@@ -0,0 +1,55 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/audio_basics.hpp>
+
+namespace element {
+
+/** Stages audio device buffers for the render graph.
+
+    Inputs are copied straight into the device's output channels and
+    metered in the same pass, so graphs render in place in the device
+    buffers. Inputs beyond the output count go to spare channels allocated
+    by prepare(). Nothing allocates in the audio callback: channels or spare
+    samples beyond what prepare() was given are left out of the render, and
+    their outputs are silenced.
+ */
+class DeviceIO final
+{
+public:
+    DeviceIO() = default;
+    ~DeviceIO() = default;
+
+    /** Allocate for the given channel counts and block size. Not realtime safe. */
+    void prepare (int numIns, int numOuts, int blockSize);
+
+    /** Free all buffers. */
+    void release();
+
+    /** Copies device inputs into the outputs and returns a buffer over them
+        to render. Outputs without an input are cleared.
+     */
+    juce::AudioBuffer<float> begin (const float* const* inputs, int numIns, float* const* outputs, int numOuts, int numSamples) noexcept;
+
+    /** Meters the rendered outputs. */
+    void end (const float* const* outputs, int numOuts, int numSamples) noexcept;
+
+    /** Returns the peak of a channel in the last block. */
+    float getPeak (int channel, bool input) const noexcept;
+
+    /** Returns the bytes read and written by the last begin() and end(). */
+    size_t getBytesMoved() const noexcept { return bytesMoved; }
+
+private:
+    juce::HeapBlock<float*> channels;
+    juce::HeapBlock<float> inPeaks, outPeaks;
+    juce::AudioBuffer<float> spare;
+    int maxIns = 0, maxOuts = 0;
+    size_t bytesMoved = 0;
+
+    void reserve (int numIns, int numOuts);
+};
+
+} // namespace element
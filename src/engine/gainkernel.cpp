@@ -0,0 +1,257 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "engine/gainkernel.hpp"
+
+namespace element {
+
+namespace {
+constexpr int numLanes = 8;
+
+template <bool WriteOutput, bool Measure, typename FloatType>
+ChannelLevel process (FloatType* data, int numSamples, FloatType startGain, FloatType endGain) noexcept
+{
+    ChannelLevel level;
+    if (numSamples <= 0)
+        return level;
+
+    const FloatType step = (endGain - startGain) / (FloatType) numSamples;
+    const FloatType laneStep = step * (FloatType) numLanes;
+
+    FloatType gains[numLanes], squares[numLanes], peaks[numLanes];
+    for (int l = 0; l < numLanes; ++l)
+    {
+        gains[l] = startGain + step * (FloatType) l;
+        squares[l] = peaks[l] = 0;
+    }
+
+    int i = 0;
+    for (; i + numLanes <= numSamples; i += numLanes)
+    {
+        FloatType* const block = data + i;
+        for (int l = 0; l < numLanes; ++l)
+        {
+            const FloatType sample = WriteOutput ? block[l] * gains[l] : block[l];
+            if (WriteOutput)
+                block[l] = sample;
+            if (Measure)
+            {
+                squares[l] += sample * sample;
+                peaks[l] = std::max (peaks[l], std::abs (sample));
+            }
+            gains[l] += laneStep;
+        }
+    }
+
+    FloatType gain = startGain + step * (FloatType) i;
+    for (; i < numSamples; ++i)
+    {
+        const FloatType sample = WriteOutput ? data[i] * gain : data[i];
+        if (WriteOutput)
+            data[i] = sample;
+        if (Measure)
+        {
+            squares[0] += sample * sample;
+            peaks[0] = std::max (peaks[0], std::abs (sample));
+        }
+        gain += step;
+    }
+
+    if (Measure)
+    {
+        FloatType sum = 0, peak = 0;
+        for (int l = 0; l < numLanes; ++l)
+        {
+            sum += squares[l];
+            peak = std::max (peak, peaks[l]);
+        }
+        level.rms = (float) std::sqrt (sum / (FloatType) numSamples);
+        level.peak = (float) peak;
+    }
+
+    return level;
+}
+
+template <bool Measure>
+ChannelLevel accumulate (float* dest, const float* source, int numSamples, float startGain, float endGain) noexcept
+{
+    ChannelLevel level;
+    if (numSamples <= 0)
+        return level;
+
+    const float step = (endGain - startGain) / (float) numSamples;
+    const float laneStep = step * (float) numLanes;
+
+    float gains[numLanes], squares[numLanes], peaks[numLanes];
+    for (int l = 0; l < numLanes; ++l)
+    {
+        gains[l] = startGain + step * (float) l;
+        squares[l] = peaks[l] = 0.f;
+    }
+
+    int i = 0;
+    for (; i + numLanes <= numSamples; i += numLanes)
+    {
+        for (int l = 0; l < numLanes; ++l)
+        {
+            const float sample = source[i + l] * gains[l];
+            dest[i + l] += sample;
+            if (Measure)
+            {
+                squares[l] += sample * sample;
+                peaks[l] = std::max (peaks[l], std::abs (sample));
+            }
+            gains[l] += laneStep;
+        }
+    }
+
+    float gain = startGain + step * (float) i;
+    for (; i < numSamples; ++i)
+    {
+        const float sample = source[i] * gain;
+        dest[i] += sample;
+        if (Measure)
+        {
+            squares[0] += sample * sample;
+            peaks[0] = std::max (peaks[0], std::abs (sample));
+        }
+        gain += step;
+    }
+
+    if (Measure)
+    {
+        float sum = 0.f, peak = 0.f;
+        for (int l = 0; l < numLanes; ++l)
+        {
+            sum += squares[l];
+            peak = std::max (peak, peaks[l]);
+        }
+        level.rms = std::sqrt (sum / (float) numSamples);
+        level.peak = peak;
+    }
+
+    return level;
+}
+
+ChannelLevel copy (float* dest, const float* source, int numSamples) noexcept
+{
+    ChannelLevel level;
+    if (numSamples <= 0)
+        return level;
+
+    float squares[numLanes], peaks[numLanes];
+    for (int l = 0; l < numLanes; ++l)
+        squares[l] = peaks[l] = 0.f;
+
+    int i = 0;
+    for (; i + numLanes <= numSamples; i += numLanes)
+    {
+        for (int l = 0; l < numLanes; ++l)
+        {
+            const float sample = source[i + l];
+            dest[i + l] = sample;
+            squares[l] += sample * sample;
+            peaks[l] = std::max (peaks[l], std::abs (sample));
+        }
+    }
+
+    for (; i < numSamples; ++i)
+    {
+        const float sample = source[i];
+        dest[i] = sample;
+        squares[0] += sample * sample;
+        peaks[0] = std::max (peaks[0], std::abs (sample));
+    }
+
+    float sum = 0.f, peak = 0.f;
+    for (int l = 0; l < numLanes; ++l)
+    {
+        sum += squares[l];
+        peak = std::max (peak, peaks[l]);
+    }
+    level.rms = std::sqrt (sum / (float) numSamples);
+    level.peak = peak;
+    return level;
+}
+
+template <typename FloatType>
+void applyGain (FloatType* data, int numSamples, float startGain, float endGain) noexcept
+{
+    if (GainKernel::isUnity (startGain, endGain) || numSamples <= 0)
+        return;
+
+    if (startGain == 0.f && endGain == 0.f)
+    {
+        std::memset (data, 0, sizeof (FloatType) * (size_t) numSamples);
+        return;
+    }
+
+    process<true, false> (data, numSamples, (FloatType) startGain, (FloatType) endGain);
+}
+
+template <typename FloatType>
+ChannelLevel applyGainAndMeasure (FloatType* data, int numSamples, float startGain, float endGain) noexcept
+{
+    if (GainKernel::isUnity (startGain, endGain))
+        return process<false, true> (data, numSamples, (FloatType) 1, (FloatType) 1);
+
+    if (startGain == 0.f && endGain == 0.f)
+    {
+        if (numSamples > 0)
+            std::memset (data, 0, sizeof (FloatType) * (size_t) numSamples);
+        return {};
+    }
+
+    return process<true, true> (data, numSamples, (FloatType) startGain, (FloatType) endGain);
+}
+} // namespace
+
+void GainKernel::apply (float* data, int numSamples, float startGain, float endGain) noexcept
+{
+    applyGain (data, numSamples, startGain, endGain);
+}
+
+void GainKernel::apply (double* data, int numSamples, float startGain, float endGain) noexcept
+{
+    applyGain (data, numSamples, startGain, endGain);
+}
+
+ChannelLevel GainKernel::applyAndMeasure (float* data, int numSamples, float startGain, float endGain) noexcept
+{
+    return applyGainAndMeasure (data, numSamples, startGain, endGain);
+}
+
+ChannelLevel GainKernel::applyAndMeasure (double* data, int numSamples, float startGain, float endGain) noexcept
+{
+    return applyGainAndMeasure (data, numSamples, startGain, endGain);
+}
+
+ChannelLevel GainKernel::measure (const float* data, int numSamples) noexcept
+{
+    return process<false, true> (const_cast<float*> (data), numSamples, 1.f, 1.f);
+}
+
+ChannelLevel GainKernel::copyAndMeasure (float* dest, const float* source, int numSamples) noexcept
+{
+    return copy (dest, source, numSamples);
+}
+
+void GainKernel::add (float* dest, const float* source, int numSamples, float startGain, float endGain) noexcept
+{
+    if (startGain == 0.f && endGain == 0.f)
+        return;
+    accumulate<false> (dest, source, numSamples, startGain, endGain);
+}
+
+ChannelLevel GainKernel::addAndMeasure (float* dest, const float* source, int numSamples, float startGain, float endGain) noexcept
+{
+    if (startGain == 0.f && endGain == 0.f)
+        return {};
+    return accumulate<true> (dest, source, numSamples, startGain, endGain);
+}
+
+} // namespace element
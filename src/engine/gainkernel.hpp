@@ -0,0 +1,51 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+namespace element {
+
+/** Level of one channel after a gain pass. */
+struct ChannelLevel
+{
+    float rms = 0.f;
+    float peak = 0.f;
+};
+
+/** Single pass gain and metering kernels used by the render graph.
+
+    Gains ramp linearly from start to end across the block, the same as
+    AudioBuffer::applyGainRamp. Pass equal values for a constant gain.
+    The loops are split into independent lanes so the compiler can
+    vectorize them. The double overloads serve 64-bit graphs.
+ */
+struct GainKernel
+{
+    /** Returns true if a gain pass from start to end changes nothing. */
+    static bool isUnity (float startGain, float endGain) noexcept
+    {
+        return startGain == 1.f && endGain == 1.f;
+    }
+
+    /** Applies the gain in place. */
+    static void apply (float* data, int numSamples, float startGain, float endGain) noexcept;
+    static void apply (double* data, int numSamples, float startGain, float endGain) noexcept;
+
+    /** Applies the gain in place and returns the level of the result. */
+    static ChannelLevel applyAndMeasure (float* data, int numSamples, float startGain, float endGain) noexcept;
+    static ChannelLevel applyAndMeasure (double* data, int numSamples, float startGain, float endGain) noexcept;
+
+    /** Returns the level of a block without changing it. */
+    static ChannelLevel measure (const float* data, int numSamples) noexcept;
+
+    /** Copies source to dest and returns the level of the block in one pass. */
+    static ChannelLevel copyAndMeasure (float* dest, const float* source, int numSamples) noexcept;
+
+    /** Adds source times the gain to dest in one pass. */
+    static void add (float* dest, const float* source, int numSamples, float startGain, float endGain) noexcept;
+
+    /** Adds source times the gain to dest and returns the level of what was added. */
+    static ChannelLevel addAndMeasure (float* dest, const float* source, int numSamples, float startGain, float endGain) noexcept;
+};
+
+} // namespace element
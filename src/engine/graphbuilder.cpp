@@ -2,46 +2,32 @@
 // SPDX-License-Identifier: GPL3-or-later
 
 #include <element/processor.hpp>
-#include "engine/miditranspose.hpp"
+#include "engine/gainkernel.hpp"
+#include "engine/midikernel.hpp"
 #include "engine/graphnode.hpp"
 #include "engine/graphbuilder.hpp"
 #include "engine/ionode.hpp"
+#include "engine/rendertrace.hpp"
 
 namespace element {
 
-class BindParameterOp : public GraphOp,
-                        public Parameter::Listener
+/** Runs an op's process() template for either sample type. */
+template <class OpType>
+class TypedGraphOp : public GraphOp
 {
 public:
-    BindParameterOp (ParameterPtr src, ParameterPtr dst)
-        : param1 (src), param2 (dst)
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples) override
     {
-        param1->addListener (this);
+        static_cast<OpType*> (this)->process (sharedBufferChans, sharedMidiBuffers, numSamples);
     }
 
-    ~BindParameterOp()
+    void perform (AudioBuffer<double>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples) override
     {
-        param1->removeListener (this);
+        static_cast<OpType*> (this)->process (sharedBufferChans, sharedMidiBuffers, numSamples);
     }
-
-    void controlValueChanged (int index, float value) override
-    {
-        juce::ignoreUnused (index);
-        param2->setValueNotifyingHost (value);
-    }
-
-    void controlTouched (int index, bool grabbed) override
-    {
-    }
-
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>&, const int) override {}
-
-private:
-    ParameterPtr param1, param2;
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BindParameterOp)
 };
 
-class ClearChannelOp : public GraphOp
+class ClearChannelOp : public TypedGraphOp<ClearChannelOp>
 {
 public:
     ClearChannelOp (const int channelNum_)
@@ -49,7 +35,8 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
     {
         sharedBufferChans.clear (channelNum, 0, numSamples);
     }
@@ -60,7 +47,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (ClearChannelOp)
 };
 
-class CopyChannelOp : public GraphOp
+class CopyChannelOp : public TypedGraphOp<CopyChannelOp>
 {
 public:
     CopyChannelOp (const int srcChannelNum_, const int dstChannelNum_)
@@ -69,7 +56,8 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
     {
         sharedBufferChans.copyFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
     }
@@ -80,7 +68,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (CopyChannelOp)
 };
 
-class AddChannelOp : public GraphOp
+class AddChannelOp : public TypedGraphOp<AddChannelOp>
 {
 public:
     AddChannelOp (const int srcChannelNum_, const int dstChannelNum_)
@@ -89,7 +77,8 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
     {
         sharedBufferChans.addFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
     }
@@ -100,7 +89,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (AddChannelOp)
 };
 
-class ClearMidiBufferOp : public GraphOp
+class ClearMidiBufferOp : public TypedGraphOp<ClearMidiBufferOp>
 {
 public:
     ClearMidiBufferOp (const int bufferNum_)
@@ -108,7 +97,8 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
     {
         sharedMidiBuffers.getUnchecked (bufferNum)->clear();
     }
@@ -119,7 +109,7 @@ private:
     JUCE_DECLARE_NON_COPYABLE (ClearMidiBufferOp)
 };
 
-class CopyMidiBufferOp : public GraphOp
+class CopyMidiBufferOp : public TypedGraphOp<CopyMidiBufferOp>
 {
 public:
     CopyMidiBufferOp (const int srcBufferNum_, const int dstBufferNum_)
@@ -128,9 +118,10 @@ public:
     {
     }
 
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
     {
-        *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
+        MidiKernel::copy (*sharedMidiBuffers.getUnchecked (srcBufferNum), *sharedMidiBuffers.getUnchecked (dstBufferNum));
     }
 
 private:
@@ -139,28 +130,41 @@ private:
     JUCE_DECLARE_NON_COPYABLE (CopyMidiBufferOp)
 };
 
-class AddMidiBufferOp : public GraphOp
+/** Merges several MIDI buffers in one pass. The destination may be one of
+    the sources: the merge goes to the scratch buffer and is swapped in. */
+class MergeMidiBuffersOp : public TypedGraphOp<MergeMidiBuffersOp>
 {
 public:
-    AddMidiBufferOp (const int srcBufferNum_, const int dstBufferNum_)
-        : srcBufferNum (srcBufferNum_),
+    MergeMidiBuffersOp (const Array<int>& srcBufferNums_, const int dstBufferNum_)
+        : srcBufferNums (srcBufferNums_),
           dstBufferNum (dstBufferNum_)
     {
+        sources.calloc ((size_t) srcBufferNums.size());
+        cursors.calloc ((size_t) srcBufferNums.size());
     }
 
-    void perform (AudioSampleBuffer&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>&, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int)
     {
-        sharedMidiBuffers.getUnchecked (dstBufferNum)
-            ->addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, numSamples, 0);
+        for (int i = 0; i < srcBufferNums.size(); ++i)
+            sources[i] = sharedMidiBuffers.getUnchecked (srcBufferNums.getUnchecked (i));
+
+        auto& scratch = *sharedMidiBuffers.getUnchecked (GraphBuilder::midiScratchBuffer);
+        MidiKernel::merge (sources.get(), srcBufferNums.size(), cursors.get(), scratch);
+        sharedMidiBuffers.getUnchecked (dstBufferNum)->swapWith (scratch);
+        scratch.clear();
     }
 
 private:
-    const int srcBufferNum, dstBufferNum;
+    const Array<int> srcBufferNums;
+    const int dstBufferNum;
+    HeapBlock<const MidiBuffer*> sources;
+    HeapBlock<int> cursors;
 
-    JUCE_DECLARE_NON_COPYABLE (AddMidiBufferOp)
+    JUCE_DECLARE_NON_COPYABLE (MergeMidiBuffersOp)
 };
 
-class DelayChannelOp : public GraphOp
+class DelayChannelOp : public TypedGraphOp<DelayChannelOp>
 {
 public:
     DelayChannelOp (const int channel_, const int numSamplesDelay_)
@@ -172,14 +176,15 @@ public:
         buffer.calloc ((size_t) bufferSize);
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
     {
-        float* data = sharedBufferChans.getWritePointer (channel, 0);
+        FloatType* data = sharedBufferChans.getWritePointer (channel, 0);
 
         for (int i = numSamples; --i >= 0;)
         {
             buffer[writeIndex] = *data;
-            *data++ = buffer[readIndex];
+            *data++ = static_cast<FloatType> (buffer[readIndex]);
 
             if (++readIndex >= bufferSize)
                 readIndex = 0;
@@ -189,31 +194,271 @@ public:
     }
 
 private:
-    HeapBlock<float> buffer;
+    HeapBlock<double> buffer; // holds either sample type exactly
     const int channel, bufferSize;
     int readIndex, writeIndex;
 
     JUCE_DECLARE_NON_COPYABLE (DelayChannelOp)
 };
 
-class ProcessBufferOp : public GraphOp
+class CopyControlOp : public TypedGraphOp<CopyControlOp>
+{
+public:
+    CopyControlOp (ControlBuffers& buffers_, const int srcBufferNum_, const int dstBufferNum_)
+        : buffers (buffers_),
+          srcBufferNum (srcBufferNum_),
+          dstBufferNum (dstBufferNum_)
+    {
+    }
+
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>&, const OwnedArray<MidiBuffer>&, const int)
+    {
+        *buffers.getValue (dstBufferNum) = *buffers.getValue (srcBufferNum);
+    }
+
+private:
+    ControlBuffers& buffers;
+    const int srcBufferNum, dstBufferNum;
+
+    JUCE_DECLARE_NON_COPYABLE (CopyControlOp)
+};
+
+class AddControlOp : public TypedGraphOp<AddControlOp>
+{
+public:
+    AddControlOp (ControlBuffers& buffers_, const int srcBufferNum_, const int dstBufferNum_)
+        : buffers (buffers_),
+          srcBufferNum (srcBufferNum_),
+          dstBufferNum (dstBufferNum_)
+    {
+    }
+
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>&, const OwnedArray<MidiBuffer>&, const int)
+    {
+        *buffers.getValue (dstBufferNum) += *buffers.getValue (srcBufferNum);
+    }
+
+private:
+    ControlBuffers& buffers;
+    const int srcBufferNum, dstBufferNum;
+
+    JUCE_DECLARE_NON_COPYABLE (AddControlOp)
+};
+
+/** Copies or mixes a CV, audio or control source into a CV buffer. */
+class MixCVOp : public TypedGraphOp<MixCVOp>
+{
+public:
+    MixCVOp (ControlBuffers& buffers_, const PortType srcType_, const int srcBufferNum_, const int dstBufferNum_, const bool add_)
+        : buffers (buffers_),
+          srcType (srcType_.id()),
+          srcBufferNum (srcBufferNum_),
+          dstBufferNum (dstBufferNum_),
+          add (add_)
+    {
+    }
+
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>&, const int numSamples)
+    {
+        float* const dst = buffers.getCV (dstBufferNum);
+
+        switch (srcType)
+        {
+            case PortType::Control: {
+                const float value = *buffers.getValue (srcBufferNum);
+                if (add)
+                    FloatVectorOperations::add (dst, value, numSamples);
+                else
+                    FloatVectorOperations::fill (dst, value, numSamples);
+                break;
+            }
+
+            case PortType::Audio:
+                mix (sharedBufferChans.getReadPointer (srcBufferNum), dst, numSamples);
+                break;
+
+            default:
+                mix (static_cast<const float*> (buffers.getCV (srcBufferNum)), dst, numSamples);
+                break;
+        }
+    }
+
+private:
+    ControlBuffers& buffers;
+    const int srcType, srcBufferNum, dstBufferNum;
+    const bool add;
+
+    void mix (const float* src, float* dst, int numSamples) const noexcept
+    {
+        if (add)
+            FloatVectorOperations::add (dst, src, numSamples);
+        else
+            FloatVectorOperations::copy (dst, src, numSamples);
+    }
+
+    void mix (const double* src, float* dst, int numSamples) const noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dst[i] = (add ? dst[i] : 0.f) + static_cast<float> (src[i]);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (MixCVOp)
+};
+
+/** A node's Control or CV port and the shared buffer it uses. */
+struct ControlPortBuffer
+{
+    uint32 port;
+    int buffer; // -1 if a control input isn't connected
+    bool input;
+    bool cv;
+};
+
+/** Start and end gains for a block, ramping in and out of mute. */
+static void getGainRamp (float lastGain, float gain, bool muted, bool wasMuted, bool muteApplies, float& startGain, float& endGain) noexcept
+{
+    startGain = lastGain;
+    endGain = gain;
+
+    if (muted && muteApplies)
+    {
+        // just became muted, or normal mute processing
+        endGain = 0.f;
+        if (wasMuted == muted)
+            startGain = 0.f;
+    }
+    else if (! muted && muteApplies && muted != wasMuted)
+    {
+        // just became unmuted
+        startGain = 0.f;
+    }
+}
+
+/** One pass per channel: gain or ramp plus metering. Unity gain without
+    meters doesn't touch the audio at all. */
+template <typename FloatType>
+static void applyNodeGain (Processor& node, AudioBuffer<FloatType>& buffer, int numChans, int numSamples, float startGain, float endGain, bool metering, bool inputs) noexcept
+{
+    numChans = jmin (numChans, buffer.getNumChannels());
+
+    if (! metering)
+    {
+        if (! GainKernel::isUnity (startGain, endGain))
+            for (int ch = 0; ch < numChans; ++ch)
+                GainKernel::apply (buffer.getWritePointer (ch), numSamples, startGain, endGain);
+        return;
+    }
+
+    for (int ch = 0; ch < numChans; ++ch)
+    {
+        const auto level = GainKernel::applyAndMeasure (buffer.getWritePointer (ch), numSamples, startGain, endGain);
+        if (inputs)
+        {
+            node.setInputRMS (ch, level.rms);
+            node.setInputPeak (ch, level.peak);
+        }
+        else
+        {
+            node.setOutputRMS (ch, level.rms);
+            node.setOutputPeak (ch, level.peak);
+        }
+    }
+}
+
+/** A node's MIDI filters: key range, channels, program changes and
+    transpose. Settings come from one lock free read of the node's render
+    state per block. */
+class NodeMidiFilter
+{
+public:
+    explicit NodeMidiFilter (Processor& node_)
+        : node (node_),
+          state (node_.getRenderState()),
+          keyRange (state.getKeyRange()),
+          filteringKeys (keyRange.getLength() > 0 && (keyRange.getStart() > 0 || keyRange.getEnd() < 127))
+    {
+    }
+
+    /** False when every event passes through unchanged. The full 0-127 key
+        range doesn't count, so shared read-only MIDI isn't copied for it. */
+    bool isActive() const noexcept
+    {
+        return filteringKeys || ! state.isOmni() || state.midiProgramsEnabled || state.transposeOffset != 0;
+    }
+
+    /** Filters in place, dropped events are compacted through scratch. */
+    void process (MidiBuffer& midi, MidiBuffer& scratch)
+    {
+        MidiKernel::filter (midi, scratch, [this] (uint8* data, int numBytes, int) {
+            const bool isNote = (data[0] & 0xe0) == 0x80 && numBytes >= 3;
+
+            // out of range
+            if (isNote && filteringKeys && (data[1] < keyRange.getStart() || data[1] > keyRange.getEnd()))
+                return false;
+
+            const int channel = (data[0] & 0xf0) != 0xf0 ? (data[0] & 0x0f) + 1 : 0;
+            if (channel > 0 && state.isChannelOff (channel))
+                return false;
+
+            if (state.midiProgramsEnabled && (data[0] & 0xf0) == 0xc0 && numBytes >= 2)
+            {
+                node.setMidiProgram (data[1]);
+                node.reloadMidiProgram();
+                return false;
+            }
+
+            if (isNote && state.transposeOffset != 0)
+                data[1] = (uint8) ((data[1] + state.transposeOffset) & 127);
+            return true;
+        });
+    }
+
+private:
+    Processor& node;
+    const Processor::RenderState state;
+    const Range<int> keyRange;
+    const bool filteringKeys;
+};
+
+class ProcessBufferOp : public TypedGraphOp<ProcessBufferOp>
 {
 public:
     ProcessBufferOp (const ProcessorPtr& node_,
                      const Array<int>& audioChannelsToUse_,
                      const int totalChans_,
                      const int midiBufferToUse_,
-                     const Array<int> chans[PortType::Unknown])
+                     const Array<int> chans[PortType::Unknown],
+                     const Array<bool>& readOnlyMidi,
+                     ControlBuffers& controls_,
+                     const Array<ControlPortBuffer>& controlPorts_,
+                     const bool doublePrecision,
+                     const int blockSize)
         : node (node_),
-          processor (node_->getAudioPluginInstance()),
           audioChannelsToUse (audioChannelsToUse_),
           midiChannelsToUse (chans[PortType::Midi]),
           totalChans (jmax (1, totalChans_)),
           numAudioIns (node_->getNumPorts (PortType::Audio, true)),
           numAudioOuts (node_->getNumPorts (PortType::Audio, false)),
-          midiBufferToUse (midiBufferToUse_)
+          midiBufferToUse (midiBufferToUse_),
+          controls (controls_),
+          controlPorts (controlPorts_)
     {
         channels.calloc ((size_t) totalChans);
+        channels64.calloc ((size_t) totalChans);
+
+        // room to convert nodes that only render floats, sized once for
+        // the block the graph was prepared with
+        if (doublePrecision)
+            convertBuffer.setSize (totalChans, jmax (1, blockSize));
+
+        for (const auto& cp : controlPorts)
+        {
+            controlParams.add (cp.cv ? nullptr : findParameter (cp.port, cp.input));
+            lastControlValues.add (std::numeric_limits<float>::quiet_NaN());
+        }
 
         while (audioChannelsToUse.size() < totalChans)
             audioChannelsToUse.add (0);
@@ -223,115 +468,138 @@ public:
         else
             midiChannelsToUse.add (midiBufferToUse);
 
+        // shared inputs get a private copy only when they need changing
+        midiData.calloc ((size_t) midiChannelsToUse.size());
+        for (int i = 0; i < midiChannelsToUse.size(); ++i)
+        {
+            MidiBuffer* copy = nullptr;
+            if (readOnlyMidi[i])
+                MidiKernel::reserve (*(copy = new MidiBuffer()));
+            midiCopies.add (copy);
+        }
+
         lastMute = node->isMuted();
 
         osChanSize = totalChans;
         osChans.reset (new float*[osChanSize]);
-        tempMidi.ensureSize (128);
+
+        auto& trace = RenderTrace::getInstance();
+        const auto* parentGraph = node->getParentGraph();
+        traceLabel = trace.registerNode (parentGraph != nullptr ? parentGraph->nodeId : 0,
+                                         node->nodeId,
+                                         node->getName());
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
     {
+        const auto start = readRenderTicks();
+        renderNode (sharedBufferChans, sharedMidiBuffers, numSamples);
+        const auto end = readRenderTicks();
+
+        updateCpuLoad (end - start, numSamples);
+
+        auto& trace = RenderTrace::getInstance();
+        if (trace.isEnabled())
+            trace.record (traceLabel, start, end);
+    }
+
+    template <typename FloatType>
+    void renderNode (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    {
+        FloatType** const chans = getChannels (sharedBufferChans);
         for (int i = totalChans; --i >= 0;)
         {
-            channels[i] = sharedBufferChans.getWritePointer (audioChannelsToUse.getUnchecked (i), 0);
+            chans[i] = sharedBufferChans.getWritePointer (audioChannelsToUse.getUnchecked (i), 0);
         }
 
-        AudioSampleBuffer buffer (channels, totalChans, numSamples);
-        MidiPipe midiPipe (sharedMidiBuffers, midiChannelsToUse);
+        AudioBuffer<FloatType> buffer (chans, totalChans, numSamples);
+        for (int i = 0; i < midiChannelsToUse.size(); ++i)
+            midiData[i] = sharedMidiBuffers.getUnchecked (midiChannelsToUse.getUnchecked (i));
 
         if (! node->isEnabled())
         {
             for (int ch = numAudioIns; ch < numAudioOuts; ++ch)
                 buffer.clear (ch, 0, buffer.getNumSamples());
+            clearCVOutputs (numSamples);
             return;
         }
 
         const bool muted = node->isMuted();
         const bool muteInput = node->isMutingInputs();
+        const bool metering = node->isMetering();
 
-        if (muted && muteInput)
-        {
-            if (lastMute != muted)
-            {
-                // just became muted
-                buffer.applyGainRamp (0, numSamples, node->getLastInputGain(), 0.0);
-            }
-            else
-            {
-                // normal mute processing
-                buffer.applyGain (0, numSamples, 0.0);
-            }
-        }
-        else if (! muted && muteInput && muted != lastMute)
-        {
-            // just became unmuted
-            buffer.applyGainRamp (0, numSamples, 0.0, node->getInputGain());
-        }
-        else if (node->getInputGain() != node->getLastInputGain())
-        {
-            buffer.applyGainRamp (0, numSamples, node->getLastInputGain(), node->getInputGain());
-        }
-        else
         {
-            buffer.applyGain (0, numSamples, node->getInputGain());
+            float startGain, endGain;
+            getGainRamp (node->getLastInputGain(), node->getInputGain(), muted, lastMute, muteInput, startGain, endGain);
+            applyNodeGain (*node, buffer, numAudioIns, numSamples, startGain, endGain, metering, true);
         }
 
-        for (int i = numAudioIns; --i >= 0;)
-            node->setInputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+        auto& scratchMidi = *sharedMidiBuffers.getUnchecked (GraphBuilder::midiScratchBuffer);
+        const auto osFactor = node->getOversamplingFactor();
 
         // Begin MIDI filters
         {
-            jassert (tempMidi.getNumEvents() == 0);
-            ScopedLock spl (node->getPropertyLock());
-            transpose.setNoteOffset (node->getTransposeOffset());
-            const auto keyRange (node->getKeyRange());
-            const auto midiChans (node->getMidiChannels());
-            const auto useMidiProgram (node->areMidiProgramsEnabled());
+            NodeMidiFilter filter (*node);
+            const bool filtering = filter.isActive();
 
-            if (keyRange.getLength() > 0 || ! midiChans.isOmni() || useMidiProgram)
+            for (int i = 0; i < midiChannelsToUse.size() && (filtering || osFactor > 1); ++i)
             {
-                for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-                {
-                    auto& midi = *midiPipe.getWriteBuffer (i);
-                    for (auto m : midi)
-                    {
-                        auto msg = m.getMessage();
-                        if (msg.isNoteOnOrOff())
-                        {
-                            // out of range
-                            if (keyRange.getLength() > 0 && (msg.getNoteNumber() < keyRange.getStart() || msg.getNoteNumber() > keyRange.getEnd()))
-                                continue;
-                        }
+                auto& midi = getWritableMidi (i);
+                if (filtering)
+                    filter.process (midi, scratchMidi);
+            }
+        }
+        // End MIDI filters
 
-                        if (msg.getChannel() > 0 && midiChans.isOff (msg.getChannel()))
-                            continue;
+        MidiPipe midiPipe (midiData.get(), midiChannelsToUse.size());
 
-                        if (useMidiProgram && msg.isProgramChange())
-                        {
-                            node->setMidiProgram (msg.getProgramChangeNumber());
-                            node->reloadMidiProgram();
-                            continue;
-                        }
+        const bool portData = node->wantsPortData();
+        connectControlPorts (portData, osFactor > 1);
+        renderBlock (buffer, midiPipe, osFactor);
 
-                        transpose.process (msg);
-                        tempMidi.addEvent (msg, m.samplePosition);
-                    }
+        if (! portData)
+            writeControlOutputs (numSamples);
+        else if (osFactor > 1)
+            clearCVOutputs (numSamples);
 
-                    midi.swapWith (tempMidi);
-                    tempMidi.clear();
-                }
-            }
-            else
-            {
-                for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-                    transpose.process (*midiPipe.getWriteBuffer (i), numSamples);
-            }
+        {
+            float startGain, endGain;
+            getGainRamp (node->getLastGain(), node->getGain(), muted, lastMute, ! muteInput, startGain, endGain);
+            applyNodeGain (*node, buffer, numAudioOuts, numSamples, startGain, endGain, metering, false);
         }
 
-        tempMidi.clear();
-        // End MIDI filters
+        node->updateGain();
+        lastMute = muted;
+    }
+
+    const ProcessorPtr node;
 
+private:
+    Array<int> audioChannelsToUse;
+    Array<int> midiChannelsToUse;
+    HeapBlock<float*> channels;
+    HeapBlock<double*> channels64;
+    AudioSampleBuffer convertBuffer;
+    int totalChans, numAudioIns, numAudioOuts;
+    int midiBufferToUse;
+    bool lastMute = false;
+    HeapBlock<MidiBuffer*> midiData;
+    OwnedArray<MidiBuffer> midiCopies;
+
+    std::unique_ptr<float*> osChans;
+    int osChanSize = 0;
+
+    ControlBuffers& controls;
+    Array<ControlPortBuffer> controlPorts;
+    ReferenceCountedArray<Parameter> controlParams;
+    Array<float> lastControlValues;
+
+    uint32 traceLabel = 0;
+
+    /** Renders the node itself, oversampled if it's set to. */
+    void renderBlock (AudioSampleBuffer& buffer, MidiPipe& midiPipe, const int osFactor)
+    {
         auto pluginProcessBlock = [=] (AudioSampleBuffer& buffer, MidiPipe& midiPipe, bool isSuspended) {
             if (node->wantsMidiPipe())
             {
@@ -342,6 +610,8 @@ public:
             }
             else
             {
+                // looked up per block, program standby swaps the instance
+                auto* const processor = node->getAudioProcessor();
                 jassert (processor != nullptr);
                 if (! isSuspended)
                 {
@@ -356,7 +626,6 @@ public:
             }
         };
 
-        const auto osFactor = node->getOversamplingFactor();
         if (osFactor > 1)
         {
             auto osProcessor = node->getOversamplingProcessor();
@@ -378,151 +647,506 @@ public:
                                         buffer.getNumChannels(),
                                         static_cast<int> (osBlock.getNumSamples()));
 
-            tempMidi.clear();
             for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-            {
-                auto& mb = *midiPipe.getWriteBuffer (i);
-                for (const MidiMessageMetadata msg : mb)
-                {
-                    tempMidi.addEvent (
-                        msg.data,
-                        msg.numBytes,
-                        msg.samplePosition * osFactor);
-                }
-                mb.swapWith (tempMidi);
-                tempMidi.clear();
-            }
+                MidiKernel::scaleTimes (*midiPipe.getWriteBuffer (i), osFactor, 1);
 
             pluginProcessBlock (osBuffer, midiPipe, node->isSuspended());
             osProcessor->processSamplesDown (block);
 
-            tempMidi.clear();
             for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-            {
-                auto& mb = *midiPipe.getWriteBuffer (i);
-                for (const MidiMessageMetadata msg : mb)
-                {
-                    tempMidi.addEvent (
-                        msg.data,
-                        msg.numBytes,
-                        msg.samplePosition / osFactor);
-                }
-                mb.swapWith (tempMidi);
-                tempMidi.clear();
-            }
+                MidiKernel::scaleTimes (*midiPipe.getWriteBuffer (i), 1, osFactor);
         }
         else
         {
             pluginProcessBlock (buffer, midiPipe, node->isSuspended());
         }
+    }
 
-        if (muted && ! muteInput)
+    /** Renders at 64 bits if the node can, otherwise converts to and from
+        float around it. Oversampling always runs in float. */
+    void renderBlock (AudioBuffer<double>& buffer, MidiPipe& midiPipe, const int osFactor)
+    {
+        const bool suspended = node->isSuspended();
+        if (osFactor <= 1 && node->wantsMidiPipe() && node->supportsDoublePrecision())
         {
-            if (lastMute != muted)
-            {
-                // just became muted
-                buffer.applyGainRamp (0, numSamples, node->getLastGain(), 0.0);
-            }
+            if (! suspended)
+                node->render64 (buffer, midiPipe);
             else
-            {
-                // normal mute processing
-                buffer.applyGain (0, numSamples, 0.0);
-            }
-        }
-        else if (! muted && ! muteInput && muted != lastMute)
-        {
-            // just became unmuted
-            buffer.applyGainRamp (0, numSamples, 0.0, node->getGain());
-        }
-        else if (node->getGain() != node->getLastGain())
-        {
-            buffer.applyGainRamp (0, numSamples, node->getLastGain(), node->getGain());
+                node->renderBypassed64 (buffer, midiPipe);
+            return;
         }
-        else
+
+        auto* const processor = node->getAudioProcessor();
+        if (osFactor <= 1 && ! node->wantsMidiPipe() && processor != nullptr && processor->isUsingDoublePrecision())
         {
-            buffer.applyGain (0, numSamples, node->getGain());
+            if (! suspended)
+                processor->processBlock (buffer, *midiPipe.getWriteBuffer (0));
+            else
+                processor->processBlockBypassed (buffer, *midiPipe.getWriteBuffer (0));
+            return;
         }
 
-        node->updateGain();
-        lastMute = muted;
+        const int numChans = buffer.getNumChannels();
+        const int numSamples = buffer.getNumSamples();
+        jassert (convertBuffer.getNumChannels() >= numChans && convertBuffer.getNumSamples() >= numSamples);
 
-        for (int i = 0; i < numAudioOuts; ++i)
-            node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
-    }
+        AudioSampleBuffer floats (convertBuffer.getArrayOfWritePointers(), numChans, numSamples);
+        for (int ch = 0; ch < numChans; ++ch)
+            convertSamples (buffer.getReadPointer (ch), floats.getWritePointer (ch), numSamples);
 
-    const ProcessorPtr node;
-    AudioProcessor* const processor;
+        renderBlock (floats, midiPipe, osFactor);
 
-private:
-    Array<int> audioChannelsToUse;
-    Array<int> midiChannelsToUse;
-    HeapBlock<float*> channels;
-    int totalChans, numAudioIns, numAudioOuts;
-    int midiBufferToUse;
-    bool lastMute = false;
-    MidiTranspose transpose;
-    MidiBuffer tempMidi;
+        for (int ch = 0; ch < numChans; ++ch)
+            convertSamples (floats.getReadPointer (ch), buffer.getWritePointer (ch), numSamples);
+    }
 
-    std::unique_ptr<float*> osChans;
-    int osChanSize = 0;
-    JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
-};
+    float** getChannels (AudioSampleBuffer&) noexcept { return channels.get(); }
+    double** getChannels (AudioBuffer<double>&) noexcept { return channels64.get(); }
 
-GraphBuilder::GraphBuilder (GraphNode& graph_,
-                            const Array<void*>& orderedNodes_,
-                            Array<void*>& renderingOps)
-    : graph (graph_),
-      orderedNodes (orderedNodes_),
-      totalLatency (0)
-{
-    for (int i = 0; i < PortType::Unknown; ++i)
+    /** Returns MIDI input i, copied first if it's shared read-only. */
+    MidiBuffer& getWritableMidi (int i) noexcept
     {
-        allNodes[i].add ((uint32) zeroNodeID); // first buffer is read-only zeros
-        allPorts[i].add (EL_INVALID_PORT);
+        if (auto* copy = midiCopies.getUnchecked (i))
+        {
+            if (midiData[i] != copy)
+            {
+                MidiKernel::copy (*midiData[i], *copy);
+                midiData[i] = copy;
+            }
+        }
+
+        return *midiData[i];
     }
 
-    for (int i = 0; i < orderedNodes.size(); ++i)
+    ParameterPtr findParameter (uint32 port, bool input) const
     {
-        createRenderingOpsForNode ((Processor*) orderedNodes.getUnchecked (i),
-                                   renderingOps,
-                                   i);
-        markUnusedBuffersFree (i);
+        for (auto* param : node->getParameters (input))
+            if (param->getPortIndex() == (int) port)
+                return param;
+        return nullptr;
     }
-}
 
-int GraphBuilder::buffersNeeded (PortType type) { return allNodes[type.id()].size(); }
-int GraphBuilder::getNodeDelay (const uint32 nodeID) const { return nodeDelays[nodeDelayIDs.indexOf (nodeID)]; }
+    void connectControlPorts (bool portData, bool oversampled) noexcept
+    {
+        for (int i = 0; i < controlPorts.size(); ++i)
+        {
+            const auto& cp = controlPorts.getReference (i);
 
-void GraphBuilder::setNodeDelay (const uint32 nodeID, const int latency)
-{
-    const int index = nodeDelayIDs.indexOf (nodeID);
+            if (portData)
+            {
+                // CV buffers are base rate, oversampled nodes use their own
+                float* data = nullptr;
+                if (cp.cv && ! oversampled)
+                    data = controls.getCV (cp.buffer);
+                else if (! cp.cv && cp.buffer >= 0)
+                    data = controls.getValue (cp.buffer);
+                node->setPortData (cp.port, data);
+                continue;
+            }
 
-    if (index >= 0)
-    {
-        nodeDelays.set (index, latency);
+            if (! cp.input || cp.cv || cp.buffer < 0)
+                continue;
+
+            auto* param = controlParams.getUnchecked (i);
+            const float value = *controls.getValue (cp.buffer);
+            if (param != nullptr && value != lastControlValues.getUnchecked (i))
+            {
+                lastControlValues.setUnchecked (i, value);
+                param->setValue (value);
+            }
+        }
     }
-    else
+
+    void writeControlOutputs (int numSamples) noexcept
     {
-        nodeDelayIDs.add (nodeID);
-        nodeDelays.add (latency);
+        for (int i = 0; i < controlPorts.size(); ++i)
+        {
+            const auto& cp = controlPorts.getReference (i);
+            if (cp.input)
+                continue;
+
+            if (cp.cv)
+                FloatVectorOperations::clear (controls.getCV (cp.buffer), numSamples);
+            else if (auto* param = controlParams.getUnchecked (i))
+                *controls.getValue (cp.buffer) = param->getValue();
+        }
     }
-}
-
-int GraphBuilder::getInputLatency (const uint32 nodeID) const
-{
-    int maxLatency = 0;
 
-    for (int i = graph.getNumConnections(); --i >= 0;)
+    void clearCVOutputs (int numSamples) noexcept
     {
-        const auto* const c = graph.getConnection (i);
-        if (c->destNode == nodeID)
-            maxLatency = jmax (maxLatency, getNodeDelay (c->sourceNode));
+        for (const auto& cp : controlPorts)
+            if (cp.cv && ! cp.input)
+                FloatVectorOperations::clear (controls.getCV (cp.buffer), numSamples);
     }
 
-    return maxLatency;
+    void updateCpuLoad (uint64 ticks, int numSamples) noexcept
+    {
+        const double rate = node->getSampleRate();
+        if (rate <= 0.0 || numSamples <= 0)
+            return;
+
+        const double blockSeconds = (double) numSamples / rate;
+        const float load = (float) (RenderTrace::getInstance().ticksToSeconds (ticks) / blockSeconds);
+        const float last = node->cpuLoad.get();
+        node->cpuLoad.set (last + 0.2f * (load - last));
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
+};
+
+/** Stands in for an inlined subgraph before its nodes: input gain, input
+    meters and the graph node's MIDI filters, applied to the buffers its IO
+    nodes alias. */
+class SubgraphInputOp : public TypedGraphOp<SubgraphInputOp>
+{
+public:
+    SubgraphInputOp (const ProcessorPtr& node_, const Array<int>& audioChannels_, const Array<int>& midiChannels_)
+        : node (node_),
+          audioChannels (audioChannels_),
+          midiChannels (midiChannels_)
+    {
+        channels.calloc ((size_t) jmax (1, audioChannels.size()));
+        channels64.calloc ((size_t) jmax (1, audioChannels.size()));
+        lastMute = node->isMuted();
+    }
+
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    {
+        if (! node->isEnabled())
+            return;
+
+        const bool muted = node->isMuted();
+
+        if (audioChannels.size() > 0)
+        {
+            FloatType** const chans = getChannels (sharedBufferChans);
+            for (int i = audioChannels.size(); --i >= 0;)
+                chans[i] = sharedBufferChans.getWritePointer (audioChannels.getUnchecked (i));
+
+            AudioBuffer<FloatType> buffer (chans, audioChannels.size(), numSamples);
+            float startGain, endGain;
+            getGainRamp (node->getLastInputGain(), node->getInputGain(), muted, lastMute, node->isMutingInputs(), startGain, endGain);
+            applyNodeGain (*node, buffer, audioChannels.size(), numSamples, startGain, endGain, node->isMetering(), true);
+        }
+
+        lastMute = muted;
+
+        NodeMidiFilter filter (*node);
+        if (! filter.isActive())
+            return;
+
+        auto& scratchMidi = *sharedMidiBuffers.getUnchecked (GraphBuilder::midiScratchBuffer);
+        for (const int index : midiChannels)
+            filter.process (*sharedMidiBuffers.getUnchecked (index), scratchMidi);
+    }
+
+private:
+    const ProcessorPtr node;
+    Array<int> audioChannels, midiChannels;
+    HeapBlock<float*> channels;
+    HeapBlock<double*> channels64;
+    bool lastMute = false;
+
+    float** getChannels (AudioSampleBuffer&) noexcept { return channels.get(); }
+    double** getChannels (AudioBuffer<double>&) noexcept { return channels64.get(); }
+
+    JUCE_DECLARE_NON_COPYABLE (SubgraphInputOp)
+};
+
+/** Stands in for an inlined subgraph after its nodes: output gain and
+    meters on the buffers its output IO nodes alias. */
+class SubgraphOutputOp : public TypedGraphOp<SubgraphOutputOp>
+{
+public:
+    SubgraphOutputOp (const ProcessorPtr& node_, const Array<int>& audioChannels_, const Array<int>& midiChannels_)
+        : node (node_),
+          audioChannels (audioChannels_),
+          midiChannels (midiChannels_)
+    {
+        channels.calloc ((size_t) jmax (1, audioChannels.size()));
+        channels64.calloc ((size_t) jmax (1, audioChannels.size()));
+        lastMute = node->isMuted();
+    }
+
+    template <typename FloatType>
+    void process (AudioBuffer<FloatType>& sharedBufferChans, const OwnedArray<MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    {
+        if (! node->isEnabled())
+        {
+            // disabling rebuilds the parent without inlining, until then stay silent
+            for (const int index : audioChannels)
+                sharedBufferChans.clear (index, 0, numSamples);
+            for (const int index : midiChannels)
+                sharedMidiBuffers.getUnchecked (index)->clear();
+            return;
+        }
+
+        const bool muted = node->isMuted();
+
+        if (audioChannels.size() > 0)
+        {
+            FloatType** const chans = getChannels (sharedBufferChans);
+            for (int i = audioChannels.size(); --i >= 0;)
+                chans[i] = sharedBufferChans.getWritePointer (audioChannels.getUnchecked (i));
+
+            AudioBuffer<FloatType> buffer (chans, audioChannels.size(), numSamples);
+            float startGain, endGain;
+            getGainRamp (node->getLastGain(), node->getGain(), muted, lastMute, ! node->isMutingInputs(), startGain, endGain);
+            applyNodeGain (*node, buffer, audioChannels.size(), numSamples, startGain, endGain, node->isMetering(), false);
+        }
+
+        node->updateGain();
+        lastMute = muted;
+    }
+
+private:
+    const ProcessorPtr node;
+    Array<int> audioChannels, midiChannels;
+    HeapBlock<float*> channels;
+    HeapBlock<double*> channels64;
+    bool lastMute = false;
+
+    float** getChannels (AudioSampleBuffer&) noexcept { return channels.get(); }
+    double** getChannels (AudioBuffer<double>&) noexcept { return channels64.get(); }
+
+    JUCE_DECLARE_NON_COPYABLE (SubgraphOutputOp)
+};
+
+GraphBuilder::GraphBuilder (GraphNode& graph_,
+                            const Array<void*>& orderedNodes,
+                            Array<void*>& renderingOps,
+                            bool optimise_)
+    : graph (graph_),
+      optimise (optimise_),
+      totalLatency (0)
+{
+    for (int i = 0; i < PortType::Unknown; ++i)
+    {
+        allNodes[i].add ((uint32) zeroNodeID); // first buffer is read-only zeros
+        allPorts[i].add (EL_INVALID_PORT);
+    }
+
+    allNodes[PortType::Midi].add ((uint32) scratchNodeID);
+    allPorts[PortType::Midi].add (EL_INVALID_PORT);
+    jassert (allNodes[PortType::Midi].size() - 1 == midiScratchBuffer);
+
+    {
+        Array<Processor*> order;
+        order.ensureStorageAllocated (orderedNodes.size());
+        for (auto* node : orderedNodes)
+            order.add ((Processor*) node);
+        compile (graph, order, EL_INVALID_NODE, EL_INVALID_NODE, false);
+    }
+
+    renderIndex.reserve ((size_t) steps.size());
+    for (int i = 0; i < steps.size(); ++i)
+        renderIndex[steps.getReference (i).id] = i;
+
+    // liveness: the last step reading each output
+    for (int i = 0; i < steps.size(); ++i)
+    {
+        for (const auto& arc : getInputArcs (steps.getReference (i).id))
+        {
+            auto& last = lastUse[((uint64) arc.sourceNode << 32) | arc.sourcePort];
+            last = jmax (last, i);
+        }
+    }
+
+    const int firstOp = renderingOps.size();
+    for (int i = 0; i < steps.size(); ++i)
+    {
+        const auto& step = steps.getReference (i);
+        if (step.type == nodeStep)
+            createRenderingOpsForNode (step.node, step.id, renderingOps, i);
+        else
+            createSubgraphOps (step, renderingOps, i);
+        markUnusedBuffersFree (i);
+    }
+
+    updateStats (renderingOps, firstOp);
+}
+
+void GraphBuilder::compile (GraphNode& source, const Array<Processor*>& order, uint32 inputID, uint32 outputID, bool inlined)
+{
+    // ids the nodes of source are read from and written to in the flat plan
+    std::unordered_map<uint32, std::pair<uint32, uint32>> ids;
+    ids.reserve ((size_t) order.size());
+
+    for (auto* node : order)
+    {
+        if (inlined && dynamic_cast<IONode*> (node) != nullptr)
+            continue;
+
+        if (canInline (node))
+        {
+            auto& child = *dynamic_cast<GraphNode*> (node);
+            const uint32 childInput = nextInlineID++;
+            const uint32 childOutput = nextInlineID++;
+            ids[node->nodeId] = { childOutput, childInput };
+            flatNodes[childInput] = flatNodes[childOutput] = node;
+            ++numInlined;
+
+            Array<Processor*> childOrder;
+            child.getRenderOrder (childOrder);
+            steps.add ({ node, childInput, subgraphInputStep });
+            compile (child, childOrder, childInput, childOutput, true);
+            steps.add ({ node, childOutput, subgraphOutputStep });
+            continue;
+        }
+
+        const uint32 id = inlined ? nextInlineID++ : node->nodeId;
+        ids[node->nodeId] = { id, id };
+        flatNodes[id] = node;
+        steps.add ({ node, id, nodeStep });
+    }
+
+    // an IO node's channel is the graph port of the same type and channel
+    const auto mapIONode = [&source, inputID, outputID] (IONode& io, uint32 port, bool isInput, uint32& nodeID, uint32& graphPort) {
+        const PortType type (static_cast<Processor&> (io).getPortType (port));
+        const int channel = io.getChannelPort (port);
+        if (io.isInput() != isInput || channel < 0 || channel >= (int) source.getNumPorts (type, isInput)
+            || (type == PortType::Midi && channel > 0)) // IO nodes only pass the first MIDI port
+            return false;
+
+        nodeID = isInput ? inputID : outputID;
+        graphPort = (uint32) source.getNthPort (type, channel, isInput, false);
+        return true;
+    };
+
+    const auto mapEndpoint = [&] (uint32 nodeID, uint32 port, bool isSource, uint32& flatID, uint32& flatPort) {
+        const auto iter = ids.find (nodeID);
+        if (iter != ids.end())
+        {
+            flatID = isSource ? iter->second.first : iter->second.second;
+            flatPort = port;
+            return true;
+        }
+
+        auto* io = inlined ? dynamic_cast<IONode*> (source.getNodeForId (nodeID)) : nullptr;
+        return io != nullptr && mapIONode (*io, port, isSource, flatID, flatPort);
+    };
+
+    for (auto* node : order)
+    {
+        for (const auto* c : source.getInputConnections (node->nodeId))
+        {
+            FlatArc arc;
+            if (mapEndpoint (c->sourceNode, c->sourcePort, true, arc.sourceNode, arc.sourcePort)
+                && mapEndpoint (c->destNode, c->destPort, false, arc.destNode, arc.destPort))
+            {
+                inputArcs[arc.destNode].add (arc);
+                outputArcs[arc.sourceNode].add (arc);
+            }
+        }
+    }
+}
+
+bool GraphBuilder::canInline (Processor* node) const
+{
+    auto* child = dynamic_cast<GraphNode*> (node);
+    if (! optimise || child == nullptr || ! child->isSubGraph()
+        || ! child->isEnabled() || child->isSuspended() || child->getOversamplingFactor() > 1)
+        return false;
+
+    // IO nodes hand over MIDI by copying, more than one of a kind doesn't alias
+    int numMidiInputs = 0, numMidiOutputs = 0;
+    for (auto* n : child->nodes)
+    {
+        if (auto* io = dynamic_cast<IONode*> (n))
+        {
+            numMidiInputs += io->getType() == IONode::midiInputNode ? 1 : 0;
+            numMidiOutputs += io->getType() == IONode::midiOutputNode ? 1 : 0;
+        }
+    }
+
+    if (numMidiInputs > 1 || numMidiOutputs > 1)
+        return false;
+
+    return child->getInputFilter().isPassThrough();
+}
+
+const Array<GraphBuilder::FlatArc>& GraphBuilder::getInputArcs (const uint32 nodeID) const noexcept
+{
+    static const Array<FlatArc> none;
+    const auto iter = inputArcs.find (nodeID);
+    return iter != inputArcs.end() ? iter->second : none;
+}
+
+const Array<GraphBuilder::FlatArc>& GraphBuilder::getOutputArcs (const uint32 nodeID) const noexcept
+{
+    static const Array<FlatArc> none;
+    const auto iter = outputArcs.find (nodeID);
+    return iter != outputArcs.end() ? iter->second : none;
+}
+
+int GraphBuilder::getLastUse (const uint32 nodeID, const uint32 port) const noexcept
+{
+    const auto iter = lastUse.find (((uint64) nodeID << 32) | port);
+    return iter != lastUse.end() ? iter->second : -1;
+}
+
+void GraphBuilder::updateStats (const Array<void*>& renderingOps, int firstOp)
+{
+    stats = {};
+    stats.inlinedGraphs = numInlined;
+    stats.audioBuffers = buffersNeeded (PortType::Audio);
+    stats.midiBuffers = buffersNeeded (PortType::Midi);
+
+    for (int i = firstOp; i < renderingOps.size(); ++i)
+    {
+        auto* op = static_cast<GraphOp*> (renderingOps.getUnchecked (i));
+        if (dynamic_cast<ClearChannelOp*> (op) != nullptr || dynamic_cast<ClearMidiBufferOp*> (op) != nullptr)
+            ++stats.clearOps;
+        else if (dynamic_cast<CopyChannelOp*> (op) != nullptr || dynamic_cast<CopyMidiBufferOp*> (op) != nullptr)
+            ++stats.copyOps;
+        else if (dynamic_cast<AddChannelOp*> (op) != nullptr || dynamic_cast<MergeMidiBuffersOp*> (op) != nullptr)
+            ++stats.addOps;
+        else if (dynamic_cast<DelayChannelOp*> (op) != nullptr)
+            ++stats.delayOps;
+    }
+}
+
+int GraphBuilder::buffersNeeded (PortType type) { return allNodes[type.id()].size(); }
+int GraphBuilder::getNodeDelay (const uint32 nodeID) const { return nodeDelays[nodeDelayIDs.indexOf (nodeID)]; }
+
+void GraphBuilder::setNodeDelay (const uint32 nodeID, const int latency)
+{
+    const int index = nodeDelayIDs.indexOf (nodeID);
+
+    if (index >= 0)
+    {
+        nodeDelays.set (index, latency);
+    }
+    else
+    {
+        nodeDelayIDs.add (nodeID);
+        nodeDelays.add (latency);
+    }
+}
+
+int GraphBuilder::getInputLatency (const uint32 nodeID) const
+{
+    int maxLatency = 0;
+    for (const auto& arc : getInputArcs (nodeID))
+        maxLatency = jmax (maxLatency, getNodeDelay (arc.sourceNode));
+    return maxLatency;
+}
+
+void GraphBuilder::getSources (const uint32 nodeId, const uint32 port, Array<uint32>& sourceNodes, Array<uint32>& sourcePorts) const
+{
+    for (const auto& arc : getInputArcs (nodeId))
+    {
+        if (arc.destPort == port)
+        {
+            sourceNodes.add (arc.sourceNode);
+            sourcePorts.add (arc.sourcePort);
+        }
+    }
 }
 
 void GraphBuilder::createRenderingOpsForNode (Processor* const node,
+                                              const uint32 nodeID,
                                               Array<void*>& renderingOps,
                                               const int ourRenderingIndex)
 {
@@ -540,13 +1164,16 @@ void GraphBuilder::createRenderingOpsForNode (Processor* const node,
     }
 
     Array<int> channelsToUse[PortType::Unknown];
-    int maxLatency = getInputLatency (node->nodeId);
+    Array<bool> readOnlyMidi;
+    Array<ControlPortBuffer> controlPorts;
+    int maxLatency = getInputLatency (nodeID);
 
     const uint32 numPorts (node->getNumPorts());
     for (uint32 port = 0; port < numPorts; ++port)
     {
         const PortType portType (node->getPortType (port));
-        if (portType != PortType::Audio && portType != PortType::Midi && portType != PortType::Control)
+        if (portType != PortType::Audio && portType != PortType::Midi
+            && portType != PortType::Control && portType != PortType::CV)
             continue;
 
         const uint32 numIns = node->getNumPorts (portType, true);
@@ -558,9 +1185,11 @@ void GraphBuilder::createRenderingOpsForNode (Processor* const node,
         {
             switch (portType.id())
             {
-                case PortType::Control: {
+                case PortType::Control:
+                case PortType::CV: {
                     const int bufIndex = getFreeBuffer (portType);
-                    markBufferAsContaining (bufIndex, portType, node->nodeId, port);
+                    markBufferAsContaining (bufIndex, portType, nodeID, port);
+                    controlPorts.add ({ port, bufIndex, false, portType == PortType::CV });
                     break;
                 }
 
@@ -576,7 +1205,9 @@ void GraphBuilder::createRenderingOpsForNode (Processor* const node,
                         jassert (outPort == port);
                         jassert (outPort < node->getNumPorts());
 
-                        markBufferAsContaining (bufIndex, portType, node->nodeId, outPort);
+                        markBufferAsContaining (bufIndex, portType, nodeID, outPort);
+                        if (portType == PortType::Midi)
+                            readOnlyMidi.add (false);
                     }
                     break;
                 }
@@ -586,216 +1217,349 @@ void GraphBuilder::createRenderingOpsForNode (Processor* const node,
 
         jassert (node->isPortInput (port));
 
+        if (portType == PortType::Control || portType == PortType::CV)
+        {
+            const int bufIndex = createControlInputOps (portType, nodeID, port, renderingOps);
+            controlPorts.add ({ port, bufIndex, true, portType == PortType::CV });
+            continue;
+        }
+
         const int inputChan = node->getChannelPort (port);
+        bool readOnly = false;
+        const int bufIndex = createInputOps (node, nodeID, port, portType, inputChan < (int) numOuts, maxLatency, renderingOps, ourRenderingIndex, readOnly);
 
-        // get a list of all the inputs to this node
-        Array<uint32> sourceNodes;
-        Array<uint32> sourcePorts;
-        for (int i = graph.getNumConnections(); --i >= 0;)
+        jassert (bufIndex >= 0);
+        channelsToUse[portType.id()].add (bufIndex);
+        if (portType == PortType::Midi)
+            readOnlyMidi.add (readOnly);
+
+        if (inputChan < (int) numOuts)
         {
-            const auto* const c = graph.getConnection (i);
-            if (c->destNode == node->nodeId && c->destPort == port)
-            {
-                sourceNodes.add (c->sourceNode);
-                sourcePorts.add (c->sourcePort);
-            }
+            const int outputPort = node->getNthPort (portType, inputChan, false, false);
+            markBufferAsContaining (bufIndex, portType, nodeID, outputPort);
         }
+    } /* foreach port */
+
+    setNodeDelay (nodeID, maxLatency + node->getLatencySamples());
+
+    if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
+        totalLatency = maxLatency;
 
-        int bufIndex = -1;
-        if (sourceNodes.size() == 0)
+    int totalChans = jmax (node->getNumPorts (PortType::Audio, true),
+                           node->getNumPorts (PortType::Audio, false));
+    renderingOps.add (new ProcessBufferOp (node, channelsToUse[PortType::Audio], totalChans, 0, channelsToUse, readOnlyMidi, graph.controlBuffers, controlPorts, graph.isUsingDoublePrecision(), graph.getBlockSize()));
+}
+
+int GraphBuilder::createInputOps (Processor* const node,
+                                  const uint32 nodeID,
+                                  const uint32 port,
+                                  PortType portType,
+                                  bool writable,
+                                  int maxLatency,
+                                  Array<void*>& renderingOps,
+                                  const int ourRenderingIndex,
+                                  bool& readOnly)
+{
+    const int inputChan = node->getChannelPort (port);
+
+    // get a list of all the inputs to this node
+    Array<uint32> sourceNodes;
+    Array<uint32> sourcePorts;
+    getSources (nodeID, port, sourceNodes, sourcePorts);
+
+    int bufIndex = -1;
+    if (sourceNodes.size() == 0)
+    {
+        // unconnected input channel
+        if (portType == PortType::Audio && ! writable)
         {
-            // unconnected input channel
-            if (portType == PortType::Audio && inputChan >= (int) numOuts)
-            {
-                bufIndex = getReadOnlyEmptyBuffer();
-                jassert (bufIndex >= 0);
-            }
-            else
+            bufIndex = getReadOnlyEmptyBuffer();
+            jassert (bufIndex >= 0);
+        }
+        else
+        {
+            bufIndex = getFreeBuffer (portType);
+            switch (portType.id())
             {
-                bufIndex = getFreeBuffer (portType);
-                switch (portType.id())
-                {
-                    case PortType::Audio:
-                        renderingOps.add (new ClearChannelOp (bufIndex));
-                        break;
-                    case PortType::Midi:
-                        renderingOps.add (new ClearMidiBufferOp (bufIndex));
-                        break;
-                    default:
-                        break;
-                }
+                case PortType::Audio:
+                    renderingOps.add (new ClearChannelOp (bufIndex));
+                    break;
+                case PortType::Midi:
+                    renderingOps.add (new ClearMidiBufferOp (bufIndex));
+                    break;
+                default:
+                    break;
             }
         }
-        else if (sourceNodes.size() == 1)
-        {
-            // port with a straight forward single input..
-            const uint32 srcNode = sourceNodes.getUnchecked (0);
-            const uint32 srcPort = sourcePorts.getUnchecked (0);
+    }
+    else if (sourceNodes.size() == 1)
+    {
+        // port with a straight forward single input..
+        const uint32 srcNode = sourceNodes.getUnchecked (0);
+        const uint32 srcPort = sourcePorts.getUnchecked (0);
+
+        bufIndex = getBufferContaining (portType, srcNode, srcPort);
 
-            bufIndex = getBufferContaining (portType, srcNode, srcPort);
+        if (bufIndex < 0)
+        {
+            // if not found, this is probably a feedback loop
+            bufIndex = getReadOnlyEmptyBuffer();
+            jassert (bufIndex >= 0);
+        }
 
-            if (bufIndex < 0)
+        const bool bufNeededLater = isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort);
+        if (bufNeededLater && portType == PortType::Midi && ! writable && node->wantsReadOnlyMidi())
+        {
+            // the node only reads its MIDI, so it can share the buffer
+            readOnly = true;
+        }
+        else if (bufNeededLater && (writable || portType == PortType::Midi))
+        {
+            // can't mess up this channel because it's needed later by another node, so we
+            // need to use a copy of it..
+            const int newFreeBuffer = getFreeBuffer (portType);
+            markBufferAsContaining (newFreeBuffer, portType, anonymousNodeID, 0);
+            switch (portType.id())
             {
-                // if not found, this is probably a feedback loop
-                bufIndex = getReadOnlyEmptyBuffer();
-                jassert (bufIndex >= 0);
+                case PortType::Audio:
+                    renderingOps.add (new CopyChannelOp (bufIndex, newFreeBuffer));
+                    break;
+                case PortType::Midi:
+                    renderingOps.add (new CopyMidiBufferOp (bufIndex, newFreeBuffer));
+                    break;
+                default:
+                    break;
             }
 
-            const bool bufNeededLater = isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort);
-            if (portType == PortType::Control)
+            bufIndex = newFreeBuffer;
+        }
+
+        const int nodeDelay = getNodeDelay (srcNode);
+
+        if (portType == PortType::Audio && nodeDelay < maxLatency)
+            renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
+    }
+    else if (portType == PortType::Midi)
+    {
+        // several inputs merged in one pass, into one of them if it's free
+        Array<int> srcBuffers;
+        for (int i = 0; i < sourceNodes.size(); ++i)
+        {
+            const int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (i), sourcePorts.getUnchecked (i));
+            if (srcIndex < 0)
+                continue; // probably a feedback loop
+
+            if (bufIndex < 0
+                && ! isBufferNeededLater (ourRenderingIndex,
+                                          optimise ? port : (uint32) inputChan,
+                                          sourceNodes.getUnchecked (i),
+                                          sourcePorts.getUnchecked (i)))
             {
-                auto src = graph.getNodeForId (srcNode);
-                renderingOps.add (new BindParameterOp (
-                    src->getParameter ((int) srcPort),
-                    node->getParameter ((int) port)));
+                bufIndex = srcIndex;
+                srcBuffers.insert (0, srcIndex);
             }
-            else if (bufNeededLater && (inputChan < (int) numOuts || portType == PortType::Midi))
+            else
             {
-                // can't mess up this channel because it's needed later by another node, so we
-                // need to use a copy of it..
-                const int newFreeBuffer = getFreeBuffer (portType);
-                markBufferAsContaining (newFreeBuffer, portType, anonymousNodeID, 0);
-                switch (portType.id())
-                {
-                    case PortType::Audio:
-                        renderingOps.add (new CopyChannelOp (bufIndex, newFreeBuffer));
-                        break;
-                    case PortType::Midi:
-                        renderingOps.add (new CopyMidiBufferOp (bufIndex, newFreeBuffer));
-                        break;
-                    default:
-                        break;
-                }
-
-                bufIndex = newFreeBuffer;
+                srcBuffers.add (srcIndex);
             }
+        }
 
-            const int nodeDelay = getNodeDelay (srcNode);
-
-            if (nodeDelay < maxLatency)
-                renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
+        if (bufIndex < 0)
+        {
+            bufIndex = getFreeBuffer (portType);
+            jassert (bufIndex != 0);
+            markBufferAsContaining (bufIndex, portType, anonymousNodeID, 0);
         }
+
+        if (srcBuffers.isEmpty())
+            renderingOps.add (new ClearMidiBufferOp (bufIndex));
         else
+            renderingOps.add (new MergeMidiBuffersOp (srcBuffers, bufIndex));
+    }
+    else
+    {
+        // channel with a mix of several inputs..
+        // try to find a re-usable channel from our inputs..
+        int reusableInputIndex = -1;
+
+        for (int i = 0; i < sourceNodes.size(); ++i)
         {
-            // channel with a mix of several inputs..
-            // try to find a re-usable channel from our inputs..
-            int reusableInputIndex = -1;
+            const int sourceBufIndex = getBufferContaining (portType, sourceNodes.getUnchecked (i), sourcePorts.getUnchecked (i));
 
-            for (int i = 0; i < sourceNodes.size(); ++i)
+            if (sourceBufIndex >= 0
+                && ! isBufferNeededLater (ourRenderingIndex,
+                                          optimise ? port : (uint32) inputChan,
+                                          sourceNodes.getUnchecked (i),
+                                          sourcePorts.getUnchecked (i)))
             {
-                const int sourceBufIndex = getBufferContaining (portType, sourceNodes.getUnchecked (i), sourcePorts.getUnchecked (i));
+                // we've found one of our input chans that can be re-used..
+                reusableInputIndex = i;
+                bufIndex = sourceBufIndex;
 
-                if (sourceBufIndex >= 0
-                    && ! isBufferNeededLater (ourRenderingIndex,
-                                              inputChan,
-                                              sourceNodes.getUnchecked (i),
-                                              sourcePorts.getUnchecked (i)))
+                if (portType == PortType::Audio)
                 {
-                    // we've found one of our input chans that can be re-used..
-                    reusableInputIndex = i;
-                    bufIndex = sourceBufIndex;
-
-                    if (portType == PortType::Audio)
-                    {
-                        const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (i));
-                        if (nodeDelay < maxLatency)
-                            renderingOps.add (new DelayChannelOp (sourceBufIndex, maxLatency - nodeDelay));
-                    }
-
-                    break;
+                    const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (i));
+                    if (nodeDelay < maxLatency)
+                        renderingOps.add (new DelayChannelOp (sourceBufIndex, maxLatency - nodeDelay));
                 }
+
+                break;
             }
+        }
 
-            if (reusableInputIndex < 0)
-            {
-                // can't re-use any of our input chans, so get a new one and copy everything into it..
-                bufIndex = getFreeBuffer (portType);
-                jassert (bufIndex != 0);
+        if (reusableInputIndex < 0)
+        {
+            // can't re-use any of our input chans, so get a new one and copy everything into it..
+            bufIndex = getFreeBuffer (portType);
+            jassert (bufIndex != 0);
 
-                markBufferAsContaining (bufIndex, portType, anonymousNodeID, 0);
+            markBufferAsContaining (bufIndex, portType, anonymousNodeID, 0);
 
-                const int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (0), sourcePorts.getUnchecked (0));
-                if (srcIndex < 0)
-                {
-                    // if not found, this is probably a feedback loop
-                    if (portType == PortType::Audio)
-                        renderingOps.add (new ClearChannelOp (bufIndex));
-                    else if (portType == PortType::Midi)
-                        renderingOps.add (new ClearMidiBufferOp (bufIndex));
-                }
-                else
-                {
-                    if (portType == PortType::Audio)
-                        renderingOps.add (new CopyChannelOp (srcIndex, bufIndex));
-                    else if (portType == PortType::Midi)
-                        renderingOps.add (new CopyMidiBufferOp (srcIndex, bufIndex));
-                }
+            const int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (0), sourcePorts.getUnchecked (0));
+            if (srcIndex < 0)
+            {
+                // if not found, this is probably a feedback loop
+                renderingOps.add (new ClearChannelOp (bufIndex));
+            }
+            else
+            {
+                renderingOps.add (new CopyChannelOp (srcIndex, bufIndex));
+            }
 
-                reusableInputIndex = 0;
+            reusableInputIndex = 0;
 
-                if (portType == PortType::Audio)
-                {
-                    const int nodeDelay = getNodeDelay (sourceNodes.getFirst());
-                    if (nodeDelay < maxLatency)
-                        renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
-                }
+            if (portType == PortType::Audio)
+            {
+                const int nodeDelay = getNodeDelay (sourceNodes.getFirst());
+                if (nodeDelay < maxLatency)
+                    renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
             }
+        }
 
-            for (int j = 0; j < sourceNodes.size(); ++j)
+        for (int j = 0; j < sourceNodes.size(); ++j)
+        {
+            if (j != reusableInputIndex)
             {
-                if (j != reusableInputIndex)
+                int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (j), sourcePorts.getUnchecked (j));
+                if (srcIndex >= 0)
                 {
-                    int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (j), sourcePorts.getUnchecked (j));
-                    if (srcIndex >= 0)
+                    if (portType == PortType::Audio)
                     {
-                        if (portType == PortType::Audio)
-                        {
-                            const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (j));
+                        const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (j));
 
-                            if (nodeDelay < maxLatency)
+                        if (nodeDelay < maxLatency)
+                        {
+                            if (! isBufferNeededLater (ourRenderingIndex, port, sourceNodes.getUnchecked (j), sourcePorts.getUnchecked (j)))
                             {
-                                if (! isBufferNeededLater (ourRenderingIndex, port, sourceNodes.getUnchecked (j), sourcePorts.getUnchecked (j)))
-                                {
-                                    renderingOps.add (new DelayChannelOp (srcIndex, maxLatency - nodeDelay));
-                                }
-                                else // buffer is reused elsewhere, can't be delayed
-                                {
-                                    const int bufferToDelay = getFreeBuffer (PortType::Audio);
-                                    renderingOps.add (new CopyChannelOp (srcIndex, bufferToDelay));
-                                    renderingOps.add (new DelayChannelOp (bufferToDelay, maxLatency - nodeDelay));
-                                    srcIndex = bufferToDelay;
-                                }
+                                renderingOps.add (new DelayChannelOp (srcIndex, maxLatency - nodeDelay));
+                            }
+                            else // buffer is reused elsewhere, can't be delayed
+                            {
+                                const int bufferToDelay = getFreeBuffer (PortType::Audio);
+                                renderingOps.add (new CopyChannelOp (srcIndex, bufferToDelay));
+                                renderingOps.add (new DelayChannelOp (bufferToDelay, maxLatency - nodeDelay));
+                                srcIndex = bufferToDelay;
                             }
-
-                            renderingOps.add (new AddChannelOp (srcIndex, bufIndex));
-                        }
-                        else if (portType == PortType::Midi)
-                        {
-                            renderingOps.add (new AddMidiBufferOp (srcIndex, bufIndex));
                         }
+
+                        renderingOps.add (new AddChannelOp (srcIndex, bufIndex));
                     }
                 }
             }
         }
+    }
 
-        jassert (bufIndex >= 0);
-        channelsToUse[portType.id()].add (bufIndex);
+    jassert (bufIndex >= 0);
+    return bufIndex;
+}
 
-        if (inputChan < (int) numOuts)
+void GraphBuilder::createSubgraphOps (const Step& step, Array<void*>& renderingOps, const int ourRenderingIndex)
+{
+    // the graph's inputs on its input step, its outputs on the output step
+    const bool inputs = step.type == subgraphInputStep;
+    Processor* const node = step.node;
+    Array<int> channelsToUse[PortType::Unknown];
+    const int maxLatency = getInputLatency (step.id);
+
+    for (uint32 port = 0; port < node->getNumPorts(); ++port)
+    {
+        const PortType portType (node->getPortType (port));
+        if ((portType != PortType::Audio && portType != PortType::Midi) || node->isPortInput (port) != inputs)
+            continue;
+
+        bool readOnly = false;
+        int bufIndex = createInputOps (node, step.id, port, portType, true, maxLatency, renderingOps, ourRenderingIndex, readOnly);
+        if (bufIndex == getReadOnlyEmptyBuffer())
         {
-            const int outputPort = node->getNthPort (portType, inputChan, false, false);
-            markBufferAsContaining (bufIndex, portType, node->nodeId, outputPort);
+            // probably a feedback loop, the ops below write to it
+            bufIndex = getFreeBuffer (portType);
+            if (portType == PortType::Audio)
+                renderingOps.add (new ClearChannelOp (bufIndex));
+            else
+                renderingOps.add (new ClearMidiBufferOp (bufIndex));
         }
-    } /* foreach port */
 
-    setNodeDelay (node->nodeId, maxLatency + node->getLatencySamples());
+        markBufferAsContaining (bufIndex, portType, step.id, port);
+        channelsToUse[portType.id()].add (bufIndex);
+    }
 
-    if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
-        totalLatency = maxLatency;
+    setNodeDelay (step.id, maxLatency);
 
-    int totalChans = jmax (node->getNumPorts (PortType::Audio, true),
-                           node->getNumPorts (PortType::Audio, false));
-    renderingOps.add (new ProcessBufferOp (node, channelsToUse[PortType::Audio], totalChans, 0, channelsToUse));
+    if (inputs)
+        renderingOps.add (new SubgraphInputOp (node, channelsToUse[PortType::Audio], channelsToUse[PortType::Midi]));
+    else
+        renderingOps.add (new SubgraphOutputOp (node, channelsToUse[PortType::Audio], channelsToUse[PortType::Midi]));
+}
+
+int GraphBuilder::createControlInputOps (PortType portType,
+                                         const uint32 nodeID,
+                                         const uint32 port,
+                                         Array<void*>& renderingOps)
+{
+    Array<uint32> sourceNodes;
+    Array<uint32> sourcePorts;
+    getSources (nodeID, port, sourceNodes, sourcePorts);
+
+    // unconnected control inputs keep their own value, CV reads silence
+    if (sourceNodes.size() == 0)
+        return portType == PortType::CV ? getReadOnlyEmptyBuffer() : -1;
+
+    Array<PortType> sourceTypes;
+    for (int i = 0; i < sourceNodes.size(); ++i)
+    {
+        const auto iter = flatNodes.find (sourceNodes.getUnchecked (i));
+        sourceTypes.add (iter != flatNodes.end() ? iter->second->getPortType (sourcePorts.getUnchecked (i)) : portType);
+    }
+
+    // inputs are read-only, so a single source of the same type is used in place
+    if (sourceNodes.size() == 1 && sourceTypes.getFirst() == portType)
+    {
+        const int bufIndex = getBufferContaining (portType, sourceNodes.getFirst(), sourcePorts.getFirst());
+        // if not found, this is probably a feedback loop
+        return bufIndex >= 0 ? bufIndex : getReadOnlyEmptyBuffer();
+    }
+
+    // otherwise sources are converted and summed into a new buffer
+    const int bufIndex = getFreeBuffer (portType);
+    jassert (bufIndex != 0);
+    markBufferAsContaining (bufIndex, portType, anonymousNodeID, 0);
+
+    for (int i = 0; i < sourceNodes.size(); ++i)
+    {
+        const auto srcType = sourceTypes.getUnchecked (i);
+        int srcIndex = getBufferContaining (srcType, sourceNodes.getUnchecked (i), sourcePorts.getUnchecked (i));
+        if (srcIndex < 0)
+            srcIndex = getReadOnlyEmptyBuffer();
+
+        if (portType == PortType::CV)
+            renderingOps.add (new MixCVOp (graph.controlBuffers, srcType, srcIndex, bufIndex, i > 0));
+        else if (i == 0)
+            renderingOps.add (new CopyControlOp (graph.controlBuffers, srcIndex, bufIndex));
+        else
+            renderingOps.add (new AddControlOp (graph.controlBuffers, srcIndex, bufIndex));
+    }
+
+    return bufIndex;
 }
 
 int GraphBuilder::getFreeBuffer (PortType type)
@@ -838,33 +1602,31 @@ void GraphBuilder::markUnusedBuffersFree (const int stepIndex)
 
         for (int i = 0; i < nodes.size(); ++i)
         {
-            if (isNodeBusy (nodes.getUnchecked (i))
-                && ! isBufferNeededLater (stepIndex, EL_INVALID_PORT, nodes.getUnchecked (i), ports.getUnchecked (i)))
-            {
+            if (! isNodeBusy (nodes.getUnchecked (i)))
+                continue;
+
+            const bool neededLater = optimise
+                                         ? getLastUse (nodes.getUnchecked (i), ports.getUnchecked (i)) > stepIndex
+                                         : isBufferNeededLater (stepIndex, EL_INVALID_PORT, nodes.getUnchecked (i), ports.getUnchecked (i));
+            if (! neededLater)
                 nodes.set (i, (uint32) freeNodeID);
-            }
         }
     }
 }
 
 bool GraphBuilder::isBufferNeededLater (int stepIndexToSearchFrom, uint32 inputChannelOfIndexToIgnore, const uint32 sourceNode, const uint32 outputPortIndex) const
 {
-    while (stepIndexToSearchFrom < orderedNodes.size())
+    for (const auto& arc : getOutputArcs (sourceNode))
     {
-        const Processor* const node = (const Processor*) orderedNodes.getUnchecked (stepIndexToSearchFrom);
+        if (arc.sourcePort != outputPortIndex)
+            continue;
 
-        {
-            for (uint32 port = 0; port < node->getNumPorts(); ++port)
-            {
-                if (port != inputChannelOfIndexToIgnore && graph.getConnectionBetween (sourceNode, outputPortIndex, node->nodeId, port) != nullptr)
-                {
-                    return true;
-                }
-            }
-        }
+        const auto iter = renderIndex.find (arc.destNode);
+        if (iter == renderIndex.end() || iter->second < stepIndexToSearchFrom)
+            continue;
 
-        inputChannelOfIndexToIgnore = EL_INVALID_PORT;
-        ++stepIndexToSearchFrom;
+        if (iter->second > stepIndexToSearchFrom || arc.destPort != inputChannelOfIndexToIgnore)
+            return true;
     }
 
     return false;
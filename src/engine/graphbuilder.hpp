@@ -5,6 +5,8 @@
 
 #include "ElementApp.h"
 
+#include <unordered_map>
+
 namespace element {
 
 class GraphNode;
@@ -20,36 +22,146 @@ public:
                           const OwnedArray<MidiBuffer>& sharedMidiBuffers,
                           const int numSamples) = 0;
 
+    /** Same as above for graphs rendering in double precision. */
+    virtual void perform (AudioBuffer<double>& sharedBufferChans,
+                          const OwnedArray<MidiBuffer>& sharedMidiBuffers,
+                          const int numSamples) = 0;
+
     JUCE_LEAK_DETECTOR (GraphOp);
 };
 
+/** Copies samples between precisions, at the edges of 64-bit rendering. */
+template <typename SourceType, typename DestType>
+inline void convertSamples (const SourceType* source, DestType* dest, int numSamples) noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+        dest[i] = static_cast<DestType> (source[i]);
+}
+
+/** Control values and CV signals shared by the rendering ops of a graph.
+    Buffer 0 of each kind is read-only silence. */
+struct ControlBuffers
+{
+    HeapBlock<float> values;
+    int numValues = 0;
+    AudioSampleBuffer cv { 1, 1 };
+
+    void setSize (int numValuesNeeded, int numCVNeeded, int blockSize)
+    {
+        numValues = jmax (1, numValuesNeeded);
+        values.calloc ((size_t) numValues);
+        cv.setSize (jmax (1, numCVNeeded), jmax (1, blockSize));
+        cv.clear();
+    }
+
+    float* getValue (int index) noexcept { return values.get() + index; }
+    float* getCV (int index) noexcept { return cv.getWritePointer (index); }
+};
+
 /** Used to calculate the correct sequence of rendering ops needed, based on
-    the best re-use of shared buffers at each stage. */
+    the best re-use of shared buffers at each stage.
+
+    Before building, a liveness pass finds the last step each output is
+    read at. Buffers are handed out in render order and released right
+    after their last read, which colours the lifetime intervals with the
+    fewest buffers. Turning optimisation off gives the previous greedy
+    behaviour, where buffers were held one step longer and summed inputs
+    were always copied to a fresh buffer.
+
+    Subgraphs are compiled into the same sequence when they can be. The
+    child's nodes and connections are inlined between two steps standing in
+    for the graph node itself: one applies its input gain and MIDI filters,
+    the other its output gain. The child's IO nodes become aliases of the
+    buffers on those steps, so nothing is copied in or out of the child and
+    its nodes share buffers with the parent's. Editing stays hierarchical,
+    only the plan is flat. Graphs with their own MIDI channel or velocity
+    filters, oversampling, or which are disabled or bypassed, still render
+    as a single node.
+
+    Every op can run on float or double shared buffers. Which one a graph
+    uses is fixed when it's prepared, see GraphNode::setDoublePrecision.
+ */
 class GraphBuilder
 {
 public:
+    /** Buffer and op counts of a build. */
+    struct Stats
+    {
+        int audioBuffers = 0;
+        int midiBuffers = 0;
+        int clearOps = 0;
+        int copyOps = 0;
+        int addOps = 0;
+        int delayOps = 0;
+        int inlinedGraphs = 0;
+    };
+
     GraphBuilder (GraphNode& graph_,
                   const Array<void*>& orderedNodes_,
-                  Array<void*>& renderingOps);
+                  Array<void*>& renderingOps,
+                  bool optimise = true);
 
     int buffersNeeded (PortType type);
     int getTotalLatencySamples() const { return totalLatency; }
 
+    /** Returns the buffer and op counts of this build. */
+    const Stats& getStats() const noexcept { return stats; }
+
+    /** MIDI buffer the rendering ops use as scratch space when merging and
+        filtering. It's reserved like the others, so nothing allocates. */
+    static constexpr int midiScratchBuffer = 1;
+
 private:
     //==============================================================================
     GraphNode& graph;
-    const Array<void*>& orderedNodes;
     Array<uint32> allNodes[PortType::Unknown];
     Array<uint32> allPorts[PortType::Unknown];
+    std::unordered_map<uint32, int> renderIndex;
+    std::unordered_map<uint64, int> lastUse;
+    const bool optimise;
+    Stats stats;
 
     enum
     {
         freeNodeID = 0xffffffff,
         zeroNodeID = 0xfffffffe,
-        anonymousNodeID = 0xfffffffd
+        anonymousNodeID = 0xfffffffd,
+        scratchNodeID = 0xfffffffc,
+        firstInlineID = 0x80000000 // ids given to inlined nodes and subgraph steps
+    };
+
+    /** A connection between steps of the flattened plan. */
+    struct FlatArc
+    {
+        uint32 sourceNode, sourcePort, destNode, destPort;
+    };
+
+    enum StepType
+    {
+        nodeStep,
+        subgraphInputStep,
+        subgraphOutputStep
+    };
+
+    struct Step
+    {
+        Processor* node;
+        uint32 id;
+        StepType type;
     };
 
-    static bool isNodeBusy (uint32 nodeID) noexcept { return nodeID != freeNodeID && nodeID != zeroNodeID; }
+    Array<Step> steps;
+    std::unordered_map<uint32, Processor*> flatNodes;
+    std::unordered_map<uint32, Array<FlatArc>> inputArcs, outputArcs;
+    uint32 nextInlineID = firstInlineID;
+    int numInlined = 0;
+
+    void compile (GraphNode& source, const Array<Processor*>& order, uint32 inputID, uint32 outputID, bool inlined);
+    bool canInline (Processor* node) const;
+    const Array<FlatArc>& getInputArcs (uint32 nodeID) const noexcept;
+    const Array<FlatArc>& getOutputArcs (uint32 nodeID) const noexcept;
+
+    static bool isNodeBusy (uint32 nodeID) noexcept { return nodeID != freeNodeID && nodeID != zeroNodeID && nodeID != scratchNodeID; }
 
     Array<uint32> nodeDelayIDs;
     Array<int> nodeDelays;
@@ -59,8 +171,14 @@ private:
     void setNodeDelay (const uint32 nodeID, const int latency);
 
     int getInputLatency (const uint32 nodeID) const;
-
-    void createRenderingOpsForNode (Processor* const node, Array<void*>& renderingOps, const int ourRenderingIndex);
+    int getLastUse (const uint32 nodeID, const uint32 port) const noexcept;
+    void updateStats (const Array<void*>& renderingOps, int firstOp);
+
+    void createRenderingOpsForNode (Processor* const node, const uint32 nodeID, Array<void*>& renderingOps, const int ourRenderingIndex);
+    void createSubgraphOps (const Step& step, Array<void*>& renderingOps, const int ourRenderingIndex);
+    int createInputOps (Processor* const node, const uint32 nodeID, const uint32 port, PortType type, bool writable, int maxLatency, Array<void*>& renderingOps, const int ourRenderingIndex, bool& readOnly);
+    int createControlInputOps (PortType type, const uint32 nodeID, const uint32 port, Array<void*>& renderingOps);
+    void getSources (const uint32 nodeId, const uint32 port, Array<uint32>& sourceNodes, Array<uint32>& sourcePorts) const;
 
     int getFreeBuffer (PortType type);
     int getReadOnlyEmptyBuffer() const noexcept;
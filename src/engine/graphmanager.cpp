@@ -326,9 +326,35 @@ Processor* GraphManager::createFilter (const PluginDescription* desc, double x,
         errorMessage = "Could not find node";
     }
 
+    if (auto* apn = dynamic_cast<AudioProcessorNode*> (node.get()))
+    {
+        if (apn->getAudioPluginInstance() != nullptr)
+        {
+            apn->setStandbyFactory ([&plugins = pluginManager, description = *desc]() -> AudioProcessor* {
+                String error;
+                auto* const plugin = plugins.createAudioPlugin (description, error);
+                if (plugin != nullptr)
+                    plugin->enableAllBuses();
+                return plugin;
+            });
+        }
+    }
+
     return node != nullptr ? processor.addNode (node.release(), nodeId) : nullptr;
 }
 
+Processor* GraphManager::createFilterOrReuse (const Node& node, const PluginDescription& desc)
+{
+    if (ProcessorPtr obj = pluginManager.takeReusableProcessor (node))
+    {
+        if (obj->getSampleRate() != processor.getSampleRate() || obj->getBlockSize() != processor.getBlockSize())
+            obj->unprepare();
+        return processor.addNode (obj.get(), node.getNodeId());
+    }
+
+    return createFilter (&desc, 0, 0, node.getNodeId());
+}
+
 Processor* GraphManager::createPlaceholder (const Node& node)
 {
     auto* ph = new PlaceholderProcessor();
@@ -485,8 +511,11 @@ void GraphManager::removeNode (const uint32 uid)
             ProcessorPtr obj = node.getObject();
             if (obj)
             {
-                obj->willBeRemoved();
-                obj->releaseResources();
+                // a batched removal still renders until its graph rebuilds
+                GraphNode::callAfterBatch ([obj]() {
+                    obj->willBeRemoved();
+                    obj->releaseResources();
+                });
             }
 
             for (int i = bindings.size(); --i >= 0;)
@@ -500,7 +529,7 @@ void GraphManager::removeNode (const uint32 uid)
             nodes.removeChild (data, nullptr);
             // clear all referecnce counted objects
             Node::sanitizeProperties (data, true);
-            // finally delete the node + plugin instance.
+            // finally delete the node + plugin instance, or after the batch rebuilds.
             obj = nullptr;
         }
     }
@@ -597,7 +626,7 @@ void GraphManager::setNodeModel (const Node& node)
     {
         Node node (nodes.getChild (i), false);
         const PluginDescription desc (pluginManager.findDescriptionFor (node));
-        if (ProcessorPtr obj = createFilter (&desc, 0, 0, node.getNodeId()))
+        if (ProcessorPtr obj = createFilterOrReuse (node, desc))
         {
             setupNode (node.data(), obj);
             obj->setEnabled (node.isEnabled());
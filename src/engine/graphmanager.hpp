@@ -107,6 +107,7 @@ private:
     uint32 getNextUID() noexcept;
     inline void changed() { sendChangeMessage(); }
     Processor* createFilter (const PluginDescription* desc, double x = 0.0f, double y = 0.0f, uint32 nodeId = 0);
+    Processor* createFilterOrReuse (const Node& node, const PluginDescription& desc);
     Processor* createPlaceholder (const Node& node);
 
     void setupNode (const ValueTree& data, ProcessorPtr object);
@@ -7,6 +7,7 @@
 #include <element/audioengine.hpp>
 #include <element/midipipe.hpp>
 #include "engine/miditranspose.hpp"
+#include "engine/midikernel.hpp"
 #include "engine/nodes/NodeTypes.h"
 #include <element/node.hpp>
 #include <element/portcount.hpp>
@@ -15,6 +16,71 @@
 
 namespace element {
 
+namespace {
+/** Message thread state of the current batch. */
+struct BatchState
+{
+    int depth = 0;
+    Array<GraphNode*> graphs; // graphs remove themselves when deleted
+    ReferenceCountedArray<Processor> removed;
+    std::vector<std::function<void()>> deferred;
+};
+
+static BatchState& batchState()
+{
+    static BatchState state;
+    return state;
+}
+} // namespace
+
+GraphNode::ScopedBatch::ScopedBatch()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    ++batchState().depth;
+}
+
+GraphNode::ScopedBatch::~ScopedBatch()
+{
+    auto& state = batchState();
+    if (--state.depth > 0)
+        return;
+
+    auto graphs = std::move (state.graphs);
+    auto removed = std::move (state.removed);
+    auto deferred = std::move (state.deferred);
+    state.graphs.clear();
+    state.removed.clear();
+    state.deferred.clear();
+
+    for (auto* graph : graphs)
+    {
+        graph->cancelPendingUpdate();
+        graph->buildRenderingSequence();
+    }
+
+    for (auto* node : removed)
+    {
+        node->setParentGraph (nullptr);
+        node->setPlayHead (nullptr);
+    }
+
+    for (auto& fn : deferred)
+        fn();
+}
+
+bool GraphNode::isBatching() noexcept
+{
+    return batchState().depth > 0;
+}
+
+void GraphNode::callAfterBatch (std::function<void()> fn)
+{
+    if (isBatching())
+        batchState().deferred.push_back (std::move (fn));
+    else
+        fn();
+}
+
 GraphNode::Connection::Connection (const uint32 sourceNode_, const uint32 sourcePort_, const uint32 destNode_, const uint32 destPort_) noexcept
     : Arc (sourceNode_, sourcePort_, destNode_, destPort_) {}
 
@@ -39,22 +105,22 @@ GraphNode::~GraphNode()
     renderingSequenceChanged.disconnect_all_slots();
     clearRenderingSequence();
     clear();
+    batchState().graphs.removeAllInstancesOf (this);
 }
 
 void GraphNode::clear()
 {
     nodes.clear();
     connections.clear();
+    nodeMap.clear();
+    arcs.clear();
     clearRenderingSequence();
 }
 
 Processor* GraphNode::getNodeForId (const uint32 nodeId) const
 {
-    for (int i = nodes.size(); --i >= 0;)
-        if (nodes.getUnchecked (i)->nodeId == nodeId)
-            return nodes.getUnchecked (i);
-
-    return nullptr;
+    const auto iter = nodeMap.find (nodeId);
+    return iter != nodeMap.end() ? iter->second : nullptr;
 }
 
 Processor* GraphNode::addNode (Processor* newNode, uint32 nodeId)
@@ -65,13 +131,10 @@ Processor* GraphNode::addNode (Processor* newNode, uint32 nodeId)
         return nullptr;
     }
 
-    for (int i = nodes.size(); --i >= 0;)
+    if (getNodeForId (newNode->nodeId) == newNode)
     {
-        if (nodes.getUnchecked (i).get() == newNode)
-        {
-            jassertfalse; // Cannot add the same object to the graph twice!
-            return nullptr;
-        }
+        jassertfalse; // Cannot add the same object to the graph twice!
+        return nullptr;
     }
 
     if (nodeId == 0 || nodeId == EL_INVALID_NODE)
@@ -99,33 +162,72 @@ Processor* GraphNode::addNode (Processor* newNode, uint32 nodeId)
     newNode->refreshPorts();
     newNode->prepare (getSampleRate(), getBlockSize(), this);
     triggerAsyncUpdate();
+    nodeMap[newNode->nodeId] = newNode;
     return nodes.add (newNode);
 }
 
 bool GraphNode::removeNode (const uint32 nodeId)
 {
     disconnectNode (nodeId);
-    for (int i = nodes.size(); --i >= 0;)
-    {
-        ProcessorPtr n = nodes.getUnchecked (i);
-        if (n->nodeId == nodeId)
-        {
-            nodes.remove (i);
+    const auto iter = nodeMap.find (nodeId);
+    if (iter == nodeMap.end())
+        return false;
 
-            handleAsyncUpdate();
-            n->setParentGraph (nullptr);
-            n->setPlayHead (nullptr);
+    ProcessorPtr n = iter->second;
+    nodeMap.erase (iter);
+    arcs.erase (nodeId);
+    nodes.removeObject (n.get());
 
-            if (n->isSubGraph())
-            {
-                DBG ("[element] sub graph removed");
-            }
+    if (isBatching())
+    {
+        // the sequence still renders n, it's detached when the batch rebuilds
+        auto& state = batchState();
+        state.graphs.addIfNotAlreadyThere (this);
+        state.removed.add (n);
+        return true;
+    }
 
-            return true;
-        }
+    handleAsyncUpdate();
+    n->setParentGraph (nullptr);
+    n->setPlayHead (nullptr);
+
+    if (n->isSubGraph())
+    {
+        DBG ("[element] sub graph removed");
     }
 
-    return false;
+    return true;
+}
+
+const Array<const GraphNode::Connection*>& GraphNode::getInputConnections (const uint32 nodeId) const noexcept
+{
+    static const Array<const Connection*> none;
+    const auto iter = arcs.find (nodeId);
+    return iter != arcs.end() ? iter->second.inputs : none;
+}
+
+const Array<const GraphNode::Connection*>& GraphNode::getOutputConnections (const uint32 nodeId) const noexcept
+{
+    static const Array<const Connection*> none;
+    const auto iter = arcs.find (nodeId);
+    return iter != arcs.end() ? iter->second.outputs : none;
+}
+
+void GraphNode::addArcs (const Connection* c)
+{
+    arcs[c->sourceNode].outputs.add (c);
+    arcs[c->destNode].inputs.add (c);
+}
+
+void GraphNode::removeArcs (const Connection* c)
+{
+    auto src = arcs.find (c->sourceNode);
+    if (src != arcs.end())
+        src->second.outputs.removeFirstMatchingValue (c);
+
+    auto dst = arcs.find (c->destNode);
+    if (dst != arcs.end())
+        dst->second.inputs.removeFirstMatchingValue (c);
 }
 
 const GraphNode::Connection*
@@ -142,16 +244,9 @@ const GraphNode::Connection*
 bool GraphNode::isConnected (const uint32 sourceNode,
                              const uint32 destNode) const
 {
-    for (int i = connections.size(); --i >= 0;)
-    {
-        const Connection* const c = connections.getUnchecked (i);
-
-        if (c->sourceNode == sourceNode
-            && c->destNode == destNode)
-        {
+    for (const auto* c : getOutputConnections (sourceNode))
+        if (c->destNode == destNode)
             return true;
-        }
-    }
 
     return false;
 }
@@ -212,6 +307,7 @@ bool GraphNode::addConnection (const uint32 sourceNode, const uint32 sourcePort,
     ArcSorter sorter;
     Connection* c = new Connection (sourceNode, sourcePort, destNode, destPort);
     connections.addSorted (sorter, c);
+    addArcs (c);
     triggerAsyncUpdate();
     return true;
 }
@@ -227,6 +323,8 @@ bool GraphNode::connectChannels (PortType type, uint32 sourceNode, int32 sourceC
 
 void GraphNode::removeConnection (const int index)
 {
+    if (const auto* c = connections[index])
+        removeArcs (c);
     connections.remove (index);
     cancelPendingUpdate();
     triggerAsyncUpdate();
@@ -234,41 +332,30 @@ void GraphNode::removeConnection (const int index)
 
 bool GraphNode::removeConnection (const uint32 sourceNode, const uint32 sourcePort, const uint32 destNode, const uint32 destPort)
 {
-    bool doneAnything = false;
-
-    for (int i = connections.size(); --i >= 0;)
-    {
-        const Connection* const c = connections.getUnchecked (i);
-
-        if (c->sourceNode == sourceNode
-            && c->destNode == destNode
-            && c->sourcePort == sourcePort
-            && c->destPort == destPort)
-        {
-            removeConnection (i);
-            doneAnything = true;
-        }
-    }
+    const Connection c (sourceNode, sourcePort, destNode, destPort);
+    ArcSorter sorter;
+    const int index = connections.indexOfSorted (sorter, &c);
+    if (index < 0)
+        return false;
 
-    return doneAnything;
+    removeConnection (index);
+    return true;
 }
 
 bool GraphNode::disconnectNode (const uint32 nodeId)
 {
-    bool doneAnything = false;
+    Array<const Connection*> attached (getInputConnections (nodeId));
+    attached.addArray (getOutputConnections (nodeId));
 
-    for (int i = connections.size(); --i >= 0;)
+    ArcSorter sorter;
+    for (const auto* c : attached)
     {
-        const Connection* const c = connections.getUnchecked (i);
-
-        if (c->sourceNode == nodeId || c->destNode == nodeId)
-        {
-            removeConnection (i);
-            doneAnything = true;
-        }
+        const int index = connections.indexOfSorted (sorter, c);
+        if (index >= 0)
+            removeConnection (index);
     }
 
-    return doneAnything;
+    return ! attached.isEmpty();
 }
 
 bool GraphNode::isConnectionLegal (const Connection* const c) const
@@ -304,34 +391,66 @@ bool GraphNode::removeIllegalConnections()
 void GraphNode::setMidiChannel (const int channel) noexcept
 {
     jassert (isPositiveAndBelow (channel, 17));
-    if (channel <= 0)
-        midiChannels.setOmni (true);
-    else
-        midiChannels.setChannel (channel);
+    {
+        ScopedLock sl (getPropertyLock());
+        if (channel <= 0)
+            midiChannels.setOmni (true);
+        else
+            midiChannels.setChannel (channel);
+        publishInputFilter (getInputFilter().velocityCurve);
+    }
+    updateParentSequence();
 }
 
 void GraphNode::setMidiChannels (const BigInteger channels) noexcept
 {
-    ScopedLock sl (getPropertyLock());
-    midiChannels.setChannels (channels);
+    {
+        ScopedLock sl (getPropertyLock());
+        midiChannels.setChannels (channels);
+        publishInputFilter (getInputFilter().velocityCurve);
+    }
+    updateParentSequence();
 }
 
 void GraphNode::setMidiChannels (const MidiChannels channels) noexcept
 {
-    ScopedLock sl (getPropertyLock());
-    midiChannels = channels;
+    {
+        ScopedLock sl (getPropertyLock());
+        midiChannels = channels;
+        publishInputFilter (getInputFilter().velocityCurve);
+    }
+    updateParentSequence();
 }
 
 bool GraphNode::acceptsMidiChannel (const int channel) const noexcept
 {
-    ScopedLock sl (getPropertyLock());
-    return midiChannels.isOn (channel);
+    return ! getInputFilter().isChannelOff (channel);
 }
 
 void GraphNode::setVelocityCurveMode (const VelocityCurve::Mode mode) noexcept
 {
-    ScopedLock sl (getPropertyLock());
-    velocityCurve.setMode (mode);
+    {
+        ScopedLock sl (getPropertyLock());
+        publishInputFilter (mode);
+    }
+    updateParentSequence();
+}
+
+// call with the property lock held
+void GraphNode::publishInputFilter (int velocityCurveMode)
+{
+    InputFilter filter;
+    filter.midiChannels = (uint32) midiChannels.get().getBitRangeAsInt (0, 17);
+    filter.velocityCurve = velocityCurveMode;
+    inputFilter.store (filter);
+}
+
+void GraphNode::updateParentSequence()
+{
+    // the parent may inline this graph into its own sequence
+    if (isSubGraph())
+        if (auto* parent = getParentGraph())
+            parent->triggerAsyncUpdate();
 }
 
 static void deleteRenderOpArray (Array<void*>& ops)
@@ -346,7 +465,7 @@ void GraphNode::clearRenderingSequence()
     Array<void*> oldOps;
 
     {
-        const ScopedLock sl (getPropertyLock());
+        const ScopedLock sl (seqLock);
         renderingOps.swapWith (oldOps);
     }
 
@@ -359,25 +478,58 @@ bool GraphNode::isAnInputTo (const uint32 possibleInputId,
 {
     if (recursionCheck > 0)
     {
-        for (int i = connections.size(); --i >= 0;)
-        {
-            const GraphNode::Connection* const c = connections.getUnchecked (i);
-
-            if (c->destNode == possibleDestinationId
-                && (c->sourceNode == possibleInputId
-                    || isAnInputTo (possibleInputId, c->sourceNode, recursionCheck - 1)))
+        for (const auto* c : getInputConnections (possibleDestinationId))
+            if (c->sourceNode == possibleInputId
+                || isAnInputTo (possibleInputId, c->sourceNode, recursionCheck - 1))
                 return true;
-        }
     }
 
     return false;
 }
 
+void GraphNode::getRenderOrder (Array<Processor*>& ordered) const
+{
+    // depth first over the inputs so every node follows its sources,
+    // feedback loops are broken wherever they are first found
+    std::unordered_map<uint32, bool> visited;
+    std::vector<std::pair<Processor*, int>> stack;
+    visited.reserve ((size_t) nodes.size());
+    ordered.ensureStorageAllocated (nodes.size());
+
+    for (auto* node : nodes)
+    {
+        if (! visited.emplace (node->nodeId, true).second)
+            continue;
+
+        stack.push_back ({ node, 0 });
+        while (! stack.empty())
+        {
+            auto& top = stack.back();
+            const auto& inputs = getInputConnections (top.first->nodeId);
+
+            if (top.second < inputs.size())
+            {
+                const uint32 sourceId = inputs.getUnchecked (top.second++)->sourceNode;
+                if (visited.emplace (sourceId, true).second)
+                    if (auto* source = getNodeForId (sourceId))
+                        stack.push_back ({ source, 0 });
+            }
+            else
+            {
+                ordered.add (top.first);
+                stack.pop_back();
+            }
+        }
+    }
+}
+
 void GraphNode::buildRenderingSequence()
 {
     Array<void*> newRenderingOps;
     int numRenderingBuffersNeeded = 2;
     int numMidiBuffersNeeded = 1;
+    int numControlBuffersNeeded = 1;
+    int numCVBuffersNeeded = 1;
 
     {
         //XXX:
@@ -386,40 +538,40 @@ void GraphNode::buildRenderingSequence()
         Array<void*> orderedNodes;
 
         {
-            const LookupTable table (connections);
-
-            for (int i = 0; i < nodes.size(); ++i)
-            {
-                Processor* const node = nodes.getUnchecked (i);
-
-                int j = 0;
-                for (; j < orderedNodes.size(); ++j)
-                    if (table.isAnInputTo (node->nodeId, ((Processor*) orderedNodes.getUnchecked (j))->nodeId))
-                        break;
-
-                orderedNodes.insert (j, node);
-            }
+            Array<Processor*> order;
+            getRenderOrder (order);
+            for (auto* node : order)
+                orderedNodes.add (node);
         }
 
         GraphBuilder builder (*this, orderedNodes, newRenderingOps);
         numRenderingBuffersNeeded = builder.buffersNeeded (PortType::Audio);
         numMidiBuffersNeeded = builder.buffersNeeded (PortType::Midi);
+        numControlBuffersNeeded = builder.buffersNeeded (PortType::Control);
+        numCVBuffersNeeded = builder.buffersNeeded (PortType::CV);
+        buildStats = builder.getStats();
         setLatencySamples (builder.getTotalLatencySamples());
     }
 
     {
         // swap over to the new rendering sequence..
         // const ScopedLock sl (getCallbackLock());
-        renderingBuffers.setSize (numRenderingBuffersNeeded, 4096);
+        // only the precision the graph renders in needs room
+        const int numFloat = doublePrecision ? 1 : numRenderingBuffersNeeded;
+        const int numDouble = doublePrecision ? numRenderingBuffersNeeded : 1;
+        renderingBuffers.setSize (numFloat, numFloat > 1 ? jmax (4096, getBlockSize()) : 1);
         renderingBuffers.clear();
+        renderingBuffers64.setSize (numDouble, numDouble > 1 ? jmax (4096, getBlockSize()) : 1);
+        renderingBuffers64.clear();
 
         for (int i = midiBuffers.size(); --i >= 0;)
             midiBuffers.getUnchecked (i)->clear();
 
         while (midiBuffers.size() < numMidiBuffersNeeded)
-            midiBuffers.add (new MidiBuffer());
+            MidiKernel::reserve (*midiBuffers.add (new MidiBuffer()));
 
         ScopedLock sl (seqLock);
+        controlBuffers.setSize (numControlBuffersNeeded, numCVBuffersNeeded, jmax (4096, getBlockSize()));
         renderingOps.swapWith (newRenderingOps);
     }
 
@@ -427,22 +579,15 @@ void GraphNode::buildRenderingSequence()
     deleteRenderOpArray (newRenderingOps);
 
     renderingSequenceChanged();
+    updateParentSequence();
 }
 
 void GraphNode::getOrderedNodes (ReferenceCountedArray<Processor>& orderedNodes)
 {
-    const LookupTable table (connections);
-    for (int i = 0; i < nodes.size(); ++i)
-    {
-        Processor* const node = nodes.getUnchecked (i);
-
-        int j = 0;
-        for (; j < orderedNodes.size(); ++j)
-            if (table.isAnInputTo (node->nodeId, ((Processor*) orderedNodes.getUnchecked (j))->nodeId))
-                break;
-
-        orderedNodes.insert (j, node);
-    }
+    Array<Processor*> order;
+    getRenderOrder (order);
+    for (auto* node : order)
+        orderedNodes.add (node);
 }
 
 void GraphNode::handleAsyncUpdate()
@@ -452,10 +597,20 @@ void GraphNode::handleAsyncUpdate()
 
 void GraphNode::prepareToRender (double sampleRate, int estimatedSamplesPerBlock)
 {
+    auto* const parentGraph = getParentGraph();
+    doublePrecision = parentGraph != nullptr ? parentGraph->isUsingDoublePrecision() : wantsDoublePrecision;
+
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (jmax (1, getNumAudioOutputs()), estimatedSamplesPerBlock);
+    currentAudioInputBuffer64 = nullptr;
+    currentAudioOutputBuffer64.setSize (doublePrecision ? jmax (1, getNumAudioOutputs()) : 1,
+                                        doublePrecision ? estimatedSamplesPerBlock : 1);
+    edgeBuffer64.setSize (doublePrecision ? jmax (2, getNumAudioInputs(), getNumAudioOutputs()) : 1,
+                          doublePrecision ? estimatedSamplesPerBlock : 1);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
+    MidiKernel::reserve (currentMidiOutputBuffer);
+    MidiKernel::reserve (filteredMidi);
     clearRenderingSequence();
 
     if (getSampleRate() != sampleRate || getBlockSize() != estimatedSamplesPerBlock)
@@ -474,16 +629,23 @@ void GraphNode::releaseResources()
 
     renderingBuffers.setSize (1, 1);
     midiBuffers.clear();
+    controlBuffers.setSize (1, 1, 1);
 
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (1, 1);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
+
+    renderingBuffers64.setSize (1, 1);
+    currentAudioInputBuffer64 = nullptr;
+    currentAudioOutputBuffer64.setSize (1, 1);
+    edgeBuffer64.setSize (1, 1);
 }
 
 void GraphNode::reset()
 {
-    const ScopedLock sl (getPropertyLock());
+    // keeps plugins from resetting mid render
+    const ScopedLock sl (seqLock);
     for (auto node : nodes)
         if (auto* const proc = node->getAudioProcessor())
             proc->reset();
@@ -492,19 +654,55 @@ void GraphNode::reset()
 // MARK: Process Graph
 
 void GraphNode::render (AudioSampleBuffer& buffer, MidiPipe& midi)
+{
+    if (! doublePrecision)
+    {
+        renderGraph (buffer, midi, renderingBuffers, currentAudioInputBuffer, currentAudioOutputBuffer);
+        return;
+    }
+
+    // called with floats, the graph converts at its edges only
+    const int numChans = buffer.getNumChannels();
+    const int numSamples = buffer.getNumSamples();
+    if (edgeBuffer64.getNumChannels() < numChans || edgeBuffer64.getNumSamples() < numSamples)
+        edgeBuffer64.setSize (numChans, numSamples, false, false, true);
+
+    AudioBuffer<double> audio (edgeBuffer64.getArrayOfWritePointers(), numChans, numSamples);
+    for (int ch = 0; ch < numChans; ++ch)
+        convertSamples (buffer.getReadPointer (ch), audio.getWritePointer (ch), numSamples);
+
+    renderGraph (audio, midi, renderingBuffers64, currentAudioInputBuffer64, currentAudioOutputBuffer64);
+
+    for (int ch = 0; ch < numChans; ++ch)
+        convertSamples (audio.getReadPointer (ch), buffer.getWritePointer (ch), numSamples);
+}
+
+void GraphNode::render64 (AudioBuffer<double>& buffer, MidiPipe& midi)
+{
+    jassert (doublePrecision); // parents only call this if supported
+    renderGraph (buffer, midi, renderingBuffers64, currentAudioInputBuffer64, currentAudioOutputBuffer64);
+}
+
+template <typename FloatType>
+void GraphNode::renderGraph (AudioBuffer<FloatType>& buffer, MidiPipe& midi, AudioBuffer<FloatType>& sharedBuffers,
+                             AudioBuffer<FloatType>*& audioInput, AudioBuffer<FloatType>& audioOutput)
 {
     const int32 numSamples = buffer.getNumSamples();
     auto& midiMessages = *midi.getWriteBuffer (0);
-    currentAudioInputBuffer = &buffer;
-    currentAudioOutputBuffer.setSize (jmax (1, buffer.getNumChannels()), numSamples);
-    currentAudioOutputBuffer.clear();
+    audioInput = &buffer;
+    audioOutput.setSize (jmax (1, buffer.getNumChannels()), numSamples);
+    audioOutput.clear();
 
-    if (midiChannels.isOmni() && velocityCurve.getMode() == VelocityCurve::Linear)
+    const auto filter = getInputFilter();
+    if (filter.isPassThrough())
     {
         currentMidiInputBuffer = &midiMessages;
     }
     else
     {
+        if (velocityCurve.getMode() != filter.velocityCurve)
+            velocityCurve.setMode ((VelocityCurve::Mode) filter.velocityCurve);
+
         filteredMidi.clear();
         int chan = 0;
 
@@ -512,7 +710,7 @@ void GraphNode::render (AudioSampleBuffer& buffer, MidiPipe& midi)
         {
             auto msg = m.getMessage();
             chan = msg.getChannel();
-            if (chan > 0 && midiChannels.isOff (chan))
+            if (chan > 0 && filter.isChannelOff (chan))
                 continue;
 
             if (msg.isNoteOn())
@@ -520,7 +718,7 @@ void GraphNode::render (AudioSampleBuffer& buffer, MidiPipe& midi)
                 msg.setVelocity (velocityCurve.process (msg.getFloatVelocity()));
             }
 
-            filteredMidi.addEvent (msg, m.samplePosition);
+            MidiKernel::append (filteredMidi, msg.getRawData(), msg.getRawDataSize(), m.samplePosition);
         }
 
         currentMidiInputBuffer = &filteredMidi;
@@ -533,15 +731,14 @@ void GraphNode::render (AudioSampleBuffer& buffer, MidiPipe& midi)
         for (int i = 0; i < renderingOps.size(); ++i)
         {
             GraphOp* const op = static_cast<GraphOp*> (renderingOps.getUnchecked (i));
-            op->perform (renderingBuffers, midiBuffers, numSamples);
+            op->perform (sharedBuffers, midiBuffers, numSamples);
         }
     }
 
     for (int i = 0; i < buffer.getNumChannels(); ++i)
-        buffer.copyFrom (i, 0, currentAudioOutputBuffer, i, 0, numSamples);
+        buffer.copyFrom (i, 0, audioOutput, i, 0, numSamples);
 
-    midiMessages.clear();
-    midiMessages.addEvents (currentMidiOutputBuffer, 0, numSamples, 0);
+    MidiKernel::copy (currentMidiOutputBuffer, midiMessages);
 }
 
 void GraphNode::getPluginDescription (PluginDescription& d) const
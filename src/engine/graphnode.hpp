@@ -5,10 +5,14 @@
 
 #include "ElementApp.h"
 #include <element/processor.hpp>
+#include "engine/graphbuilder.hpp"
 #include "engine/velocitycurve.hpp"
 #include <element/arc.hpp>
 #include <element/signals.hpp>
 
+#include <functional>
+#include <unordered_map>
+
 namespace element {
 
 class GraphNode : public Processor,
@@ -96,6 +100,12 @@ public:
     */
     const Connection* getConnectionBetween (uint32 sourceNode, uint32 sourcePort, uint32 destNode, uint32 destPort) const;
 
+    /** Returns the connections feeding the given node. */
+    const Array<const Connection*>& getInputConnections (uint32 nodeId) const noexcept;
+
+    /** Returns the connections leaving the given node. */
+    const Array<const Connection*>& getOutputConnections (uint32 nodeId) const noexcept;
+
     /** Returns true if there is a connection between any of the channels of
         two specified nodes.
     */
@@ -154,6 +164,32 @@ public:
     /** Set the MIDI curve of this graph */
     void setVelocityCurveMode (const VelocityCurve::Mode) noexcept;
 
+    /** How this graph filters its MIDI input, published for the render thread. */
+    struct InputFilter
+    {
+        uint32 midiChannels = 1; ///< bit 0 is omni, bits 1 to 16 the channels
+        int velocityCurve = VelocityCurve::Linear;
+
+        /** Returns true if the channel is neither on nor covered by omni. */
+        bool isChannelOff (int channel) const noexcept { return (midiChannels & (1u | (1u << channel))) == 0; }
+
+        /** Returns true if input MIDI passes through unchanged. */
+        bool isPassThrough() const noexcept { return (midiChannels & 1u) != 0 && velocityCurve == VelocityCurve::Linear; }
+    };
+
+    /** Returns the input filter without locking. */
+    InputFilter getInputFilter() const noexcept { return inputFilter.load(); }
+
+    /** Render with 64-bit buffers between nodes. Nodes and plugins that
+        support double precision render at 64 bits, others are converted
+        to and from float around their render. Subgraphs follow the graph
+        they're in. Takes effect the next time the graph is prepared.
+     */
+    void setDoublePrecision (bool useDoublePrecision) noexcept { wantsDoublePrecision = useDoublePrecision; }
+
+    /** Returns true if the graph was prepared to render in double precision. */
+    bool isUsingDoublePrecision() const noexcept { return doublePrecision; }
+
     //==========================================================================
     void prepareToRender (double sampleRate, int estimatedBlockSize) override;
     void releaseResources() override;
@@ -162,6 +198,10 @@ public:
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
     void renderBypassed (AudioSampleBuffer&, MidiPipe&) override {}
 
+    bool supportsDoublePrecision() const override { return doublePrecision; }
+    void render64 (AudioBuffer<double>& audio, MidiPipe& midi) override;
+    void renderBypassed64 (AudioBuffer<double>&, MidiPipe&) override {}
+
     int getNumPrograms() const override { return 1; }
     int getCurrentProgram() const override { return 0; }
     const String getProgramName (int index) const override { return "program"; }
@@ -177,6 +217,35 @@ public:
 
     void setNumPorts (PortType type, int count, bool inputs, bool async = true);
 
+    /** Returns the buffer and op counts of the current rendering sequence. */
+    GraphBuilder::Stats getBuildStats() const noexcept { return buildStats; }
+
+    /** Groups structural edits on the message thread into one rebuild per graph.
+
+        Removing a node normally rebuilds its graph right away. While a batch
+        is alive removals only mark the graph, and removed nodes keep
+        rendering until the outermost batch ends and every marked graph
+        rebuilds once. Batches nest.
+     */
+    class ScopedBatch final
+    {
+    public:
+        ScopedBatch();
+        ~ScopedBatch();
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE (ScopedBatch)
+    };
+
+    /** Returns true while a ScopedBatch is alive. */
+    static bool isBatching() noexcept;
+
+    /** Calls a function now, or after the current batch has rebuilt its
+        graphs. Use it for work that needs a removed node out of the
+        rendering sequence, like releasing it.
+     */
+    static void callAfterBatch (std::function<void()> fn);
+
 protected:
     //==========================================================================
     virtual void preRenderNodes() {}
@@ -186,6 +255,7 @@ protected:
     void initialize() override {}
 
 private:
+    friend class GraphBuilder;
     friend class GraphPort;
     friend class IONode;
     friend class GraphManager;
@@ -193,23 +263,42 @@ private:
     friend class NodeObjectSync;
     friend class Node;
 
-    typedef ArcTable<Connection> LookupTable;
     ReferenceCountedArray<Processor> nodes;
     OwnedArray<Connection> connections;
+
+    struct NodeArcs
+    {
+        Array<const Connection*> inputs, outputs;
+    };
+    std::unordered_map<uint32, Processor*> nodeMap;
+    std::unordered_map<uint32, NodeArcs> arcs;
+    void addArcs (const Connection*);
+    void removeArcs (const Connection*);
+    void getRenderOrder (Array<Processor*>& ordered) const;
     uint32 ioNodes[10];
 
     uint32 lastNodeId;
     AudioSampleBuffer renderingBuffers;
     OwnedArray<MidiBuffer> midiBuffers;
+    ControlBuffers controlBuffers;
+    GraphBuilder::Stats buildStats;
     Array<void*> renderingOps;
 
     AudioSampleBuffer* currentAudioInputBuffer;
     AudioSampleBuffer currentAudioOutputBuffer;
+
+    bool wantsDoublePrecision = false, doublePrecision = false;
+    AudioBuffer<double> renderingBuffers64;
+    AudioBuffer<double>* currentAudioInputBuffer64 = nullptr;
+    AudioBuffer<double> currentAudioOutputBuffer64;
+    AudioBuffer<double> edgeBuffer64; // float callers of a 64-bit graph
+
     MidiBuffer* currentMidiInputBuffer;
     MidiBuffer currentMidiOutputBuffer;
 
     MidiChannels midiChannels;
-    VelocityCurve velocityCurve;
+    SeqLockValue<InputFilter> inputFilter;
+    VelocityCurve velocityCurve; ///< render thread only, follows inputFilter
     MidiBuffer filteredMidi;
 
     std::atomic<AudioPlayHead*> playhead { nullptr };
@@ -221,6 +310,12 @@ private:
     void handleAsyncUpdate() override;
     void clearRenderingSequence();
     void buildRenderingSequence();
+    void updateParentSequence();
+    void publishInputFilter (int velocityCurveMode);
+
+    template <typename FloatType>
+    void renderGraph (AudioBuffer<FloatType>& buffer, MidiPipe& midi, AudioBuffer<FloatType>& sharedBuffers,
+                      AudioBuffer<FloatType>*& audioInput, AudioBuffer<FloatType>& audioOutput);
     bool isAnInputTo (uint32 possibleInputId, uint32 possibleDestinationId, int recursionCheck) const;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphNode)
@@ -3,6 +3,7 @@
 
 #include "engine/ionode.hpp"
 #include "engine/graphnode.hpp"
+#include "engine/midikernel.hpp"
 #include "engine/nodes/NodeTypes.h"
 
 namespace element {
@@ -96,41 +97,51 @@ void IONode::releaseResources() {}
 void IONode::render (AudioSampleBuffer& buffer, MidiPipe& midiPipe)
 {
     jassert (graph != nullptr);
+    renderIO (buffer, midiPipe, graph->currentAudioInputBuffer, graph->currentAudioOutputBuffer);
+}
+
+void IONode::render64 (AudioBuffer<double>& buffer, MidiPipe& midiPipe)
+{
+    jassert (graph != nullptr);
+    renderIO (buffer, midiPipe, graph->currentAudioInputBuffer64, graph->currentAudioOutputBuffer64);
+}
+
+template <typename FloatType>
+void IONode::renderIO (AudioBuffer<FloatType>& buffer, MidiPipe& midiPipe, AudioBuffer<FloatType>* graphInput, AudioBuffer<FloatType>& graphOutput)
+{
     // jassert (midiPipe.getNumBuffers() > 0);
     auto& midiMessages = *midiPipe.getWriteBuffer (0);
     switch (type)
     {
         case audioOutputNode: {
-            for (int i = jmin (graph->currentAudioOutputBuffer.getNumChannels(),
+            for (int i = jmin (graphOutput.getNumChannels(),
                                buffer.getNumChannels());
                  --i >= 0;)
             {
-                graph->currentAudioOutputBuffer.addFrom (i, 0, buffer, i, 0, buffer.getNumSamples());
+                graphOutput.addFrom (i, 0, buffer, i, 0, buffer.getNumSamples());
             }
 
             break;
         }
 
         case audioInputNode: {
-            for (int i = jmin (graph->currentAudioInputBuffer->getNumChannels(),
+            for (int i = jmin (graphInput->getNumChannels(),
                                buffer.getNumChannels());
                  --i >= 0;)
             {
-                buffer.copyFrom (i, 0, *graph->currentAudioInputBuffer, i, 0, buffer.getNumSamples());
+                buffer.copyFrom (i, 0, *graphInput, i, 0, buffer.getNumSamples());
             }
 
             break;
         }
 
         case midiOutputNode:
-            graph->currentMidiOutputBuffer.clear();
-            graph->currentMidiOutputBuffer.addEvents (midiMessages, 0, buffer.getNumSamples(), 0);
-            midiMessages.clear();
+            // input may be shared with other nodes, so it's left as is
+            MidiKernel::copy (midiMessages, graph->currentMidiOutputBuffer);
             break;
 
         case midiInputNode:
-            midiMessages.clear();
-            midiMessages.addEvents (*graph->currentMidiInputBuffer, 0, buffer.getNumSamples(), 0);
+            MidiKernel::copy (*graph->currentMidiInputBuffer, midiMessages);
             graph->currentMidiInputBuffer->clear();
             break;
 
@@ -71,9 +71,12 @@ public:
     //==========================================================================
     void refreshPorts() override;
     bool wantsMidiPipe() const override { return true; }
+    bool wantsReadOnlyMidi() const override { return type == midiOutputNode; }
     void prepareToRender (double, int) override;
     void releaseResources() override;
     void render (AudioSampleBuffer&, MidiPipe&) override;
+    bool supportsDoublePrecision() const override { return true; }
+    void render64 (AudioBuffer<double>&, MidiPipe&) override;
     void getState (MemoryBlock&) override {}
     void setState (const void*, int sizeInBytes) override {}
 
@@ -85,6 +88,8 @@ private:
     const IODeviceType type;
     GraphNode* graph;
     void updateName();
+    template <typename FloatType>
+    void renderIO (AudioBuffer<FloatType>&, MidiPipe&, AudioBuffer<FloatType>* graphInput, AudioBuffer<FloatType>& graphOutput);
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (IONode)
 };
 
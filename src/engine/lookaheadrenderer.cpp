@@ -0,0 +1,199 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/denormals.hpp"
+#include "engine/lookaheadrenderer.hpp"
+#include "threadpools.hpp"
+
+namespace element {
+
+using namespace juce;
+
+LookaheadRenderer::LookaheadRenderer()
+    : Thread ("element: lookahead render") {}
+
+LookaheadRenderer::~LookaheadRenderer()
+{
+    stop();
+}
+
+void LookaheadRenderer::start (int newNumChannels, int newBlockSize, int newDepth, RenderFunction newRender)
+{
+    stop();
+
+    OwnedArray<Slot> newSlots;
+    // one slot being filled, depth slots queued, one slot being read
+    for (int i = 0; i < newDepth + 2; ++i)
+    {
+        auto* slot = newSlots.add (new Slot());
+        slot->audio.setSize (jmax (1, newNumChannels), newBlockSize);
+        slot->audio.clear();
+        slot->midi.ensureSize (2048);
+    }
+
+    MidiBuffer newCarried, newDeferred;
+    newCarried.ensureSize (2048 * (size_t) (newDepth + 4));
+    newDeferred.ensureSize (2048);
+
+    {
+        const SpinLock::ScopedLockType sl (processLock);
+        slots.swapWith (newSlots);
+        carried.swapWith (newCarried);
+        deferred.swapWith (newDeferred);
+        render = std::move (newRender);
+        numChannels = jmax (1, newNumChannels);
+        blockSize = newBlockSize;
+        depth = newDepth;
+        readIndex = 0;
+        written.store (0);
+        claimed.store (0);
+        rendered.store (0);
+        underruns.store (0);
+        overruns.store (0);
+    }
+
+    if (render == nullptr || blockSize <= 0 || depth <= 0)
+        return;
+
+    startThread (Thread::Priority::highest);
+    active.store (true, std::memory_order_release);
+}
+
+void LookaheadRenderer::stop()
+{
+    {
+        const SpinLock::ScopedLockType sl (processLock);
+        active.store (false, std::memory_order_release);
+    }
+
+    signalThreadShouldExit();
+    workReady.signal();
+    stopThread (-1);
+}
+
+bool LookaheadRenderer::process (AudioBuffer<float>& buffer, MidiBuffer& midi) noexcept
+{
+    const SpinLock::ScopedTryLockType sl (processLock);
+    if (! sl.isLocked() || ! isActive())
+        return false;
+
+    if (buffer.getNumSamples() != blockSize)
+    {
+        // anything still queued would play after this block
+        flush (midi);
+        return false;
+    }
+
+    const int numSamples = buffer.getNumSamples();
+    const int numChans = jmin (buffer.getNumChannels(), numChannels);
+    const auto numSlots = (int64) slots.size();
+    const auto nextWrite = written.load (std::memory_order_relaxed);
+
+    // the oldest slot can still be rendering after a flush
+    const auto oldest = jmin (readIndex, rendered.load (std::memory_order_acquire));
+    if (nextWrite - oldest >= numSlots)
+    {
+        overruns.fetch_add (1, std::memory_order_relaxed);
+        flush (midi);
+        return false;
+    }
+
+    // queue the input
+    auto* slot = slots.getUnchecked ((int) (nextWrite % numSlots));
+    for (int c = 0; c < numChans; ++c)
+        slot->audio.copyFrom (c, 0, buffer, c, 0, numSamples);
+    for (int c = numChans; c < slot->audio.getNumChannels(); ++c)
+        slot->audio.clear (c, 0, numSamples);
+    slot->midi.clear();
+    for (const auto meta : deferred)
+        slot->midi.addEvent (meta.data, meta.numBytes, 0);
+    deferred.clear();
+    slot->midi.addEvents (midi, 0, numSamples, 0);
+    written.store (nextWrite + 1, std::memory_order_release);
+    workReady.signal();
+
+    // hand back the oldest finished block
+    const bool primed = nextWrite + 1 - readIndex > (int64) depth;
+    if (primed && rendered.load (std::memory_order_acquire) > readIndex)
+    {
+        auto* ready = slots.getUnchecked ((int) (readIndex % numSlots));
+        for (int c = 0; c < numChans; ++c)
+            buffer.copyFrom (c, 0, ready->audio, c, 0, numSamples);
+        for (int c = numChans; c < buffer.getNumChannels(); ++c)
+            buffer.clear (c, 0, numSamples);
+        midi.swapWith (ready->midi);
+        ++readIndex;
+        return true;
+    }
+
+    if (primed)
+        underruns.fetch_add (1, std::memory_order_relaxed);
+    buffer.clear();
+    midi.clear();
+    return true;
+}
+
+/** Drops every queued block so the next one is output in order. Slots the
+    worker hasn't claimed are taken back here and their input MIDI goes
+    ahead of midi, a slot it's already rendering finishes and is ignored.
+ */
+void LookaheadRenderer::flush (MidiBuffer& midi) noexcept
+{
+    const auto end = written.load (std::memory_order_relaxed);
+    const auto begin = jmax (readIndex, claimed.exchange (end, std::memory_order_acq_rel));
+    if (begin < end || ! deferred.isEmpty())
+    {
+        const auto numSlots = (int64) slots.size();
+        carried.clear();
+        for (const auto meta : deferred)
+            carried.addEvent (meta.data, meta.numBytes, 0);
+        deferred.clear();
+        for (auto i = begin; i < end; ++i)
+            for (const auto meta : slots.getUnchecked ((int) (i % numSlots))->midi)
+                carried.addEvent (meta.data, meta.numBytes, 0);
+        carried.addEvents (midi, 0, -1, 0);
+        midi.swapWith (carried);
+    }
+
+    readIndex = end;
+    workReady.signal();
+}
+
+void LookaheadRenderer::defer (AudioBuffer<float>& buffer, MidiBuffer& midi) noexcept
+{
+    buffer.clear();
+    const SpinLock::ScopedTryLockType sl (processLock);
+    if (sl.isLocked() && isActive())
+        for (const auto meta : midi)
+            deferred.addEvent (meta.data, meta.numBytes, 0);
+    midi.clear();
+}
+
+void LookaheadRenderer::run()
+{
+    ThreadPools::getInstance().applyToCurrentThread (ThreadPools::realtime);
+    flushDenormalsOnThisThread();
+    while (! threadShouldExit())
+    {
+        auto next = claimed.load (std::memory_order_acquire);
+        // nothing is rendering, slots a flush took back count as done
+        if (rendered.load (std::memory_order_relaxed) < next)
+            rendered.store (next, std::memory_order_release);
+
+        if (next >= written.load (std::memory_order_acquire))
+        {
+            workReady.wait (100);
+            continue;
+        }
+
+        // a flush on the audio thread can take the slot back first
+        if (! claimed.compare_exchange_strong (next, next + 1, std::memory_order_acq_rel))
+            continue;
+
+        auto* slot = slots.getUnchecked ((int) (next % (int64) slots.size()));
+        render (slot->audio, slot->midi);
+        rendered.store (next + 1, std::memory_order_release);
+    }
+}
+
+} // namespace element
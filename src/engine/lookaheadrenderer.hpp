@@ -0,0 +1,108 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/audio_basics.hpp>
+
+#include <atomic>
+#include <functional>
+
+namespace element {
+
+/** Renders audio blocks ahead of the device on a high priority thread.
+
+    The audio callback hands each incoming block (audio input and MIDI) to
+    the renderer and gets back a block which was rendered `depth` callbacks
+    earlier, so the callback itself only copies buffers. Output is delayed
+    by depth blocks. Until the queue fills, and whenever the worker falls
+    behind, the callback gets silence.
+
+    If the worker falls so far behind that the queue is full, or a block
+    arrives with a different size, the queue is flushed and the caller
+    renders that block directly. Queued audio which would be output late is
+    discarded, but MIDI from blocks the worker hasn't started on is handed
+    to the caller so notes and controllers aren't lost. Priming then starts
+    over.
+ */
+class LookaheadRenderer final : private juce::Thread
+{
+public:
+    /** Renders one block in place. Called on the worker thread. */
+    using RenderFunction = std::function<void (juce::AudioBuffer<float>&, juce::MidiBuffer&)>;
+
+    LookaheadRenderer();
+    ~LookaheadRenderer();
+
+    /** Allocate slots and start the worker. Not realtime safe. */
+    void start (int numChannels, int blockSize, int depth, RenderFunction render);
+
+    /** Stop the worker. Blocks until the current render finishes. */
+    void stop();
+
+    /** Returns true if the worker is running. */
+    bool isActive() const noexcept { return active.load (std::memory_order_acquire); }
+
+    /** Returns the number of blocks output is delayed by. */
+    int getDepth() const noexcept { return depth; }
+
+    /** Returns the block size the renderer was started with. */
+    int getBlockSize() const noexcept { return blockSize; }
+
+    /** Returns the number of channels the renderer was started with. */
+    int getNumChannels() const noexcept { return numChannels; }
+
+    /** Returns the output delay in samples. */
+    int getLatencySamples() const noexcept { return isActive() ? depth * blockSize : 0; }
+
+    /** Returns the number of blocks output as silence because the worker
+        wasn't ready.
+     */
+    int getNumUnderruns() const noexcept { return underruns.load (std::memory_order_relaxed); }
+
+    /** Returns the number of blocks rendered directly because the queue was
+        full.
+     */
+    int getNumOverruns() const noexcept { return overruns.load (std::memory_order_relaxed); }
+
+    /** Queues buffer and midi for rendering and replaces them with the
+        oldest finished block. Returns false if not active, the block size
+        doesn't match or the queue is full, in which case the caller should
+        render directly. The audio is untouched then, but pending MIDI from
+        flushed blocks may have been merged in ahead of the block's own.
+     */
+    bool process (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) noexcept;
+
+    /** Takes a block process() returned false for, when the caller can't
+        render it directly either. The audio is replaced with silence, as
+        while priming, and the MIDI goes ahead of the next queued block's.
+     */
+    void defer (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) noexcept;
+
+private:
+    struct Slot
+    {
+        juce::AudioBuffer<float> audio;
+        juce::MidiBuffer midi;
+    };
+
+    juce::OwnedArray<Slot> slots;
+    RenderFunction render;
+    juce::WaitableEvent workReady;
+    juce::SpinLock processLock;
+    std::atomic<bool> active { false };
+    std::atomic<juce::int64> written { 0 }, claimed { 0 }, rendered { 0 };
+    juce::int64 readIndex = 0;
+    juce::MidiBuffer carried, deferred;
+    std::atomic<int> underruns { 0 }, overruns { 0 };
+    int numChannels = 0;
+    int blockSize = 0;
+    int depth = 0;
+
+    void flush (juce::MidiBuffer& midi) noexcept;
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LookaheadRenderer)
+};
+
+} // namespace element
@@ -10,41 +10,75 @@ void MidiClock::process (const MidiMessage& msg)
     jassert (sampleRate > 0.0 && blockSize > 0);
     jassert (msg.isMidiClock() || msg.isSongPositionPointer());
 
-    if (midiClockTicks <= 0)
+    if (msg.isSongPositionPointer())
     {
-        dll.reset (msg.getTimeStamp(), (double) blockSize / sampleRate, 1.0);
-        dll.setParams ((double) blockSize / sampleRate, 1.0);
+        const int midiBeats = msg.getSongPositionPointerMidiBeat();
+        for (auto* listener : listeners)
+            listener->midiClockSongPositionChanged (midiBeats);
+        return;
+    }
+
+    processTick (msg.getTimeStamp());
+}
+
+void MidiClock::processTick (const double time)
+{
+    if (midiClockTicks > 0 && time - lastTickTime > dropoutSeconds)
+    {
+        if (locked)
+            for (auto* listener : listeners)
+                listener->midiClockSignalDropped();
+        locked = false;
+        midiClockTicks = 0;
+    }
+
+    if (midiClockTicks == 1)
+    {
+        // seed the loop with the first measured interval
+        const double period = jmax (1.0e-4, time - lastTickTime);
+        dll.reset (time, period, 1.0);
+        dll.setParams (bandwidth, 1.0 / period);
     }
-    else
+    else if (midiClockTicks > 1)
     {
-        dll.update (msg.getTimeStamp());
+        dll.update (time);
     }
 
-    if (midiClockTicks == syncPeriodTicks)
+    lastTickTime = time;
+    ++midiClockTicks;
+
+    if (midiClockTicks <= 1)
+        return;
+
+    const double period = dll.period();
+    if (period <= 0.0)
+        return;
+    tempo = 60.0 / (period * 24.0);
+
+    if (! locked && midiClockTicks >= syncPeriodTicks)
+    {
+        locked = true;
+        lastReportedTempo = 0.0;
         for (auto* listener : listeners)
             listener->midiClockSignalAcquired();
+    }
 
-    if (midiClockTicks >= syncPeriodTicks && msg.getTimeStamp() - timeOfLastUpdate >= 1.0)
+    if (locked && std::abs (tempo - lastReportedTempo) >= tempoResolution && tempo >= 20.0 && tempo <= 999.0)
     {
-        lastKnownTimeDiff = dll.timeDiff();
-        const double bpm = 60.0 / (lastKnownTimeDiff * 24.0);
-        timeOfLastUpdate = msg.getTimeStamp();
-
-        if (bpm >= 20.0 && bpm <= 999.0)
-            for (auto* listener : listeners)
-                listener->midiClockTempoChanged (bpm);
+        lastReportedTempo = tempo;
+        for (auto* listener : listeners)
+            listener->midiClockTempoChanged ((float) tempo);
     }
-
-    ++midiClockTicks;
 }
 
 void MidiClock::reset (const double sr, const int bs)
 {
     sampleRate = sr;
     blockSize = bs;
-    timeOfLastUpdate = 0.0;
-    lastKnownTimeDiff = 0.0;
+    lastTickTime = 0.0;
+    tempo = lastReportedTempo = 0.0;
     midiClockTicks = 0;
+    locked = false;
 }
 
 void MidiClock::addListener (Listener* listener)
@@ -20,14 +20,30 @@ public:
         virtual void midiClockSignalAcquired() = 0;
         virtual void midiClockSignalDropped() = 0;
         virtual void midiClockTempoChanged (const float bpm) = 0;
+
+        /** Called when a Song Position Pointer arrives. The position is in
+            MIDI beats (16th notes) from the start of the song.
+         */
+        virtual void midiClockSongPositionChanged (const int midiBeats) { juce::ignoreUnused (midiBeats); }
     };
 
     MidiClock() = default;
     ~MidiClock() {}
 
+    /** Process a clock or song position message. Timestamps must be in
+        seconds, as MidiInput provides them.
+     */
     void process (const MidiMessage& msg);
     void reset (const double sampleRate, const int blockSize);
 
+    /** Returns the filtered tempo, or 0 if not locked to a clock. */
+    double getTempo() const noexcept { return locked ? tempo : 0.0; }
+
+    /** Set the loop bandwidth in Hz. Lower values reject more jitter but
+        follow tempo changes slower.
+     */
+    void setBandwidth (double hz) noexcept { bandwidth = jmax (0.01, hz); }
+
     void addListener (Listener*);
     void removeListener (Listener*);
 
@@ -35,15 +51,31 @@ private:
     double sampleRate = 0.0;
     int blockSize = 0;
     DelayLockedLoop dll;
-    double timeOfLastUpdate = 0.0;
-    double lastKnownTimeDiff = 0.0;
+    double bandwidth = 1.0;
+    double lastTickTime = 0.0;
+    double tempo = 0.0;
+    double lastReportedTempo = 0.0;
     int midiClockTicks = 0;
-    int syncPeriodTicks = 48;
-    double bpmUpdateSeconds = 1.0;
+    int syncPeriodTicks = 24;
+    bool locked = false;
+
+    /** Tempo changes smaller than this aren't reported. */
+    static constexpr double tempoResolution = 0.01;
+
+    /** A gap longer than this between ticks drops the signal (~5 bpm). */
+    static constexpr double dropoutSeconds = 0.5;
 
     Array<Listener*> listeners;
+
+    void processTick (double time);
 };
 
+/** Generates MIDI clock at 24 ticks per quarter note.
+
+    Tick positions are accumulated with fractional sample precision across
+    blocks, so rounding never builds up into drift and tempo changes keep
+    the phase of the next tick.
+ */
 class MidiClockMaster
 {
 public:
@@ -57,7 +89,7 @@ public:
 
     inline void reset()
     {
-        pos = 0;
+        nextClock = 0.0;
         updateCoefficients();
     }
 
@@ -65,8 +97,11 @@ public:
     {
         if (tempo == newTempo)
             return;
+        const double oldSamplesPerClock = samplesPerClock;
         tempo = newTempo;
         updateCoefficients();
+        if (oldSamplesPerClock > 0.0)
+            nextClock *= samplesPerClock / oldSamplesPerClock;
     }
 
     inline void setSampleRate (const double newSampleRate) noexcept
@@ -77,35 +112,34 @@ public:
         updateCoefficients();
     }
 
+    /** Returns the exact, fractional number of samples between ticks. */
+    inline double getSamplesPerClock() const noexcept { return samplesPerClock; }
+
     inline void render (MidiBuffer& midi, int numSamples) noexcept
     {
-        if (samplesPerClock <= 0)
+        if (samplesPerClock <= 0.0)
             return;
 
-        int frame = static_cast<int> (pos % samplesPerClock);
-        if (frame > 0)
-            frame = samplesPerClock - frame;
-        while (frame < numSamples)
+        while (nextClock < (double) numSamples)
         {
-            midi.addEvent (clockMessage, frame);
-            frame += samplesPerClock;
+            midi.addEvent (clockMessage, static_cast<int> (nextClock));
+            nextClock += samplesPerClock;
         }
 
-        pos += numSamples;
+        nextClock -= (double) numSamples;
     }
 
 private:
     MidiMessage clockMessage;
-    int64 pos = 0;
+    double nextClock = 0.0;
     double tempo = 120.0;
     double sampleRate = 44100.0;
-    int samplesPerClock = 0;
-    double clocksPerMinute = 1.0;
+    double samplesPerClock = 0.0;
 
     void updateCoefficients()
     {
-        clocksPerMinute = 24.f * tempo;
-        samplesPerClock = roundToIntAccurate ((60.0 * sampleRate) / clocksPerMinute);
+        const double clocksPerMinute = 24.0 * tempo;
+        samplesPerClock = clocksPerMinute > 0.0 ? (60.0 * sampleRate) / clocksPerMinute : 0.0;
     }
 };
 
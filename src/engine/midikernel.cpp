@@ -0,0 +1,82 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/midikernel.hpp"
+
+namespace element {
+
+void MidiKernel::reserve (MidiBuffer& midi, int numBytes)
+{
+    midi.data.ensureStorageAllocated (numBytes);
+}
+
+void MidiKernel::copy (const MidiBuffer& source, MidiBuffer& dest) noexcept
+{
+    if (&source == &dest)
+        return;
+    dest.data.clearQuick();
+    dest.data.addArray (source.data.begin(), source.data.size());
+}
+
+void MidiKernel::append (MidiBuffer& dest, const uint8* data, int numBytes, int samplePosition) noexcept
+{
+    jassert (numBytes > 0 && numBytes <= 0xffff);
+    jassert (dest.isEmpty() || dest.getLastEventTime() <= samplePosition);
+
+    const int offset = dest.data.size();
+    dest.data.resize (offset + headerSize + numBytes);
+
+    uint8* const event = dest.data.getRawDataPointer() + offset;
+    writeUnaligned<int32> (event, (int32) samplePosition);
+    writeUnaligned<uint16> (event + sizeof (int32), (uint16) numBytes);
+    std::memcpy (event + headerSize, data, (size_t) numBytes);
+}
+
+void MidiKernel::merge (const MidiBuffer* const* sources, int numSources, int* cursors, MidiBuffer& dest) noexcept
+{
+    dest.data.clearQuick();
+
+    for (int i = 0; i < numSources; ++i)
+    {
+        jassert (sources[i] != &dest);
+        cursors[i] = 0;
+    }
+
+    for (;;)
+    {
+        // the earliest head wins, ties go to the first source
+        int best = -1, bestTime = 0;
+        for (int i = 0; i < numSources; ++i)
+        {
+            if (cursors[i] >= sources[i]->data.size())
+                continue;
+
+            const int time = getTime (sources[i]->data.begin() + cursors[i]);
+            if (best < 0 || time < bestTime)
+            {
+                best = i;
+                bestTime = time;
+            }
+        }
+
+        if (best < 0)
+            break;
+
+        const uint8* const event = sources[best]->data.begin() + cursors[best];
+        const int total = headerSize + getNumBytes (event);
+        dest.data.addArray (event, total);
+        cursors[best] += total;
+    }
+}
+
+void MidiKernel::scaleTimes (MidiBuffer& midi, int multiplier, int divisor) noexcept
+{
+    jassert (multiplier > 0 && divisor > 0);
+    uint8* const data = midi.data.getRawDataPointer();
+    const int size = midi.data.size();
+
+    for (int offset = 0; offset < size; offset += headerSize + getNumBytes (data + offset))
+        writeUnaligned<int32> (data + offset, (int32) ((getTime (data + offset) * multiplier) / divisor));
+}
+
+} // namespace element
@@ -0,0 +1,90 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce.hpp>
+
+namespace element {
+
+/** Allocation free operations on the MIDI buffers of a render graph.
+
+    Graph buffers reserve their storage when the rendering sequence is
+    built. Everything here then works on the raw event data in time order,
+    so nothing allocates on the audio thread while a buffer stays within
+    its reserved size.
+ */
+struct MidiKernel
+{
+    /** Bytes reserved for each graph MIDI buffer: about 900 short events. */
+    static constexpr int reservedBytes = 8192;
+
+    /** Reserves storage for numBytes of event data. */
+    static void reserve (MidiBuffer& midi, int numBytes = reservedBytes);
+
+    /** Replaces dest with the events in source. */
+    static void copy (const MidiBuffer& source, MidiBuffer& dest) noexcept;
+
+    /** Appends an event. The position must not be before the last event's. */
+    static void append (MidiBuffer& dest, const uint8* data, int numBytes, int samplePosition) noexcept;
+
+    /** Stable k-way merge of the sources into dest, which must not be one of
+        them. Events at the same position keep the order of their sources.
+        cursors is scratch space for numSources ints.
+     */
+    static void merge (const MidiBuffer* const* sources, int numSources, int* cursors, MidiBuffer& dest) noexcept;
+
+    /** Multiplies then divides every event position, in place. */
+    static void scaleTimes (MidiBuffer& midi, int multiplier, int divisor) noexcept;
+
+    /** Runs fn over every event in place.
+
+        fn is called as fn (uint8* data, int numBytes, int samplePosition) and
+        may rewrite the bytes as long as the size stays the same. Return false
+        to drop the event. Dropping shortens the buffer, and JUCE releases
+        storage when an Array shrinks, so the remaining events are compacted
+        into scratch and the two buffers swapped.
+     */
+    template <typename Fn>
+    static void filter (MidiBuffer& midi, MidiBuffer& scratch, Fn&& fn)
+    {
+        uint8* const data = midi.data.getRawDataPointer();
+        const int size = midi.data.size();
+        bool compacting = false;
+
+        for (int offset = 0; offset < size;)
+        {
+            uint8* const event = data + offset;
+            const int numBytes = getNumBytes (event);
+            const int total = headerSize + numBytes;
+
+            if (fn (event + headerSize, numBytes, getTime (event)))
+            {
+                if (compacting)
+                    scratch.data.addArray (event, total);
+            }
+            else if (! compacting)
+            {
+                scratch.data.clearQuick();
+                scratch.data.addArray (data, offset);
+                compacting = true;
+            }
+
+            offset += total;
+        }
+
+        if (compacting)
+        {
+            midi.swapWith (scratch);
+            scratch.clear();
+        }
+    }
+
+    /** Size of the position and length that precede each event's bytes. */
+    static constexpr int headerSize = (int) (sizeof (int32) + sizeof (uint16));
+
+    static int getTime (const uint8* event) noexcept { return readUnaligned<int32> (event); }
+    static int getNumBytes (const uint8* event) noexcept { return (int) readUnaligned<uint16> (event + sizeof (int32)); }
+};
+
+} // namespace element
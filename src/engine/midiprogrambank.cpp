@@ -0,0 +1,82 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include <element/node.hpp>
+#include <element/tags.hpp>
+
+#include "engine/midiprogrambank.hpp"
+
+namespace element {
+
+using namespace juce;
+
+void MidiProgramBank::clear()
+{
+    for (auto& state : states)
+        state.reset();
+    used.clear();
+}
+
+bool MidiProgramBank::contains (int program) const noexcept
+{
+    return isPositiveAndBelow (program, (int) numPrograms) && used[program];
+}
+
+const MemoryBlock* MidiProgramBank::getState (int program) const noexcept
+{
+    return contains (program) ? &states[program] : nullptr;
+}
+
+void MidiProgramBank::setState (int program, const MemoryBlock& state)
+{
+    if (! isPositiveAndBelow (program, (int) numPrograms))
+        return;
+    if (state.getSize() <= 0)
+        return removeState (program);
+    states[program] = state;
+    used.setBit (program);
+}
+
+void MidiProgramBank::removeState (int program)
+{
+    if (! isPositiveAndBelow (program, (int) numPrograms))
+        return;
+    states[program].reset();
+    used.clearBit (program);
+}
+
+String MidiProgramBank::getProgramFileName (const String& identifier, int program)
+{
+    return identifier + "_" + String (program).paddedLeft ('0', 3) + ".eln";
+}
+
+bool MidiProgramBank::decodeProgramFile (const File& file, MemoryBlock& state)
+{
+    state.reset();
+    if (! file.existsAsFile())
+        return false;
+
+    const auto data = Node::parse (file).getProperty (tags::state).toString().trim();
+    if (data.isNotEmpty())
+        state.fromBase64Encoding (data);
+    return state.getSize() > 0;
+}
+
+int MidiProgramBank::loadGlobalPrograms (const File& directory, const String& identifier)
+{
+    clear();
+    if (identifier.isEmpty() || ! directory.isDirectory())
+        return 0;
+
+    MemoryBlock state;
+    for (int program = 0; program < numPrograms; ++program)
+    {
+        const auto file = directory.getChildFile (getProgramFileName (identifier, program));
+        if (decodeProgramFile (file, state))
+            setState (program, state);
+    }
+
+    return size();
+}
+
+} // namespace element
@@ -0,0 +1,59 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/core.hpp>
+
+namespace element {
+
+/** Decoded MIDI program states for one node.
+
+    Program files and base64 node data are parsed once when the bank is
+    loaded, so switching programs is just a memory copy.
+ */
+class MidiProgramBank final
+{
+public:
+    enum
+    {
+        numPrograms = 128
+    };
+
+    MidiProgramBank() = default;
+
+    /** Remove all states. */
+    void clear();
+
+    /** Returns the number of programs which have a state. */
+    int size() const noexcept { return (int) used.countNumberOfSetBits(); }
+
+    /** Returns true if a state exists for the program. */
+    bool contains (int program) const noexcept;
+
+    /** Returns the state for a program or nullptr if there isn't one. */
+    const juce::MemoryBlock* getState (int program) const noexcept;
+
+    /** Set the state for a program. Empty states remove the program. */
+    void setState (int program, const juce::MemoryBlock& state);
+
+    /** Remove the state for a program. */
+    void removeState (int program);
+
+    /** Load every global program file for the plugin identifier found in
+        directory. Returns the number of programs loaded.
+     */
+    int loadGlobalPrograms (const juce::File& directory, const juce::String& identifier);
+
+    /** Returns the global program file name for an identifier and program. */
+    static juce::String getProgramFileName (const juce::String& identifier, int program);
+
+    /** Parse a program file and decode its state. */
+    static bool decodeProgramFile (const juce::File& file, juce::MemoryBlock& state);
+
+private:
+    juce::MemoryBlock states[numPrograms];
+    juce::BigInteger used;
+};
+
+} // namespace element
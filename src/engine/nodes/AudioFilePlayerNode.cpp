@@ -377,7 +377,6 @@ void AudioFilePlayerNode::openFile (const File& file)
 
 void AudioFilePlayerNode::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    thread.startThread();
     formats.registerBasicFormats();
     player.prepareToPlay (maximumExpectedSamplesPerBlock, sampleRate);
 
@@ -409,7 +408,6 @@ void AudioFilePlayerNode::releaseResources()
     player.releaseResources();
     player.setSource (nullptr);
     formats.clearFormats();
-    thread.stopThread (14);
 }
 
 void AudioFilePlayerNode::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
@@ -1,6 +1,7 @@
 // Copyright 2023 Kushview, LLC <info@kushview.net>
 // SPDX-License-Identifier: GPL3-or-later
 
+#include "engine/gainkernel.hpp"
 #include "engine/nodes/AudioMixerProcessor.h"
 #include "gui/widgets/HorizontalListBox.h"
 #include <element/ui/style.hpp>
@@ -25,10 +26,15 @@ public:
         setName ("AudioMixerEditor");
         addAndMakeVisible (channels);
         setSize (330, 210);
+        owner.addMeterSubscriber();
         startTimerHz (24);
     }
 
-    ~AudioMixerEditor() noexcept {}
+    ~AudioMixerEditor() noexcept
+    {
+        stopTimer();
+        owner.removeMeterSubscriber();
+    }
 
     void paint (Graphics& g) override
     {
@@ -62,6 +68,10 @@ public:
         monitors.clearQuick();
         for (int i = 0; i < owner.getNumTracks(); ++i)
             monitors.add (owner.getMonitor (i));
+        for (int i = 0; i < owner.getNumGroups(); ++i)
+            monitors.add (owner.getGroupMonitor (i));
+        for (int i = 0; i < owner.getNumAuxBuses(); ++i)
+            monitors.add (owner.getAuxMonitor (i));
         channels.updateContent();
 
         masterMonitor = owner.getMonitor();
@@ -95,8 +105,11 @@ private:
             addAndMakeVisible (name);
             name.setFont (name.getFont().withHeight (14));
             name.setJustificationType (Justification::centred);
-            setTrackName (monitor->getTrackId() >= 0 ? "Track " + String (monitor->getTrackId() + 1)
-                                                     : "Master");
+            if (monitor->getName().isNotEmpty())
+                setTrackName (monitor->getName());
+            else
+                setTrackName (monitor->getTrackId() >= 0 ? "Track " + String (monitor->getTrackId() + 1)
+                                                         : "Master");
 
             addAndMakeVisible (mute);
             mute.setColour (TextButton::buttonOnColourId, Colors::toggleRed);
@@ -148,7 +161,10 @@ private:
         {
             if (button == &mute)
             {
-                monitor->requestMute (! mute.getToggleState());
+                if (isMaster())
+                    editor.owner.setMasterMuted (! mute.getToggleState());
+                else
+                    monitor->requestMute (! mute.getToggleState());
             }
         }
 
@@ -156,7 +172,10 @@ private:
         {
             if (s == &fader)
             {
-                monitor->requestVolume (s->getValue());
+                if (isMaster())
+                    editor.owner.setMasterVolume ((float) s->getValue());
+                else
+                    monitor->requestVolume ((float) s->getValue());
                 updateLabels();
             }
         }
@@ -175,6 +194,9 @@ private:
         Label name;
         Label volume;
 
+        // the master's fader and mute are host parameters
+        bool isMaster() const { return monitor == editor.owner.getMonitor(); }
+
         void updateLabels()
         {
             String voltxt = String (fader.getValue(), 2);
@@ -342,76 +364,119 @@ private:
     }
 };
 
+
+namespace AudioMixerTags {
+static const Identifier track ("track");
+static const Identifier group ("group");
+static const Identifier aux ("aux");
+static const Identifier send ("send");
+static const Identifier index ("index");
+static const Identifier gain ("gain");
+static const Identifier mute ("mute");
+static const Identifier preFader ("preFader");
+} // namespace AudioMixerTags
+
 AudioMixerProcessor::~AudioMixerProcessor()
 {
-    Array<Track*> oldTracks;
-    {
-        ScopedLock sl (getCallbackLock());
-        masterMute = nullptr;
-        masterVolume = nullptr;
-        tracks.swapWith (oldTracks);
-    }
+    delete pending.exchange (nullptr);
+    delete retired.exchange (nullptr);
+    active.reset();
+}
 
-    for (auto* t : oldTracks)
-        delete t;
+AudioMixerProcessor::MonitorPtr AudioMixerProcessor::getMonitor (const ReferenceCountedArray<Track>& list, int index) const
+{
+    if (auto* const track = list.getObjectPointer (index))
+        return track->monitor;
+    return nullptr;
 }
 
 AudioMixerProcessor::MonitorPtr AudioMixerProcessor::getMonitor (const int track) const
 {
     if (track < 0)
         return masterMonitor;
-    ScopedLock sl (getCallbackLock());
-    if (! isPositiveAndBelow (track, tracks.size()))
-        return nullptr;
-    return tracks.getUnchecked (track)->monitor;
+    return getMonitor (tracks, track);
+}
+
+AudioMixerProcessor::MonitorPtr AudioMixerProcessor::getGroupMonitor (const int group) const
+{
+    return getMonitor (groups, group);
 }
 
-void AudioMixerProcessor::addMonoTrack()
+AudioMixerProcessor::MonitorPtr AudioMixerProcessor::getAuxMonitor (const int aux) const
 {
-    auto* track = new Track();
-    track->index = tracks.size();
-    track->busIdx = -1;
-    track->numInputs = 1;
-    track->numOutputs = 2;
-    track->lastGain = 1.0;
-    track->gain = 1.0;
-    track->mute = false;
-    deleteAndZero (track); // mono not yet supported
+    return getMonitor (auxBuses, aux);
 }
 
 void AudioMixerProcessor::addStereoTrack()
 {
+    // the new bus becomes a track in numBusesChanged()
     if (! addBus (true))
-        return;
-
-    bool wasAdded = false;
-    auto* const input = getBus (true, getBusCount (true) - 1);
-
-    if (input != nullptr)
-        wasAdded = true;
-
-    if (wasAdded)
-    {
-        auto* const track = new Track();
-        track->index = tracks.size();
-        track->busIdx = input->getBusIndex();
-        track->numInputs = input->getNumberOfChannels();
-        track->numOutputs = input->getNumberOfChannels();
-        track->lastGain = 1.0;
-        track->gain = 1.0;
-        track->mute = false;
-        track->monitor = new Monitor (track->index, track->numOutputs);
-
-        ScopedLock sl (getCallbackLock());
-        tracks.add (track);
-        numTracks = tracks.size();
-    }
-    else
     {
         DBG ("[element] AudioMixerProcessor: could not add new track");
     }
 }
 
+void AudioMixerProcessor::numBusesChanged()
+{
+    syncBuses();
+}
+
+void AudioMixerProcessor::syncBuses()
+{
+    const int numInputs = getBusCount (true);
+    const int numAux = jlimit (0, (int) maxAuxBuses, getBusCount (false) - 1);
+
+    const auto resize = [this] (ReferenceCountedArray<Track>& list, int size, bool isInput) {
+        if (list.size() > size)
+            list.removeRange (size, list.size() - size);
+
+        for (int i = list.size(); i < size; ++i)
+        {
+            auto* const bus = getBus (isInput, isInput ? i : i + 1);
+            auto* const track = list.add (new Track());
+            track->index = i;
+            track->busIdx = bus != nullptr ? bus->getBusIndex() : -1;
+            track->firstChannel = bus != nullptr ? bus->getChannelIndexInProcessBlockBuffer (0) : -1;
+            track->numInputs = track->numOutputs = bus != nullptr ? bus->getNumberOfChannels() : 2;
+            track->monitor = new Monitor (i, track->numOutputs, isInput ? String() : "Aux " + String (i + 1));
+        }
+    };
+
+    resize (tracks, numInputs, true);
+    resize (auxBuses, numAux, false);
+    numTracks = tracks.size();
+    numAuxBuses = auxBuses.size();
+    publishLayout();
+}
+
+void AudioMixerProcessor::publishLayout()
+{
+    auto layout = std::make_unique<Layout>();
+    layout->tracks = tracks;
+    layout->groups = groups;
+    layout->auxBuses = auxBuses;
+
+    // dropped channels go with the last layout that listed them
+    delete retired.exchange (nullptr);
+
+    // the audio thread never picked up the last one, so it's still ours
+    delete pending.exchange (layout.release());
+}
+
+int AudioMixerProcessor::addGroup()
+{
+    if (groups.size() >= maxGroups)
+        return -1;
+
+    auto* const group = groups.add (new Track());
+    group->index = groups.size() - 1;
+    group->numInputs = group->numOutputs = 2;
+    group->monitor = new Monitor (group->index, 2, "Group " + String (group->index + 1));
+    numGroups = groups.size();
+    publishLayout();
+    return group->index;
+}
+
 AudioProcessorEditor* AudioMixerProcessor::createEditor()
 {
     auto* ed = new AudioMixerEditor (*this);
@@ -423,81 +488,159 @@ void AudioMixerProcessor::prepareToPlay (const double sampleRate, const int buff
 {
     setRateAndBufferSizeDetails (sampleRate, bufferSize);
     jassert (tracks.size() == getBusCount (true));
-    jassert (1 == getBusCount (false));
-    tempBuffer.setSize (getMainBusNumOutputChannels(), bufferSize, false, true, true);
+
+    // room for every subgroup and aux bus, so adding one never reallocates
+    mixBuffer.setSize (2 * (1 + maxGroups + maxAuxBuses), bufferSize, false, true, true);
 }
 
-void AudioMixerProcessor::processBlock (AudioSampleBuffer& audio, MidiBuffer& midi)
+void AudioMixerProcessor::mixTrack (Track& track, const Layout& layout, AudioSampleBuffer& input, int numSamples, bool metering)
 {
-    midi.clear();
-
-    ScopedLock sl (getCallbackLock());
-
-    if (tracks.size() <= 0)
+    const int numGroupBuses = layout.groups.size();
+    const int numAux = layout.auxBuses.size();
+    auto& monitor = *track.monitor;
+    track.gain = monitor.nextGain.get();
+    track.mute = monitor.nextMute.get() > 0;
+    const float muteGain = track.mute ? 0.f : 1.f;
+    const float endGain = track.gain * muteGain;
+
+    std::array<float, maxAuxBuses> sends;
+    std::array<bool, maxAuxBuses> pre;
+    for (int a = 0; a < numAux; ++a)
     {
-        audio.clear();
-        return;
+        sends[(size_t) a] = monitor.sends[(size_t) a].get();
+        pre[(size_t) a] = monitor.preFader[(size_t) a].get() > 0;
     }
 
-    auto output (getBusBuffer<float> (audio, false, 0));
-    const int numSamples = audio.getNumSamples();
-    tempBuffer.clear (0, numSamples);
+    float* const* const mix = mixBuffer.getArrayOfWritePointers();
+    const int group = monitor.group.get();
+    float* const* const dest = isPositiveAndBelow (group, numGroupBuses) ? mix + 2 + 2 * group : mix;
+    float* const* const aux = mix + 2 + 2 * numGroupBuses;
 
-    for (int i = 0; i < tracks.size(); ++i)
+    for (int c = 0; c < jmin (2, input.getNumChannels()); ++c)
     {
-        auto* const track = tracks.getUnchecked (i);
-        auto input (getBusBuffer<float> (audio, true, track->busIdx));
-        auto& rms = track->monitor->rms;
+        const float* const source = input.getReadPointer (c);
+        if (metering)
+            monitor.rms.getReference (c).set (GainKernel::addAndMeasure (dest[c], source, numSamples, track.lastGain, endGain).rms);
+        else
+            GainKernel::add (dest[c], source, numSamples, track.lastGain, endGain);
 
-        if (track->mute)
+        // sends read the same source while it's still in cache
+        for (int a = 0; a < numAux; ++a)
         {
-            for (int c = 0; c < track->numInputs; ++c)
-                rms.getReference (c).set (0.0);
+            const auto i = (size_t) a;
+            const float start = track.lastSends[i] * (pre[i] ? track.lastMuteGain : track.lastGain);
+            const float end = sends[i] * (pre[i] ? muteGain : endGain);
+            GainKernel::add (aux[2 * a + c], source, numSamples, start, end);
         }
+    }
+
+    track.lastGain = endGain;
+    track.lastMuteGain = muteGain;
+    for (int a = 0; a < numAux; ++a)
+        track.lastSends[(size_t) a] = sends[(size_t) a];
+
+    monitor.gain.set (track.gain);
+    monitor.muted.set (track.mute ? 1 : 0);
+}
+
+void AudioMixerProcessor::mixBus (Track& bus, float* const* source, float* const* dest, int numSamples, bool metering)
+{
+    auto& monitor = *bus.monitor;
+    bus.gain = monitor.nextGain.get();
+    bus.mute = monitor.nextMute.get() > 0;
+    const float endGain = bus.mute ? 0.f : bus.gain;
+
+    for (int c = 0; c < 2; ++c)
+    {
+        if (metering)
+            monitor.rms.getReference (c).set (GainKernel::addAndMeasure (dest[c], source[c], numSamples, bus.lastGain, endGain).rms);
         else
+            GainKernel::add (dest[c], source[c], numSamples, bus.lastGain, endGain);
+    }
+
+    bus.lastGain = endGain;
+    monitor.gain.set (bus.gain);
+    monitor.muted.set (bus.mute ? 1 : 0);
+}
+
+AudioSampleBuffer AudioMixerProcessor::getChannels (AudioSampleBuffer& audio, int firstChannel, int numChannels) noexcept
+{
+    // bus layouts change on the message thread, the audio thread only uses the cached offsets
+    const int available = isPositiveAndBelow (firstChannel, audio.getNumChannels())
+                              ? jmin (numChannels, audio.getNumChannels() - firstChannel)
+                              : 0;
+    return { audio.getArrayOfWritePointers() + jmax (0, firstChannel), available, audio.getNumSamples() };
+}
+
+void AudioMixerProcessor::processBlock (AudioSampleBuffer& audio, MidiBuffer& midi)
+{
+    midi.clear();
+    const int numSamples = audio.getNumSamples();
+
+    // a new layout is only taken once the previous one was collected
+    if (pending.load (std::memory_order_relaxed) != nullptr && retired.load (std::memory_order_acquire) == nullptr)
+    {
+        if (auto* const next = pending.exchange (nullptr, std::memory_order_acq_rel))
         {
-            for (int c = 0; c < track->numInputs; ++c)
-            {
-                rms.getReference (c).set (track->gain * input.getRMSLevel (c, 0, numSamples));
-                tempBuffer.addFromWithRamp (c, 0, input.getReadPointer (c), numSamples, track->lastGain, track->gain);
-            }
+            retired.store (active.release(), std::memory_order_release);
+            active.reset (next);
         }
+    }
 
-        track->lastGain = track->gain;
+    if (active == nullptr || active->tracks.isEmpty() || numSamples > mixBuffer.getNumSamples())
+    {
+        jassert (numSamples <= mixBuffer.getNumSamples());
+        audio.clear();
+        return;
+    }
 
-        if (track->gain != track->monitor->nextGain.get())
-            track->gain = track->monitor->nextGain.get();
-        track->monitor->gain.set (track->gain);
+    const auto& layout = *active;
+    const int numGroupBuses = layout.groups.size();
+    const bool metering = meterSubscribers.load() > 0;
+    const int numMixChannels = 2 * (1 + numGroupBuses + layout.auxBuses.size());
+    for (int c = 0; c < numMixChannels; ++c)
+        FloatVectorOperations::clear (mixBuffer.getWritePointer (c), numSamples);
 
-        if (static_cast<int> (track->mute) != track->monitor->nextMute.get())
-            track->mute = track->monitor->nextMute.get() > 0;
-        track->monitor->muted.set (track->mute ? 1 : 0);
+    // every input is consumed before any output is written, they share channels
+    for (auto* const track : layout.tracks)
+    {
+        auto input (getChannels (audio, track->firstChannel, track->numInputs));
+        mixTrack (*track, layout, input, numSamples, metering);
     }
 
-    output.clear (0, numSamples);
-    const float gain = Decibels::decibelsToGain ((float) *masterVolume, (float) EL_FADER_MIN_DB);
-    if (! *masterMute)
-        for (int c = 0; c < output.getNumChannels(); ++c)
-            output.copyFromWithRamp (c, 0, tempBuffer.getReadPointer (c), numSamples, lastGain, gain);
+    float* const* const mix = mixBuffer.getArrayOfWritePointers();
+    for (int g = 0; g < numGroupBuses; ++g)
+        mixBus (*layout.groups.getObjectPointerUnchecked (g), mix + 2 + 2 * g, mix, numSamples, metering);
 
-    if (gain != masterMonitor->nextGain.get())
-        *masterVolume = Decibels::gainToDecibels (masterMonitor->nextGain.get(), (float) EL_FADER_MIN_DB);
-    if (static_cast<int> (*masterMute) != masterMonitor->nextMute.get())
-        *masterMute = masterMonitor->nextMute.get() <= 0 ? false : true;
-
-    masterMonitor->muted.set (*masterMute);
-    masterMonitor->gain.set (gain);
+    for (int a = 0; a < layout.auxBuses.size(); ++a)
+    {
+        auto* const aux = layout.auxBuses.getObjectPointerUnchecked (a);
+        auto output (getChannels (audio, aux->firstChannel, aux->numOutputs));
+        output.clear (0, numSamples);
+        if (output.getNumChannels() >= 2)
+            mixBus (*aux, mix + 2 + 2 * (numGroupBuses + a), output.getArrayOfWritePointers(), numSamples, metering);
+    }
 
-    for (int i = 0; i < 2; ++i)
-        masterMonitor->rms.getReference (i).set (
-            output.getRMSLevel (i, 0, numSamples));
+    auto output (getChannels (audio, 0, 2));
+    const float gain = Decibels::decibelsToGain ((float) *masterVolume, (float) EL_FADER_MIN_DB);
+    const float endGain = *masterMute ? 0.f : gain;
+    output.clear (0, numSamples);
+    for (int c = 0; c < jmin (2, output.getNumChannels()); ++c)
+    {
+        if (metering)
+            masterMonitor->rms.getReference (c).set (GainKernel::addAndMeasure (output.getWritePointer (c), mix[c], numSamples, lastGain, endGain).rms);
+        else
+            GainKernel::add (output.getWritePointer (c), mix[c], numSamples, lastGain, endGain);
+    }
 
-    lastGain = gain;
+    masterMonitor->muted.set (*masterMute ? 1 : 0);
+    masterMonitor->gain.set (gain);
+    lastGain = endGain;
 }
 
 void AudioMixerProcessor::releaseResources()
 {
-    tempBuffer.setSize (1, 1, false, false, false);
+    mixBuffer.setSize (1, 1, false, false, false);
 }
 
 bool AudioMixerProcessor::canApplyBusCountChange (bool isInput, bool isAdding, AudioProcessor::BusProperties& outProperties)
@@ -514,7 +657,8 @@ bool AudioMixerProcessor::canApplyBusCountChange (bool isInput, bool isAdding, A
 
     if (isAdding)
     {
-        outProperties.busName = String (isInput ? "Input #" : "Output #") + String (getBusCount (isInput));
+        outProperties.busName = isInput ? "Input #" + String (num)
+                                        : "Aux #" + String (num);
         outProperties.defaultLayout = (num > 0 ? getBus (isInput, num - 1)->getDefaultLayout()
                                                : main->getDefaultLayout());
         outProperties.isActivatedByDefault = true;
@@ -525,66 +669,99 @@ bool AudioMixerProcessor::canApplyBusCountChange (bool isInput, bool isAdding, A
 
 void AudioMixerProcessor::setTrackGain (const int track, const float gain)
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return;
-    ScopedLock sl (getCallbackLock());
-    tracks.getUnchecked (track)->gain = gain;
+    if (auto monitor = getMonitor (tracks, track))
+        monitor->requestGain (gain);
 }
 
 void AudioMixerProcessor::setTrackMuted (const int track, const bool mute)
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return;
-    ScopedLock sl (getCallbackLock());
-    tracks.getUnchecked (track)->mute = mute;
+    if (auto monitor = getMonitor (tracks, track))
+        monitor->requestMute (mute);
 }
 
 bool AudioMixerProcessor::isTrackMuted (const int track) const
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return false;
-    ScopedLock sl (getCallbackLock());
-    return tracks.getUnchecked (track)->mute;
+    if (auto monitor = getMonitor (tracks, track))
+        return monitor->nextMute.get() > 0;
+    return false;
 }
 
 float AudioMixerProcessor::getTrackGain (const int track) const
 {
-    if (! isPositiveAndBelow (track, numTracks))
-        return 1.f;
-    ScopedLock sl (getCallbackLock());
-    return tracks.getUnchecked (track)->gain;
+    if (auto monitor = getMonitor (tracks, track))
+        return monitor->nextGain.get();
+    return 1.f;
 }
 
-void AudioMixerProcessor::getStateInformation (juce::MemoryBlock& block)
+void AudioMixerProcessor::setTrackGroup (const int track, const int group)
+{
+    if (auto monitor = getMonitor (tracks, track))
+        monitor->requestGroup (group);
+}
+
+void AudioMixerProcessor::setTrackSend (const int track, const int aux, const float gain, const bool preFader)
 {
-    OwnedArray<Track> t;
-    while (t.size() < numTracks)
-        t.add (new Track());
-    float volume = 0.0f;
-    bool mute = false;
+    if (auto monitor = getMonitor (tracks, track))
     {
-        ScopedLock sl (getCallbackLock());
-        for (int i = 0; i < numTracks; ++i)
-            t.getUnchecked (i)->update (tracks.getUnchecked (i));
-        volume = *masterVolume;
-        mute = *masterMute;
+        monitor->requestSendPreFader (aux, preFader);
+        monitor->requestSend (aux, gain);
     }
+}
+
+void AudioMixerProcessor::setMasterVolume (const float dB)
+{
+    *masterVolume = dB;
+    masterMonitor->requestGain (Decibels::decibelsToGain (dB, (float) EL_FADER_MIN_DB));
+}
+
+void AudioMixerProcessor::setMasterMuted (const bool mute)
+{
+    *masterMute = mute;
+    masterMonitor->requestMute (mute);
+}
 
+void AudioMixerProcessor::getStateInformation (juce::MemoryBlock& block)
+{
+    namespace mt = AudioMixerTags;
     ValueTree state ("audiomixer");
-    state.setProperty (tags::volume, volume, 0)
-        .setProperty ("mute", mute, 0);
-    for (int i = 0; i < numTracks; ++i)
-    {
-        ValueTree trk ("track");
-        auto* const track = t.getUnchecked (i);
-        trk.setProperty ("index", track->index, 0)
-            .setProperty ("busIdx", track->busIdx, 0)
-            .setProperty ("numInputs", track->numInputs, 0)
-            .setProperty ("numOutputs", track->numOutputs, 0)
-            .setProperty ("gain", track->gain, 0)
-            .setProperty ("mute", track->mute, 0);
-        state.addChild (trk, -1, 0);
-    }
+    state.setProperty (tags::volume, (float) *masterVolume, 0)
+        .setProperty (mt::mute, (bool) *masterMute, 0);
+
+    const auto addChannels = [&state] (const ReferenceCountedArray<Track>& list, const Identifier& type) {
+        for (const auto* const track : list)
+        {
+            auto& monitor = *track->monitor;
+            ValueTree child (type);
+            child.setProperty (mt::index, track->index, 0)
+                .setProperty (mt::gain, monitor.nextGain.get(), 0)
+                .setProperty (mt::mute, monitor.nextMute.get() > 0, 0);
+
+            if (type == mt::track)
+            {
+                child.setProperty ("busIdx", track->busIdx, 0)
+                    .setProperty ("numInputs", track->numInputs, 0)
+                    .setProperty ("numOutputs", track->numOutputs, 0)
+                    .setProperty (mt::group, monitor.getGroup(), 0);
+
+                for (int a = 0; a < maxAuxBuses; ++a)
+                {
+                    if (monitor.getSend (a) <= 0.f)
+                        continue;
+                    ValueTree send (mt::send);
+                    send.setProperty (mt::index, a, 0)
+                        .setProperty (mt::gain, monitor.getSend (a), 0)
+                        .setProperty (mt::preFader, monitor.isSendPreFader (a), 0);
+                    child.appendChild (send, 0);
+                }
+            }
+
+            state.appendChild (child, 0);
+        }
+    };
+
+    addChannels (tracks, mt::track);
+    addChannels (groups, mt::group);
+    addChannels (auxBuses, mt::aux);
 
     if (auto xml = state.createXml())
     {
@@ -594,6 +771,7 @@ void AudioMixerProcessor::getStateInformation (juce::MemoryBlock& block)
 
 void AudioMixerProcessor::setStateInformation (const void* data, int size)
 {
+    namespace mt = AudioMixerTags;
     ValueTree state;
     if (auto xml = getXmlFromBinary (data, size))
     {
@@ -603,43 +781,48 @@ void AudioMixerProcessor::setStateInformation (const void* data, int size)
     if (! state.isValid())
         return;
 
-    Array<Track*> newTracks;
-    for (int i = 0; i < state.getNumChildren(); ++i)
-    {
-        const ValueTree trk (state.getChild (i));
-        auto* const track = new Track();
-        track->index = trk.getProperty ("index", i);
-        track->busIdx = trk.getProperty ("busIdx", i);
-        track->numInputs = trk.getProperty ("numInputs", 2);
-        track->numOutputs = trk.getProperty ("numOutputs", 2);
-        track->gain = trk.getProperty ("gain", 1.f);
-        track->lastGain = track->gain;
-        track->mute = (bool) trk.getProperty ("mute", false);
-
-        track->monitor = new Monitor (track->index, track->numInputs);
-        track->monitor->gain.set (track->gain);
-        track->monitor->nextGain.set (track->gain);
-        track->monitor->muted.set (track->mute ? 1 : 0);
-        track->monitor->nextMute.set (track->mute ? 1 : 0);
-
-        newTracks.add (track);
-    }
+    // tracks and aux buses follow the bus layout, subgroups are created here
+    int numStateGroups = 0;
+    for (const auto& child : state)
+        numStateGroups += child.hasType (mt::group) ? 1 : 0;
+    while (groups.size() < jmin ((int) maxGroups, numStateGroups))
+        addGroup();
 
+    int numTracksRead = 0, numGroupsRead = 0, numAuxRead = 0;
+    for (const auto& child : state)
     {
-        ScopedLock sl (getCallbackLock());
-        *masterVolume = (float) state.getProperty (tags::volume, 0.0);
-        *masterMute = (bool) state.getProperty ("mute", false);
-        masterMonitor->nextGain.set (Decibels::decibelsToGain ((float) *masterVolume, (float) EL_FADER_MIN_DB));
-        masterMonitor->gain.set (masterMonitor->nextGain.get());
-        masterMonitor->nextMute.set (*masterMute ? 1 : 0);
-        masterMonitor->muted.set (masterMonitor->nextMute.get());
-        tracks.swapWith (newTracks);
-        numTracks = tracks.size();
+        MonitorPtr monitor;
+        if (child.hasType (mt::track))
+            monitor = getMonitor (tracks, numTracksRead++);
+        else if (child.hasType (mt::group))
+            monitor = getMonitor (groups, numGroupsRead++);
+        else if (child.hasType (mt::aux))
+            monitor = getMonitor (auxBuses, numAuxRead++);
+
+        if (monitor == nullptr)
+            continue;
+
+        monitor->requestGain ((float) child.getProperty (mt::gain, 1.f));
+        monitor->requestMute ((bool) child.getProperty (mt::mute, false));
+
+        if (child.hasType (mt::track))
+        {
+            monitor->requestGroup ((int) child.getProperty (mt::group, -1));
+            for (int a = 0; a < maxAuxBuses; ++a)
+                monitor->requestSend (a, 0.f);
+            for (const auto& send : child)
+            {
+                const int aux = send.getProperty (mt::index, -1);
+                monitor->requestSendPreFader (aux, (bool) send.getProperty (mt::preFader, false));
+                monitor->requestSend (aux, (float) send.getProperty (mt::gain, 0.f));
+            }
+        }
     }
 
-    for (auto* dt : newTracks)
-        delete dt;
-    newTracks.clear();
+    setMasterVolume ((float) state.getProperty (tags::volume, 0.0));
+    setMasterMuted ((bool) state.getProperty (mt::mute, false));
+    masterMonitor->gain.set (masterMonitor->nextGain.get());
+    masterMonitor->muted.set (masterMonitor->nextMute.get());
 }
 
 } // namespace element
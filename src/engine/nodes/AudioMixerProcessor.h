@@ -3,21 +3,42 @@
 
 #pragma once
 
+#include <array>
+
 #include "engine/nodes/BaseProcessor.h"
 
 namespace element {
 
+/** A mixer with stereo tracks, subgroups and aux buses.
+
+    Every input bus is a track. Output bus 0 is the master and every
+    further output bus is an aux bus fed by pre or post fader sends.
+    Tracks sum into the master or a subgroup, and subgroups sum into the
+    master.
+
+    The editor and other threads never lock the audio thread for
+    parameters: they request values through each channel's Monitor, which
+    the audio thread picks up at the next block. Layout changes publish an
+    immutable list of channels the same way. Levels are only measured
+    while an editor is open.
+ */
 class AudioMixerProcessor : public BaseProcessor
 {
     AudioParameterBool* masterMute;
     AudioParameterFloat* masterVolume;
 
 public:
+    enum
+    {
+        maxAuxBuses = 8,
+        maxGroups = 8
+    };
+
     class Monitor : public ReferenceCountedObject
     {
     public:
-        explicit Monitor (const int track, const int totalChannels = 2)
-            : trackId (track), numChannels (totalChannels)
+        explicit Monitor (const int track, const int totalChannels = 2, const String& channelName = {})
+            : trackId (track), numChannels (totalChannels), name (channelName)
         {
             reset();
         }
@@ -30,6 +51,7 @@ public:
         inline float getGain() const { return gain.get(); }
         inline int getNumChannels() const { return numChannels; }
         inline int getTrackId() const { return trackId; }
+        inline const String& getName() const { return name; }
         inline bool isMuted() const { return muted.get() > 0; }
 
         inline float getLevel (const int channel)
@@ -54,15 +76,47 @@ public:
             requestGain (Decibels::decibelsToGain (dB, -120.f));
         }
 
+        /** Send level to an aux bus, 0 is off. */
+        inline float getSend (const int aux) const
+        {
+            return isPositiveAndBelow (aux, (int) maxAuxBuses) ? sends[(size_t) aux].get() : 0.f;
+        }
+
+        inline void requestSend (const int aux, const float sendGain)
+        {
+            if (isPositiveAndBelow (aux, (int) maxAuxBuses))
+                sends[(size_t) aux].set (jmax (0.f, sendGain));
+        }
+
+        /** True if a send taps the signal before the fader. */
+        inline bool isSendPreFader (const int aux) const
+        {
+            return isPositiveAndBelow (aux, (int) maxAuxBuses) && preFader[(size_t) aux].get() > 0;
+        }
+
+        inline void requestSendPreFader (const int aux, const bool pre)
+        {
+            if (isPositiveAndBelow (aux, (int) maxAuxBuses))
+                preFader[(size_t) aux].set (pre ? 1 : 0);
+        }
+
+        /** The subgroup a track feeds, -1 for the master. */
+        inline int getGroup() const { return group.get(); }
+        inline void requestGroup (const int newGroup) { group.set (jmax (-1, newGroup)); }
+
     private:
         friend class AudioMixerProcessor;
         const int trackId;
         const int numChannels;
+        const String name;
         Array<Atomic<float>> rms;
         Atomic<int> muted;
         Atomic<int> nextMute;
         Atomic<float> gain;
         Atomic<float> nextGain;
+        std::array<Atomic<float>, maxAuxBuses> sends;
+        std::array<Atomic<int>, maxAuxBuses> preFader;
+        Atomic<int> group { -1 };
 
         void reset()
         {
@@ -74,33 +128,31 @@ public:
                 rms.clearQuick();
             while (rms.size() < numChannels)
                 rms.add (Atomic<float> (0.f));
+            for (size_t i = 0; i < sends.size(); ++i)
+            {
+                sends[i] = 0.f;
+                preFader[i] = 0;
+            }
         }
     };
 
     typedef ReferenceCountedObjectPtr<Monitor> MonitorPtr;
 
-    struct Track
+    /** Audio thread state of a track, subgroup or aux bus. Shared by every
+        layout that lists it, only the audio thread changes the gains. */
+    struct Track : public ReferenceCountedObject
     {
         int index = -1;
         int busIdx = -1;
+        int firstChannel = -1; ///< the bus's first channel in the process buffer
         int numInputs = 0;
         int numOutputs = 0;
         float lastGain = 1.0;
         float gain = 1.0;
         bool mute = false;
+        float lastMuteGain = 1.f;
+        std::array<float, maxAuxBuses> lastSends {};
         MonitorPtr monitor;
-
-        inline void update (const Track* const track)
-        {
-            this->index = track->index;
-            this->busIdx = track->busIdx;
-            this->numInputs = track->numInputs;
-            this->numOutputs = track->numOutputs;
-            this->gain = track->gain;
-            this->lastGain = track->gain;
-            this->mute = track->mute;
-            this->monitor = track->monitor;
-        }
     };
 
     explicit AudioMixerProcessor (int numTracks = 4,
@@ -109,7 +161,6 @@ public:
         : BaseProcessor (BusesProperties()
                              .withOutput ("Master", AudioChannelSet::stereo(), false))
     {
-        tracks.ensureStorageAllocated (16);
         while (--numTracks >= 0)
             addStereoTrack();
 
@@ -138,19 +189,39 @@ public:
         desc.version = "1.0.0";
     }
 
-    int getNumTracks() const
-    {
-        ScopedLock sl (getCallbackLock());
-        return tracks.size();
-    }
+    int getNumTracks() const { return numTracks.load(); }
+    int getNumGroups() const { return numGroups.load(); }
+    int getNumAuxBuses() const { return numAuxBuses.load(); }
 
+    /** Returns a track's monitor, or the master's for -1. */
     MonitorPtr getMonitor (const int track = -1) const;
+    MonitorPtr getGroupMonitor (const int group) const;
+    MonitorPtr getAuxMonitor (const int aux) const;
 
     void setTrackGain (const int track, const float gain);
     void setTrackMuted (const int track, const bool mute);
     bool isTrackMuted (const int track) const;
     float getTrackGain (const int track) const;
 
+    /** Route a track to a subgroup, or the master with -1. */
+    void setTrackGroup (const int track, const int group);
+
+    /** Set a track's send level to an aux bus. */
+    void setTrackSend (const int track, const int aux, const float gain, const bool preFader = false);
+
+    void setMasterVolume (const float dB);
+    void setMasterMuted (const bool mute);
+
+    /** Add a subgroup. Returns its index or -1 if at the limit. */
+    int addGroup();
+
+    /** Add an aux bus as a new output bus. */
+    bool addAuxBus() { return numAuxBuses.load() < maxAuxBuses && addBus (false); }
+
+    /** Meters are measured while at least one subscriber is registered. */
+    void addMeterSubscriber() noexcept { ++meterSubscribers; }
+    void removeMeterSubscriber() noexcept { --meterSubscribers; }
+
     inline bool acceptsMidi() const override { return false; }
     inline bool producesMidi() const override { return false; }
 
@@ -172,9 +243,10 @@ public:
         return true;
     }
 
-    bool canAddBus (bool) const override { return true; }
-    bool canRemoveBus (bool) const override { return true; }
+    bool canAddBus (bool isInput) const override { return isInput || getBusCount (false) <= maxAuxBuses; }
+    bool canRemoveBus (bool isInput) const override { return isInput || getBusCount (false) > 1; }
     bool canApplyBusCountChange (bool isInput, bool isAdding, AudioProcessor::BusProperties& outProperties) override;
+    void numBusesChanged() override;
 
     double getTailLengthSeconds() const override { return 0.0; }
 
@@ -189,12 +261,30 @@ public:
 
 private:
     MonitorPtr masterMonitor;
-    Array<Track*> tracks;
-    int numTracks = 0;
-    AudioSampleBuffer tempBuffer;
+
+    /** Immutable once published: the channels the audio thread mixes. */
+    struct Layout
+    {
+        ReferenceCountedArray<Track> tracks, groups, auxBuses;
+    };
+
+    // changed on the message thread only, then published to the audio thread
+    ReferenceCountedArray<Track> tracks, groups, auxBuses;
+    std::atomic<Layout*> pending { nullptr }, retired { nullptr };
+    std::unique_ptr<Layout> active;
+    std::atomic<int> numTracks { 0 }, numGroups { 0 }, numAuxBuses { 0 };
+    std::atomic<int> meterSubscribers { 0 };
+
+    AudioSampleBuffer mixBuffer;
     float lastGain = 0.f;
-    void addMonoTrack();
+
     void addStereoTrack();
+    void syncBuses();
+    void publishLayout();
+    MonitorPtr getMonitor (const ReferenceCountedArray<Track>&, int index) const;
+    void mixTrack (Track&, const Layout&, AudioSampleBuffer& input, int numSamples, bool metering);
+    static AudioSampleBuffer getChannels (AudioSampleBuffer&, int firstChannel, int numChannels) noexcept;
+    void mixBus (Track&, float* const* source, float* const* dest, int numSamples, bool metering);
 };
 
 } // namespace element
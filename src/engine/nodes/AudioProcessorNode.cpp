@@ -1,9 +1,11 @@
 // Copyright 2023 Kushview, LLC <info@kushview.net>
 // SPDX-License-Identifier: GPL3-or-later
 
+#include "engine/graphnode.hpp"
 #include "engine/nodes/AudioProcessorNode.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiDeviceProcessor.h"
+#include "engine/programstandby.hpp"
 #include "scopedflag.hpp"
 
 namespace element {
@@ -15,40 +17,50 @@ class AudioProcessorNodeParameter : public Parameter,
 {
 public:
     AudioProcessorNodeParameter (AudioProcessorParameter& p)
-        : param (p)
+        : param (&p)
     {
-        param.addListener (this);
+        param->addListener (this);
         addListener (this);
     }
 
     ~AudioProcessorNodeParameter()
     {
-        param.removeListener (this);
+        param->removeListener (this);
         removeListener (this);
     }
 
     int getPortIndex() const noexcept override { return portIndex; }
-    int getParameterIndex() const noexcept override { return param.getParameterIndex(); }
-    float getValue() const override { return param.getValue(); }
-    void setValue (float newValue) override { param.setValue (newValue); }
-    float getDefaultValue() const override { return param.getDefaultValue(); }
-    float getValueForText (const String& text) const override { return param.getValueForText (text); }
-    String getName (int maximumStringLength) const override { return param.getName (maximumStringLength); }
-    String getLabel() const override { return param.getLabel(); }
-    int getNumSteps() const override { return param.getNumSteps(); }
-    bool isDiscrete() const override { return param.isDiscrete(); }
-    bool isBoolean() const override { return param.isBoolean(); }
-    String getText (float value, int maxLen) const override { return param.getText (value, maxLen); }
-    bool isOrientationInverted() const override { return param.isOrientationInverted(); }
-    bool isAutomatable() const override { return param.isAutomatable(); }
-    bool isMetaParameter() const override { return param.isMetaParameter(); }
-    Category getCategory() const override { return static_cast<Parameter::Category> (param.getCategory()); }
-    String getCurrentValueAsText() const override { return param.getCurrentValueAsText(); }
-    StringArray getValueStrings() const override { return param.getAllValueStrings(); }
+    int getParameterIndex() const noexcept override { return param->getParameterIndex(); }
+    float getValue() const override { return param->getValue(); }
+    void setValue (float newValue) override { param->setValue (newValue); }
+    float getDefaultValue() const override { return param->getDefaultValue(); }
+    float getValueForText (const String& text) const override { return param->getValueForText (text); }
+    String getName (int maximumStringLength) const override { return param->getName (maximumStringLength); }
+    String getLabel() const override { return param->getLabel(); }
+    int getNumSteps() const override { return param->getNumSteps(); }
+    bool isDiscrete() const override { return param->isDiscrete(); }
+    bool isBoolean() const override { return param->isBoolean(); }
+    String getText (float value, int maxLen) const override { return param->getText (value, maxLen); }
+    bool isOrientationInverted() const override { return param->isOrientationInverted(); }
+    bool isAutomatable() const override { return param->isAutomatable(); }
+    bool isMetaParameter() const override { return param->isMetaParameter(); }
+    Category getCategory() const override { return static_cast<Parameter::Category> (param->getCategory()); }
+    String getCurrentValueAsText() const override { return param->getCurrentValueAsText(); }
+    StringArray getValueStrings() const override { return param->getAllValueStrings(); }
+
+    /** Point at the same parameter on another instance of the processor. */
+    void rebind (AudioProcessorParameter& newParam)
+    {
+        if (param == &newParam)
+            return;
+        param->removeListener (this);
+        param = &newParam;
+        param->addListener (this);
+    }
 
 private:
     friend class AudioProcessorNode;
-    AudioProcessorParameter& param;
+    AudioProcessorParameter* param;
     int portIndex = -1;
     bool ignoreChanges { false };
 
@@ -57,7 +69,7 @@ private:
         if (ignoreChanges)
             return;
         ScopedFlag sf (ignoreChanges, true);
-        param.sendValueChangedMessageToListeners (value);
+        param->sendValueChangedMessageToListeners (value);
     }
 
     void controlTouched (int /*index*/, bool grabbed) override
@@ -65,7 +77,7 @@ private:
         if (ignoreChanges)
             return;
         ScopedFlag sf (ignoreChanges, true);
-        grabbed ? param.beginChangeGesture() : param.endChangeGesture();
+        grabbed ? param->beginChangeGesture() : param->endChangeGesture();
     }
 
     void parameterValueChanged (int /*index*/, float value) override
@@ -94,8 +106,30 @@ void AudioProcessorNode::prepareToRender (double sampleRate, int maxBufferSize)
         return;
     }
 
+    activeStandby.store (nullptr);
+    if (retiringStandby.load())
+    {
+        // nothing renders while preparing, so it can go now
+        finishDestroyingStandby();
+    }
+    else if (standby != nullptr)
+    {
+        standby->release();
+        syncStandby();
+    }
+
+    // program standby renders through float buffers, so it keeps single precision
+    auto* const graph = getParentGraph();
+    const bool useDouble = graph != nullptr && graph->isUsingDoublePrecision() && standby == nullptr
+                           && proc->supportsDoublePrecisionProcessing() && getOversamplingFactor() <= 1;
+    proc->setProcessingPrecision (useDouble ? AudioProcessor::doublePrecision
+                                            : AudioProcessor::singlePrecision);
+
     proc->setRateAndBufferSizeDetails (sampleRate, maxBufferSize);
     proc->prepareToPlay (sampleRate, maxBufferSize);
+    preparedRate = sampleRate;
+    preparedBlockSize = maxBufferSize;
+    startStandby();
 }
 
 void AudioProcessorNode::releaseResources()
@@ -106,9 +140,182 @@ void AudioProcessorNode::releaseResources()
         return;
     }
 
+    activeStandby.store (nullptr);
+    if (retiringStandby.load())
+    {
+        // nothing renders while preparing, so it can go now
+        finishDestroyingStandby();
+    }
+    else if (standby != nullptr)
+    {
+        standby->release();
+        syncStandby();
+    }
+
+    preparedBlockSize = 0;
     proc->releaseResources();
 }
 
+//=============================================================================
+void AudioProcessorNode::setStandbyFactory (std::function<AudioProcessor*()> factory)
+{
+    standbyFactory = std::move (factory);
+    createStandby();
+}
+
+void AudioProcessorNode::createStandby()
+{
+    if (standby != nullptr || retiringStandby.load() || proc == nullptr || standbyFactory == nullptr || ! areMidiProgramsEnabled())
+        return;
+
+    std::unique_ptr<AudioProcessor> instance (standbyFactory());
+    if (instance == nullptr)
+        return;
+
+    spareProc = std::move (instance);
+    standby = std::make_unique<ProgramStandby> (*proc, *spareProc, [this] (int program, MemoryBlock& state) {
+        return getMidiProgramState (program, state);
+    });
+    startStandby();
+}
+
+void AudioProcessorNode::destroyStandby()
+{
+    if (standby == nullptr)
+        return;
+
+    if (retiringStandby.load())
+        return;
+
+    activeStandby.store (nullptr);
+    const auto sequence = renderSequence.load();
+    if ((sequence & 1) == 0)
+    {
+        // blocks starting from here don't see it
+        finishDestroyingStandby();
+        return;
+    }
+
+    // a block is still rendering through it, the audio thread hands it
+    // back when the block ends
+    retiredAt = sequence;
+    retiringStandby.store (true);
+}
+
+void AudioProcessorNode::finishDestroyingStandby()
+{
+    retiringStandby.store (false);
+    standby->release();
+    syncStandby();
+    standby.reset();
+    spareProc.reset();
+}
+
+void AudioProcessorNode::updateStandby()
+{
+    if (retiringStandby.load() && renderSequence.load() != retiredAt)
+    {
+        finishDestroyingStandby();
+        // the bank may have been enabled again meanwhile
+        if (areMidiProgramsEnabled())
+            createStandby();
+        return;
+    }
+
+    syncStandby();
+}
+
+void AudioProcessorNode::startStandby()
+{
+    // a standby created while rendering doubles waits for the next prepare
+    if (standby == nullptr || retiringStandby.load() || preparedBlockSize <= 0 || proc->isUsingDoublePrecision())
+        return;
+    standby->prepare (preparedRate, preparedBlockSize);
+    activeStandby.store (standby.get());
+}
+
+void AudioProcessorNode::syncStandby()
+{
+    // the audio thread swaps instances, ownership follows here.
+    if (standby == nullptr)
+        return;
+
+    if (standby->getLive() != proc.get())
+    {
+        proc->removeListener (&stateListener);
+        std::swap (proc, spareProc);
+        proc->addListener (&stateListener);
+
+        const auto& procParams = proc->getParameters();
+        for (int i = 0; i < jmin (params.size(), procParams.size()); ++i)
+            if (auto* param = dynamic_cast<AudioProcessorNodeParameter*> (params.getObjectPointerUnchecked (i)))
+                param->rebind (*procParams.getUnchecked (i));
+
+        markStateChanged();
+    }
+
+    // only now may the worker reset the old instance for the next program
+    standby->handoverComplete();
+}
+
+bool AudioProcessorNode::switchMidiProgram (int program)
+{
+    auto* const s = activeStandby.load (std::memory_order_acquire);
+    if (s == nullptr)
+        return false;
+
+    // an open editor belongs to the live instance, so it can't be swapped out.
+    if (auto* live = s->getLive())
+        if (live->getActiveEditor() != nullptr)
+            return false;
+
+    return s->requestProgram (program);
+}
+
+void AudioProcessorNode::midiProgramBankChanged()
+{
+    // a disabled bank doesn't need a second prepared instance
+    if (areMidiProgramsEnabled())
+        createStandby();
+    else
+        destroyStandby();
+}
+
+void AudioProcessorNode::renderWithStandby (AudioSampleBuffer& audio, MidiBuffer& midi, bool bypassed)
+{
+    ++renderSequence;
+    if (auto* const s = activeStandby.load())
+    {
+        if (s->process (audio, midi, bypassed))
+        {
+            live.store (s->getLive(), std::memory_order_release);
+            standbySwapper.triggerAsyncUpdate();
+        }
+    }
+    else if (bypassed)
+    {
+        getAudioProcessor()->processBlockBypassed (audio, midi);
+    }
+    else
+    {
+        getAudioProcessor()->processBlock (audio, midi);
+    }
+
+    ++renderSequence;
+    if (retiringStandby.load())
+        standbySwapper.triggerAsyncUpdate();
+}
+
+void AudioProcessorNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
+{
+    renderWithStandby (audio, *midi.getWriteBuffer (0), false);
+}
+
+void AudioProcessorNode::renderBypassed (AudioSampleBuffer& audio, MidiPipe& midi)
+{
+    renderWithStandby (audio, *midi.getWriteBuffer (0), true);
+}
+
 void AudioProcessorNode::EnablementUpdater::handleAsyncUpdate()
 {
     node.setEnabled (! node.isEnabled());
@@ -122,6 +329,7 @@ AudioProcessorNode::AudioProcessorNode (uint32 nodeId, AudioProcessor* processor
       enablement (*this)
 {
     proc.reset (processor);
+    live.store (processor);
     jassert (proc != nullptr);
     setLatencySamples (proc->getLatencySamples());
     setName (proc->getName());
@@ -129,6 +337,8 @@ AudioProcessorNode::AudioProcessorNode (uint32 nodeId, AudioProcessor* processor
 
     for (auto* param : proc->getParameters())
         params.add (new AudioProcessorNodeParameter (*param));
+
+    proc->addListener (&stateListener);
 }
 
 AudioProcessorNode::~AudioProcessorNode()
@@ -136,20 +346,29 @@ AudioProcessorNode::~AudioProcessorNode()
     params.clear();
     Processor::clearParameters();
     enablement.cancelPendingUpdate();
+    standbySwapper.cancelPendingUpdate();
+    activeStandby.store (nullptr);
+    standby.reset();
     pluginState.reset();
+    if (proc != nullptr)
+        proc->removeListener (&stateListener);
+    live.store (nullptr);
     proc = nullptr;
+    spareProc = nullptr;
 }
 
 void AudioProcessorNode::getState (MemoryBlock& block)
 {
-    if (proc != nullptr)
-        proc->getStateInformation (block);
+    if (auto* p = getAudioProcessor())
+        p->getStateInformation (block);
 }
 
 void AudioProcessorNode::setState (const void* data, int size)
 {
-    if (proc != nullptr)
-        proc->setStateInformation (data, size);
+    if (auto* p = getAudioProcessor())
+        p->setStateInformation (data, size);
+    if (standby != nullptr)
+        standby->invalidateLiveProgram();
 }
 
 void AudioProcessorNode::refreshPorts()
@@ -5,9 +5,13 @@
 
 #include <element/processor.hpp>
 
+#include <atomic>
+#include <functional>
+
 namespace element {
 
 class MidiPipe;
+class ProgramStandby;
 
 class AudioProcessorNode : public Processor
 {
@@ -17,14 +21,36 @@ public:
 
     virtual ~AudioProcessorNode();
 
-    /** Returns the processor as an AudioProcessor */
-    AudioProcessor* getAudioProcessor() const noexcept override { return proc.get(); }
+    /** Returns the instance currently rendering. With program standby this
+        changes as soon as the audio thread swaps instances, so two calls on
+        the message thread can return different instances. Both stay alive
+        until the standby is destroyed on the message thread.
+     */
+    AudioProcessor* getAudioProcessor() const noexcept override { return live.load (std::memory_order_acquire); }
+
+    /** Returns the instance the node owns as live. It only changes on the
+        message thread, once a swap has been handed over, so message thread
+        code that keeps the pointer, like editors, should use this.
+     */
+    AudioProcessor* getOwnedAudioProcessor() const noexcept { return proc.get(); }
     void setPlayHead (AudioPlayHead* playhead) override
     {
         if (auto* p = proc.get())
             p->setPlayHead (playhead);
+        if (auto* p = spareProc.get())
+            p->setPlayHead (playhead);
     }
 
+    /** Set a function which creates another instance of the processor. When
+        set and MIDI programs are enabled, program changes are loaded on a
+        standby instance and crossfaded in on the audio thread.
+     */
+    void setStandbyFactory (std::function<AudioProcessor*()> factory);
+
+    bool wantsMidiPipe() const override { return activeStandby.load (std::memory_order_acquire) != nullptr; }
+    void render (AudioSampleBuffer&, MidiPipe&) override;
+    void renderBypassed (AudioSampleBuffer&, MidiPipe&) override;
+
     void getState (MemoryBlock&) override;
     void setState (const void*, int) override;
 
@@ -36,13 +62,32 @@ public:
 
 protected:
     ParameterPtr getParameter (const PortDescription& port) override;
+    bool switchMidiProgram (int program) override;
+    void midiProgramBankChanged() override;
 
 private:
-    std::unique_ptr<AudioProcessor> proc;
+    std::unique_ptr<AudioProcessor> proc, spareProc;
+    std::atomic<AudioProcessor*> live { nullptr };
+    std::unique_ptr<ProgramStandby> standby;
+    std::atomic<ProgramStandby*> activeStandby { nullptr };
+    std::atomic<uint32> renderSequence { 0 }; // odd while a block renders
+    std::atomic<bool> retiringStandby { false };
+    uint32 retiredAt = 0;
+    std::function<AudioProcessor*()> standbyFactory;
+    double preparedRate = 0.0;
+    int preparedBlockSize = 0;
     Atomic<int> enabled { 1 };
     MemoryBlock pluginState;
     ParameterArray params;
 
+    struct StateListener : public AudioProcessorListener
+    {
+        StateListener (AudioProcessorNode& n) : node (n) {}
+        void audioProcessorParameterChanged (AudioProcessor*, int, float) override { node.markStateChanged(); }
+        void audioProcessorChanged (AudioProcessor*, const ChangeDetails&) override { node.markStateChanged(); }
+        AudioProcessorNode& node;
+    } stateListener { *this };
+
     struct EnablementUpdater : public AsyncUpdater
     {
         EnablementUpdater (AudioProcessorNode& n) : node (n) {}
@@ -51,6 +96,22 @@ private:
         AudioProcessorNode& node;
     } enablement;
 
+    struct StandbySwapper : public AsyncUpdater
+    {
+        StandbySwapper (AudioProcessorNode& n) : node (n) {}
+        ~StandbySwapper() { cancelPendingUpdate(); }
+        void handleAsyncUpdate() override { node.updateStandby(); }
+        AudioProcessorNode& node;
+    } standbySwapper { *this };
+
+    void createStandby();
+    void destroyStandby();
+    void finishDestroyingStandby();
+    void updateStandby();
+    void renderWithStandby (AudioSampleBuffer&, MidiBuffer&, bool bypassed);
+    void startStandby();
+    void syncStandby();
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioProcessorNode);
 };
 
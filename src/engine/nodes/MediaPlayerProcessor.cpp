@@ -217,7 +217,6 @@ void MediaPlayerProcessor::openFile (const File& file)
 
 void MediaPlayerProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    thread.startThread();
     formats.registerBasicFormats();
     player.prepareToPlay (maximumExpectedSamplesPerBlock, sampleRate);
     player.setLooping (true);
@@ -230,7 +229,6 @@ void MediaPlayerProcessor::releaseResources()
     player.stop();
     player.releaseResources();
     formats.clearFormats();
-    thread.stopThread (14);
 }
 
 void MediaPlayerProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "engine/nodes/BaseProcessor.h"
+#include "threadpools.hpp"
 
 namespace element {
 
@@ -105,7 +106,7 @@ protected:
 #endif
 
 private:
-    TimeSliceThread thread { "MediaPlayer" };
+    TimeSliceThread& thread { ThreadPools::getInstance().getIOThread() }; // shared, always running
     std::unique_ptr<AudioFormatReaderSource> reader;
     AudioFormatManager formats;
     AudioTransportSource player;
@@ -3,6 +3,7 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/nodes/MidiRouterNode.h"
+#include "engine/midikernel.hpp"
 #include <element/midipipe.hpp>
 #include "common.hpp"
 
@@ -14,12 +15,14 @@ MidiRouterNode::MidiRouterNode (int ins, int outs)
     : Processor (0),
       numSources (ins),
       numDestinations (outs),
-      state (ins, outs),
-      toggles (ins, outs),
-      nextToggles (ins, outs)
+      state (ins, outs)
 {
+    filters.insertMultiple (0, MidiRouteFilter(), ins * outs);
     clearPatches();
-    initMidiOuts (midiOuts);
+    initMidiOuts (midiOuts, numDestinations);
+    initMidiOuts (scratch, numSources);
+    mergeSources.allocate ((size_t) numSources, true);
+    mergeCursors.allocate ((size_t) numSources, true);
 
     auto* program = programs.add (new Program ("Linear"));
     program->matrix.resize (ins, outs);
@@ -51,7 +54,22 @@ MidiRouterNode::MidiRouterNode (int ins, int outs)
     }
 }
 
-MidiRouterNode::~MidiRouterNode() {}
+MidiRouterNode::~MidiRouterNode()
+{
+    deleteRetired();
+    delete pending.exchange (nullptr);
+}
+
+void MidiRouterNode::prepareToRender (double sampleRate, int maxBufferSize)
+{
+    ignoreUnused (sampleRate, maxBufferSize);
+    for (auto* const buffer : midiOuts)
+        MidiKernel::reserve (*buffer);
+    for (auto* const buffer : scratch)
+        MidiKernel::reserve (*buffer);
+}
+
+void MidiRouterNode::releaseResources() {}
 
 void MidiRouterNode::setCurrentProgram (int index)
 {
@@ -65,13 +83,10 @@ void MidiRouterNode::setCurrentProgram (int index)
 void MidiRouterNode::setMatrixState (const MatrixState& matrix)
 {
     jassert (state.sameSizeAs (matrix));
-    state = matrix;
-    ToggleGrid newPatches (state);
-
     {
         ScopedLock sl (getLock());
-        toggles.swapWith (newPatches);
-        togglesChanged = true; // initiate the crossfade
+        state = matrix;
+        publishRoutes();
     }
 
     sendChangeMessage();
@@ -82,27 +97,124 @@ MatrixState MidiRouterNode::getMatrixState() const
     return state;
 }
 
+void MidiRouterNode::setRouteFilter (int src, int dst, const MidiRouteFilter& filter)
+{
+    jassert (isPositiveAndBelow (src, numSources) && isPositiveAndBelow (dst, numDestinations));
+    {
+        ScopedLock sl (getLock());
+        auto& existing = filters.getReference (src * numDestinations + dst);
+        if (existing == filter)
+            return;
+        existing = filter;
+        publishRoutes();
+    }
+
+    sendChangeMessage();
+}
+
+MidiRouteFilter MidiRouterNode::getRouteFilter (int src, int dst) const
+{
+    ScopedLock sl (lock);
+    return filters[src * numDestinations + dst];
+}
+
+void MidiRouterNode::publishRoutes()
+{
+    auto table = std::make_unique<RoutingTable>();
+    table->firstRoute.ensureStorageAllocated (numDestinations + 1);
+    for (int dst = 0; dst < numDestinations; ++dst)
+    {
+        table->firstRoute.add (table->routes.size());
+        for (int src = 0; src < numSources; ++src)
+            if (state.connected (src, dst))
+                table->routes.add ({ src, filters.getReference (src * numDestinations + dst) });
+    }
+    table->firstRoute.add (table->routes.size());
+    numActiveRoutes = table->routes.size();
+
+    deleteRetired();
+
+    // the audio thread never picked up the last one, so it's still ours
+    delete pending.exchange (table.release());
+}
+
+void MidiRouterNode::deleteRetired()
+{
+    delete retired.exchange (nullptr);
+}
+
 void MidiRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     jassert (midi.getNumBuffers() >= numDestinations);
 
-    const auto nsamples = audio.getNumSamples();
     const auto nbuffers = midi.getNumBuffers();
     audio.clear();
 
-    ScopedLock sl (getLock());
-    for (int src = 0; src < numSources; ++src)
+    // a new table is only taken once the previous one was collected
+    if (pending.load (std::memory_order_relaxed) != nullptr && retired.load (std::memory_order_acquire) == nullptr)
     {
-        if (src >= nbuffers)
-            break;
+        if (auto* const next = pending.exchange (nullptr, std::memory_order_acq_rel))
+        {
+            retired.store (active.release(), std::memory_order_release);
+            active.reset (next);
+        }
+    }
+
+    if (active == nullptr)
+    {
+        midi.clear();
+        return;
+    }
+
+    const auto& routes = active->routes;
+    const auto& firstRoute = active->firstRoute;
+
+    for (int dst = 0; dst < numDestinations; ++dst)
+    {
+        auto& out = *midiOuts.getUnchecked (dst);
+        out.clear();
 
-        const auto& rb = *midi.getReadBuffer (src);
-        for (int dst = 0; dst < numDestinations; ++dst)
-            if (toggles.get (src, dst))
-                midiOuts.getUnchecked (dst)->addEvents (rb, 0, nsamples, 0);
+        int numMerged = 0;
+        for (int r = firstRoute.getUnchecked (dst); r < firstRoute.getUnchecked (dst + 1); ++r)
+        {
+            const auto& route = routes.getReference (r);
+            if (route.source >= nbuffers)
+                continue;
+
+            const auto& source = *midi.getReadBuffer (route.source);
+            if (source.isEmpty())
+                continue;
+
+            // sources already in time order go straight out, others merge below
+            auto& target = numMerged == 0 ? out : *scratch.getUnchecked (numMerged - 1);
+            if (numMerged > 0)
+                target.clear();
+
+            if (route.filter.passesAll())
+            {
+                MidiKernel::copy (source, target);
+            }
+            else
+            {
+                for (const auto meta : source)
+                    if (route.filter.accepts (meta.data, meta.numBytes))
+                        MidiKernel::append (target, meta.data, meta.numBytes, meta.samplePosition);
+            }
+
+            if (! target.isEmpty())
+                mergeSources[numMerged++] = &target;
+        }
+
+        if (numMerged > 1)
+        {
+            // merge can't write into one of its sources
+            auto& merged = *scratch.getUnchecked (numSources - 1);
+            MidiKernel::merge (mergeSources.get(), numMerged, mergeCursors.get(), merged);
+            out.swapWith (merged);
+        }
     }
 
-    for (int i = midiOuts.size(); --i >= 0;)
+    for (int i = numDestinations; --i >= 0;)
     {
         auto* const ob = midiOuts.getUnchecked (i);
         ob->swapWith (*midi.getWriteBuffer (i));
@@ -112,8 +224,28 @@ void MidiRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 
 void MidiRouterNode::getState (MemoryBlock& block)
 {
+    ValueTree tree;
+    {
+        ScopedLock sl (getLock());
+        tree = state.createValueTree();
+        for (int i = 0; i < filters.size(); ++i)
+        {
+            const auto& filter = filters.getReference (i);
+            if (filter.passesAll())
+                continue;
+            ValueTree child ("filter");
+            child.setProperty ("source", i / numDestinations, nullptr)
+                .setProperty ("destination", i % numDestinations, nullptr)
+                .setProperty ("channels", (int) filter.channels, nullptr)
+                .setProperty ("types", (int) filter.types, nullptr)
+                .setProperty ("lowNote", (int) filter.lowNote, nullptr)
+                .setProperty ("highNote", (int) filter.highNote, nullptr);
+            tree.appendChild (child, nullptr);
+        }
+    }
+
     MemoryOutputStream stream (block, false);
-    state.createValueTree().writeToStream (stream);
+    tree.writeToStream (stream);
 }
 
 void MidiRouterNode::setState (const void* data, int sizeInBytes)
@@ -125,6 +257,25 @@ void MidiRouterNode::setState (const void* data, int sizeInBytes)
         MatrixState matrix;
         matrix.restoreFromValueTree (tree);
         jassert (matrix.getNumRows() == numSources && matrix.getNumColumns() == numDestinations);
+
+        {
+            ScopedLock sl (getLock());
+            filters.fill (MidiRouteFilter());
+            for (const auto& child : tree)
+            {
+                const int src = child.getProperty ("source", -1);
+                const int dst = child.getProperty ("destination", -1);
+                if (! child.hasType ("filter") || ! isPositiveAndBelow (src, numSources) || ! isPositiveAndBelow (dst, numDestinations))
+                    continue;
+
+                auto& filter = filters.getReference (src * numDestinations + dst);
+                filter.channels = (uint16) (int) child.getProperty ("channels", 0xffff);
+                filter.types = (uint8) (int) child.getProperty ("types", (int) MidiRouteFilter::allTypes);
+                filter.lowNote = (uint8) jlimit (0, 127, (int) child.getProperty ("lowNote", 0));
+                filter.highNote = (uint8) jlimit (0, 127, (int) child.getProperty ("highNote", 127));
+            }
+        }
+
         setMatrixState (matrix);
     }
 }
@@ -132,37 +283,31 @@ void MidiRouterNode::setState (const void* data, int sizeInBytes)
 void MidiRouterNode::setWithoutLocking (int src, int dst, bool set)
 {
     jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
-    toggles.set (src, dst, set);
     state.set (src, dst, set);
+    publishRoutes();
 }
 
 void MidiRouterNode::set (int src, int dst, bool patched)
 {
-    jassert (src >= 0 && src < numSources && dst >= 0 && numDestinations < 4);
-    toggles.set (src, dst, patched);
+    jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
+    ScopedLock sl (getLock());
     state.set (src, dst, patched);
+    publishRoutes();
 }
 
 void MidiRouterNode::clearPatches()
 {
-    {
-        ScopedLock sl (getLock());
-        toggles.clear();
-        nextToggles.clear();
-    }
-
+    ScopedLock sl (getLock());
     for (int r = 0; r < state.getNumRows(); ++r)
         for (int c = 0; c < state.getNumColumns(); ++c)
             state.set (r, c, false);
+    publishRoutes();
 }
 
-void MidiRouterNode::initMidiOuts (OwnedArray<MidiBuffer>& outs)
+void MidiRouterNode::initMidiOuts (OwnedArray<MidiBuffer>& outs, int size)
 {
-    while (outs.size() < numDestinations)
-    {
-        auto* const buf = outs.add (new MidiBuffer());
-        buf->ensureSize (16 * 3);
-    }
+    while (outs.size() < size)
+        MidiKernel::reserve (*outs.add (new MidiBuffer()));
 }
 
 } // namespace element
@@ -3,13 +3,88 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "engine/nodes/NodeTypes.h"
 #include <element/processor.hpp>
 #include "engine/linearfade.hpp"
-#include "engine/togglegrid.hpp"
+#include "matrixstate.hpp"
 
 namespace element {
 
+/** Decides which events pass along one route of a MidiRouterNode. */
+struct MidiRouteFilter
+{
+    enum MessageTypes : uint8
+    {
+        notes = 1 << 0, ///< note on, note off and poly pressure
+        controllers = 1 << 1,
+        programs = 1 << 2,
+        channelPressure = 1 << 3,
+        pitchBend = 1 << 4,
+        system = 1 << 5, ///< sysex, clock and everything without a channel
+        allTypes = 0x3f
+    };
+
+    uint16 channels = 0xffff; ///< bit n passes channel n + 1
+    uint8 types = allTypes;
+    uint8 lowNote = 0, highNote = 127; ///< applies to note messages only
+
+    /** Returns true if everything passes. */
+    bool passesAll() const noexcept
+    {
+        return channels == 0xffff && types == allTypes && lowNote == 0 && highNote == 127;
+    }
+
+    /** Returns true if the raw message passes. */
+    bool accepts (const uint8* data, int numBytes) const noexcept
+    {
+        if (numBytes <= 0)
+            return false;
+
+        const uint8 status = data[0];
+        if (status >= 0xf0)
+            return (types & system) != 0;
+
+        if ((channels & (1 << (status & 0x0f))) == 0)
+            return false;
+
+        switch (status & 0xf0)
+        {
+            case 0x80:
+            case 0x90:
+            case 0xa0:
+                return (types & notes) != 0 && numBytes > 1 && data[1] >= lowNote && data[1] <= highNote;
+            case 0xb0:
+                return (types & controllers) != 0;
+            case 0xc0:
+                return (types & programs) != 0;
+            case 0xd0:
+                return (types & channelPressure) != 0;
+            case 0xe0:
+                return (types & pitchBend) != 0;
+            default:
+                break;
+        }
+
+        return (types & system) != 0;
+    }
+
+    bool operator== (const MidiRouteFilter& o) const noexcept
+    {
+        return channels == o.channels && types == o.types && lowNote == o.lowNote && highNote == o.highNote;
+    }
+
+    bool operator!= (const MidiRouteFilter& o) const noexcept { return ! operator== (o); }
+};
+
+/** A MIDI patch grid with a filter on every route.
+
+    Changes to the matrix or filters are compiled into a sparse routing
+    table on the calling thread and handed to the audio thread with an
+    atomic pointer swap, so rendering never locks. Only patched routes are
+    visited, and output goes into buffers reserved in prepareToRender.
+ */
 class MidiRouterNode : public Processor,
                        public ChangeBroadcaster
 {
@@ -17,8 +92,8 @@ public:
     explicit MidiRouterNode (int ins = 4, int outs = 4);
     ~MidiRouterNode();
 
-    void prepareToRender (double sampleRate, int maxBufferSize) override { ignoreUnused (sampleRate, maxBufferSize); }
-    void releaseResources() override {}
+    void prepareToRender (double sampleRate, int maxBufferSize) override;
+    void releaseResources() override;
 
     inline bool wantsMidiPipe() const override { return true; }
     void render (AudioSampleBuffer&, MidiPipe&) override;
@@ -30,6 +105,14 @@ public:
     void setWithoutLocking (int src, int dst, bool set);
     CriticalSection& getLock() { return lock; }
 
+    /** Set the filter of the route from src to dst. The route keeps its
+        filter while unpatched. */
+    void setRouteFilter (int src, int dst, const MidiRouteFilter& filter);
+    MidiRouteFilter getRouteFilter (int src, int dst) const;
+
+    /** Returns the number of patched routes the audio thread will use. */
+    int getNumActiveRoutes() const noexcept { return numActiveRoutes.load(); }
+
     int getNumPrograms() const override { return jmax (1, programs.size()); }
     int getCurrentProgram() const override { return currentProgram; }
     void setCurrentProgram (int index) override;
@@ -61,15 +144,10 @@ public:
             return;
         int index = 0;
         PortList newPorts;
-        newPorts.add (PortType::Midi, index++, 0, "midi_in_0", "Input 1", true);
-        newPorts.add (PortType::Midi, index++, 1, "midi_in_1", "Input 2", true);
-        newPorts.add (PortType::Midi, index++, 2, "midi_in_2", "Input 3", true);
-        newPorts.add (PortType::Midi, index++, 3, "midi_in_3", "Input 4", true);
-
-        newPorts.add (PortType::Midi, index++, 0, "midi_out_0", "Output 1", false);
-        newPorts.add (PortType::Midi, index++, 1, "midi_out_1", "Output 2", false);
-        newPorts.add (PortType::Midi, index++, 2, "midi_out_2", "Output 3", false);
-        newPorts.add (PortType::Midi, index++, 3, "midi_out_3", "Output 4", false);
+        for (int i = 0; i < numSources; ++i)
+            newPorts.add (PortType::Midi, index++, i, "midi_in_" + String (i), "Input " + String (i + 1), true);
+        for (int i = 0; i < numDestinations; ++i)
+            newPorts.add (PortType::Midi, index++, i, "midi_out_" + String (i), "Output " + String (i + 1), false);
         setPorts (newPorts);
     }
 
@@ -93,15 +171,36 @@ private:
     void set (int src, int dst, bool patched);
     void clearPatches();
 
-    // used by the UI, but not the rendering
+    // used by the UI and to build routing tables, not by the rendering
     MatrixState state;
+    Array<MidiRouteFilter> filters;
+
+    /** Patched routes to one destination. */
+    struct Route
+    {
+        int source = 0;
+        MidiRouteFilter filter;
+    };
+
+    /** Immutable once published: routes grouped by destination. */
+    struct RoutingTable
+    {
+        Array<Route> routes;
+        Array<int> firstRoute; ///< per destination, plus one past the end
+    };
+
+    // published by the message thread, picked up by render
+    std::atomic<RoutingTable*> pending { nullptr }, retired { nullptr };
+    std::unique_ptr<RoutingTable> active;
+    std::atomic<int> numActiveRoutes { 0 };
 
-    ToggleGrid toggles;
-    ToggleGrid nextToggles;
-    bool togglesChanged { false };
+    OwnedArray<MidiBuffer> midiOuts, scratch;
+    HeapBlock<const MidiBuffer*> mergeSources;
+    HeapBlock<int> mergeCursors;
 
-    OwnedArray<MidiBuffer> midiOuts;
-    void initMidiOuts (OwnedArray<MidiBuffer>& outs);
+    void initMidiOuts (OwnedArray<MidiBuffer>& outs, int size);
+    void publishRoutes();
+    void deleteRetired();
 };
 
 } // namespace element
@@ -10,6 +10,7 @@
 #include "el/factories.hpp"
 
 #include "ElementApp.h"
+#include "engine/denormals.hpp"
 #include "engine/nodes/ScriptNode.h"
 #include <element/midipipe.hpp>
 #include <element/parameter.hpp>
@@ -140,6 +141,8 @@ void ScriptNode::releaseResources()
 
 void ScriptNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
+    // Lua math runs in doubles and won't undenormalise its own feedback
+    const ScopedFlushDenormals flushDenormals;
     ScopedLock sl (lock);
     script->process (audio, midi);
 }
@@ -38,6 +38,11 @@ PortBuffer::PortBuffer (bool inputPort, uint32 portType, uint32 dataType, uint32
     {
         buffer.control = (float*) data.get();
     }
+    else if (type == PortType::CV)
+    {
+        buffer.cv = (float*) data.get();
+        std::fill (buffer.cv, buffer.cv + capacity / sizeof (float), 0.f);
+    }
     else
     {
         // trying to use an unsupported buffer type
@@ -107,7 +112,7 @@ bool PortBuffer::addEvent (int64 frames, uint32 size, uint32 bodyType, const uin
 
 void PortBuffer::clear()
 {
-    if (isAudio() || isControl())
+    if (isAudio() || isControl() || isCV())
     {
     }
     else if (isSequence())
@@ -34,13 +34,16 @@ public:
     inline bool isAtom() const { return type == PortType::Atom; }
     inline bool isAudio() const { return type == PortType::Audio; }
     inline bool isControl() const { return type == PortType::Control; }
+    inline bool isCV() const { return type == PortType::CV; }
     inline bool isEvent() const { return type == PortType::Event; }
     inline bool isSequence() const { return isAtom(); }
 
+    /** Use external memory for the port. Passing nullptr goes back to the
+        buffer's own storage. */
     void referTo (void* location)
     {
-        buffer.referred = location;
-        referenced = true;
+        referenced = location != nullptr;
+        buffer.referred = referenced ? location : data.get();
     }
 
     float getValue() const;
@@ -1,12 +1,12 @@
 // Copyright 2023 Kushview, LLC <info@kushview.net>
 // SPDX-License-Identifier: GPL3-or-later
 
-#include <iomanip>
 #include "ElementApp.h"
 
 #include "engine/nodes/AudioProcessorNode.h"
 #include "engine/nodes/MidiDeviceProcessor.h"
 #include "engine/nodes/PlaceholderProcessor.h"
+#include "engine/midiprogrambank.hpp"
 #include <element/audioengine.hpp>
 #include <element/midipipe.hpp>
 #include <element/processor.hpp>
@@ -28,6 +28,7 @@ Processor::Processor (const PortList& portList)
     inputGain.set (1.0f);
     lastInputGain.set (1.0f);
     oversampler = std::make_unique<Oversampler<float>>();
+    programBank = std::make_unique<MidiProgramBank>();
     // ports = portList;
     setPorts (portList);
 }
@@ -45,6 +46,7 @@ Processor::Processor (const uint32 nodeId_) noexcept
     inputGain.set (1.0f);
     lastInputGain.set (1.0f);
     oversampler = std::make_unique<Oversampler<float>>();
+    programBank = std::make_unique<MidiProgramBank>();
 }
 
 Processor::~Processor()
@@ -205,6 +207,25 @@ void Processor::setOutputRMS (int chan, float val)
         outRMS.getUnchecked (chan)->set (val);
 }
 
+void Processor::setInputPeak (int chan, float val)
+{
+    if (chan < inPeak.size())
+        inPeak.getUnchecked (chan)->set (val);
+}
+
+void Processor::setOutputPeak (int chan, float val)
+{
+    if (chan < outPeak.size())
+        outPeak.getUnchecked (chan)->set (val);
+}
+
+void Processor::removeMeterSubscriber() noexcept
+{
+    jassert (meterSubscribers.get() > 0);
+    if (--meterSubscribers <= 0)
+        meterSubscribers = 0;
+}
+
 bool Processor::isSuspended() const
 {
     return bypassed.get() == 1;
@@ -229,7 +250,13 @@ void Processor::suspendProcessing (const bool shouldBeSuspended)
     }
 
     if (isSuspended() != wasSuspeneded)
+    {
         bypassChanged (this);
+        // bypassed subgraphs render on their own, not inlined
+        if (isSubGraph())
+            if (auto* g = getParentGraph())
+                g->triggerAsyncUpdate();
+    }
 }
 
 bool Processor::isGraph() const noexcept { return isA<GraphNode>(); }
@@ -320,20 +347,26 @@ void Processor::prepare (const double newSampleRate,
         const int osFactor = jmax (1, getOversamplingFactor());
         prepareToRender (sampleRate * osFactor, blockSize * osFactor);
 
-        inRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioInputs(); ++i)
+        for (auto* levels : { &inRMS, &inPeak })
         {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set (0);
-            inRMS.add (avf);
+            levels->clearQuick (true);
+            for (int i = 0; i < getNumAudioInputs(); ++i)
+            {
+                AtomicValue<float>* avf = new AtomicValue<float>();
+                avf->set (0);
+                levels->add (avf);
+            }
         }
 
-        outRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioOutputs(); ++i)
+        for (auto* levels : { &outRMS, &outPeak })
         {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set (0);
-            outRMS.add (avf);
+            levels->clearQuick (true);
+            for (int i = 0; i < getNumAudioOutputs(); ++i)
+            {
+                AtomicValue<float>* avf = new AtomicValue<float>();
+                avf->set (0);
+                levels->add (avf);
+            }
         }
     }
 }
@@ -347,9 +380,24 @@ void Processor::unprepare()
         oversampler->reset();
         inRMS.clear (true);
         outRMS.clear (true);
+        inPeak.clear (true);
+        outPeak.clear (true);
+        cpuLoad.set (0.f);
     }
 }
 
+void Processor::publishRenderState()
+{
+    const ScopedLock sl (propertyLock);
+    RenderState state;
+    state.keyLow = keyRangeLow.get();
+    state.keyHigh = keyRangeHigh.get();
+    state.transposeOffset = transposeOffset.get();
+    state.midiChannels = (uint32) midiChannels.get().getBitRangeAsInt (0, 17);
+    state.midiProgramsEnabled = midiProgramsEnabled.get() == 1;
+    renderState.store (state);
+}
+
 void Processor::setEnabled (const bool shouldBeEnabled)
 {
     if (shouldBeEnabled == isEnabled())
@@ -368,6 +416,9 @@ void Processor::setEnabled (const bool shouldBeEnabled)
         {
             prepare (parent->getSampleRate(), parent->getBlockSize(), parent, true);
             enabled.set (1);
+            // an enabled subgraph can be inlined into its parent again
+            if (isSubGraph())
+                parent->triggerAsyncUpdate();
         }
         else
         {
@@ -377,6 +428,10 @@ void Processor::setEnabled (const bool shouldBeEnabled)
     else
     {
         enabled.set (0);
+        // an inlined subgraph's nodes render in the parent's sequence, so
+        // take them out of it before they're released
+        if (isSubGraph() && parent != nullptr)
+            parent->buildRenderingSequence();
         unprepare();
     }
 
@@ -392,9 +447,49 @@ void Processor::EnablementUpdater::handleAsyncUpdate()
 
 void Processor::reloadMidiProgram()
 {
+    const auto program = midiProgram.get();
+    standbyMidiProgram.set (switchMidiProgram (program) ? program : -1);
     midiProgramLoader.triggerAsyncUpdate();
 }
 
+void Processor::refreshMidiProgramBank()
+{
+    {
+        ScopedLock sl (programBankLock);
+        auto& bank = *programBank;
+        bank.clear();
+
+        if (! useGlobalMidiPrograms())
+        {
+            for (const auto* const program : midiPrograms)
+                bank.setState (program->program, program->state);
+        }
+        else if (areMidiProgramsEnabled())
+        {
+            // only touch the disk for nodes which can change programs
+            PluginDescription desc;
+            getPluginDescription (desc);
+            bank.loadGlobalPrograms (DataPath::defaultGlobalMidiProgramsDir(),
+                                     desc.createIdentifierString());
+        }
+    }
+
+    midiProgramBankChanged();
+}
+
+bool Processor::getMidiProgramState (int program, MemoryBlock& state) const
+{
+    ScopedLock sl (programBankLock);
+    if (auto* const cached = programBank->getState (program))
+    {
+        state = *cached;
+        return true;
+    }
+
+    state.reset();
+    return false;
+}
+
 File Processor::getMidiProgramFile (int program) const
 {
     PluginDescription desc;
@@ -415,9 +510,7 @@ File Processor::getMidiProgramFile (int program) const
         return File();
     }
 
-    std::stringstream stream;
-    stream << uids.toStdString() << "_" << std::setfill ('0') << std::setw (3) << program << ".eln";
-    String fileName = stream.str();
+    const auto fileName = MidiProgramBank::getProgramFileName (uids, program);
     const File file (DataPath::defaultGlobalMidiProgramsDir().getChildFile (fileName));
     if (! file.getParentDirectory().exists())
         file.getParentDirectory().createDirectory();
@@ -436,6 +529,7 @@ void Processor::saveMidiProgram()
     {
         program->state = MemoryBlock();
         getState (program->state);
+        refreshMidiProgramBank();
     }
 }
 
@@ -459,6 +553,8 @@ void Processor::removeMidiProgram (int program, bool global)
                 midiPrograms.remove (i);
         }
     }
+
+    refreshMidiProgramBank();
 }
 
 Processor::MidiProgram* Processor::getMidiProgram (int program) const
@@ -475,46 +571,35 @@ Processor::MidiProgram* Processor::getMidiProgram (int program) const
 
 void Processor::MidiProgramLoader::handleAsyncUpdate()
 {
-    const File programFile = node.getMidiProgramFile();
     const bool globalPrograms = node.useGlobalMidiPrograms();
     const auto requestedProgram = node.getMidiProgram();
-#if 0
-    if (node.lastMidiProgram.get() == requestedProgram)
+
+    if (node.standbyMidiProgram.get() == requestedProgram)
     {
-        DBG("[element] same program, not loading.");
-        return;
+        // the node switches on the audio thread
+        node.lastMidiProgram.set (requestedProgram);
     }
-#endif
-
-    if (globalPrograms)
+    else
     {
-        if (programFile.existsAsFile())
+        MemoryBlock state;
+        bool loaded = node.getMidiProgramState (requestedProgram, state);
+
+        if (! loaded && globalPrograms)
         {
-            const auto programData = Node::parse (programFile);
-            auto data = programData.getProperty (tags::state).toString().trim();
-            if (data.isNotEmpty())
+            // saved after the bank was loaded
+            loaded = MidiProgramBank::decodeProgramFile (node.getMidiProgramFile(), state);
+            if (loaded)
             {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    node.lastMidiProgram.set (requestedProgram);
-                    node.setState (state.getData(), (int) state.getSize());
-                    DBG ("[element] loaded program: " << requestedProgram);
-                }
+                ScopedLock sl (node.programBankLock);
+                node.programBank->setState (requestedProgram, state);
             }
         }
-        else
-        {
-            DBG ("[element] Program file doesn't exist: " << node.getMidiProgramFile().getFileName());
-        }
-    }
-    else
-    {
-        if (auto* const program = node.getMidiProgram (requestedProgram))
+
+        if (loaded)
         {
-            node.setState (program->state.getData(),
-                           static_cast<int> (program->state.getSize()));
+            node.lastMidiProgram.set (requestedProgram);
+            node.setState (state.getData(), (int) state.getSize());
+            DBG ("[element] loaded program: " << requestedProgram);
         }
         else
         {
@@ -0,0 +1,203 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/programstandby.hpp"
+#include "threadpools.hpp"
+
+namespace element {
+
+using namespace juce;
+
+static void renderBlock (AudioProcessor& processor, AudioBuffer<float>& audio, MidiBuffer& midi, bool bypassed)
+{
+    if (bypassed)
+        processor.processBlockBypassed (audio, midi);
+    else
+        processor.processBlock (audio, midi);
+}
+
+ProgramStandby::ProgramStandby (AudioProcessor& liveProcessor, AudioProcessor& spareProcessor, StateFunction stateFunction)
+    : live (&liveProcessor),
+      spare (&spareProcessor),
+      getState (std::move (stateFunction))
+{
+    jassert (&liveProcessor != &spareProcessor);
+}
+
+ProgramStandby::~ProgramStandby()
+{
+    release();
+}
+
+void ProgramStandby::prepare (double sampleRate, int blockSize)
+{
+    release();
+
+    auto* const current = live.load();
+    auto* const next = spare.load();
+    next->setBusesLayout (current->getBusesLayout());
+    next->setPlayHead (current->getPlayHead());
+    next->setRateAndBufferSizeDetails (sampleRate, blockSize);
+    next->prepareToPlay (sampleRate, blockSize);
+
+    scratch.setSize (jmax (1, current->getTotalNumInputChannels(), current->getTotalNumOutputChannels()),
+                     jmax (1, blockSize));
+    scratch.clear();
+    scratchMidi.clear();
+    scratchMidi.ensureSize (2048);
+
+    {
+        const SpinLock::ScopedLockType sl (spareLock);
+        spareProgram = -1;
+    }
+
+    guard = std::make_shared<Guard>();
+    guard->owner = this;
+    active.store (true, std::memory_order_release);
+    queueLoad();
+}
+
+void ProgramStandby::release()
+{
+    {
+        const SpinLock::ScopedLockType sl (spareLock);
+        if (! active.load())
+            return;
+        active.store (false, std::memory_order_release);
+    }
+
+    cancelPendingUpdate();
+    {
+        // waits for a load in progress, queued jobs find no owner
+        const ScopedLock sl (guard->lock);
+        guard->owner = nullptr;
+    }
+    guard = nullptr;
+    jobQueued.store (false);
+
+    spare.load()->releaseResources();
+}
+
+void ProgramStandby::handoverComplete() noexcept
+{
+    if (handoverPending.exchange (false, std::memory_order_acq_rel))
+        triggerAsyncUpdate();
+}
+
+bool ProgramStandby::requestProgram (int program) noexcept
+{
+    if (! isActive() || ! isPositiveAndBelow (program, 128))
+        return false;
+    requested.store (program, std::memory_order_release);
+    triggerAsyncUpdate();
+    return true;
+}
+
+bool ProgramStandby::process (AudioBuffer<float>& audio, MidiBuffer& midi, bool bypassed) noexcept
+{
+    auto* const current = live.load (std::memory_order_relaxed);
+    int want = requested.load (std::memory_order_acquire);
+    if (want >= 0 && want == liveProgram.load (std::memory_order_relaxed))
+    {
+        requested.compare_exchange_strong (want, -1);
+        want = -1;
+    }
+
+    const int numSamples = audio.getNumSamples();
+    const int numChannels = audio.getNumChannels();
+
+    const SpinLock::ScopedTryLockType sl (spareLock);
+    if (! sl.isLocked() || want < 0 || want != spareProgram
+        || numSamples > scratch.getNumSamples() || numChannels > scratch.getNumChannels())
+    {
+        renderBlock (*current, audio, midi, bypassed);
+        return false;
+    }
+
+    auto* const next = spare.load (std::memory_order_relaxed);
+
+    // the spare renders the same input as the live instance
+    AudioBuffer<float> fadeIn (scratch.getArrayOfWritePointers(), numChannels, numSamples);
+    for (int c = 0; c < numChannels; ++c)
+        fadeIn.copyFrom (c, 0, audio, c, 0, numSamples);
+    scratchMidi.clear();
+    scratchMidi.addEvents (midi, 0, numSamples, 0);
+
+    renderBlock (*next, fadeIn, scratchMidi, bypassed);
+    renderBlock (*current, audio, midi, bypassed);
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        audio.applyGainRamp (c, 0, numSamples, 1.f, 0.f);
+        audio.addFromWithRamp (c, 0, fadeIn.getReadPointer (c), numSamples, 0.f, 1.f);
+    }
+
+    midi.swapWith (scratchMidi);
+    scratchMidi.clear();
+
+    // the old instance stops mid-note, so it gets reset before reuse
+    live.store (next, std::memory_order_release);
+    spare.store (current, std::memory_order_release);
+    spareProgram = -1;
+    liveProgram.store (want, std::memory_order_release);
+    requested.compare_exchange_strong (want, -1);
+    handoverPending.store (true, std::memory_order_release);
+    return true;
+}
+
+void ProgramStandby::handleAsyncUpdate()
+{
+    queueLoad();
+}
+
+void ProgramStandby::queueLoad()
+{
+    // one job at a time, it loads whatever is requested when it runs
+    if (! isActive() || jobQueued.exchange (true))
+        return;
+
+    ThreadPools::getInstance().addJob (ThreadPools::worker, [g = guard]() {
+        const ScopedLock sl (g->lock);
+        if (auto* const owner = g->owner)
+            owner->loadRequested();
+    });
+}
+
+void ProgramStandby::loadRequested()
+{
+    // requests from here on queue another job
+    jobQueued.store (false);
+    MemoryBlock state;
+
+    for (;;)
+    {
+        // the owner may still be using the old live instance
+        int want = requested.load (std::memory_order_acquire);
+        if (handoverPending.load (std::memory_order_acquire)
+            || want < 0 || want == liveProgram.load (std::memory_order_acquire))
+            return;
+
+        {
+            const SpinLock::ScopedLockType sl (spareLock);
+            if (want == spareProgram)
+                return;
+        }
+
+        if (! getState || ! getState (want, state))
+        {
+            // nothing to load, leave the live instance alone
+            requested.compare_exchange_strong (want, -1);
+            continue;
+        }
+
+        // the audio thread only try-locks this, so it skips the swap while loading
+        const SpinLock::ScopedLockType sl (spareLock);
+        auto* const target = spare.load (std::memory_order_acquire);
+        spareProgram = -1;
+        target->reset();
+        target->setStateInformation (state.getData(), (int) state.getSize());
+        spareProgram = want;
+    }
+}
+
+} // namespace element
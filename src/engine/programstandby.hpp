@@ -0,0 +1,103 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/audio_processors.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace element {
+
+/** Switches MIDI programs by swapping in a second, pre-loaded instance.
+
+    Program states are applied to the spare instance by a worker job from
+    ThreadPools, queued on the message thread after a request. Once the
+    spare is ready, the next rendered block runs both instances and
+    crossfades from the live one to the spare, which then becomes live. Once
+    the owner confirms the swap with handoverComplete(), the old live
+    instance is reset and used as the spare for the next change.
+
+    Neither instance is owned here.
+ */
+class ProgramStandby final : private juce::AsyncUpdater
+{
+public:
+    /** Copies the state of a program. Called on a worker thread. */
+    using StateFunction = std::function<bool (int program, juce::MemoryBlock& state)>;
+
+    ProgramStandby (juce::AudioProcessor& live, juce::AudioProcessor& spare, StateFunction getState);
+    ~ProgramStandby();
+
+    /** Match the spare to the live instance and allocate crossfade buffers.
+        Call after the live instance has been prepared.
+     */
+    void prepare (double sampleRate, int blockSize);
+
+    /** Wait for a load in progress and release the spare. Jobs still queued
+        do nothing when they run.
+     */
+    void release();
+
+    /** Returns true if prepared. */
+    bool isActive() const noexcept { return active.load (std::memory_order_acquire); }
+
+    /** Returns the instance currently rendering. */
+    juce::AudioProcessor* getLive() const noexcept { return live.load (std::memory_order_acquire); }
+
+    /** Returns the instance being loaded in the background. */
+    juce::AudioProcessor* getSpare() const noexcept { return spare.load (std::memory_order_acquire); }
+
+    /** Returns the program the live instance has loaded or -1 if unknown. */
+    int getLiveProgram() const noexcept { return liveProgram.load (std::memory_order_acquire); }
+
+    /** Forget which program the live instance has, e.g. after its state was
+        set directly.
+     */
+    void invalidateLiveProgram() noexcept { liveProgram.store (-1, std::memory_order_release); }
+
+    /** Call on the owner's thread once it has taken ownership of the
+        instances after a swap. Until then the old live instance is left
+        alone and no further swap happens.
+     */
+    void handoverComplete() noexcept;
+
+    /** Request a program. Audio thread safe. Returns false if not active. */
+    bool requestProgram (int program) noexcept;
+
+    /** Render a block with the live instance, crossfading to the spare if the
+        requested program is loaded on it. Returns true if the instances were
+        swapped.
+     */
+    bool process (juce::AudioBuffer<float>& audio, juce::MidiBuffer& midi, bool bypassed) noexcept;
+
+private:
+    std::atomic<juce::AudioProcessor*> live, spare;
+    StateFunction getState;
+    std::atomic<bool> active { false };
+    std::atomic<int> requested { -1 }, liveProgram { -1 };
+    std::atomic<bool> handoverPending { false };
+    std::atomic<bool> jobQueued { false };
+    int spareProgram = -1;
+    juce::SpinLock spareLock;
+    juce::AudioBuffer<float> scratch;
+    juce::MidiBuffer scratchMidi;
+
+    /** Shared with queued jobs, which only load while it points here. */
+    struct Guard
+    {
+        juce::CriticalSection lock;
+        ProgramStandby* owner = nullptr;
+    };
+    std::shared_ptr<Guard> guard;
+
+    void handleAsyncUpdate() override;
+    void queueLoad();
+    void loadRequested();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProgramStandby)
+};
+
+} // namespace element
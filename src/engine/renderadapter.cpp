@@ -0,0 +1,39 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/renderadapter.hpp"
+
+namespace element {
+
+using namespace juce;
+
+void RenderAdapter::prepare (int numChannels, int renderBlockSize, bool fixedBlockSize)
+{
+    blockSize = jmax (1, renderBlockSize);
+    fixed = fixedBlockSize;
+    fill = 0;
+
+    const int numFrames = fixed ? blockSize : 1;
+    input.setSize (jmax (1, numChannels), numFrames);
+    output.setSize (jmax (1, numChannels), numFrames);
+    input.clear();
+    output.clear();
+
+    for (auto* buffer : { &midiBlock, &midiIn, &midiRendered, &midiOut })
+    {
+        buffer->clear();
+        buffer->ensureSize (2048);
+    }
+}
+
+void RenderAdapter::release()
+{
+    blockSize = fill = 0;
+    fixed = false;
+    input.setSize (1, 1);
+    output.setSize (1, 1);
+    for (auto* buffer : { &midiBlock, &midiIn, &midiRendered, &midiOut })
+        buffer->clear();
+}
+
+} // namespace element
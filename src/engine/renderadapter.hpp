@@ -0,0 +1,130 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/audio_basics.hpp>
+
+namespace element {
+
+/** Adapts arbitrarily sized host buffers to the block size graphs were
+    prepared with.
+
+    In split mode host buffers are rendered in place as consecutive
+    sub-blocks no larger than the render block size. MIDI is partitioned by
+    timestamp so each sub-block only sees its own events. There is no added
+    latency.
+
+    In fixed mode every render call gets exactly the render block size.
+    Input is collected until a full block is available, so output is
+    delayed by one render block.
+ */
+class RenderAdapter final
+{
+public:
+    RenderAdapter() = default;
+    ~RenderAdapter() = default;
+
+    /** Allocate for the given channel count and render block size. Not
+        realtime safe.
+     */
+    void prepare (int numChannels, int renderBlockSize, bool fixedBlockSize);
+
+    /** Free all buffers. */
+    void release();
+
+    /** Returns the block size renders are limited to. */
+    int getRenderBlockSize() const noexcept { return blockSize; }
+
+    /** Returns true if running with a fixed block size. */
+    bool isFixedBlockSize() const noexcept { return fixed; }
+
+    /** Returns the latency added by the adapter. */
+    int getLatencySamples() const noexcept { return fixed ? blockSize : 0; }
+
+    /** Render a host buffer, calling render for each internal block.
+        render is invoked as render (AudioBuffer<float>&, MidiBuffer&) and
+        must replace the MIDI buffer contents with its output.
+     */
+    template <class RenderFn>
+    void process (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi, RenderFn&& render)
+    {
+        const int numSamples = buffer.getNumSamples();
+        if (blockSize <= 0)
+        {
+            render (buffer, midi);
+            return;
+        }
+
+        if (! fixed)
+        {
+            if (numSamples <= blockSize)
+            {
+                render (buffer, midi);
+                return;
+            }
+
+            midiOut.clear();
+            for (int offset = 0; offset < numSamples; offset += blockSize)
+            {
+                const int length = juce::jmin (blockSize, numSamples - offset);
+                juce::AudioBuffer<float> sub (buffer.getArrayOfWritePointers(),
+                                              buffer.getNumChannels(),
+                                              offset,
+                                              length);
+                midiBlock.clear();
+                midiBlock.addEvents (midi, offset, length, -offset);
+                render (sub, midiBlock);
+                midiOut.addEvents (midiBlock, 0, length, offset);
+            }
+
+            midi.swapWith (midiOut);
+            return;
+        }
+
+        const int numChans = juce::jmin (buffer.getNumChannels(), input.getNumChannels());
+        midiOut.clear();
+
+        for (int pos = 0; pos < numSamples;)
+        {
+            const int length = juce::jmin (numSamples - pos, blockSize - fill);
+
+            for (int c = 0; c < numChans; ++c)
+            {
+                input.copyFrom (c, fill, buffer, c, pos, length);
+                buffer.copyFrom (c, pos, output, c, fill, length);
+            }
+            for (int c = numChans; c < buffer.getNumChannels(); ++c)
+                buffer.clear (c, pos, length);
+
+            midiIn.addEvents (midi, pos, length, fill - pos);
+            midiOut.addEvents (midiRendered, fill, length, pos - fill);
+
+            fill += length;
+            pos += length;
+
+            if (fill == blockSize)
+            {
+                juce::AudioBuffer<float> block (input.getArrayOfWritePointers(), numChans, blockSize);
+                render (block, midiIn);
+                std::swap (input, output);
+                midiRendered.swapWith (midiIn);
+                midiIn.clear();
+                fill = 0;
+            }
+        }
+
+        midi.swapWith (midiOut);
+    }
+
+private:
+    int blockSize = 0;
+    bool fixed = false;
+    int fill = 0;
+    juce::AudioBuffer<float> input, output;
+    juce::MidiBuffer midiBlock, midiIn, midiRendered, midiOut;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderAdapter)
+};
+
+} // namespace element
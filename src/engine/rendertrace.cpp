@@ -0,0 +1,233 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/rendertrace.hpp"
+
+namespace element {
+
+using namespace juce;
+
+struct RenderTrace::Ring
+{
+    Ring (int index_)
+        : index (index_), fifo (ringSize)
+    {
+        events.calloc ((size_t) ringSize);
+    }
+
+    bool push (const Event& event) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+        if (size1 + size2 < 1)
+            return false;
+        events[size1 > 0 ? start1 : start2] = event;
+        fifo.finishedWrite (1);
+        return true;
+    }
+
+    template <typename Fn>
+    void drain (Fn&& callback)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; ++i)
+            callback (events[start1 + i]);
+        for (int i = 0; i < size2; ++i)
+            callback (events[start2 + i]);
+        fifo.finishedRead (size1 + size2);
+    }
+
+    const int index;
+    AbstractFifo fifo;
+    HeapBlock<Event> events;
+};
+
+/** Hands a thread's ring back to the tracer when the thread exits. */
+struct RenderTrace::SlotClaim
+{
+    ~SlotClaim()
+    {
+        if (owner != nullptr && slot >= 0)
+            owner->releaseSlot (slot);
+    }
+
+    RenderTrace* owner = nullptr;
+    int slot = -1;
+};
+
+/** Time elapsed since construction before the calibration is kept. */
+static constexpr double calibrationSeconds = 0.25;
+
+RenderTrace::RenderTrace()
+{
+    for (auto& slot : slots)
+        slot.store (nullptr);
+    for (auto& claim : claimed)
+        claim.store (false);
+    originHiresTicks = Time::getHighResolutionTicks();
+    originTicks = readRenderTicks();
+}
+
+RenderTrace::~RenderTrace() {}
+
+double RenderTrace::getTicksPerSecond() const noexcept
+{
+#if JUCE_INTEL
+    const auto calibrated = ticksPerSecond.load (std::memory_order_relaxed);
+    if (calibrated > 0.0)
+        return calibrated;
+
+    const auto seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - originHiresTicks);
+    const auto ticks = readRenderTicks() - originTicks;
+    if (seconds <= 0.0 || ticks == 0)
+        return 1.0e9;
+
+    const auto estimate = (double) ticks / seconds;
+    if (seconds >= calibrationSeconds)
+        ticksPerSecond.store (estimate, std::memory_order_relaxed);
+    return estimate;
+#else
+    return (double) Time::getHighResolutionTicksPerSecond();
+#endif
+}
+
+RenderTrace& RenderTrace::getInstance()
+{
+    static RenderTrace instance;
+    return instance;
+}
+
+void RenderTrace::setEnabled (bool shouldBeEnabled)
+{
+    const ScopedLock sl (lock);
+    if (shouldBeEnabled && rings.isEmpty())
+    {
+        for (int i = 0; i < maxThreads; ++i)
+            slots[i].store (rings.add (new Ring (i)), std::memory_order_release);
+    }
+
+    enabled.store (shouldBeEnabled, std::memory_order_relaxed);
+}
+
+uint32 RenderTrace::registerLabel (const String& name)
+{
+    const ScopedLock sl (lock);
+    for (int i = 0; i < labels.size(); ++i)
+        if (labelKeys.getUnchecked (i) < 0 && labels[i] == name)
+            return (uint32) i;
+    labels.add (name);
+    labelKeys.add (-1);
+    return (uint32) labels.size() - 1;
+}
+
+uint32 RenderTrace::registerNode (uint32 graphId, uint32 nodeId, const String& name)
+{
+    const ScopedLock sl (lock);
+    const auto key = ((int64) graphId << 32) | (int64) nodeId;
+    const int index = labelKeys.indexOf (key);
+    if (index >= 0)
+    {
+        labels.set (index, name);
+        return (uint32) index;
+    }
+
+    labels.add (name);
+    labelKeys.add (key);
+    return (uint32) labels.size() - 1;
+}
+
+RenderTrace::Ring* RenderTrace::getRingForThisThread() noexcept
+{
+    thread_local SlotClaim claim;
+    if (claim.slot < 0)
+    {
+        for (int i = 0; i < maxThreads; ++i)
+        {
+            bool expected = false;
+            if (claimed[i].compare_exchange_strong (expected, true, std::memory_order_acquire))
+            {
+                claim.owner = this;
+                claim.slot = i;
+                break;
+            }
+        }
+
+        if (claim.slot < 0)
+            return nullptr;
+    }
+
+    return slots[claim.slot].load (std::memory_order_acquire);
+}
+
+void RenderTrace::releaseSlot (int slot) noexcept
+{
+    // publishes this thread's writes to the ring's next owner
+    claimed[slot].store (false, std::memory_order_release);
+}
+
+void RenderTrace::record (uint32 label, uint64 start, uint64 end) noexcept
+{
+    if (! isEnabled())
+        return;
+
+    auto* const ring = getRingForThisThread();
+    if (ring == nullptr || ! ring->push ({ label, start, end }))
+        dropped.fetch_add (1, std::memory_order_relaxed);
+}
+
+bool RenderTrace::writeChromeTrace (OutputStream& out)
+{
+    const ScopedLock sl (lock);
+    const double usPerTick = 1.0e6 / getTicksPerSecond();
+    bool first = true;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (auto* ring : rings)
+    {
+        ring->drain ([&] (const Event& ev) {
+            if (! first)
+                out << ",";
+            first = false;
+
+            const auto start = ev.start > originTicks ? ev.start - originTicks : 0;
+            const auto duration = ev.end > ev.start ? ev.end - ev.start : 0;
+            out << "{\"name\":" << JSON::toString (labels[(int) ev.label])
+                << ",\"cat\":\"render\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << ring->index
+                << ",\"ts\":" << String ((double) start * usPerTick, 3)
+                << ",\"dur\":" << String ((double) duration * usPerTick, 3);
+
+            const auto key = labelKeys[(int) ev.label];
+            if (key >= 0)
+                out << ",\"args\":{\"graph\":" << (int64) (key >> 32)
+                    << ",\"node\":" << (int64) (key & 0xffffffff) << "}";
+            out << "}";
+        });
+    }
+
+    out << "],\"otherData\":{\"droppedEvents\":" << dropped.exchange (0) << "}}";
+    out.flush();
+    return true;
+}
+
+bool RenderTrace::writeChromeTrace (const File& file)
+{
+    FileOutputStream out (file);
+    if (! out.openedOk())
+        return false;
+    out.setPosition (0);
+    out.truncate();
+    return writeChromeTrace (out) && out.getStatus().wasOk();
+}
+
+void RenderTrace::clear()
+{
+    const ScopedLock sl (lock);
+    for (auto* ring : rings)
+        ring->drain ([] (const Event&) {});
+    dropped.store (0);
+}
+
+} // namespace element
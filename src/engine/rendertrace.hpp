@@ -0,0 +1,146 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/core.hpp>
+
+#include <atomic>
+
+#if JUCE_INTEL
+#if JUCE_MSVC
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace element {
+
+/** Reads a cheap, monotonically increasing tick count for render timing.
+    Uses the CPU timestamp counter when available and falls back to JUCE's
+    high resolution ticks elsewhere.
+ */
+inline static juce::uint64 readRenderTicks() noexcept
+{
+#if JUCE_INTEL
+    return (juce::uint64) __rdtsc();
+#else
+    return (juce::uint64) juce::Time::getHighResolutionTicks();
+#endif
+}
+
+/** Collects timed render events from the audio thread(s) and writes them
+    out as a Chrome trace (also readable by Perfetto).
+
+    Each rendering thread claims its own single-producer ring on its first
+    event and hands it back when the thread exits. After that first event,
+    recording never locks or allocates. Rings are allocated when tracing is
+    enabled and live as long as the tracer.
+ */
+class RenderTrace final
+{
+public:
+    /** A single timed span */
+    struct Event
+    {
+        juce::uint32 label = 0;
+        juce::uint64 start = 0;
+        juce::uint64 end = 0;
+    };
+
+    /** Maximum number of threads which can record events. */
+    static constexpr int maxThreads = 16;
+
+    /** Number of events each thread can hold before they are exported. */
+    static constexpr int ringSize = 1 << 14;
+
+    ~RenderTrace();
+
+    /** Returns the shared tracer. */
+    static RenderTrace& getInstance();
+
+    /** Returns the number of render ticks per second.
+        The timestamp counter is calibrated against the time elapsed since
+        the tracer was created, so early calls return an estimate.
+     */
+    double getTicksPerSecond() const noexcept;
+
+    /** Converts a tick delta to seconds. */
+    double ticksToSeconds (juce::uint64 ticks) const noexcept { return (double) ticks / getTicksPerSecond(); }
+
+    /** Enable or disable event recording. Not realtime safe. */
+    void setEnabled (bool shouldBeEnabled);
+
+    /** Returns true if events are being recorded. */
+    bool isEnabled() const noexcept { return enabled.load (std::memory_order_relaxed); }
+
+    /** Returns an ID for the given label. Not realtime safe. */
+    juce::uint32 registerLabel (const juce::String& name);
+
+    /** Returns an ID for a node's events. Nodes are told apart by their
+        graph and node IDs, so nodes sharing a name get their own label and
+        re-registering a node updates its name. Not realtime safe.
+     */
+    juce::uint32 registerNode (juce::uint32 graphId, juce::uint32 nodeId, const juce::String& name);
+
+    /** Records an event on the calling thread's ring. Realtime safe.
+        Events are dropped when recording is disabled or the ring is full.
+     */
+    void record (juce::uint32 label, juce::uint64 start, juce::uint64 end) noexcept;
+
+    /** Returns the number of events dropped because a ring was full. */
+    int getNumDroppedEvents() const noexcept { return dropped.load (std::memory_order_relaxed); }
+
+    /** Drains all recorded events and writes Chrome trace JSON. The number
+        of dropped events is written to "otherData" and then reset.
+     */
+    bool writeChromeTrace (juce::OutputStream& output);
+
+    /** Drains all recorded events and writes Chrome trace JSON to file. */
+    bool writeChromeTrace (const juce::File& file);
+
+    /** Discards all recorded events. */
+    void clear();
+
+private:
+    RenderTrace();
+    struct Ring;
+
+    juce::CriticalSection lock;
+    juce::StringArray labels;
+    juce::Array<juce::int64> labelKeys;
+    juce::OwnedArray<Ring> rings;
+    std::atomic<Ring*> slots[maxThreads];
+    std::atomic<bool> claimed[maxThreads];
+    std::atomic<bool> enabled { false };
+    std::atomic<int> dropped { 0 };
+    mutable std::atomic<double> ticksPerSecond { 0.0 };
+    juce::uint64 originTicks = 0;
+    juce::int64 originHiresTicks = 0;
+
+    struct SlotClaim;
+    Ring* getRingForThisThread() noexcept;
+    void releaseSlot (int slot) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderTrace)
+};
+
+/** Records the lifetime of this object as a render event. */
+struct ScopedRenderTrace
+{
+    ScopedRenderTrace (juce::uint32 l) noexcept
+        : label (l), start (readRenderTicks()) {}
+
+    ~ScopedRenderTrace() noexcept
+    {
+        auto& trace = RenderTrace::getInstance();
+        if (trace.isEnabled())
+            trace.record (label, start, readRenderTicks());
+    }
+
+    const juce::uint32 label;
+    const juce::uint64 start;
+};
+
+} // namespace element
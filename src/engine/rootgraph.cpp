@@ -30,4 +30,16 @@ void RootGraph::setPlayConfigFor (const DeviceManager::AudioDeviceSetup& setup)
     setRenderDetails (setup.sampleRate, setup.bufferSize);
 }
 
+bool RootGraph::usesLiveAudioInput() const
+{
+    for (int i = getNumConnections(); --i >= 0;)
+    {
+        auto* const io = dynamic_cast<IONode*> (getNodeForId (getConnection (i)->sourceNode));
+        if (io != nullptr && io->getType() == IONode::audioInputNode)
+            return true;
+    }
+
+    return false;
+}
+
 } // namespace element
@@ -72,6 +72,14 @@ public:
      */
     inline constexpr int getEngineIndex() const noexcept { return engineIndex; }
 
+    /** Returns true if the audio input node feeds anything in this graph. */
+    bool usesLiveAudioInput() const;
+
+    /** Returns true if the engine stopped rendering this graph because it
+        isn't heard and its output tail has decayed.
+     */
+    inline bool isSleeping() const noexcept { return asleep; }
+
 private:
     friend class AudioEngine;
     friend struct RootGraphRender;
@@ -81,6 +89,8 @@ private:
     int midiProgram = -1;
     int engineIndex = -1;
     RenderMode renderMode = Parallel;
+    int silentSamples = 0;
+    bool asleep = false;
 };
 
 } // namespace element
@@ -0,0 +1,237 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "fileindex.hpp"
+#include "threadpools.hpp"
+
+namespace element {
+
+using namespace juce;
+
+namespace FileIndexTags {
+static const Identifier index ("fileindex");
+static const Identifier entry ("entry");
+static const Identifier version ("version");
+static const Identifier path ("path");
+static const Identifier modified ("modified");
+static const Identifier size ("size");
+static const int currentVersion = 1;
+} // namespace FileIndexTags
+
+FileIndex::FileIndex (const String& name, const File& cache, const String& wc, ParseFunction parseFunction)
+    : Thread (name),
+      cacheFile (cache),
+      wildcard (wc),
+      parse (std::move (parseFunction)),
+      entries (std::make_shared<const Entries>())
+{
+}
+
+FileIndex::~FileIndex()
+{
+    stop();
+}
+
+void FileIndex::setDirectories (const Array<File>& newDirectories)
+{
+    {
+        const ScopedLock sl (lock);
+        directories = newDirectories;
+    }
+    refresh();
+}
+
+void FileIndex::addDirectory (const File& directory)
+{
+    {
+        const ScopedLock sl (lock);
+        if (directories.contains (directory))
+            return;
+        directories.add (directory);
+    }
+    refresh();
+}
+
+Array<File> FileIndex::getDirectories() const
+{
+    const ScopedLock sl (lock);
+    return directories;
+}
+
+std::shared_ptr<const FileIndex::Entries> FileIndex::getEntries() const
+{
+    const ScopedLock sl (lock);
+    return entries;
+}
+
+void FileIndex::publish (std::shared_ptr<const Entries> newEntries)
+{
+    {
+        const ScopedLock sl (lock);
+        entries = std::move (newEntries);
+    }
+
+    sendChangeMessage();
+}
+
+void FileIndex::start (int pollIntervalMs)
+{
+    stop();
+    loadCache();
+    pollInterval = jmax (100, pollIntervalMs);
+    startThread (Thread::Priority::low);
+}
+
+void FileIndex::stop()
+{
+    stopThread (10000);
+}
+
+void FileIndex::refresh()
+{
+    notify();
+}
+
+bool FileIndex::scanNow()
+{
+    const ScopedLock sl (scanLock);
+    const auto current = getEntries();
+
+    std::map<String, const Entry*> existing;
+    for (const auto& entry : *current)
+        existing[entry.file.getFullPathName()] = &entry;
+
+    auto next = std::make_shared<Entries>();
+    next->reserve (current->size());
+    std::set<String> seen;
+    bool changed = false;
+
+    for (const auto& directory : getDirectories())
+    {
+        if (! directory.isDirectory())
+            continue;
+
+        for (const DirectoryEntry& item : RangedDirectoryIterator (directory, true, wildcard))
+        {
+            if (threadShouldExit())
+                return false;
+
+            const auto file = item.getFile();
+            const auto path = file.getFullPathName();
+            if (! seen.insert (path).second)
+                continue;
+
+            const auto modified = item.getModificationTime().toMilliseconds();
+            const auto size = item.getFileSize();
+            const auto found = existing.find (path);
+            if (found != existing.end() && found->second->modified == modified && found->second->size == size)
+            {
+                next->push_back (*found->second);
+                continue;
+            }
+
+            // unparsable files are kept too so they aren't parsed on every poll.
+            Entry entry;
+            entry.file = file;
+            entry.modified = modified;
+            entry.size = size;
+            entry.metadata = parse != nullptr ? parse (file) : ValueTree();
+            ++numParsed;
+            next->push_back (std::move (entry));
+            changed = true;
+        }
+    }
+
+    changed |= next->size() != current->size();
+    if (! changed)
+        return false;
+
+    std::sort (next->begin(), next->end(), [] (const Entry& a, const Entry& b) {
+        return a.file.getFullPathName() < b.file.getFullPathName();
+    });
+
+    publish (std::move (next));
+    saveCache();
+    return true;
+}
+
+bool FileIndex::loadCache()
+{
+    MemoryBlock data;
+    if (! cacheFile.existsAsFile() || ! cacheFile.loadFileAsData (data) || data.getSize() <= 0)
+        return false;
+
+    const auto tree = ValueTree::readFromGZIPData (data.getData(), data.getSize());
+    if (! tree.hasType (FileIndexTags::index)
+        || (int) tree.getProperty (FileIndexTags::version, 0) != FileIndexTags::currentVersion)
+        return false;
+
+    auto loaded = std::make_shared<Entries>();
+    loaded->reserve ((size_t) tree.getNumChildren());
+    for (const auto& child : tree)
+    {
+        const auto path = child.getProperty (FileIndexTags::path).toString();
+        if (! File::isAbsolutePath (path))
+            continue;
+
+        Entry entry;
+        entry.file = File (path);
+        entry.modified = (int64) child.getProperty (FileIndexTags::modified, 0);
+        entry.size = (int64) child.getProperty (FileIndexTags::size, 0);
+        if (child.getNumChildren() > 0)
+            entry.metadata = child.getChild (0).createCopy();
+        loaded->push_back (std::move (entry));
+    }
+
+    publish (std::move (loaded));
+    return true;
+}
+
+bool FileIndex::saveCache() const
+{
+    if (cacheFile == File())
+        return false;
+
+    ValueTree tree (FileIndexTags::index);
+    tree.setProperty (FileIndexTags::version, FileIndexTags::currentVersion, nullptr);
+    for (const auto& entry : *getEntries())
+    {
+        ValueTree child (FileIndexTags::entry);
+        child.setProperty (FileIndexTags::path, entry.file.getFullPathName(), nullptr)
+            .setProperty (FileIndexTags::modified, entry.modified, nullptr)
+            .setProperty (FileIndexTags::size, entry.size, nullptr);
+        if (entry.metadata.isValid())
+            child.appendChild (entry.metadata.createCopy(), nullptr);
+        tree.appendChild (child, nullptr);
+    }
+
+    if (! cacheFile.getParentDirectory().createDirectory())
+        return false;
+
+    TemporaryFile temp (cacheFile);
+    {
+        FileOutputStream output (temp.getFile());
+        if (! output.openedOk())
+            return false;
+        GZIPCompressorOutputStream gzip (output, 6);
+        tree.writeToStream (gzip);
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+void FileIndex::run()
+{
+    ThreadPools::getInstance().applyToCurrentThread (ThreadPools::io);
+    while (! threadShouldExit())
+    {
+        scanNow();
+        wait (pollInterval);
+    }
+}
+
+} // namespace element
@@ -0,0 +1,106 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/juce/core.hpp>
+#include <element/juce/data_structures.hpp>
+#include <element/juce/events.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace element {
+
+/** A persistent index of file metadata kept up to date on a background thread.
+
+    Files matching a wildcard in the watched directories are parsed once and
+    only parsed again when their size or modification time changes. The
+    metadata is saved to a cache file so the next launch starts without
+    parsing anything. A change message is sent whenever entries were added,
+    updated or removed.
+
+    JUCE has no portable file system notifications, so the thread polls file
+    sizes and times, which is much cheaper than parsing.
+ */
+class FileIndex : public juce::ChangeBroadcaster,
+                  private juce::Thread
+{
+public:
+    /** Returns the metadata for a file or an invalid tree to skip it. Called
+        on the index thread.
+     */
+    using ParseFunction = std::function<juce::ValueTree (const juce::File&)>;
+
+    struct Entry
+    {
+        juce::File file;
+        juce::int64 modified = 0;
+        juce::int64 size = 0;
+        juce::ValueTree metadata;
+    };
+
+    using Entries = std::vector<Entry>;
+
+    FileIndex (const juce::String& name, const juce::File& cacheFile,
+               const juce::String& wildcard, ParseFunction parse);
+    ~FileIndex() override;
+
+    /** Set the directories to watch. Subdirectories are included. */
+    void setDirectories (const juce::Array<juce::File>& directories);
+
+    /** Add a directory to watch. */
+    void addDirectory (const juce::File& directory);
+
+    /** Returns the watched directories. */
+    juce::Array<juce::File> getDirectories() const;
+
+    /** Load the cache file and start the background thread.
+        @param pollIntervalMs   How often the directories are checked
+     */
+    void start (int pollIntervalMs = 3000);
+
+    /** Stop the background thread. */
+    void stop();
+
+    /** Ask the background thread to rescan now. Doesn't block. */
+    void refresh();
+
+    /** Rescan on the calling thread. Returns true if anything changed. */
+    bool scanNow();
+
+    /** Returns the current entries. Cheap, the array is shared until the next
+        change.
+     */
+    std::shared_ptr<const Entries> getEntries() const;
+
+    /** Returns the number of files parsed since construction. */
+    int getNumParsed() const noexcept { return numParsed.load(); }
+
+    /** Loads entries from the cache file. Returns true if it was read. */
+    bool loadCache();
+
+    /** Writes entries to the cache file. */
+    bool saveCache() const;
+
+private:
+    const juce::File cacheFile;
+    const juce::String wildcard;
+    ParseFunction parse;
+
+    juce::CriticalSection lock;
+    juce::Array<juce::File> directories;
+    std::shared_ptr<const Entries> entries;
+
+    juce::CriticalSection scanLock;
+    std::atomic<int> numParsed { 0 };
+    int pollInterval = 3000;
+
+    void run() override;
+    void publish (std::shared_ptr<const Entries>);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FileIndex)
+};
+
+} // namespace element
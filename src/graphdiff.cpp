@@ -0,0 +1,410 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include <element/context.hpp>
+#include <element/engine.hpp>
+#include <element/node.hpp>
+#include <element/services.hpp>
+
+#include "engine/graphnode.hpp"
+#include "graphdiff.hpp"
+
+namespace element {
+
+using namespace juce;
+
+namespace {
+static bool isStateProperty (const Identifier& name)
+{
+    return name == tags::state || name == tags::programState;
+}
+
+/** Properties the engine sets at runtime, never part of an edit. */
+static bool isRuntimeProperty (const Identifier& name)
+{
+    return name == tags::object || name == tags::updater || name == tags::offline
+           || name == tags::placeholder || name == tags::missing;
+}
+
+static MemoryBlock compress (const void* data, size_t size)
+{
+    MemoryBlock block;
+    if (size > 0)
+    {
+        MemoryOutputStream mo (block, false);
+        GZIPCompressorOutputStream gz (mo, 9);
+        gz.write (data, size);
+    }
+    return block;
+}
+
+static MemoryBlock decompress (const MemoryBlock& block)
+{
+    MemoryBlock result;
+    if (block.getSize() > 0)
+    {
+        MemoryInputStream mi (block, false);
+        GZIPDecompressorInputStream gz (mi);
+        gz.readIntoMemoryBlock (result);
+    }
+    return result;
+}
+
+static MemoryBlock decodeState (const var& value)
+{
+    MemoryBlock block;
+    if (value.isString())
+        block.fromBase64Encoding (value.toString());
+    return block;
+}
+
+/** Swaps base64 plugin state for binary or back, recursively. */
+static void convertStates (ValueTree tree, bool toBinary)
+{
+    for (const auto& name : { tags::state, tags::programState })
+    {
+        const auto value = tree.getProperty (name);
+        if (toBinary && value.isString())
+            tree.setProperty (name, decodeState (value), nullptr);
+        else if (! toBinary && value.isBinaryData())
+            tree.setProperty (name, value.getBinaryData()->toBase64Encoding(), nullptr);
+    }
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+        convertStates (tree.getChild (i), toBinary);
+}
+} // namespace
+
+//=============================================================================
+StateDelta::StateDelta (const MemoryBlock& before, const MemoryBlock& after)
+    : beforeSize (before.getSize()), afterSize (after.getSize())
+{
+    const auto* a = static_cast<const uint8*> (before.getData());
+    const auto* b = static_cast<const uint8*> (after.getData());
+    const auto common = jmin (beforeSize, afterSize);
+
+    while (prefix < common && a[prefix] == b[prefix])
+        ++prefix;
+    while (suffix < common - prefix && a[beforeSize - 1 - suffix] == b[afterSize - 1 - suffix])
+        ++suffix;
+
+    beforeSpan = compress (a + prefix, beforeSize - prefix - suffix);
+    afterSpan = compress (b + prefix, afterSize - prefix - suffix);
+}
+
+bool StateDelta::apply (const MemoryBlock& from, MemoryBlock& result, bool forward) const
+{
+    if (from.getSize() != (forward ? beforeSize : afterSize))
+        return false;
+
+    const auto span = decompress (forward ? afterSpan : beforeSpan);
+    const auto* src = static_cast<const uint8*> (from.getData());
+    result.setSize (prefix + span.getSize() + suffix, false);
+    auto* dst = static_cast<uint8*> (result.getData());
+
+    memcpy (dst, src, prefix);
+    memcpy (dst + prefix, span.getData(), span.getSize());
+    memcpy (dst + prefix + span.getSize(), src + from.getSize() - suffix, suffix);
+    return true;
+}
+
+//=============================================================================
+NodeSnapshot::NodeSnapshot (const ValueTree& node)
+{
+    auto copy = node.createCopy();
+    Node::sanitizeRuntimeProperties (copy, true);
+    convertStates (copy, true);
+
+    MemoryOutputStream mo (data, false);
+    GZIPCompressorOutputStream gz (mo, 9);
+    copy.writeToStream (gz);
+}
+
+ValueTree NodeSnapshot::restore() const
+{
+    MemoryInputStream mi (data, false);
+    GZIPDecompressorInputStream gz (mi);
+    auto tree = ValueTree::readFromStream (gz);
+    convertStates (tree, false);
+    return tree;
+}
+
+//=============================================================================
+bool GraphDiff::ArcKey::operator< (const ArcKey& o) const noexcept
+{
+    return std::tie (sourceNode, sourcePort, destNode, destPort)
+           < std::tie (o.sourceNode, o.sourcePort, o.destNode, o.destPort);
+}
+
+bool GraphDiff::isEmpty() const noexcept
+{
+    return addedNodes.empty() && removedNodes.empty() && addedArcs.empty()
+           && removedArcs.empty() && properties.empty();
+}
+
+size_t GraphDiff::getSize() const noexcept
+{
+    size_t size = sizeof (GraphDiff);
+    for (const auto* changes : { &addedNodes, &removedNodes })
+        for (const auto& change : *changes)
+            size += sizeof (NodeChange) + change.snapshot.getSize();
+    size += (addedArcs.size() + removedArcs.size()) * sizeof (ArcChange);
+    for (const auto& change : properties)
+        size += sizeof (PropertyChange) + change.state.getSize();
+    return size;
+}
+
+void GraphDiff::apply (EngineService& engine, Session& session, bool forward) const
+{
+    // every graph touched rebuilds once, after all of it
+    const GraphNode::ScopedBatch batch;
+
+    auto connect = [&] (const ArcChange& change, bool add) {
+        const auto graph = session.findNodeById (Uuid (change.graph));
+        if (! graph.isGraph())
+            return;
+        const auto& a = change.arc;
+        if (add)
+            engine.addConnection (a.sourceNode, a.sourcePort, a.destNode, a.destPort, graph);
+        else
+            engine.removeConnection (a.sourceNode, a.sourcePort, a.destNode, a.destPort, graph);
+    };
+
+    if (forward)
+    {
+        for (const auto& change : removedArcs)
+            connect (change, false);
+        for (const auto& change : removedNodes)
+            engine.removeNode (Uuid (change.node));
+        for (const auto& change : addedNodes)
+            addNode (engine, session, change);
+        for (const auto& change : addedArcs)
+            connect (change, true);
+        for (const auto& change : properties)
+            setProperty (session, change, true);
+    }
+    else
+    {
+        for (const auto& change : addedArcs)
+            connect (change, false);
+        for (auto it = addedNodes.rbegin(); it != addedNodes.rend(); ++it)
+            engine.removeNode (Uuid (it->node));
+        for (const auto& change : removedNodes)
+            addNode (engine, session, change);
+        for (const auto& change : removedArcs)
+            connect (change, true);
+        for (auto it = properties.rbegin(); it != properties.rend(); ++it)
+            setProperty (session, *it, false);
+    }
+}
+
+void GraphDiff::addNode (EngineService& engine, Session& session, const NodeChange& change) const
+{
+    const auto graph = session.findNodeById (Uuid (change.graph));
+    if (! graph.isGraph())
+        return;
+
+    const Node node (change.snapshot.restore(), false);
+    auto created = engine.addNode (node, graph, ConnectionBuilder());
+    // the graph manager drops coordinates from nodes it adds
+    if (created.isValid() && node.hasProperty (tags::relativeX))
+        created.setRelativePosition ((double) node.getProperty (tags::relativeX),
+                                     (double) node.getProperty (tags::relativeY));
+}
+
+void GraphDiff::setProperty (Session& session, const PropertyChange& change, bool forward) const
+{
+    auto node = session.findNodeById (Uuid (change.node));
+    if (! node.isValid())
+        return;
+
+    if (isStateProperty (change.name))
+    {
+        MemoryBlock state;
+        if (! change.state.apply (decodeState (node.getProperty (change.name)), state, forward))
+        {
+            DBG ("[element] plugin state diverged from undo history: " << node.getName());
+            return;
+        }
+
+        node.setProperty (change.name, state.toBase64Encoding());
+        node.restorePluginState();
+        return;
+    }
+
+    const auto& value = forward ? change.after : change.before;
+    if (value.isVoid())
+        node.data().removeProperty (change.name, nullptr);
+    else
+        node.setProperty (change.name, value);
+}
+
+//=============================================================================
+void GraphDiff::Recorder::Index::add (const Node& graph)
+{
+    const auto graphId = graph.getUuidString();
+    auto& graphArcs = arcs[graphId];
+    const auto arcsTree = graph.getArcsValueTree();
+    for (int i = 0; i < arcsTree.getNumChildren(); ++i)
+    {
+        const auto arc = arcsTree.getChild (i);
+        graphArcs.insert ({ (uint32) (int) arc[tags::sourceNode], (uint32) (int) arc[tags::sourcePort],
+                            (uint32) (int) arc[tags::destNode], (uint32) (int) arc[tags::destPort] });
+    }
+
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+    {
+        const auto node = graph.getNode (i);
+        nodes[node.getUuidString()] = { node.data(), graphId, node.data().getProperties() };
+        if (node.isGraph())
+            add (node);
+    }
+}
+
+GraphDiff::Recorder::Recorder (const Session& s)
+    : session (s), root (s.getValueTree())
+{
+    for (int i = 0; i < session.getNumGraphs(); ++i)
+        before.add (session.getGraph (i));
+    root.addListener (this);
+}
+
+GraphDiff::Recorder::~Recorder()
+{
+    root.removeListener (this);
+}
+
+void GraphDiff::Recorder::valueTreeChildRemoved (ValueTree& parent, ValueTree& child, int)
+{
+    // save the state of removed plugins while they still exist
+    if (parent.hasType (tags::nodes) && child.hasType (types::Node))
+    {
+        Node node (child, false);
+        if (node.getObject() != nullptr)
+            node.savePluginState();
+    }
+}
+
+std::unique_ptr<GraphDiff> GraphDiff::Recorder::finish()
+{
+    root.removeListener (this);
+
+    Index after;
+    for (int i = 0; i < session.getNumGraphs(); ++i)
+        after.add (session.getGraph (i));
+
+    auto diff = std::make_unique<GraphDiff>();
+
+    // nodes inside added or removed graphs travel with their graph
+    for (const auto& [uuid, entry] : before.nodes)
+        if (after.nodes.count (uuid) == 0 && after.arcs.count (entry.graph) > 0)
+            diff->removedNodes.push_back ({ entry.graph, uuid, NodeSnapshot (entry.tree) });
+
+    for (const auto& [uuid, entry] : after.nodes)
+    {
+        if (before.nodes.count (uuid) == 0 && before.arcs.count (entry.graph) > 0)
+        {
+            Node node (entry.tree, false);
+            node.savePluginState();
+            diff->addedNodes.push_back ({ entry.graph, uuid, NodeSnapshot (entry.tree) });
+        }
+    }
+
+    for (const auto& [uuid, entry] : after.nodes)
+    {
+        const auto found = before.nodes.find (uuid);
+        if (found == before.nodes.end())
+            continue;
+
+        const auto& oldProps = found->second.properties;
+        const auto& newProps = entry.tree.getProperties();
+        auto compare = [&] (const Identifier& name) {
+            if (isRuntimeProperty (name))
+                return;
+            const auto* oldValue = oldProps.getVarPointer (name);
+            const auto* newValue = newProps.getVarPointer (name);
+            const var beforeValue = oldValue != nullptr ? *oldValue : var();
+            const var afterValue = newValue != nullptr ? *newValue : var();
+            if (beforeValue == afterValue)
+                return;
+
+            if (isStateProperty (name))
+                diff->properties.push_back ({ uuid, name, {}, {}, StateDelta (decodeState (beforeValue), decodeState (afterValue)) });
+            else
+                diff->properties.push_back ({ uuid, name, beforeValue, afterValue, {} });
+        };
+
+        for (int i = 0; i < newProps.size(); ++i)
+            compare (newProps.getName (i));
+        for (int i = 0; i < oldProps.size(); ++i)
+            if (! newProps.contains (oldProps.getName (i)))
+                compare (oldProps.getName (i));
+    }
+
+    for (const auto& [graph, arcs] : after.arcs)
+    {
+        const auto found = before.arcs.find (graph);
+        if (found == before.arcs.end())
+            continue;
+        for (const auto& arc : arcs)
+            if (found->second.count (arc) == 0)
+                diff->addedArcs.push_back ({ graph, arc });
+        for (const auto& arc : found->second)
+            if (arcs.count (arc) == 0)
+                diff->removedArcs.push_back ({ graph, arc });
+    }
+
+    return diff;
+}
+
+//=============================================================================
+GraphDiffAction::GraphDiffAction (Services& a, Edits e)
+    : app (a), edits (std::move (e))
+{
+}
+
+GraphDiffAction::~GraphDiffAction() {}
+
+bool GraphDiffAction::perform()
+{
+    auto session = app.context().session();
+    auto* engine = app.find<EngineService>();
+    if (session == nullptr || engine == nullptr)
+        return false;
+
+    if (diff != nullptr)
+    {
+        diff->apply (*engine, *session, true);
+        return true;
+    }
+
+    bool performed = false;
+    {
+        const GraphNode::ScopedBatch batch;
+        GraphDiff::Recorder recorder (*session);
+        for (const auto& edit : edits)
+            performed = edit() || performed;
+        diff = recorder.finish();
+    }
+
+    // the edits held copies of what they changed, the diff is all undo needs
+    edits.clear();
+    return performed && ! diff->isEmpty();
+}
+
+bool GraphDiffAction::undo()
+{
+    auto session = app.context().session();
+    auto* engine = app.find<EngineService>();
+    if (diff == nullptr || session == nullptr || engine == nullptr)
+        return false;
+    diff->apply (*engine, *session, false);
+    return true;
+}
+
+int GraphDiffAction::getSizeInUnits()
+{
+    return diff != nullptr ? jmax (1, (int) (diff->getSize() / 1024)) : 1;
+}
+
+} // namespace element
@@ -0,0 +1,178 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include <element/juce/data_structures.hpp>
+#include <element/session.hpp>
+
+namespace element {
+
+class EngineService;
+class Services;
+
+/** A reversible change to a block of bytes, like a plugin's state.
+
+    Only the span between the common prefix and suffix of both versions is
+    kept, gzipped, so small edits to large states stay small.
+ */
+class StateDelta final
+{
+public:
+    StateDelta() = default;
+    StateDelta (const juce::MemoryBlock& before, const juce::MemoryBlock& after);
+
+    /** Rebuilds the after bytes from the before bytes when forward, or the
+        before bytes from the after bytes. Returns false if from isn't the
+        side this delta was made against.
+     */
+    bool apply (const juce::MemoryBlock& from, juce::MemoryBlock& result, bool forward) const;
+
+    /** Returns the number of bytes held. */
+    size_t getSize() const noexcept { return beforeSpan.getSize() + afterSpan.getSize(); }
+
+private:
+    size_t prefix = 0, suffix = 0;
+    size_t beforeSize = 0, afterSize = 0;
+    juce::MemoryBlock beforeSpan, afterSpan;
+};
+
+/** A compressed copy of a node's model, runtime properties removed and
+    plugin state stored as binary.
+ */
+class NodeSnapshot final
+{
+public:
+    NodeSnapshot() = default;
+    explicit NodeSnapshot (const juce::ValueTree& node);
+
+    /** Returns a new tree with the node as it was. */
+    juce::ValueTree restore() const;
+
+    /** Returns the number of bytes held. */
+    size_t getSize() const noexcept { return data.getSize(); }
+
+private:
+    juce::MemoryBlock data;
+};
+
+/** The node, arc and property changes an edit made to a session's graphs.
+
+    Undo history keeps these instead of copies of the graphs. Record one by
+    creating a Recorder before the edit and calling finish() after it.
+    Applying a diff in either direction rebuilds each graph it touches once.
+ */
+class GraphDiff final
+{
+public:
+    class Recorder;
+
+    /** Returns true if the edit changed nothing. */
+    bool isEmpty() const noexcept;
+
+    /** Returns the number of bytes held. */
+    size_t getSize() const noexcept;
+
+    /** Redo the changes when forward, otherwise undo them. */
+    void apply (EngineService& engine, Session& session, bool forward) const;
+
+private:
+    struct ArcKey
+    {
+        juce::uint32 sourceNode, sourcePort, destNode, destPort;
+        bool operator< (const ArcKey& o) const noexcept;
+    };
+
+    struct NodeChange
+    {
+        juce::String graph, node;
+        NodeSnapshot snapshot;
+    };
+
+    struct ArcChange
+    {
+        juce::String graph;
+        ArcKey arc;
+    };
+
+    struct PropertyChange
+    {
+        juce::String node;
+        juce::Identifier name;
+        juce::var before, after; ///< void for plugin state, which uses the delta
+        StateDelta state;
+    };
+
+    std::vector<NodeChange> addedNodes, removedNodes;
+    std::vector<ArcChange> addedArcs, removedArcs;
+    std::vector<PropertyChange> properties;
+
+    void addNode (EngineService&, Session&, const NodeChange&) const;
+    void setProperty (Session&, const PropertyChange&, bool forward) const;
+};
+
+/** Watches a session while an edit runs. */
+class GraphDiff::Recorder final : private juce::ValueTree::Listener
+{
+public:
+    explicit Recorder (const Session& session);
+    ~Recorder() override;
+
+    /** Returns the changes since this was created. */
+    std::unique_ptr<GraphDiff> finish();
+
+private:
+    struct NodeEntry
+    {
+        juce::ValueTree tree;
+        juce::String graph;
+        juce::NamedValueSet properties;
+    };
+
+    struct Index
+    {
+        std::map<juce::String, NodeEntry> nodes;
+        std::map<juce::String, std::set<ArcKey>> arcs;
+        void add (const Node& graph);
+    };
+
+    const Session& session;
+    juce::ValueTree root;
+    Index before;
+
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int) override;
+};
+
+/** Performs a message's edits once, then keeps only their GraphDiff for
+    undo and redo.
+ */
+class GraphDiffAction final : public juce::UndoableAction
+{
+public:
+    /** Changes the session once. Returns true if it did anything. */
+    using Edit = std::function<bool()>;
+    using Edits = std::vector<Edit>;
+
+    GraphDiffAction (Services& app, Edits edits);
+    ~GraphDiffAction() override;
+
+    bool perform() override;
+    bool undo() override;
+
+    /** UndoManager limits history in these units, one per KiB held. */
+    int getSizeInUnits() override;
+
+private:
+    Services& app;
+    Edits edits;
+    std::unique_ptr<GraphDiff> diff;
+};
+
+} // namespace element
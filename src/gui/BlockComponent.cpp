@@ -234,6 +234,19 @@ void BlockComponent::handleAsyncUpdate()
     repaint();
 }
 
+void BlockComponent::updateCpuLoad()
+{
+    if (node.isIONode())
+        return;
+
+    ProcessorPtr obj = node.getObject();
+    const int tenths = obj != nullptr ? roundToInt (obj->getCpuLoad() * 1000.f) : 0;
+    if (tenths == cpuLoadTenths)
+        return;
+    cpuLoadTenths = tenths;
+    repaint();
+}
+
 void BlockComponent::buttonClicked (Button* b)
 {
     if (! isEnabled())
@@ -458,9 +471,9 @@ void BlockComponent::mouseDrag (const MouseEvent& e)
 
         if (hasMoved)
         {
-            for (int i = 0; i < panel->getNumChildComponents(); ++i)
+            for (const auto& nodeId : panel->selectedNodes)
             {
-                auto* block = dynamic_cast<BlockComponent*> (panel->getChildComponent (i));
+                auto* block = panel->getComponentForFilter (nodeId);
                 if (block == nullptr || block == this || ! block->isSelected())
                     continue;
 
@@ -690,6 +703,15 @@ void BlockComponent::paint (Graphics& g)
         }
     }
 
+    if (cpuLoadTenths > 0 && (displayMode == Normal || displayMode == Embed))
+    {
+        String load (cpuLoadTenths / 10);
+        load << "." << (cpuLoadTenths % 10) << "%";
+        g.setColour (Colours::black.withAlpha (0.6f));
+        g.setFont (Font (9.f));
+        g.drawText (load, box.reduced (4, 2), Justification::bottomLeft, false);
+    }
+
     if (mouseInCornerResize)
     {
         auto cbox = getCornerResizeBox();
@@ -795,7 +817,7 @@ void BlockComponent::update (const bool doPosition, const bool forcePins)
 
     if (! node.data().getParent().hasType (tags::nodes))
     {
-        delete this;
+        ged->removeBlock (this);
         return;
     }
 
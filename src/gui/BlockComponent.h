@@ -294,6 +294,7 @@ private:
 
     DisplayMode displayMode { Normal };
     bool selected { false };
+    int cpuLoadTenths { 0 };
 
     void changeListenerCallback (ChangeBroadcaster*) override;
 
@@ -330,6 +331,10 @@ private:
     void handleAsyncUpdate() override;
     void valueChanged (Value& value) override;
 
+    /** Repaints if the node's CPU load changed. The graph editor calls this
+        for every block from one timer. */
+    void updateCpuLoad();
+
     void addDisplaySubmenu (PopupMenu& menuToAddTo);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BlockComponent);
@@ -87,6 +87,36 @@ private:
 };
 
 //=============================================================================
+static void buildCablePaths (Path& linePath, Path& hitPath, float x1, float y1, float x2, float y2, bool vertical)
+{
+    linePath.clear();
+    linePath.startNewSubPath (x1, y1);
+
+    if (vertical)
+    {
+        linePath.cubicTo (x1, y1 + (y2 - y1) * 0.33f, x2, y1 + (y2 - y1) * 0.66f, x2, y2);
+    }
+    else
+    {
+        linePath.cubicTo (x1 + (x2 - x1) * 0.33f, y1, x1 + (x2 - x1) * 0.66f, y2, x2, y2);
+    }
+
+    PathStrokeType wideStroke (8.0f);
+    wideStroke.createStrokedPath (hitPath, linePath);
+
+    PathStrokeType stroke (2.5f);
+    stroke.createStrokedPath (linePath, linePath);
+    linePath.setUsingNonZeroWinding (true);
+}
+
+static Colour getCableColour (bool highlighted)
+{
+    auto c = Colours::black.brighter();
+    return highlighted ? c.brighter (0.2f) : c;
+}
+
+//=============================================================================
+/** The cable being dragged. Patched cables are painted by the editor. */
 class ConnectorComponent : public Component,
                            public SettableTooltipClient
 {
@@ -185,10 +215,7 @@ public:
 
     void paint (Graphics& g) override
     {
-        auto c = Colours::black.brighter();
-        if (hover || dragging)
-            c = c.brighter (0.2f);
-        g.setColour (c);
+        g.setColour (getCableColour (hover || dragging));
         g.fillPath (linePath);
     }
 
@@ -270,49 +297,7 @@ public:
         lastOutputX = x2;
         lastOutputY = y2;
 
-        x1 -= getX();
-        y1 -= getY();
-        x2 -= getX();
-        y2 -= getY();
-
-        linePath.clear();
-        linePath.startNewSubPath (x1, y1);
-        const bool vertical = getGraphPanel()->isLayoutVertical();
-
-        if (vertical)
-        {
-            linePath.cubicTo (x1, y1 + (y2 - y1) * 0.33f, x2, y1 + (y2 - y1) * 0.66f, x2, y2);
-        }
-        else
-        {
-            linePath.cubicTo (x1 + (x2 - x1) * 0.33f, y1, x1 + (x2 - x1) * 0.66f, y2, x2, y2);
-        }
-
-        PathStrokeType wideStroke (8.0f);
-        wideStroke.createStrokedPath (hitPath, linePath);
-
-        PathStrokeType stroke (2.5f);
-        stroke.createStrokedPath (linePath, linePath);
-
-        const bool showArrow = false;
-
-        if (showArrow)
-        {
-            const float arrowW = 5.0f;
-            const float arrowL = 4.0f;
-
-            Path arrow;
-            arrow.addTriangle (-arrowL, arrowW, -arrowL, -arrowW, arrowL, 0.0f);
-
-            arrow.applyTransform (AffineTransform()
-                                      .rotated (MathConstants<float>::pi * 0.5f - (float) atan2 (x2 - x1, y2 - y1))
-                                      .translated ((x1 + x2) * 0.5f,
-                                                   (y1 + y2) * 0.5f));
-
-            linePath.addPath (arrow);
-        }
-
-        linePath.setUsingNonZeroWinding (true);
+        buildCablePaths (linePath, hitPath, x1 - getX(), y1 - getY(), x2 - getX(), y2 - getY(), getGraphPanel()->isLayoutVertical());
     }
 
     uint32 sourceFilterID { EL_INVALID_PORT },
@@ -346,18 +331,14 @@ private:
 //=============================================================================
 void GraphEditorComponent::SelectedNodes::itemSelected (uint32 nodeId)
 {
-    for (int i = 0; i < editor.getNumChildComponents(); ++i)
-        if (auto* block = dynamic_cast<BlockComponent*> (editor.getChildComponent (i)))
-            if (nodeId == block->node.getNodeId())
-                block->setSelectedInternal (true);
+    if (auto* block = editor.getComponentForFilter (nodeId))
+        block->setSelectedInternal (true);
 }
 
 void GraphEditorComponent::SelectedNodes::itemDeselected (uint32 nodeId)
 {
-    for (int i = 0; i < editor.getNumChildComponents(); ++i)
-        if (auto* block = dynamic_cast<BlockComponent*> (editor.getChildComponent (i)))
-            if (nodeId == block->node.getNodeId())
-                block->setSelectedInternal (false);
+    if (auto* block = editor.getComponentForFilter (nodeId))
+        block->setSelectedInternal (false);
 }
 
 //=============================================================================
@@ -368,15 +349,18 @@ GraphEditorComponent::GraphEditorComponent()
     factory.reset (new DefaultBlockFactory (*this));
     setOpaque (true);
     data.addListener (this);
+    // one timer refreshes the CPU load of every block
+    startTimerHz (4);
 }
 
 GraphEditorComponent::~GraphEditorComponent()
 {
+    stopTimer();
     data.removeListener (this);
     graph = Node();
     data = ValueTree();
     draggingConnector = nullptr;
-    deleteAllChildren();
+    deleteAllBlocksAndCables();
 
     factory.reset();
 }
@@ -396,7 +380,7 @@ void GraphEditorComponent::setNode (const Node& n)
 
     if (draggingConnector)
         removeChildComponent (draggingConnector.get());
-    deleteAllChildren();
+    deleteAllBlocksAndCables();
     updateComponents();
     if (draggingConnector)
         addAndMakeVisible (draggingConnector.get());
@@ -414,13 +398,33 @@ void GraphEditorComponent::setVerticalLayout (const bool isVertical)
         graph.setProperty ("vertical", verticalLayout);
 
     draggingConnector = nullptr;
-    deleteAllChildren();
+    deleteAllBlocksAndCables();
     updateComponents();
 }
 
 void GraphEditorComponent::paint (Graphics& g)
 {
     g.fillAll (findColour (Style::contentBackgroundColorId));
+
+    // one fill for every cable in the dirty area, under the blocks
+    const auto clip = g.getClipBounds();
+    Path batch;
+    for (const auto& [key, cable] : cables)
+        if (cable.visible && cable.bounds.intersects (clip) && hoverCable != key)
+            batch.addPath (cable.linePath);
+
+    g.setColour (getCableColour (false));
+    g.fillPath (batch);
+
+    if (hoverCable)
+    {
+        auto iter = cables.find (*hoverCable);
+        if (iter != cables.end() && iter->second.visible)
+        {
+            g.setColour (getCableColour (true));
+            g.fillPath (iter->second.linePath);
+        }
+    }
 }
 
 void GraphEditorComponent::mouseDown (const MouseEvent& e)
@@ -642,20 +646,76 @@ void GraphEditorComponent::mouseDown (const MouseEvent& e)
     }
     else
     {
-        addAndMakeVisible (lasso);
-        lasso.beginLasso (e, this);
+        pressedCable = findCableAt (e.getPosition());
+        draggingCable = false;
+        if (! pressedCable)
+        {
+            addAndMakeVisible (lasso);
+            lasso.beginLasso (e, this);
+        }
     }
 }
 
 void GraphEditorComponent::mouseUp (const MouseEvent& e)
 {
+    if (pressedCable)
+    {
+        pressedCable.reset();
+        if (draggingCable)
+            endDraggingConnector (e);
+        draggingCable = false;
+        return;
+    }
+
     lasso.endLasso();
     removeChildComponent (&lasso);
 }
 
 void GraphEditorComponent::mouseDrag (const MouseEvent& e)
 {
-    lasso.dragLasso (e);
+    if (! pressedCable)
+    {
+        lasso.dragLasso (e);
+        return;
+    }
+
+    if (draggingCable)
+    {
+        dragConnector (e);
+        return;
+    }
+
+    if (e.mouseWasClicked())
+        return;
+
+    // pick the cable up by the end nearest the mouse, like ConnectorComponent
+    draggingCable = true;
+    const auto key = *pressedCable;
+    setHoverCable ({});
+
+    float x1 = 0.f, y1 = 0.f, x2 = 0.f, y2 = 0.f;
+    if (auto iter = cables.find (key); iter != cables.end())
+    {
+        x1 = iter->second.x1;
+        y1 = iter->second.y1;
+        x2 = iter->second.x2;
+        y2 = iter->second.y2;
+    }
+
+    const auto pos = e.getMouseDownPosition().toFloat();
+    const bool isNearerSource = pos.getDistanceFrom ({ x1, y1 }) < pos.getDistanceFrom ({ x2, y2 });
+    ViewHelpers::postMessageFor (this, new RemoveConnectionMessage (key.sourceNode, key.sourcePort, key.destNode, key.destPort, graph));
+    beginConnectorDrag (isNearerSource ? 0 : key.sourceNode, (int) key.sourcePort, isNearerSource ? key.destNode : 0, (int) key.destPort, e);
+}
+
+void GraphEditorComponent::mouseMove (const MouseEvent& e)
+{
+    setHoverCable (isEnabled() ? findCableAt (e.getPosition()) : std::optional<CableKey>());
+}
+
+void GraphEditorComponent::mouseExit (const MouseEvent&)
+{
+    setHoverCable ({});
 }
 
 void GraphEditorComponent::createNewPlugin (const PluginDescription* desc, int x, int y)
@@ -665,29 +725,159 @@ void GraphEditorComponent::createNewPlugin (const PluginDescription* desc, int x
 
 BlockComponent* GraphEditorComponent::getComponentForFilter (const uint32 filterID) const
 {
-    for (int i = getNumChildComponents(); --i >= 0;)
+    auto iter = blocks.find (filterID);
+    return iter != blocks.end() ? iter->second : nullptr;
+}
+
+BlockComponent* GraphEditorComponent::addBlock (const Node& node, int zOrder)
+{
+    auto* const block = createBlock (node);
+    if (block == nullptr)
+        return nullptr;
+    blocks[block->filterID] = block;
+    addAndMakeVisible (block, zOrder);
+    return block;
+}
+
+void GraphEditorComponent::removeBlock (BlockComponent* block)
+{
+    auto iter = blocks.find (block->filterID);
+    if (iter != blocks.end() && iter->second == block)
+        blocks.erase (iter);
+    delete block;
+}
+
+void GraphEditorComponent::deleteAllBlocksAndCables()
+{
+    blocks.clear();
+    cables.clear();
+    hoverCable.reset();
+    pressedCable.reset();
+    draggingCable = false;
+    deleteAllChildren();
+    repaint();
+}
+
+void GraphEditorComponent::timerCallback()
+{
+    for (const auto& [nodeId, block] : blocks)
+        block->updateCpuLoad();
+}
+
+//=============================================================================
+void GraphEditorComponent::addCable (const ValueTree& arc)
+{
+    if (arc.getProperty (tags::missing, false))
+        return;
+
+    const auto a = Node::arcFromValueTree (arc);
+    const CableKey key { a.sourceNode, a.destNode, a.sourcePort, a.destPort };
+    auto& cable = cables[key];
+    updateCable (key, cable);
+}
+
+void GraphEditorComponent::removeCable (const ValueTree& arc)
+{
+    const auto a = Node::arcFromValueTree (arc);
+    const CableKey key { a.sourceNode, a.destNode, a.sourcePort, a.destPort };
+    auto iter = cables.find (key);
+    if (iter == cables.end())
+        return;
+
+    if (hoverCable == key)
+        hoverCable.reset();
+    repaint (iter->second.bounds);
+    cables.erase (iter);
+}
+
+void GraphEditorComponent::syncCables()
+{
+    // the arcs tree is read once, lookups are by key instead of scans
+    std::map<CableKey, Cable> synced;
+    const ValueTree arcs = graph.getArcsValueTree();
+    for (int i = 0; i < arcs.getNumChildren(); ++i)
     {
-        if (BlockComponent* const block = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-            if (block->filterID == filterID)
-                return block;
+        const ValueTree arc (arcs.getChild (i));
+        if (arc.getProperty (tags::missing, false))
+            continue;
+
+        const auto a = Node::arcFromValueTree (arc);
+        const CableKey key { a.sourceNode, a.destNode, a.sourcePort, a.destPort };
+        auto existing = cables.find (key);
+        synced[key] = existing != cables.end() ? std::move (existing->second) : Cable();
     }
 
-    return nullptr;
+    for (const auto& [key, cable] : cables)
+        if (cable.visible && synced.find (key) == synced.end())
+            repaint (cable.bounds);
+
+    cables.swap (synced);
+    if (hoverCable && cables.find (*hoverCable) == cables.end())
+        hoverCable.reset();
 }
 
-ConnectorComponent* GraphEditorComponent::getComponentForConnection (const Arc& arc) const
+bool GraphEditorComponent::updateCable (const CableKey& key, Cable& cable)
 {
-    for (int i = getNumChildComponents(); --i >= 0;)
+    float x1 = 0.f, y1 = 0.f, x2 = 0.f, y2 = 0.f;
+    auto* const src = getComponentForFilter (key.sourceNode);
+    auto* const dst = getComponentForFilter (key.destNode);
+    const bool visible = src != nullptr && dst != nullptr
+                         && src->getPortPos ((int) key.sourcePort, false, x1, y1)
+                         && dst->getPortPos ((int) key.destPort, true, x2, y2);
+
+    if (visible == cable.visible && (! visible || (x1 == cable.x1 && y1 == cable.y1 && x2 == cable.x2 && y2 == cable.y2)))
+        return false;
+
+    if (cable.visible)
+        repaint (cable.bounds);
+
+    cable.visible = visible;
+    if (! visible)
     {
-        if (ConnectorComponent* const c = dynamic_cast<ConnectorComponent*> (getChildComponent (i)))
-            if (c->sourceFilterID == arc.sourceNode
-                && c->destFilterID == arc.destNode
-                && (uint32_t) c->sourceFilterChannel == arc.sourcePort
-                && (uint32_t) c->destFilterChannel == arc.destPort)
-                return c;
+        cable.linePath.clear();
+        cable.hitPath.clear();
+        cable.bounds = {};
+        return true;
     }
 
-    return nullptr;
+    cable.x1 = x1;
+    cable.y1 = y1;
+    cable.x2 = x2;
+    cable.y2 = y2;
+    buildCablePaths (cable.linePath, cable.hitPath, x1, y1, x2, y2, verticalLayout);
+    cable.bounds = cable.hitPath.getBounds().getSmallestIntegerContainer().expanded (2);
+    repaint (cable.bounds);
+    return true;
+}
+
+std::optional<GraphEditorComponent::CableKey> GraphEditorComponent::findCableAt (Point<int> pos) const
+{
+    const auto p = pos.toFloat();
+    for (auto iter = cables.rbegin(); iter != cables.rend(); ++iter)
+    {
+        const auto& cable = iter->second;
+        if (! cable.visible || ! cable.bounds.contains (pos) || ! cable.hitPath.contains (p))
+            continue;
+
+        // avoid picking the cable when over a pin
+        if (p.getDistanceFrom ({ cable.x1, cable.y1 }) > 7.f && p.getDistanceFrom ({ cable.x2, cable.y2 }) > 7.f)
+            return iter->first;
+    }
+
+    return {};
+}
+
+void GraphEditorComponent::setHoverCable (std::optional<CableKey> key)
+{
+    if (key == hoverCable)
+        return;
+
+    for (const auto& k : { hoverCable, key })
+        if (k)
+            if (auto iter = cables.find (*k); iter != cables.end())
+                repaint (iter->second.bounds);
+
+    hoverCable = key;
 }
 
 PortComponent* GraphEditorComponent::findPinAt (const int x, const int y) const
@@ -735,76 +925,49 @@ void GraphEditorComponent::updateConnectorComponents (bool async)
         return;
     }
 
-    const ValueTree arcs = graph.getArcsValueTree();
-    for (int i = getNumChildComponents(); --i >= 0;)
-    {
-        ConnectorComponent* const cc = dynamic_cast<ConnectorComponent*> (getChildComponent (i));
-        if (cc != nullptr && cc != draggingConnector.get())
-        {
-            if (! Node::connectionExists (arcs, cc->sourceFilterID, (uint32) cc->sourceFilterChannel, cc->destFilterID, (uint32) cc->destFilterChannel, true))
-            {
-                delete cc;
-            }
-            else
-            {
-                // update cable or remove if can't get coordinates
-                float x1, y1, x2, y2;
-                if (cc->getPoints (x1, y1, x2, y2))
-                    cc->update();
-                else
-                    delete cc;
-            }
-        }
-    }
+    // only cables whose ends moved are rebuilt and repainted
+    for (auto& [key, cable] : cables)
+        updateCable (key, cable);
 }
 
 void GraphEditorComponent::updateBlockComponents (const bool doPosition)
 {
-    for (int i = getNumChildComponents(); --i >= 0;)
-        if (auto* const block = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-        {
-            block->update (doPosition);
-        }
+    // update() deletes blocks whose node was removed
+    Array<BlockComponent*> toUpdate;
+    toUpdate.ensureStorageAllocated ((int) blocks.size());
+    for (const auto& entry : blocks)
+        toUpdate.add (entry.second);
+    for (auto* const block : toUpdate)
+        block->update (doPosition);
 }
 
 void GraphEditorComponent::stabilizeNodes()
 {
-    for (int i = getNumChildComponents(); --i >= 0;)
-        if (auto* const block = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-        {
-            block->update (false);
-            block->repaint();
-        }
+    Array<BlockComponent*> toUpdate;
+    toUpdate.ensureStorageAllocated ((int) blocks.size());
+    for (const auto& entry : blocks)
+        toUpdate.add (entry.second);
+    for (auto* const block : toUpdate)
+    {
+        Component::SafePointer<BlockComponent> safe (block);
+        block->update (false);
+        if (safe != nullptr)
+            safe->repaint();
+    }
 }
 
 void GraphEditorComponent::updateComponents (const bool doNodePositions)
 {
-    for (int i = graph.getNumConnections(); --i >= 0;)
-    {
-        const ValueTree c = graph.getConnectionValueTree (i);
-        const Arc arc (Node::arcFromValueTree (c));
-        ConnectorComponent* connector = getComponentForConnection (arc);
-
-        if (connector == nullptr)
-        {
-            connector = new ConnectorComponent (graph);
-            addAndMakeVisible (connector, i);
-        }
-
-        connector->setGraph (this->graph);
-        connector->setInput (arc.sourceNode, arc.sourcePort);
-        connector->setOutput (arc.destNode, arc.destPort);
-    }
+    syncCables();
 
     for (int i = graph.getNumNodes(); --i >= 0;)
     {
         const Node node (graph.getNode (i));
-        BlockComponent* comp = getComponentForFilter (node.getNodeId());
-        if (comp == nullptr)
+        if (getComponentForFilter (node.getNodeId()) == nullptr)
         {
-            comp = createBlock (node);
+            auto* const comp = addBlock (node, i + 10000);
+            ignoreUnused (comp);
             jassert (comp != nullptr);
-            addAndMakeVisible (comp, i + 10000);
         }
     }
 
@@ -817,15 +980,13 @@ Rectangle<int> GraphEditorComponent::getRequiredSpace() const
     Rectangle<int> r;
     r.setX (0);
     r.setY (0);
-    for (int i = getNumChildComponents(); --i >= 0;)
+    for (const auto& entry : blocks)
     {
-        if (auto* const block = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-        {
-            if (block->getRight() > r.getWidth())
-                r.setWidth (block->getRight());
-            if (block->getBottom() > r.getHeight())
-                r.setHeight (block->getBottom());
-        }
+        auto* const block = entry.second;
+        if (block->getRight() > r.getWidth())
+            r.setWidth (block->getRight());
+        if (block->getBottom() > r.getHeight())
+            r.setHeight (block->getBottom());
     }
     return r;
 }
@@ -1065,39 +1226,72 @@ void GraphEditorComponent::filesDropped (const StringArray& files, int x, int y)
 //=============================================================================
 void GraphEditorComponent::valueTreeChildAdded (ValueTree& parent, ValueTree& child)
 {
-    if (child.hasType (types::Node))
+    // the listener also hears nested graphs, only direct children apply here
+    if (child.hasType (types::Node) && parent == graph.getNodesValueTree())
     {
         child.setProperty (tags::x, verticalLayout ? lastDropX : lastDropY, 0);
         child.setProperty (tags::y, verticalLayout ? lastDropY : lastDropX, 0);
-        auto* comp = createBlock (Node (child, false));
-        addAndMakeVisible (comp, 20000);
-        comp->update();
+        if (auto* comp = addBlock (Node (child, false), 20000))
+            comp->update();
+        updateConnectorComponents();
     }
-    else if (child.hasType (types::Arc) || child.hasType (tags::nodes) || child.hasType (tags::arcs))
+    else if (child.hasType (types::Arc) && parent == graph.getArcsValueTree())
+    {
+        addCable (child);
+    }
+    else if ((child.hasType (tags::nodes) || child.hasType (tags::arcs)) && parent == data)
     {
         updateComponents();
     }
     else if (child.hasType (tags::ports))
     {
-        const Node node (parent, false);
-        for (int i = 0; i < getNumChildComponents(); ++i)
-            if (auto* const filter = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-                filter->update();
+        if (auto* const block = getComponentForFilter (Node (parent, false).getNodeId()))
+            block->update();
+        updateConnectorComponents();
+    }
+}
+
+void GraphEditorComponent::valueTreeChildRemoved (ValueTree& parent, ValueTree& child, int)
+{
+    if (child.hasType (types::Node) && parent == graph.getNodesValueTree())
+    {
+        const Node node (child, false);
+        if (auto* const block = getComponentForFilter (node.getNodeId()))
+            removeBlock (block);
         updateConnectorComponents();
     }
+    else if (child.hasType (types::Arc) && parent == graph.getArcsValueTree())
+    {
+        removeCable (child);
+    }
+    else if ((child.hasType (tags::nodes) || child.hasType (tags::arcs)) && parent == data)
+    {
+        updateComponents();
+    }
+}
+
+void GraphEditorComponent::valueTreePropertyChanged (ValueTree& tree, const Identifier& property)
+{
+    if (property == tags::missing && tree.hasType (types::Arc) && tree.getParent() == graph.getArcsValueTree())
+    {
+        if (tree.getProperty (tags::missing, false))
+            removeCable (tree);
+        else
+            addCable (tree);
+    }
 }
 
 void GraphEditorComponent::findLassoItemsInArea (Array<uint32>& itemsFound,
                                                  const Rectangle<int>& area)
 {
-    for (int i = 0; i < getNumChildComponents(); ++i)
+    for (const auto& entry : blocks)
     {
-        if (auto* block = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-            if (area.intersects (block->getBounds()))
-            {
-                itemsFound.add (block->node.getNodeId());
-                block->repaint();
-            }
+        auto* const block = entry.second;
+        if (area.intersects (block->getBounds()))
+        {
+            itemsFound.add (block->node.getNodeId());
+            block->repaint();
+        }
     }
 }
 
@@ -1195,9 +1389,8 @@ void GraphEditorComponent::setZoomScale (float scale)
 
 void GraphEditorComponent::updateSelection()
 {
-    for (int i = getNumChildComponents(); --i >= 0;)
-        if (auto* const block = dynamic_cast<BlockComponent*> (getChildComponent (i)))
-            block->repaint();
+    for (const auto& entry : blocks)
+        entry.second->repaint();
 }
 
 BlockComponent* GraphEditorComponent::createBlock (const Node& node)
@@ -3,6 +3,11 @@
 
 #pragma once
 
+#include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+
 #include "ElementApp.h"
 #include "gui/ViewHelpers.h"
 
@@ -20,6 +25,7 @@ class GraphEditorComponent : public Component,
                              public DragAndDropTarget,
                              public FileDragAndDropTarget,
                              private ValueTree::Listener,
+                             private Timer,
                              public ViewHelperMixin,
                              public LassoSource<uint32>
 {
@@ -72,6 +78,8 @@ public:
     void mouseDown (const MouseEvent& e) override;
     void mouseUp (const MouseEvent& e) override;
     void mouseDrag (const MouseEvent& e) override;
+    void mouseMove (const MouseEvent& e) override;
+    void mouseExit (const MouseEvent& e) override;
 
     bool isInterestedInDragSource (const SourceDetails&) override;
     void itemDropped (const SourceDetails& details) override;
@@ -121,6 +129,36 @@ private:
 
     float zoomScale = 1.0;
 
+    /** Identifies a cable the same way ArcSorter orders arcs. */
+    struct CableKey
+    {
+        uint32 sourceNode, destNode, sourcePort, destPort;
+        bool operator< (const CableKey& o) const noexcept
+        {
+            return std::tie (sourceNode, destNode, sourcePort, destPort)
+                   < std::tie (o.sourceNode, o.destNode, o.sourcePort, o.destPort);
+        }
+        bool operator== (const CableKey& o) const noexcept
+        {
+            return std::tie (sourceNode, destNode, sourcePort, destPort)
+                   == std::tie (o.sourceNode, o.destNode, o.sourcePort, o.destPort);
+        }
+    };
+
+    /** Cables aren't components: they're painted together by the editor. */
+    struct Cable
+    {
+        float x1 = 0.f, y1 = 0.f, x2 = 0.f, y2 = 0.f;
+        bool visible = false;
+        Path linePath, hitPath;
+        Rectangle<int> bounds;
+    };
+
+    std::map<CableKey, Cable> cables;
+    std::unordered_map<uint32, BlockComponent*> blocks;
+    std::optional<CableKey> hoverCable, pressedCable;
+    bool draggingCable = false;
+
     void selectNode (const Node& node, ModifierKeys mods);
     void setSelectedNodesCompact (bool selected);
 
@@ -136,16 +174,27 @@ private:
     void endDraggingConnector (const MouseEvent& e);
 
     BlockComponent* createBlock (const Node&);
+    BlockComponent* addBlock (const Node&, int zOrder);
+    void removeBlock (BlockComponent*);
+    void deleteAllBlocksAndCables();
 
     BlockComponent* getComponentForFilter (const uint32 filterID) const;
-    ConnectorComponent* getComponentForConnection (const Arc& conn) const;
     PortComponent* findPinAt (const int x, const int y) const;
 
+    void syncCables();
+    void addCable (const ValueTree& arc);
+    void removeCable (const ValueTree& arc);
+    bool updateCable (const CableKey&, Cable&);
+    std::optional<CableKey> findCableAt (Point<int> pos) const;
+    void setHoverCable (std::optional<CableKey>);
+
     void updateSelection();
 
-    void valueTreePropertyChanged (ValueTree& treeWhosePropertyHasChanged, const Identifier& property) override {}
+    void timerCallback() override;
+
+    void valueTreePropertyChanged (ValueTree& treeWhosePropertyHasChanged, const Identifier& property) override;
     void valueTreeChildAdded (ValueTree& parentTree, ValueTree& childWhichHasBeenAdded) override;
-    void valueTreeChildRemoved (ValueTree& parentTree, ValueTree& childWhichHasBeenRemoved, int indexFromWhichChildWasRemoved) override {}
+    void valueTreeChildRemoved (ValueTree& parentTree, ValueTree& childWhichHasBeenRemoved, int indexFromWhichChildWasRemoved) override;
     void valueTreeChildOrderChanged (ValueTree& parentTreeWhoseChildrenHaveMoved,
                                      int oldIndex,
                                      int newIndex) override {}
@@ -253,6 +253,9 @@ void MainMenu::buildWindowMenu (PopupMenu& menu)
 {
     menu.addCommandItem (&cmd, Commands::hideAllPluginWindows, "Close plugin windows...");
     menu.addCommandItem (&cmd, Commands::showAllPluginWindows, "Show plugin windows...");
+    menu.addSeparator();
+    menu.addCommandItem (&cmd, Commands::recordRenderTrace, "Record render trace");
+    menu.addCommandItem (&cmd, Commands::exportRenderTrace, "Export render trace...");
 }
 
 void MainMenu::buildWorkspaceMenu (PopupMenu& menu)
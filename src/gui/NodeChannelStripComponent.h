@@ -32,6 +32,11 @@ public:
                 node.setProperty (tags::name, nodeName.getText());
         };
 
+        addAndMakeVisible (cpuLabel);
+        cpuLabel.setJustificationType (Justification::centred);
+        cpuLabel.setFont (9.f);
+        cpuLabel.setTooltip ("Portion of the audio block spent rendering this node");
+
         addAndMakeVisible (channelBox);
         channelBox.setJustificationType (Justification::centred);
 
@@ -43,6 +48,7 @@ public:
 
     ~NodeChannelStripComponent()
     {
+        setMetered (nullptr);
         unbindSignals();
     }
 
@@ -87,7 +93,7 @@ public:
     {
         auto r (getLocalBounds());
         nodeName.setBounds (r.removeFromTop (22).reduced (2));
-        r.removeFromTop (10); // padding between strip title and IO boxes
+        cpuLabel.setBounds (r.removeFromTop (12)); // doubles as padding above the IO boxes
 
         auto r2 = r.removeFromBottom (jmin (268, r.getHeight()));
         int boxSize = r2.getWidth() - 8;
@@ -137,10 +143,16 @@ public:
             channelStrip.setPower (! ptr->isSuspended(), false);
             if (channelStrip.isMuted() != ptr->isMuted())
                 channelStrip.setMuted (ptr->isMuted(), false);
+
+            String load ("CPU ");
+            load << String (ptr->getCpuLoad() * 100.f, 1) << "%";
+            cpuLabel.setText (load, dontSendNotification);
         }
         else
         {
+            cpuLabel.setText ({}, dontSendNotification);
             meter.resetPeaks();
+            setMetered (nullptr);
             stopTimer();
         }
 
@@ -188,6 +200,7 @@ public:
         node.getPorts (audioIns, audioOuts, PortType::Audio);
         displayName.referTo (node.getPropertyAsValue (tags::name));
         stabilizeContent();
+        setMetered (node.getObject());
         startTimerHz (meterSpeedHz);
 
         if (onNodeChanged)
@@ -235,7 +248,9 @@ private:
     friend class NodeChannelStripView;
     GuiService& gui;
     Label nodeName;
+    Label cpuLabel;
     Node node;
+    ProcessorPtr metered;
     PortArray audioIns, audioOuts;
     ComboBox channelBox, flowBox;
     ChannelStripComponent channelStrip;
@@ -257,6 +272,17 @@ private:
     SignalConnection volumeDoubleClickedConnection;
     SignalConnection muteChangedConnection;
 
+    void setMetered (ProcessorPtr object)
+    {
+        if (metered == object)
+            return;
+        if (metered != nullptr)
+            metered->removeMeterSubscriber();
+        metered = object;
+        if (metered != nullptr)
+            metered->addMeterSubscriber();
+    }
+
     inline bool isMonitoringInputs() const { return flowBox.getSelectedId() == 1; }
     inline bool isMonitoringOutputs() const { return flowBox.getSelectedId() == 2; }
 
@@ -74,6 +74,7 @@ public:
                     {
                         node.savePluginState();
                         node.writeToFile (ptr->getMidiProgramFile());
+                        ptr->refreshMidiProgramBank();
                     }
                 }
                 else
@@ -16,8 +16,8 @@ JUCE_BEGIN_IGNORE_WARNINGS_GCC_LIKE ("-Wdeprecated-declarations",
 #include <element/lv2.hpp>
 #include "lv2/logfeature.hpp"
 #include "lv2/module.hpp"
+#include "lv2/workerpool.hpp"
 #include "lv2/world.hpp"
-#include "lv2/workthread.hpp"
 #include "lv2/workerfeature.hpp"
 #include "lv2/native.hpp"
 
@@ -408,6 +408,13 @@ public:
     }
 
     bool wantsMidiPipe() const override { return true; }
+    bool wantsPortData() const override { return true; }
+
+    void setPortData (uint32 port, float* data) override
+    {
+        if (auto* buf = module->getPortBuffer (port))
+            buf->referTo (data);
+    }
 
     void renderBypassed (AudioSampleBuffer& a, MidiPipe& m) override
     {
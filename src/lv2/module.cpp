@@ -264,7 +264,8 @@ void LV2Module::init()
                 dataType = map (LV2_EVENT__Event);
                 break;
             case PortType::CV:
-                capacity = sizeof (float);
+                // only used when the graph doesn't connect the port
+                capacity = sizeof (float) * EL_LV2_CV_BUFFER_FRAMES;
                 dataType = map (LV2_ATOM__Float);
                 break;
         }
@@ -384,7 +385,7 @@ Result LV2Module::instantiate (double samplerate)
         const LilvNode* node = lilv_nodes_get (nodes, iter);
         if (lilv_node_equals (node, world.work_interface))
         {
-            worker = std::make_unique<WorkerFeature> (world.getWorkThread(), 1);
+            worker = std::make_unique<WorkerFeature> (world.getWorkerPool(), 1);
             features.add (worker->getFeature());
         }
     }
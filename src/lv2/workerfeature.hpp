@@ -6,7 +6,7 @@
 #include <lvtk/ext/worker.hpp>
 
 #include "lv2/lv2features.hpp"
-#include "lv2/workthread.hpp"
+#include "lv2/workerpool.hpp"
 
 namespace element {
 
@@ -14,7 +14,7 @@ class WorkerFeature final : public LV2Feature,
                             public WorkerBase
 {
 public:
-    WorkerFeature (WorkThread& thread, uint32_t bufsize, LV2_Handle handle = nullptr, LV2_Worker_Interface* iface = nullptr);
+    WorkerFeature (WorkerPool& pool, uint32_t bufsize, LV2_Handle handle = nullptr, LV2_Worker_Interface* iface = nullptr);
 
     ~WorkerFeature();
 
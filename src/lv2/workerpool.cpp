@@ -0,0 +1,294 @@
+// Copyright 2014-2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include "engine/denormals.hpp"
+#include "lv2/workerpool.hpp"
+#include "threadpools.hpp"
+
+using namespace juce;
+
+#if _MSC_VER
+#pragma warning(disable : 4127)
+#endif
+
+#if JUCE_DEBUG
+#define WORKER_LOG(x) DBG (String ("worker: ") << x)
+#else
+#define WORKER_LOG(x)
+#endif
+
+namespace element {
+
+class WorkerPool::PoolThread : public Thread
+{
+public:
+    PoolThread (WorkerPool& p, const String& name)
+        : Thread (name), pool (p) {}
+
+    void run() override
+    {
+        ThreadPools::getInstance().applyToCurrentThread (ThreadPools::worker);
+        // plugins do dsp work here too, e.g. convolution reloading impulses
+        flushDenormalsOnThisThread();
+        pool.run (*this);
+    }
+
+private:
+    WorkerPool& pool;
+};
+
+WorkerPool::WorkerPool (const String& name, int numThreads, uint32_t bufsize, Thread::Priority priority)
+    : bufferSize ((uint32_t) nextPowerOfTwo ((int) bufsize))
+{
+    for (int i = 0; i < jmax (1, numThreads); ++i)
+        threads.add (new PoolThread (*this, name + " " + String (i + 1)))->startThread (priority);
+}
+
+WorkerPool::~WorkerPool()
+{
+    shouldExit.store (true);
+    for (auto* thread : threads)
+    {
+        thread->signalThreadShouldExit();
+        semaphore.post();
+    }
+
+    for (auto* thread : threads)
+        thread->waitForThreadToExit (-1);
+    threads.clear();
+}
+
+WorkerPool::Stats WorkerPool::getStats() const
+{
+    Stats stats;
+    stats.queueDepth = queueDepth.load();
+    stats.maxQueueDepth = maxQueueDepth.load();
+    stats.numProcessed = numProcessed.load();
+    stats.numRejected = numRejected.load();
+    const auto ticksToMs = [] (int64 ticks) { return Time::highResolutionTicksToSeconds (ticks) * 1000.0; };
+    if (stats.numProcessed > 0)
+        stats.averageLatencyMs = ticksToMs (totalLatencyTicks.load()) / (double) stats.numProcessed;
+    stats.maxLatencyMs = ticksToMs (maxLatencyTicks.load());
+    return stats;
+}
+
+void WorkerPool::resetStats()
+{
+    maxQueueDepth.store (queueDepth.load());
+    numProcessed.store (0);
+    numRejected.store (0);
+    totalLatencyTicks.store (0);
+    maxLatencyTicks.store (0);
+}
+
+void WorkerPool::addWorker (WorkerBase* worker)
+{
+    WORKER_LOG ("registering worker: " + String::toHexString ((pointer_sized_int) worker));
+    worker->requests = std::make_unique<RingBuffer> ((int32) bufferSize);
+    workers.addIfNotAlreadyThere (worker);
+}
+
+void WorkerPool::removeWorker (WorkerBase* worker)
+{
+    WORKER_LOG ("removing worker: " + String::toHexString ((pointer_sized_int) worker));
+    workers.removeFirstMatchingValue (worker);
+
+    // claims are released with the lock held, see drain()
+    for (;;)
+    {
+        {
+            const ScopedLock sl (workers.getLock());
+            if (! worker->claimed.load())
+                break;
+        }
+        Thread::sleep (1);
+    }
+
+    queueDepth.fetch_sub (worker->pending.exchange (0));
+}
+
+bool WorkerPool::scheduleWork (WorkerBase* worker, uint32_t size, const void* data)
+{
+    jassert (size > 0 && worker != nullptr && worker->requests != nullptr);
+    auto& ring = *worker->requests;
+    if (! ring.canWrite (getRequiredSpace (size)))
+    {
+        numRejected.fetch_add (1);
+        return false;
+    }
+
+    const int64 ticks = Time::getHighResolutionTicks();
+    ring.write (&size, sizeof (size));
+    ring.write (&ticks, sizeof (ticks));
+    ring.write (data, size);
+
+    const int depth = queueDepth.fetch_add (1) + 1;
+    int maxDepth = maxQueueDepth.load();
+    while (depth > maxDepth && ! maxQueueDepth.compare_exchange_weak (maxDepth, depth))
+    {
+    }
+
+    // the message is complete before it's counted, so readers never wait on a partial write
+    if (worker->pending.fetch_add (1) == 0)
+        semaphore.post();
+    return true;
+}
+
+WorkerBase* WorkerPool::claimNextWorker()
+{
+    const ScopedLock sl (workers.getLock());
+    const int numWorkers = workers.size();
+
+    // start after the last claim so one busy plugin can't starve the rest
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        const int index = (nextWorker + i) % numWorkers;
+        auto* const worker = workers.getUnchecked (index);
+        if (worker->pending.load() > 0 && ! worker->claimed.load())
+        {
+            worker->claimed.store (true);
+            nextWorker = index + 1;
+            return worker;
+        }
+    }
+
+    return nullptr;
+}
+
+void WorkerPool::drain (WorkerBase& worker, HeapBlock<uint8>& buffer, uint32_t& bufferCapacity)
+{
+    auto& ring = *worker.requests;
+
+    for (;;)
+    {
+        while (worker.pending.load() > 0 && ! shouldExit.load())
+        {
+            uint32_t size = 0;
+            int64 ticks = 0;
+            ring.read (&size, sizeof (size));
+            ring.read (&ticks, sizeof (ticks));
+
+            if (size > bufferCapacity)
+            {
+                bufferCapacity = (uint32_t) nextPowerOfTwo ((int) size);
+                buffer.realloc (bufferCapacity);
+            }
+
+            if (ring.read (buffer.getData(), size) < size)
+            {
+                WORKER_LOG ("error reading request: message body");
+            }
+            else
+            {
+                const int64 latency = Time::getHighResolutionTicks() - ticks;
+                totalLatencyTicks.fetch_add (latency);
+                int64 maxLatency = maxLatencyTicks.load();
+                while (latency > maxLatency && ! maxLatencyTicks.compare_exchange_weak (maxLatency, latency))
+                {
+                }
+
+                numProcessed.fetch_add (1);
+                worker.processRequest (size, buffer.getData());
+            }
+
+            worker.pending.fetch_sub (1);
+            queueDepth.fetch_sub (1);
+        }
+
+        // a request scheduled after the last read but before the release
+        // posted while this thread still owned the worker, so check again.
+        const ScopedLock sl (workers.getLock());
+        worker.claimed.store (false);
+        if (shouldExit.load() || worker.pending.load() <= 0 || ! workers.contains (&worker))
+            return;
+        worker.claimed.store (true);
+    }
+}
+
+void WorkerPool::run (PoolThread& thread)
+{
+    HeapBlock<uint8> buffer;
+    uint32_t bufferCapacity = 0;
+
+    while (! shouldExit.load() && ! thread.threadShouldExit())
+    {
+        semaphore.wait();
+
+        while (! shouldExit.load())
+        {
+            auto* const worker = claimNextWorker();
+            if (worker == nullptr)
+                break;
+            drain (*worker, buffer, bufferCapacity);
+        }
+    }
+}
+
+WorkerBase::WorkerBase (WorkerPool& pool, uint32_t bufsize)
+    : owner (pool)
+{
+    responses = std::make_unique<RingBuffer> (bufsize);
+    response.calloc (bufsize);
+    pool.addWorker (this);
+}
+
+WorkerBase::~WorkerBase()
+{
+    owner.removeWorker (this);
+    requests = nullptr;
+    responses = nullptr;
+    response.free();
+}
+
+bool WorkerBase::scheduleWork (uint32_t size, const void* data)
+{
+    return owner.scheduleWork (this, size, data);
+}
+
+bool WorkerBase::respondToWork (uint32_t size, const void* data)
+{
+    if (! responses->canWrite (sizeof (size) + size))
+        return false;
+
+    if (responses->write (&size, sizeof (size)) < sizeof (size))
+        return false;
+
+    if (responses->write (data, size) < size)
+        return false;
+
+    return true;
+}
+
+void WorkerBase::processWorkResponses()
+{
+    uint32_t remaining = responses->getReadSpace();
+    uint32_t size = 0;
+
+    while (remaining >= sizeof (uint32_t))
+    {
+        /* respond next cycle if response isn't ready */
+        if (! validateMessage (*responses))
+            return;
+
+        responses->read (&size, sizeof (size));
+        responses->read (response.getData(), size);
+        processResponse (size, response.getData());
+        remaining -= (sizeof (uint32_t) + size);
+    }
+}
+
+bool WorkerBase::validateMessage (RingBuffer& ring)
+{
+    // the worker only validates message size
+    uint32_t size = 0;
+    ring.peak (&size, sizeof (size));
+    return ring.canRead (size + sizeof (size));
+}
+
+void WorkerBase::setSize (uint32_t newSize)
+{
+    responses = std::make_unique<RingBuffer> (newSize);
+    response.realloc (newSize);
+}
+
+} // namespace element
@@ -0,0 +1,153 @@
+// Copyright 2014-2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <element/juce/core.hpp>
+
+#include "ringbuffer.hpp"
+#include "semaphore.hpp"
+
+namespace element {
+
+class WorkerBase;
+
+/** A pool of worker threads
+    Capable of scheduling non-realtime work from a realtime context.
+
+    Every worker has its own request queue, and only one thread services a
+    worker at a time, so requests from one plugin run in the order they were
+    scheduled while different plugins are worked on concurrently. Idle
+    threads block on a semaphore that the realtime thread posts when a
+    worker's queue goes from empty to non-empty.
+ */
+class WorkerPool
+{
+public:
+    using Priority = juce::Thread::Priority;
+
+    /** Create a pool
+        @param name Prefix of the thread names
+        @param numThreads Number of threads to start
+        @param bufsize Size of each worker's request queue in bytes */
+    WorkerPool (const juce::String& name, int numThreads, uint32_t bufsize, Priority priority = Priority::normal);
+    ~WorkerPool();
+
+    /** Returns the number of threads in the pool */
+    int getNumThreads() const noexcept { return threads.size(); }
+
+    /** Returns the size of each worker's request queue in bytes */
+    uint32_t getRequestBufferSize() const noexcept { return bufferSize; }
+
+    /** Queue statistics */
+    struct Stats
+    {
+        int queueDepth = 0; ///< requests waiting or in progress
+        int maxQueueDepth = 0; ///< most requests waiting at once
+        int64 numProcessed = 0; ///< requests handed to workers
+        int64 numRejected = 0; ///< requests that didn't fit a queue
+        double averageLatencyMs = 0.0; ///< from schedule to the start of work
+        double maxLatencyMs = 0.0;
+    };
+
+    /** Returns a snapshot of the queue statistics */
+    Stats getStats() const;
+
+    /** Resets the maximums and counters, queueDepth is left as is */
+    void resetStats();
+
+    inline static uint32_t getRequiredSpace (uint32_t msgSize) { return msgSize + sizeof (uint32_t) + sizeof (int64); }
+
+protected:
+    friend class WorkerBase;
+
+    /** Register a worker for scheduling. Does not take ownership */
+    void addWorker (WorkerBase* worker);
+
+    /** Deregister a worker from scheduling. Waits for work in progress to
+        finish and does not delete the worker */
+    void removeWorker (WorkerBase* worker);
+
+    /** Schedule non-realtime work
+        Workers will call this in Worker::scheduleWork */
+    bool scheduleWork (WorkerBase* worker, uint32_t size, const void* data);
+
+private:
+    class PoolThread;
+    const uint32_t bufferSize;
+    juce::OwnedArray<PoolThread> threads;
+    juce::Array<WorkerBase*, juce::CriticalSection> workers;
+    Semaphore semaphore;
+    std::atomic<bool> shouldExit { false };
+    int nextWorker = 0;
+
+    std::atomic<int> queueDepth { 0 }, maxQueueDepth { 0 };
+    std::atomic<int64> numProcessed { 0 }, numRejected { 0 };
+    std::atomic<int64> totalLatencyTicks { 0 }, maxLatencyTicks { 0 };
+
+    /** @internal Claims the next worker with pending requests */
+    WorkerBase* claimNextWorker();
+
+    /** @internal Runs a claimed worker's requests until its queue is empty */
+    void drain (WorkerBase& worker, juce::HeapBlock<uint8>& buffer, uint32_t& bufferCapacity);
+
+    /** @internal The pool thread function */
+    void run (PoolThread& thread);
+};
+
+class WorkerBase
+{
+public:
+    /** Create a new Worker
+        @param pool The WorkerPool to use when scheduling
+        @param bufsize Size to use for internal response buffers */
+    WorkerBase (WorkerPool& pool, uint32_t bufsize);
+    virtual ~WorkerBase();
+
+    /** Returns true if the worker is currently working */
+    inline bool isWorking() const { return claimed.load(); }
+
+    /** Schedule work (realtime thread).
+        Work will be queued, and a pool thread will call Worker::processRequest
+        in the order requests were scheduled */
+    bool scheduleWork (uint32_t size, const void* data);
+
+    /** Respond from work (worker thread). Call this during processRequest if you
+        need to send a response into the realtime thread.
+        @see processWorkResponses, @see processResponse */
+    bool respondToWork (uint32_t size, const void* data);
+
+    /** Deliver pending responses (realtime thread)
+        This must be called regularly from the realtime thread. For each read
+        response, Worker::processResponse will be called */
+    void processWorkResponses();
+
+    /** Set the internal buffer size for responses */
+    void setSize (uint32_t newSize);
+
+protected:
+    /** Process work (worker thread) */
+    virtual void processRequest (uint32_t size, const void* data) = 0;
+
+    /** Process work responses (realtime thread) */
+    virtual void processResponse (uint32_t size, const void* data) = 0;
+
+private:
+    WorkerPool& owner;
+    std::atomic<int> pending { 0 }; ///< requests queued and not yet finished
+    std::atomic<bool> claimed { false }; ///< true while a pool thread owns this worker
+
+    std::unique_ptr<RingBuffer> requests; ///< requests from the realtime thread
+    std::unique_ptr<RingBuffer> responses; ///< responses from work
+    juce::HeapBlock<uint8_t> response; ///< buffer to write a response
+
+    bool validateMessage (RingBuffer& ring);
+
+    friend class WorkerPool;
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WorkerBase)
+};
+
+} // namespace element
@@ -11,18 +11,117 @@
 #include <lvtk/ext/bufsize.hpp>
 #include <lvtk/ext/state.hpp>
 
+#include "datapath.hpp"
+#include "fileindex.hpp"
 #include "lv2/lv2features.hpp"
 #include "lv2/module.hpp"
 #include "lv2/workerfeature.hpp"
 #include "lv2/world.hpp"
 #include "lv2/logfeature.hpp"
+#include "threadpools.hpp"
 
+// 0 sizes the worker pool from the worker thread settings
 #ifndef JLV2_NUM_WORKERS
-#define JLV2_NUM_WORKERS 1
+#define JLV2_NUM_WORKERS 0
 #endif
 
 namespace element {
 
+namespace LV2BundleTags {
+static const Identifier bundle ("lv2bundle");
+static const Identifier plugin ("plugin");
+static const Identifier uri ("uri");
+static const Identifier name ("name");
+static const Identifier requiredFeatures ("requiredFeatures");
+} // namespace LV2BundleTags
+
+/** Directories lilv searches, from LV2_PATH or lilv's defaults. */
+static Array<File> getBundleSearchPath()
+{
+    auto path = SystemStats::getEnvironmentVariable ("LV2_PATH", {});
+    if (path.isEmpty())
+    {
+#if JUCE_MAC
+        path = "~/Library/Audio/Plug-Ins/LV2:~/.lv2:/usr/local/lib/lv2:/usr/lib/lv2:/Library/Audio/Plug-Ins/LV2";
+#elif JUCE_WINDOWS
+        path = "%APPDATA%\\LV2;%COMMONPROGRAMFILES%\\LV2";
+        path = path.replace ("%APPDATA%", SystemStats::getEnvironmentVariable ("APPDATA", {}))
+                   .replace ("%COMMONPROGRAMFILES%", SystemStats::getEnvironmentVariable ("COMMONPROGRAMFILES", {}));
+#else
+        path = "~/.lv2:/usr/local/lib/lv2:/usr/lib/lv2";
+#endif
+    }
+
+    Array<File> dirs;
+    const auto home = File::getSpecialLocation (File::userHomeDirectory).getFullPathName();
+    for (auto dir : StringArray::fromTokens (path, JUCE_WINDOWS ? ";" : ":", {}))
+    {
+        if (dir.startsWithChar ('~'))
+            dir = home + dir.substring (1);
+        if (File::isAbsolutePath (dir))
+            dirs.addIfNotAlreadyThere (File (dir));
+    }
+    return dirs;
+}
+
+/** Lists the plugins in one bundle. Uses a world of its own so the index
+    thread never touches the shared one.
+ */
+static ValueTree readBundle (const File& manifest)
+{
+    namespace tags = LV2BundleTags;
+    ValueTree info (tags::bundle);
+    auto* const world = lilv_world_new();
+    const auto bundlePath = manifest.getParentDirectory().getFullPathName() + File::getSeparatorString();
+    auto* const bundleNode = lilv_new_file_uri (world, nullptr, bundlePath.toRawUTF8());
+    lilv_world_load_bundle (world, bundleNode);
+
+    const LilvPlugins* plugins = lilv_world_get_all_plugins (world);
+    LILV_FOREACH (plugins, iter, plugins)
+    {
+        const LilvPlugin* plugin = lilv_plugins_get (plugins, iter);
+        ValueTree child (tags::plugin);
+        child.setProperty (tags::uri, String::fromUTF8 (lilv_node_as_uri (lilv_plugin_get_uri (plugin))), nullptr);
+
+        if (auto* nameNode = lilv_plugin_get_name (plugin))
+        {
+            child.setProperty (tags::name, String::fromUTF8 (lilv_node_as_string (nameNode)), nullptr);
+            lilv_node_free (nameNode);
+        }
+
+        StringArray required;
+        if (auto* nodes = lilv_plugin_get_required_features (plugin))
+        {
+            LILV_FOREACH (nodes, i, nodes)
+                required.add (String::fromUTF8 (lilv_node_as_uri (lilv_nodes_get (nodes, i))));
+            lilv_nodes_free (nodes);
+        }
+
+        child.setProperty (tags::requiredFeatures, required.joinIntoString (" "), nullptr);
+        info.appendChild (child, nullptr);
+    }
+
+    lilv_node_free (bundleNode);
+    lilv_world_free (world);
+    return info;
+}
+
+/** Returns the indexed entry for a plugin and sets its bundle directory. */
+static ValueTree findIndexedPlugin (const FileIndex& index, const String& uri, File* bundle = nullptr)
+{
+    for (const auto& entry : *index.getEntries())
+    {
+        const auto child = entry.metadata.getChildWithProperty (LV2BundleTags::uri, uri);
+        if (child.isValid())
+        {
+            if (bundle != nullptr)
+                *bundle = entry.file.getParentDirectory();
+            return child;
+        }
+    }
+    return {};
+}
+
 //=============================================================================
 /** A generic feature.
 
@@ -150,7 +249,14 @@ World::World()
 
     lilv_world_set_option (world, LILV_OPTION_DYN_MANIFEST, trueNode);
 
-    lilv_world_load_all (world);
+    // nothing is parsed here: bundles load on demand and the index refreshes in the background
+    bundleIndex = std::make_unique<FileIndex> ("element: lv2 bundles",
+                                               DataPath::applicationDataDir().getChildFile ("cache/lv2bundles.index"),
+                                               "manifest.ttl",
+                                               readBundle);
+    bundleIndex->setDirectories (getBundleSearchPath());
+    bundleIndex->start (10000);
+
 #if JLV2_SUIL_INIT
     suil_init (nullptr, nullptr, SUIL_ARG_NONE);
 #endif
@@ -160,12 +266,9 @@ World::World()
                           LV2ModuleUI::portUnsubscribe);
     suil_host_set_touch_func (suil, LV2ModuleUI::touch);
 
-    currentThread = 0;
-    numThreads = JLV2_NUM_WORKERS;
-    for (int i = 0; i < numThreads; ++i)
-    {
-        threads.add (new WorkThread ("lv2_worker_" + String (i + 1), EL_LV2_RING_BUFFER_SIZE));
-    }
+    const int numWorkers = JLV2_NUM_WORKERS > 0 ? JLV2_NUM_WORKERS
+                                                : ThreadPools::getInstance().getNumThreads (ThreadPools::worker);
+    workers = std::make_unique<WorkerPool> ("lv2_worker", numWorkers, EL_LV2_RING_BUFFER_SIZE);
 
     addFeature (new GenericFeature (*symbolMap.map_feature()), false);
     addFeature (new GenericFeature (*symbolMap.unmap_feature()), false);
@@ -176,6 +279,7 @@ World::World()
 
 World::~World()
 {
+    bundleIndex.reset();
     features.clear();
 
 #define _node_free(n) lilv_node_free (const_cast<LilvNode*> (n))
@@ -237,7 +341,7 @@ void World::fillPluginDescription (const String& uri, PluginDescription& desc) c
 #endif
 }
 
-const LilvPlugin* World::getPlugin (const String& uri) const
+const LilvPlugin* World::findPlugin (const String& uri) const
 {
     LilvNode* p (lilv_new_uri (world, uri.toUTF8()));
     const LilvPlugin* plugin = lilv_plugins_get_by_uri (getAllPlugins(), p);
@@ -246,17 +350,73 @@ const LilvPlugin* World::getPlugin (const String& uri) const
     return plugin;
 }
 
+const LilvPlugin* World::getPlugin (const String& uri) const
+{
+    if (const auto* plugin = findPlugin (uri))
+        return plugin;
+
+    const ScopedLock sl (loadLock);
+    if (loadBundleFor (uri))
+        if (const auto* plugin = findPlugin (uri))
+            return plugin;
+
+    // not indexed yet, or the index is stale
+    loadAllBundles();
+    return findPlugin (uri);
+}
+
+void World::loadAllBundles() const
+{
+    const ScopedLock sl (loadLock);
+    if (loadedAll)
+        return;
+
+    // lilv reloads bundles that were loaded one at a time in place
+    lilv_world_load_all (world);
+    loadedAll = loadedCore = true;
+}
+
+bool World::loadBundleFor (const String& uri) const
+{
+    File bundle;
+    if (loadedAll || ! findIndexedPlugin (*bundleIndex, uri, &bundle).isValid())
+        return false;
+    if (loadedBundles.contains (bundle.getFullPathName()))
+        return false;
+
+    // the core bundle carries the plugin class hierarchy
+    if (! loadedCore)
+    {
+        loadedCore = true;
+        for (const auto& dir : getBundleSearchPath())
+            if (dir.getChildFile ("lv2core.lv2").isDirectory())
+                loadBundle (dir.getChildFile ("lv2core.lv2"));
+        lilv_world_load_specifications (world);
+        lilv_world_load_plugin_classes (world);
+    }
+
+    loadBundle (bundle);
+    return true;
+}
+
+void World::loadBundle (const File& bundle) const
+{
+    const auto path = bundle.getFullPathName() + File::getSeparatorString();
+    auto* const bundleNode = lilv_new_file_uri (world, nullptr, path.toRawUTF8());
+    lilv_world_load_bundle (world, bundleNode);
+    lilv_node_free (bundleNode);
+    loadedBundles.add (bundle.getFullPathName());
+}
+
 String World::getPluginName (const String& uri) const
 {
-    auto* uriNode = lilv_new_uri (world, uri.toRawUTF8());
-    const auto* plugin = lilv_plugins_get_by_uri (
-        lilv_world_get_all_plugins (world), uriNode);
-    lilv_node_free (uriNode);
-    uriNode = nullptr;
+    const auto indexed = findIndexedPlugin (*bundleIndex, uri);
+    if (indexed.isValid())
+        return indexed.getProperty (LV2BundleTags::name).toString();
 
     String name;
 
-    if (plugin != nullptr)
+    if (const auto* plugin = getPlugin (uri))
     {
         auto* nameNode = lilv_plugin_get_name (plugin);
         name = String::fromUTF8 (lilv_node_as_string (nameNode));
@@ -268,13 +428,36 @@ String World::getPluginName (const String& uri) const
 
 void World::getSupportedPlugins (StringArray& list) const
 {
-    const LilvPlugins* plugins (lilv_world_get_all_plugins (world));
-    LILV_FOREACH (plugins, iter, plugins)
+    // the index thread rescans in the background and sends a change message
+    const auto searchPath = getBundleSearchPath();
+    if (bundleIndex->getDirectories() != searchPath)
+        bundleIndex->setDirectories (searchPath);
+
+    const auto entries = bundleIndex->getEntries();
+    if (entries->empty())
     {
-        const LilvPlugin* plugin = lilv_plugins_get (plugins, iter);
-        const String uri = String::fromUTF8 (lilv_node_as_uri (lilv_plugin_get_uri (plugin)));
-        if (isPluginSupported (uri))
-            list.add (uri);
+        // nothing cached yet, e.g. on first launch
+        loadAllBundles();
+        const auto* plugins = getAllPlugins();
+        LILV_FOREACH (plugins, iter, plugins)
+        {
+            const auto* plugin = lilv_plugins_get (plugins, iter);
+            if (isPluginSupported (plugin))
+                list.addIfNotAlreadyThere (String::fromUTF8 (lilv_node_as_uri (lilv_plugin_get_uri (plugin))));
+        }
+        return;
+    }
+
+    for (const auto& entry : *entries)
+    {
+        for (const auto& plugin : entry.metadata)
+        {
+            bool supported = true;
+            for (const auto& feature : StringArray::fromTokens (plugin[LV2BundleTags::requiredFeatures].toString(), " ", {}))
+                supported &= isFeatureSupported (feature);
+            if (supported)
+                list.addIfNotAlreadyThere (plugin[LV2BundleTags::uri].toString());
+        }
     }
 }
 
@@ -283,18 +466,14 @@ const LilvPlugins* World::getAllPlugins() const
     return lilv_world_get_all_plugins (world);
 }
 
-WorkThread& World::getWorkThread()
+WorkerPool& World::getWorkerPool()
 {
-    while (threads.size() < numThreads)
-    {
-        threads.add (new WorkThread ("LV2 Worker " + String (threads.size()), EL_LV2_RING_BUFFER_SIZE));
-    }
-
-    const int threadIndex = currentThread;
-    if (++currentThread >= numThreads)
-        currentThread = 0;
+    return *workers;
+}
 
-    return *threads.getUnchecked (threadIndex);
+int32 World::getNumWorkThreads() const
+{
+    return workers->getNumThreads();
 }
 
 bool World::isFeatureSupported (const String& featureURI) const
@@ -17,11 +17,16 @@
 
 namespace element {
 
+class FileIndex;
 class LV2Module;
-class WorkThread;
+class WorkerPool;
 
 /** Slim wrapper around LilvWorld.  Publishes commonly used LilvNodes and
     manages heavy weight features (like LV2 Worker)
+
+    Bundles are loaded as their plugins are needed. A persistent index of
+    manifests maps plugin URIs to bundles and is kept current on a
+    background thread, so listing plugins doesn't parse every bundle either.
  */
 class World
 {
@@ -59,12 +64,23 @@ public:
     /** Fill a PluginDescription for a plugin uri */
     void fillPluginDescription (const String& uri, PluginDescription& desc) const;
 
-    /** Get an LilvPlugin for a uri string */
+    /** Get an LilvPlugin for a uri string. Loads the plugin's bundle if
+        needed, or every bundle if the index doesn't know the plugin. */
     const LilvPlugin* getPlugin (const String& uri) const;
 
-    /** Get all Available Plugins */
+    /** Get all plugins in the bundles loaded so far
+        @see loadAllBundles */
     const LilvPlugins* getAllPlugins() const;
 
+    /** Load every bundle on the LV2 path, like lilv_world_load_all */
+    void loadAllBundles() const;
+
+    /** Returns true once every bundle was loaded */
+    bool isFullyLoaded() const noexcept { return loadedAll; }
+
+    /** Returns the index of bundle manifests */
+    FileIndex& getBundleIndex() const { return *bundleIndex; }
+
     /** Returns true if a feature is supported */
     bool isFeatureSupported (const String& featureURI) const;
 
@@ -92,15 +108,18 @@ public:
         to a plugin instance */
     inline void getFeatures (Array<const LV2_Feature*>& feats) const { features.getFeatures (feats); }
 
-    /** Get a worker thread */
-    WorkThread& getWorkThread();
+    /** Get the pool that runs LV2 worker requests */
+    WorkerPool& getWorkerPool();
 
     /** Returns the total number of available worker threads */
-    inline int32 getNumWorkThreads() const { return numThreads; }
+    int32 getNumWorkThreads() const;
 
     /** Returns a plugin's name by URI, or empty if not found */
     String getPluginName (const String& uri) const;
 
+    /** Lists supported plugins from the bundle index as it is now. Bundles
+        the background scan finds later are announced by the index's change
+        message. Loads every bundle instead while the index is empty. */
     void getSupportedPlugins (StringArray&) const;
 
     inline SuilHost* getSuilHost() const { return suil; }
@@ -128,9 +147,16 @@ private:
     lvtk::Symbols symbolMap;
     LV2FeatureArray features;
 
-    // a simple rotating thread pool
-    int currentThread, numThreads;
-    OwnedArray<WorkThread> threads;
+    std::unique_ptr<WorkerPool> workers;
+
+    std::unique_ptr<FileIndex> bundleIndex;
+    CriticalSection loadLock;
+    mutable StringArray loadedBundles;
+    mutable bool loadedAll = false, loadedCore = false;
+
+    const LilvPlugin* findPlugin (const String& uri) const;
+    bool loadBundleFor (const String& uri) const;
+    void loadBundle (const File& bundle) const;
 };
 
 } // namespace element
@@ -14,6 +14,7 @@
 
 #include <element/ui/commands.hpp>
 #include "engine/midiengine.hpp"
+#include "engine/rendertrace.hpp"
 #include "scripting.hpp"
 #include <element/ui/commands.hpp>
 #include "datapath.hpp"
@@ -147,6 +148,7 @@ public:
             return;
         }
 
+        launchCommandLine = parseRenderTraceOption (commandLine);
         initializeModulePath();
         printCopyNotice();
         launchApplication();
@@ -165,6 +167,14 @@ public:
 
         workers.clearQuick (true);
 
+        if (renderTraceFile != File())
+        {
+            if (RenderTrace::getInstance().writeChromeTrace (renderTraceFile))
+                Logger::writeToLog ("[element] render trace written to " + renderTraceFile.getFullPathName());
+            else
+                Logger::writeToLog ("[element] could not write render trace: " + renderTraceFile.getFullPathName());
+        }
+
         auto engine (world->audio());
         auto& plugins (world->plugins());
         auto& settings (world->settings());
@@ -283,11 +293,12 @@ public:
         if (world->settings().checkForUpdates())
             startTimer (5000);
 
-        maybeOpenCommandLineFile (getCommandLineParameters());
+        maybeOpenCommandLineFile (launchCommandLine);
     }
 
 private:
     String launchCommandLine;
+    File renderTraceFile;
     std::unique_ptr<Context> world;
     std::unique_ptr<Startup> startup;
     OwnedArray<juce::ChildProcessWorker> workers;
@@ -324,6 +335,33 @@ private:
         return false;
     }
 
+    /** Enables render tracing when started with --render-trace=<file>.
+        Returns the command line with the option removed.
+     */
+    String parseRenderTraceOption (const String& commandLine)
+    {
+        StringArray args;
+        args.addTokens (commandLine, true);
+
+        for (int i = args.size(); --i >= 0;)
+        {
+            const auto arg = args[i].unquoted();
+            if (! arg.startsWith ("--render-trace="))
+                continue;
+
+            const auto path = arg.fromFirstOccurrenceOf ("=", false, false).unquoted();
+            if (path.isNotEmpty())
+            {
+                renderTraceFile = File::getCurrentWorkingDirectory().getChildFile (path);
+                RenderTrace::getInstance().setEnabled (true);
+            }
+
+            args.remove (i);
+        }
+
+        return args.joinIntoString (" ");
+    }
+
     void launchApplication()
     {
         if (startup != nullptr)
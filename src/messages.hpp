@@ -7,6 +7,8 @@
 #include <element/controller.hpp>
 #include <element/node.hpp>
 
+#include "graphdiff.hpp"
+
 namespace element {
 
 class Services;
@@ -29,7 +31,9 @@ struct AppMessage : public Message
 
     };
 
-    inline virtual void createActions (Services&, OwnedArray<UndoableAction>&) const {}
+    /** Adds the session edits this message makes. Edits run once, undo
+        and redo go through the GraphDiffAction they're recorded by. */
+    inline virtual void createEdits (Services&, GraphDiffAction::Edits&) const {}
 };
 
 struct AddMidiDeviceMessage : public AppMessage
@@ -68,7 +72,7 @@ struct RemoveNodeMessage : public AppMessage
     const Node node;
     NodeArray nodes;
 
-    virtual void createActions (Services& app, OwnedArray<UndoableAction>& actions) const;
+    void createEdits (Services& app, GraphDiffAction::Edits& edits) const override;
 };
 
 /** Send this to add a new connection */
@@ -103,7 +107,7 @@ struct AddConnectionMessage : public AppMessage
 
     inline bool useChannels() const { return sourceChannel >= 0 && destChannel >= 0; }
     inline bool usePorts() const { return ! useChannels(); }
-    void createActions (Services& app, OwnedArray<UndoableAction>& actions) const override;
+    void createEdits (Services& app, GraphDiffAction::Edits& edits) const override;
 };
 
 /** Send this to remove a connection from the graph */
@@ -138,7 +142,7 @@ public:
 
     inline bool useChannels() const { return sourceChannel >= 0 && destChannel >= 0; }
     inline bool usePorts() const { return ! useChannels(); }
-    void createActions (Services& app, OwnedArray<UndoableAction>& actions) const override;
+    void createEdits (Services& app, GraphDiffAction::Edits& edits) const override;
 };
 
 class AddNodeMessage : public Message
@@ -191,7 +195,7 @@ struct AddPluginMessage : public AppMessage
     const PluginDescription description;
     const bool verified;
     ConnectionBuilder builder;
-    void createActions (Services& app, OwnedArray<UndoableAction>& actions) const override;
+    void createEdits (Services& app, GraphDiffAction::Edits& edits) const override;
 };
 
 struct ReplaceNodeMessage : public AppMessage
@@ -352,17 +352,20 @@ ValueTree Node::parse (const File& file)
     return ValueTree();
 }
 
-void Node::sanitizeProperties (ValueTree node, const bool recursive)
+bool Node::isRuntimeProperty (const Identifier& type, const Identifier& property)
 {
-    node.removeProperty (tags::updater, nullptr);
-    node.removeProperty (tags::object, nullptr);
+    if (property == tags::updater || property == tags::object)
+        return true;
+    return type == types::Node
+           && (property == tags::offline || property == tags::placeholder || property == tags::missing);
+}
 
-    if (node.hasType (types::Node))
+void Node::sanitizeProperties (ValueTree node, const bool recursive)
+{
+    for (int i = node.getNumProperties(); --i >= 0;)
     {
-        Array<Identifier> properties ({ tags::offline,
-                                        tags::placeholder,
-                                        tags::missing });
-        for (const auto& property : properties)
+        const auto property = node.getPropertyName (i);
+        if (isRuntimeProperty (node.getType(), property))
             node.removeProperty (property, nullptr);
     }
 
@@ -582,12 +585,13 @@ void Node::getPossibleSources (NodeArray& a) const
     if (! nodes.hasType (tags::nodes))
         return;
 
+    // siblings share the parent, so only the node itself is excluded
+    const auto nodeId = getNodeId();
+    a.ensureStorageAllocated (a.size() + nodes.getNumChildren());
     for (int i = 0; i < nodes.getNumChildren(); ++i)
     {
         const Node child (nodes.getChild (i));
-        if (child.getNodeId() == getNodeId())
-            continue;
-        if (child.canConnectTo (*this))
+        if (child.getNodeId() != nodeId)
             a.add (child);
     }
 }
@@ -597,12 +601,12 @@ void Node::getPossibleDestinations (NodeArray& a) const
     ValueTree nodes = objectData.getParent();
     if (! nodes.hasType (tags::nodes))
         return;
+    const auto nodeId = getNodeId();
+    a.ensureStorageAllocated (a.size() + nodes.getNumChildren());
     for (int i = 0; i < nodes.getNumChildren(); ++i)
     {
         const Node child (nodes.getChild (i));
-        if (child.getNodeId() == getNodeId())
-            continue;
-        if (canConnectTo (child))
+        if (child.getNodeId() != nodeId)
             a.add (child);
     }
 }
@@ -781,6 +785,36 @@ MidiChannels Node::getMidiChannels() const
     return chans;
 }
 
+static int64 hashPluginState (const ValueTree& data)
+{
+    return data.getProperty (tags::state).toString().hashCode64()
+           ^ (data.getProperty (tags::programState).toString().hashCode64() * 31)
+           ^ ((int64) (int) data.getProperty (tags::program, -1) << 32);
+}
+
+static void saveProcessorState (AudioProcessor& proc, ValueTree objectData)
+{
+    MemoryBlock state;
+    proc.getStateInformation (state);
+    if (state.getSize() > 0)
+    {
+        objectData.setProperty (tags::state, state.toBase64Encoding(), nullptr);
+    }
+    else
+    {
+        const bool clearStateProperty = false;
+        if (clearStateProperty)
+            objectData.removeProperty (tags::state, 0);
+    }
+
+    state.reset();
+    proc.getCurrentProgramStateInformation (state);
+    if (state.getSize() > 0)
+    {
+        objectData.setProperty (tags::programState, state.toBase64Encoding(), 0);
+    }
+}
+
 void Node::restorePluginState()
 {
     if (! isValid())
@@ -790,12 +824,17 @@ void Node::restorePluginState()
     {
         if (auto* const proc = obj->getAudioProcessor())
         {
+            // a reused instance may already hold exactly this state
+            const auto stateHash = hashPluginState (objectData);
+            const bool alreadyApplied = ! obj->hasStateChangedSinceSave() && stateHash == obj->savedStateHash;
+            obj->savedStateHash = stateHash;
+
             const int wantedProgram = objectData.getProperty (tags::program, -1);
-            const bool shouldSetProgram = proc->getNumPrograms() > 0 && isPositiveAndBelow (wantedProgram, proc->getNumPrograms());
+            const bool shouldSetProgram = ! alreadyApplied && proc->getNumPrograms() > 0 && isPositiveAndBelow (wantedProgram, proc->getNumPrograms());
             if (shouldSetProgram)
                 proc->setCurrentProgram (wantedProgram);
 
-            auto data = getProperty (tags::state).toString().trim();
+            auto data = alreadyApplied ? String() : getProperty (tags::state).toString().trim();
             if (data.isNotEmpty())
             {
                 MemoryBlock state;
@@ -873,6 +912,7 @@ void Node::restorePluginState()
         obj->setUseGlobalMidiPrograms ((bool) getProperty (tags::globalMidiPrograms, obj->useGlobalMidiPrograms()));
         if (hasProperty (tags::midiProgramsState))
             obj->setMidiProgramsState (getProperty (tags::midiProgramsState).toString().trim());
+        obj->refreshMidiProgramBank();
 
         obj->setMuted ((bool) getProperty (tags::mute, obj->isMuted()));
         obj->setMuteInput ((bool) getProperty ("muteInput", obj->isMutingInputs()));
@@ -882,6 +922,7 @@ void Node::restorePluginState()
 
         obj->setOversamplingFactor (jmax (1, (int) getProperty (tags::oversamplingFactor, 1)));
         obj->setDelayCompensation (getProperty (tags::delayCompensation, 0.0));
+        obj->savedStateRevision = obj->getStateRevision();
     }
 
     // this was originally here to help reduce memory usage
@@ -896,6 +937,16 @@ void Node::restorePluginState()
 }
 
 void Node::savePluginState()
+{
+    saveState (false);
+}
+
+void Node::savePluginStateIfChanged()
+{
+    saveState (true);
+}
+
+void Node::saveState (bool onlyIfChanged)
 {
     if (! isValid())
         return;
@@ -907,27 +958,22 @@ void Node::savePluginState()
 
         if (auto* proc = obj->getAudioProcessor())
         {
-            proc->getStateInformation (state);
-            if (state.getSize() > 0)
-            {
-                objectData.setProperty (tags::state, state.toBase64Encoding(), nullptr);
-            }
-            else
-            {
-                const bool clearStateProperty = false;
-                if (clearStateProperty)
-                    objectData.removeProperty (tags::state, 0);
-            }
-
-            state.reset();
-            proc->getCurrentProgramStateInformation (state);
-            if (state.getSize() > 0)
+            const bool editorOpen = proc->getActiveEditor() != nullptr;
+            const bool unchanged = onlyIfChanged
+                                   && ! editorOpen
+                                   && ! obj->hasStateChangedSinceSave()
+                                   && hasProperty (tags::state);
+            if (! unchanged)
             {
-                objectData.setProperty (tags::programState, state.toBase64Encoding(), 0);
+                // editors can change state without notifying, so stay dirty while one is open
+                obj->savedStateRevision = obj->getStateRevision() - (editorOpen ? 1u : 0u);
+                saveProcessorState (*proc, objectData);
             }
 
             setProperty (tags::bypass, proc->isSuspended());
             setProperty (tags::program, proc->getCurrentProgram());
+            if (! unchanged)
+                obj->savedStateHash = hashPluginState (objectData);
         }
         else
         {
@@ -949,7 +995,7 @@ void Node::savePluginState()
     }
 
     for (int i = 0; i < getNumNodes(); ++i)
-        getNode (i).savePluginState();
+        getNode (i).saveState (onlyIfChanged);
 }
 
 namespace detail {
@@ -1194,6 +1240,7 @@ void Node::setUseGlobalMidiPrograms (bool useGlobal)
         if (obj->useGlobalMidiPrograms() == useGlobal)
             return;
         obj->setUseGlobalMidiPrograms (useGlobal);
+        obj->refreshMidiProgramBank();
         setProperty (tags::globalMidiPrograms, obj->useGlobalMidiPrograms());
     }
 }
@@ -1207,6 +1254,7 @@ void Node::setMidiProgramsEnabled (bool useMidiPrograms)
         if (obj->areMidiProgramsEnabled() == useMidiPrograms)
             return;
         obj->setMidiProgramsEnabled (useMidiPrograms);
+        obj->refreshMidiProgramBank();
         setProperty (tags::midiProgramsEnabled, obj->areMidiProgramsEnabled());
     }
 }
@@ -6,6 +6,7 @@
 #include "services/sessionservice.hpp"
 #include "services/mappingservice.hpp"
 #include "services/deviceservice.hpp"
+#include "engine/denormals.hpp"
 #include "engine/internalformat.hpp"
 #include <element/plugins.hpp>
 #include "ElementApp.h"
@@ -80,6 +81,9 @@ PluginProcessor::~PluginProcessor()
 
     engine->releaseExternalResources();
 
+    watchedState.removeListener (this);
+    context->plugins().clearReusableProcessors();
+
     if (auto session = context->session())
         session->clear();
 
@@ -243,7 +247,7 @@ bool PluginProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 
 void PluginProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midi)
 {
-    ScopedNoDenormals noDenormals;
+    const ScopedFlushDenormals flushDenormals;
 
     if (! shouldProcess.get())
     {
@@ -278,7 +282,8 @@ void PluginProcessor::getStateInformation (MemoryBlock& destData)
         return;
     if (auto session = context->session())
     {
-        session->saveGraphState();
+        watchSessionState (session->getValueTree());
+        session->saveChangedGraphState();
         session->getValueTree()
             .setProperty ("pluginEditorBounds", editorBounds.toString(), nullptr)
             .setProperty ("editorKeyboardFocus", editorWantsKeyboard, nullptr)
@@ -289,8 +294,7 @@ void PluginProcessor::getStateInformation (MemoryBlock& destData)
                 session->getValueTree().setProperty (
                     "pluginTransportPlaying", mon->playing.get(), nullptr);
 
-        auto ppData = session->getValueTree().getOrCreateChildWithName ("perfParams", nullptr);
-        ppData.removeAllChildren (nullptr);
+        ValueTree newParams ("perfParams");
         for (auto* const pp : perfparams)
         {
             if (! pp->haveNode())
@@ -299,14 +303,50 @@ void PluginProcessor::getStateInformation (MemoryBlock& destData)
             data.setProperty (tags::index, pp->getParameterIndex(), nullptr)
                 .setProperty (tags::node, pp->getNode().getUuidString(), nullptr)
                 .setProperty (tags::parameter, pp->getBoundParameter(), nullptr);
-            ppData.appendChild (data, nullptr);
+            newParams.appendChild (data, nullptr);
+        }
+
+        // only touch the tree when bindings changed so the cached state survives
+        auto ppData = session->getValueTree().getOrCreateChildWithName ("perfParams", nullptr);
+        if (! ppData.isEquivalentTo (newParams))
+        {
+            ppData.removeAllChildren (nullptr);
+            while (newParams.getNumChildren() > 0)
+            {
+                auto data = newParams.getChild (0);
+                newParams.removeChild (0, nullptr);
+                ppData.appendChild (data, nullptr);
+            }
         }
 
-        if (auto xml = std::unique_ptr<XmlElement> (session->createXml()))
-            copyXmlToBinary (*xml, destData);
+        if (cachedStateDirty || cachedState.isEmpty())
+        {
+            cachedState.reset();
+            if (auto xml = session->createXml())
+                copyXmlToBinary (*xml, cachedState);
+            {
+                MemoryOutputStream out (cachedState, true);
+                out.writeInt (binaryStateMagic);
+                out.writeInt (binaryStateVersion);
+                session->writeToStream (out);
+            }
+            cachedStateDirty = false;
+        }
+
+        destData = cachedState;
     }
 }
 
+void PluginProcessor::watchSessionState (const ValueTree& data)
+{
+    if (watchedState == data)
+        return;
+    watchedState.removeListener (this);
+    watchedState = data;
+    watchedState.addListener (this);
+    cachedStateDirty = true;
+}
+
 void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     PLUGIN_DBG ("[element] restore state: prepared: " << (int) prepared);
@@ -323,10 +363,35 @@ void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
 
     mapsctl->learn (false);
 
-    if (auto xml = getXmlFromBinary (data, sizeInBytes))
+    ValueTree newData;
+    bool haveData = false;
+
+    // the binary copy follows the legacy XML chunk, if there is one
+    int64 binaryOffset = 0;
+    if (sizeInBytes > 8 && ByteOrder::littleEndianInt (data) == xmlStateMagic)
+        binaryOffset = 9 + (int64) ByteOrder::littleEndianInt (addBytesToPointer (data, 4));
+
+    if ((int64) sizeInBytes - binaryOffset > 8
+        && ByteOrder::littleEndianInt (addBytesToPointer (data, binaryOffset)) == (uint32) binaryStateMagic
+        && (int) ByteOrder::littleEndianInt (addBytesToPointer (data, binaryOffset + 4)) <= binaryStateVersion)
+    {
+        newData = ValueTree::readFromData (addBytesToPointer (data, binaryOffset + 8),
+                                           (size_t) ((int64) sizeInBytes - binaryOffset - 8));
+        haveData = newData.isValid();
+    }
+
+    if (! haveData)
+    {
+        if (auto xml = getXmlFromBinary (data, sizeInBytes))
+        {
+            newData = ValueTree::fromXml (*xml);
+            haveData = true;
+        }
+    }
+
+    if (haveData)
     {
         String error;
-        ValueTree newData = ValueTree::fromXml (*xml);
         if (newData.isValid() && (int) newData.getProperty (tags::version, -1) != EL_SESSION_VERSION)
         {
             std::clog << "[element] migrate session...\n";
@@ -340,8 +405,19 @@ void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
                 error << ": el." << newData.getType().toString();
         }
 
-        if (error.isEmpty() && ! session->loadData (newData))
-            error = "Could not load session data.";
+        if (error.isEmpty())
+        {
+            // keep current plugin instances around so the reload can reuse them
+            auto& plugins = context->plugins();
+            plugins.clearReusableProcessors();
+            session->forEach ([&plugins] (const ValueTree& tree) {
+                if (tree.hasType (types::Node))
+                    plugins.retainProcessorForReuse (Node (tree, false));
+            });
+
+            if (! session->loadData (newData))
+                error = "Could not load session data.";
+        }
 
         if (error.isNotEmpty())
         {
@@ -434,6 +510,7 @@ void PluginProcessor::handleAsyncUpdate()
     PLUGIN_DBG ("[element] handle async update");
     initialize();
     reloadEngine();
+    context->plugins().clearReusableProcessors();
 
     auto session = context->session();
     const auto ppData = session->getValueTree().getChildWithName ("perfParams");
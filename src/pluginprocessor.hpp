@@ -325,7 +325,8 @@ private:
 };
 
 class PluginProcessor : public AudioProcessor,
-                        private AsyncUpdater
+                        private AsyncUpdater,
+                        private ValueTree::Listener
 {
 public:
     enum Variant
@@ -456,6 +457,24 @@ private:
 
     std::unique_ptr<AsyncPrepare> asyncPrepare;
 
+    /** State is saved as the legacy XML chunk, which older versions read,
+        followed by a binary copy of the session that loads faster. The
+        binary part starts with this ("ELSS") and a version number, newer
+        versions than binaryStateVersion fall back to the XML.
+     */
+    static constexpr int binaryStateMagic = 0x53534c45;
+    static constexpr int binaryStateVersion = 1;
+    static constexpr uint32 xmlStateMagic = 0x21324356; ///< written by copyXmlToBinary
+    MemoryBlock cachedState;
+    ValueTree watchedState;
+    bool cachedStateDirty = true;
+
+    void watchSessionState (const ValueTree& data);
+    void valueTreePropertyChanged (ValueTree&, const Identifier&) override { cachedStateDirty = true; }
+    void valueTreeChildAdded (ValueTree&, ValueTree&) override { cachedStateDirty = true; }
+    void valueTreeChildRemoved (ValueTree&, ValueTree&, int) override { cachedStateDirty = true; }
+    void valueTreeChildOrderChanged (ValueTree&, int, int) override { cachedStateDirty = true; }
+
     void initialize();
     friend class AsyncUpdater;
     void handleAsyncUpdate() override;
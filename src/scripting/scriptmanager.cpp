@@ -7,42 +7,61 @@
 #include "scripting/scriptmanager.hpp"
 #include "scripting/bindings.hpp"
 #include "datapath.hpp"
+#include "fileindex.hpp"
 #include "sol/sol.hpp"
 
 namespace element {
 
-static void scanForScripts (File dir, Array<ScriptInfo>& results, bool recursive = true)
+static File getDefaultScriptsDir()
 {
-    for (DirectoryEntry entry : RangedDirectoryIterator (dir, recursive, "*.lua"))
-    {
-        ScriptInfo desc;
-        try
-        {
-            desc = ScriptInfo::parse (entry.getFile());
-        } catch (const std::exception& e)
-        {
-            DBG (e.what());
-            desc = {};
-        }
-
-        if (desc.valid())
-        {
-            results.add (desc);
-        }
-    }
+    return ScriptManager::getSystemScriptsDir();
 }
 
-static File getDefaultScriptsDir()
+static ValueTree readScriptInfo (const File& file)
 {
-    return ScriptManager::getSystemScriptsDir();
+    ScriptInfo desc;
+    try
+    {
+        desc = ScriptInfo::parse (file);
+    } catch (const std::exception& e)
+    {
+        DBG (e.what());
+        desc = {};
+    }
+
+    if (! desc.valid())
+        return {};
+
+    ValueTree info ("script");
+    info.setProperty ("name", desc.name, nullptr)
+        .setProperty ("type", desc.type, nullptr)
+        .setProperty ("author", desc.author, nullptr)
+        .setProperty ("description", desc.description, nullptr)
+        .setProperty ("code", desc.code, nullptr);
+    return info;
 }
 
 //==============================================================================
-class ScriptManager::Registry
+class ScriptManager::Registry : private ChangeListener
 {
 public:
     Registry (ScriptManager& sm)
-        : owner (sm) {}
+        : owner (sm),
+          index ("element: scripts",
+                 DataPath::applicationDataDir().getChildFile ("cache/scripts.index"),
+                 "*.lua",
+                 readScriptInfo)
+    {
+        index.addChangeListener (this);
+        index.start();
+        rebuild();
+    }
+
+    ~Registry()
+    {
+        index.removeChangeListener (this);
+        index.stop();
+    }
 
     void scanDefaults()
     {
@@ -54,14 +73,34 @@ public:
         if (! dir.isDirectory())
             return;
 
+        // only files changed since the cache was written get parsed here.
+        index.addDirectory (dir);
+        index.scanNow();
+        rebuild();
+    }
+
+    void rebuild()
+    {
         Array<ScriptInfo> results;
-        scanForScripts (dir, results);
         Array<ScriptInfo> newDSP;
         Array<ScriptInfo> newDSPUI;
 
-        for (int i = 0; i < results.size(); ++i)
+        for (const auto& entry : *index.getEntries())
         {
-            const auto d = results[i];
+            const auto& info = entry.metadata;
+            if (! info.isValid())
+                continue;
+
+            ScriptInfo d;
+            d.name = info["name"].toString();
+            d.type = info["type"].toString();
+            d.author = info["author"].toString();
+            d.description = info["description"].toString();
+            d.code = info["code"].toString();
+            if (! d.valid())
+                continue;
+
+            results.add (d);
             if (d.type.toLowerCase() == "dsp")
             {
                 newDSP.add (d);
@@ -80,8 +119,11 @@ public:
 private:
     friend class ScriptManager;
     ScriptManager& owner;
+    FileIndex index;
     Array<ScriptInfo> scripts;
     Array<ScriptInfo> dsp, dspui;
+
+    void changeListenerCallback (ChangeBroadcaster*) override { rebuild(); }
 };
 
 //==============================================================================
@@ -12,6 +12,8 @@
 #include <element/ui/updater.hpp>
 
 #include "services/sessionservice.hpp"
+#include "graphdiff.hpp"
+#include "engine/rendertrace.hpp"
 #include "gui/views/VirtualKeyboardView.h"
 #include "gui/AboutComponent.h"
 #include "gui/GuiCommon.h"
@@ -662,6 +664,8 @@ void GuiService::getAllCommands (Array<CommandID>& ids)
                     Commands::exportGraph,
                     //======================================================================
                     Commands::panic,
+                    Commands::recordRenderTrace,
+                    Commands::exportRenderTrace,
                     //======================================================================
                     Commands::checkNewerVersion,
                     //======================================================================
@@ -761,6 +765,14 @@ void GuiService::getCommandInfo (CommandID commandID, ApplicationCommandInfo& re
             result.addDefaultKeypress ('p', ModifierKeys::altModifier | ModifierKeys::commandModifier);
             result.setInfo ("Panic!", "Sends all notes off to the engine", "Engine", 0);
             break;
+        case Commands::recordRenderTrace:
+            result.setInfo ("Record Render Trace", "Record per-node render timing", "Engine", 0);
+            result.setTicked (RenderTrace::getInstance().isEnabled());
+            break;
+        case Commands::exportRenderTrace:
+            result.setInfo ("Export Render Trace", "Export recorded render timing as a Chrome/Perfetto trace", "Engine", 0);
+            result.setActive (RenderTrace::getInstance().isEnabled());
+            break;
         //======================================================================
         case Commands::checkNewerVersion:
             result.setInfo ("Check For Updates", "Check newer version", "Application", 0);
@@ -976,6 +988,24 @@ bool GuiService::perform (const InvocationInfo& info)
             }
             break;
         }
+        case Commands::recordRenderTrace: {
+            auto& trace = RenderTrace::getInstance();
+            if (! trace.isEnabled())
+                trace.clear();
+            trace.setEnabled (! trace.isEnabled());
+            refreshMainMenu();
+            break;
+        }
+        case Commands::exportRenderTrace: {
+            auto file = File::getSpecialLocation (File::userDocumentsDirectory)
+                            .getChildFile ("element-trace.json")
+                            .getNonexistentSibling();
+            FileChooser chooser (TRANS ("Export Render Trace"), file, "*.json");
+            if (chooser.browseForFileToSave (true))
+                if (! RenderTrace::getInstance().writeChromeTrace (chooser.getResult()))
+                    AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "Render Trace", "Could not write the trace file.");
+            break;
+        }
         //======================================================================
         case Commands::checkNewerVersion:
             updates->showAlertWhenNoUpdatesReady = true;
@@ -1081,15 +1111,14 @@ KeyListener* GuiService::getKeyListener() const { return keys.get(); }
 
 bool GuiService::handleMessage (const AppMessage& msg)
 {
-    OwnedArray<UndoableAction> actions;
-    msg.createActions (services(), actions);
-    if (! actions.isEmpty())
+    GraphDiffAction::Edits edits;
+    msg.createEdits (services(), edits);
+    if (! edits.empty())
     {
         auto& undo = impl->undo;
         undo.beginNewTransaction();
-        for (auto* action : actions)
-            undo.perform (action);
-        actions.clearQuick (false);
+        // history keeps the diff of all the message's edits, applied as one rebuild
+        undo.perform (new GraphDiffAction (services(), std::move (edits)));
         stabilizeViews();
         return true;
     }
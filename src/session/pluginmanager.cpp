@@ -10,6 +10,7 @@
 #include "engine/nodes/NodeTypes.h"
 #include "engine/ionode.hpp"
 #include "datapath.hpp"
+#include "threadpools.hpp"
 #include "utils.hpp"
 
 #define EL_DEAD_AUDIO_PLUGINS_FILENAME "scanner/crashed.txt"
@@ -580,6 +581,7 @@ private:
 
     void run() override
     {
+        ThreadPools::getInstance().applyToCurrentThread (ThreadPools::worker);
         cancelFlag.set (0);
 
         PluginManager pluginManager;
@@ -656,6 +658,19 @@ private:
     std::unique_ptr<PluginScanner> scanner;
     bool hasAddedFormats = false;
 
+    struct ReusableProcessor
+    {
+        String key;
+        ProcessorPtr object;
+    };
+    OwnedArray<ReusableProcessor> reusable;
+
+    static String reuseKey (const Node& node)
+    {
+        return node.getUuidString() + "|" + node.getFormat().toString()
+               + "|" + node.getIdentifier().toString();
+    }
+
     void scanAudioPlugins (const StringArray& names)
     {
         if (scanner)
@@ -1088,6 +1103,41 @@ void PluginManager::saveDefaultNode (const Node& node)
     node.writeToFile (file);
 }
 
+void PluginManager::retainProcessorForReuse (const Node& node)
+{
+    ProcessorPtr object = node.getObject();
+    if (object == nullptr || object->isSubGraph() || node.isIONode()
+        || node.getUuidString().isEmpty() || object->getAudioProcessor() == nullptr)
+        return;
+
+    auto* item = priv->reusable.add (new Private::ReusableProcessor());
+    item->key = Private::reuseKey (node);
+    item->object = object;
+}
+
+ProcessorPtr PluginManager::takeReusableProcessor (const Node& node)
+{
+    const auto key = Private::reuseKey (node);
+
+    for (int i = 0; i < priv->reusable.size(); ++i)
+    {
+        auto* item = priv->reusable.getUnchecked (i);
+        if (item->key != key)
+            continue;
+
+        ProcessorPtr object = item->object;
+        priv->reusable.remove (i);
+        return object;
+    }
+
+    return nullptr;
+}
+
+void PluginManager::clearReusableProcessors()
+{
+    priv->reusable.clear();
+}
+
 Node PluginManager::getDefaultNode (const PluginDescription& desc) const
 {
     auto file = DataPath::applicationDataDir().getChildFile ("nodes");
@@ -19,14 +19,25 @@
 
 #pragma once
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include <element/node.hpp>
 #include <element/presets.hpp>
 
 #include "datapath.hpp"
+#include "fileindex.hpp"
 
 namespace element {
 
-class PresetManager
+/** Presets for all plugins, grouped by format and identifier.
+
+    Metadata comes from a persistent FileIndex watching the user's presets
+    directory, so queries never touch the disk. Preset bodies are parsed from
+    PresetInfo::file only when a preset is loaded.
+ */
+class PresetManager : private ChangeListener
 {
 public:
     struct SortByName
@@ -43,8 +54,23 @@ public:
         }
     };
 
-    PresetManager() {}
-    ~PresetManager() {}
+    PresetManager()
+        : index ("element: presets",
+                 DataPath::applicationDataDir().getChildFile ("cache/presets.index"),
+                 EL_PRESET_FILE_EXTENSIONS,
+                 &PresetManager::readPreset)
+    {
+        index.setDirectories ({ path.getRootDir().getChildFile ("Presets") });
+        index.addChangeListener (this);
+        index.start();
+        rebuild();
+    }
+
+    ~PresetManager()
+    {
+        index.removeChangeListener (this);
+        index.stop();
+    }
 
     inline void clear()
     {
@@ -53,10 +79,12 @@ public:
 
     inline void getPresetsFor (const Node& node, OwnedArray<PresetInfo>& results) const
     {
-        SortByName sorter;
-        for (const auto* const preset : presets)
-            if (preset->ID == node.getIdentifier().toString() && preset->format == node.getFormat().toString())
-                results.addSorted (sorter, new PresetInfo (*preset));
+        const auto found = presets.find (makeKey (node.getFormat().toString().toStdString(),
+                                                  node.getIdentifier().toString().toStdString()));
+        if (found == presets.end())
+            return;
+        for (const auto& preset : found->second)
+            results.add (new PresetInfo (preset));
     }
 
     inline void addPresetFor (const Node& node, const String& name)
@@ -64,40 +92,73 @@ public:
         jassertfalse;
     }
 
+    /** Rescan the presets directory in the background. */
     inline void refresh()
     {
-        clear();
+        index.refresh();
+    }
+
+    /** Returns the index of preset files. */
+    FileIndex& getIndex() noexcept { return index; }
 
-        StringArray files;
-        path.findPresetFiles (files);
+private:
+    DataPath path;
+    FileIndex index;
+    std::unordered_map<std::string, std::vector<PresetInfo>> presets;
+
+    static std::string makeKey (const std::string& format, const std::string& ID)
+    {
+        return format + "\n" + ID;
+    }
 
-        for (const auto& filename : files)
+    static ValueTree readPreset (const File& file)
+    {
+        const Node node (Node::parse (file), false);
+        if (! node.isValid())
+            return {};
+
+        ValueTree info ("preset");
+        info.setProperty (tags::name, node.getName(), nullptr)
+            .setProperty (tags::format, node.getFormat().toString(), nullptr)
+            .setProperty (tags::identifier, node.getIdentifier().toString(), nullptr);
+        return info;
+    }
+
+    void changeListenerCallback (ChangeBroadcaster*) override
+    {
+        rebuild();
+    }
+
+    void rebuild()
+    {
+        clear();
+
+        for (const auto& entry : *index.getEntries())
         {
-            const File file (filename);
-            const Node node (Node::parse (file), false);
-            if (node.isValid())
-            {
-                std::unique_ptr<PresetInfo> item;
-                item.reset (new PresetInfo());
-                item->file = file.getFullPathName().toStdString();
-                item->name = node.getName().toStdString();
-                if (item->name.empty())
-                    item->name = file.getFileNameWithoutExtension().toStdString();
-                item->format = node.getFormat().toString().toStdString();
-                item->ID = node.getIdentifier().toString().toStdString();
-                if (item->format.empty() || item->ID.empty())
-                    continue;
-
-                presets.add (item.release());
-            }
+            const auto& info = entry.metadata;
+            if (! info.isValid())
+                continue;
+
+            PresetInfo item;
+            item.file = entry.file.getFullPathName().toStdString();
+            item.name = info[tags::name].toString().toStdString();
+            if (item.name.empty())
+                item.name = entry.file.getFileNameWithoutExtension().toStdString();
+            item.format = info[tags::format].toString().toStdString();
+            item.ID = info[tags::identifier].toString().toStdString();
+            if (item.format.empty() || item.ID.empty())
+                continue;
+
+            presets[makeKey (item.format, item.ID)].push_back (item);
         }
 
-        presets.minimiseStorageOverheads();
+        for (auto& group : presets)
+        {
+            std::sort (group.second.begin(), group.second.end(), [] (const PresetInfo& a, const PresetInfo& b) {
+                return a.name < b.name;
+            });
+        }
     }
-
-private:
-    DataPath path;
-    OwnedArray<PresetInfo> presets;
 };
 
 } // namespace element
@@ -116,11 +116,54 @@ bool Session::loadData (const ValueTree& data)
     return true;
 }
 
+namespace {
+/** Drops the attributes Node::sanitizeProperties would have removed. */
+static void sanitizeXml (XmlElement& e)
+{
+    const Identifier type (e.getTagName());
+    for (int i = e.getNumAttributes(); --i >= 0;)
+    {
+        const Identifier attribute (e.getAttributeName (i));
+        if (Node::isRuntimeProperty (type, attribute))
+            e.removeAttribute (attribute);
+    }
+
+    for (auto* child : e.getChildIterator())
+        sanitizeXml (*child);
+}
+
+/** Writes the same data as ValueTree::writeToStream would for a sanitized
+    copy of tree, without making the copy. */
+static void writeSanitized (const ValueTree& tree, OutputStream& output)
+{
+    const auto type = tree.getType();
+    int numProperties = 0;
+    for (int i = 0; i < tree.getNumProperties(); ++i)
+        numProperties += Node::isRuntimeProperty (type, tree.getPropertyName (i)) ? 0 : 1;
+
+    output.writeString (type.toString());
+    output.writeCompressedInt (numProperties);
+    for (int i = 0; i < tree.getNumProperties(); ++i)
+    {
+        const auto property = tree.getPropertyName (i);
+        if (Node::isRuntimeProperty (type, property))
+            continue;
+        output.writeString (property.toString());
+        tree.getProperty (property).writeToStream (output);
+    }
+
+    output.writeCompressedInt (tree.getNumChildren());
+    for (const auto& child : tree)
+        writeSanitized (child, output);
+}
+} // namespace
+
 std::unique_ptr<XmlElement> Session::createXml() const
 {
-    ValueTree saveData = objectData.createCopy();
-    Node::sanitizeProperties (saveData, true);
-    return saveData.createXml();
+    auto xml = objectData.createXml();
+    if (xml != nullptr)
+        sanitizeXml (*xml);
+    return xml;
 }
 
 void Session::setMissingProperties (bool resetExisting)
@@ -247,6 +290,12 @@ void Session::saveGraphState()
         getGraph (i).savePluginState();
 }
 
+void Session::saveChangedGraphState()
+{
+    for (int i = 0; i < getNumGraphs(); ++i)
+        getGraph (i).savePluginStateIfChanged();
+}
+
 void Session::restoreGraphState()
 {
     for (int i = 0; i < getNumGraphs(); ++i)
@@ -299,17 +348,20 @@ void Session::setActiveGraph (int index)
         .setProperty (tags::active, index, nullptr);
 }
 
+void Session::writeToStream (OutputStream& output) const
+{
+    writeSanitized (objectData, output);
+}
+
 bool Session::writeToFile (const File& file) const
 {
-    ValueTree saveData = objectData.createCopy();
-    Node::sanitizeProperties (saveData, true);
     TemporaryFile tempFile (file);
 
     if (auto fos = tempFile.getFile().createOutputStream())
     {
         {
             GZIPCompressorOutputStream gzip (*fos, 9);
-            saveData.writeToStream (gzip);
+            writeToStream (gzip);
         }
         fos.reset();
         return tempFile.overwriteTargetFileWithTemporary();
@@ -35,6 +35,14 @@ const char* Settings::pluginListHeaderKey = "pluginListHeader";
 const char* Settings::devicesKey = "devices";
 const char* Settings::keymappingsKey = "keymappings";
 const char* Settings::clockSourceKey = "clockSource";
+const char* Settings::renderBlockSizeKey = "renderBlockSize";
+const char* Settings::fixedRenderBlockKey = "fixedRenderBlock";
+const char* Settings::renderLookaheadKey = "renderLookahead";
+const char* Settings::doublePrecisionKey = "doublePrecision";
+const char* Settings::realtimePriorityKey = "realtimePriority";
+const char* Settings::workerThreadsKey = "workerThreads";
+const char* Settings::ioThreadsKey = "ioThreads";
+const char* Settings::threadAffinityKey = "threadAffinity";
 
 //=============================================================================
 enum OptionsMenuItemId
@@ -407,6 +415,112 @@ void Settings::setClockSource (const juce::String& src)
         p->setValue (clockSourceKey, src);
 }
 
+//=============================================================================
+int Settings::getRenderBlockSize() const
+{
+    if (auto* p = getProps())
+        return jmax (0, p->getIntValue (renderBlockSizeKey, 0));
+    return 0;
+}
+
+void Settings::setRenderBlockSize (int blockSize)
+{
+    if (auto* p = getProps())
+        p->setValue (renderBlockSizeKey, jmax (0, blockSize));
+}
+
+bool Settings::isRenderBlockSizeFixed() const
+{
+    if (auto* p = getProps())
+        return p->getBoolValue (fixedRenderBlockKey, false);
+    return false;
+}
+
+void Settings::setRenderBlockSizeFixed (bool fixed)
+{
+    if (auto* p = getProps())
+        p->setValue (fixedRenderBlockKey, fixed);
+}
+
+int Settings::getRenderLookahead() const
+{
+    if (auto* p = getProps())
+        return jlimit (0, 16, p->getIntValue (renderLookaheadKey, 0));
+    return 0;
+}
+
+void Settings::setRenderLookahead (int numBlocks)
+{
+    if (auto* p = getProps())
+        p->setValue (renderLookaheadKey, jlimit (0, 16, numBlocks));
+}
+
+bool Settings::useDoublePrecision() const
+{
+    if (auto* p = getProps())
+        return p->getBoolValue (doublePrecisionKey, false);
+    return false;
+}
+
+void Settings::setUseDoublePrecision (bool useDouble)
+{
+    if (auto* p = getProps())
+        p->setValue (doublePrecisionKey, useDouble);
+}
+
+int Settings::getRealtimePriority() const
+{
+    if (auto* p = getProps())
+        return jlimit (0, 99, p->getIntValue (realtimePriorityKey, 0));
+    return 0;
+}
+
+void Settings::setRealtimePriority (int priority)
+{
+    if (auto* p = getProps())
+        p->setValue (realtimePriorityKey, jlimit (0, 99, priority));
+}
+
+int Settings::getWorkerThreads() const
+{
+    if (auto* p = getProps())
+        return jlimit (0, 64, p->getIntValue (workerThreadsKey, 0));
+    return 0;
+}
+
+void Settings::setWorkerThreads (int numThreads)
+{
+    if (auto* p = getProps())
+        p->setValue (workerThreadsKey, jlimit (0, 64, numThreads));
+}
+
+int Settings::getIOThreads() const
+{
+    if (auto* p = getProps())
+        return jlimit (0, 16, p->getIntValue (ioThreadsKey, 0));
+    return 0;
+}
+
+void Settings::setIOThreads (int numThreads)
+{
+    if (auto* p = getProps())
+        p->setValue (ioThreadsKey, jlimit (0, 16, numThreads));
+}
+
+juce::uint64 Settings::getThreadAffinity (const String& pool) const
+{
+    // stored as hex, like the masks taskset takes
+    if (auto* p = getProps())
+        return (juce::uint64) p->getValue (String (threadAffinityKey) + "." + pool).getHexValue64();
+    return 0;
+}
+
+void Settings::setThreadAffinity (const String& pool, juce::uint64 mask)
+{
+    if (auto* p = getProps())
+        p->setValue (String (threadAffinityKey) + "." + pool, String::toHexString ((juce::int64) mask));
+}
+
 //=============================================================================
 void Settings::addItemsToMenu (Context& world, PopupMenu& menu)
 {
@@ -0,0 +1,345 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#include <element/settings.hpp>
+
+#include "engine/denormals.hpp"
+#include "threadpools.hpp"
+
+#include <mutex>
+
+#if JUCE_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace element {
+
+using namespace juce;
+
+namespace {
+static int defaultNumThreads (ThreadPools::Kind kind)
+{
+    switch (kind)
+    {
+        case ThreadPools::worker:
+            return jlimit (2, 4, SystemStats::getNumCpus() / 2);
+        case ThreadPools::io:
+            return 2;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static thread_local int appliedGeneration[ThreadPools::numKinds] = { -1, -1, -1 };
+
+static std::mutex sharedMutex;
+static std::weak_ptr<ThreadPools> shared;
+static std::atomic<ThreadPools*> running { nullptr };
+} // namespace
+
+//=============================================================================
+class ThreadPools::JobThread : public Thread
+{
+public:
+    JobThread (ThreadPools& p, Kind k, int index)
+        : Thread (String ("element_") + getKindName (k) + "_" + String (index)),
+          pools (p),
+          kind (k)
+    {
+    }
+
+    ~JobThread() override
+    {
+        stopThread (-1);
+    }
+
+    void run() override
+    {
+        flushDenormalsOnThisThread();
+        std::function<void()> job;
+        while (! threadShouldExit())
+        {
+            if (pools.nextJob (kind, job))
+            {
+                pools.applyToCurrentThreadIfChanged (kind);
+                job();
+                job = nullptr;
+            }
+        }
+    }
+
+private:
+    ThreadPools& pools;
+    const Kind kind;
+};
+
+//=============================================================================
+/** Applies the io options on a time slice thread, then removes itself. */
+class ThreadPools::ApplyClient : public TimeSliceClient
+{
+public:
+    explicit ApplyClient (ThreadPools& p) : pools (p) {}
+
+    int useTimeSlice() override
+    {
+        pools.applyToCurrentThreadIfChanged (io);
+        return -1;
+    }
+
+private:
+    ThreadPools& pools;
+};
+
+//=============================================================================
+ThreadPools::ThreadPools()
+{
+    for (auto& g : generation)
+        g.store (0);
+    running.store (this);
+}
+
+ThreadPools::~ThreadPools()
+{
+    running.store (nullptr);
+    shutdown();
+    for (auto* thread : ioThreads)
+        thread->stopThread (2000);
+    ioThreads.clear();
+    ioClients.clear();
+}
+
+std::shared_ptr<ThreadPools> ThreadPools::acquire()
+{
+    const std::lock_guard<std::mutex> sl (sharedMutex);
+    auto pools = shared.lock();
+    if (pools == nullptr)
+    {
+        pools.reset (new ThreadPools());
+        shared = pools;
+    }
+    return pools;
+}
+
+ThreadPools& ThreadPools::getInstance()
+{
+    auto* const pools = running.load();
+    jassert (pools != nullptr); // held by a Context, or a test fixture
+    return *pools;
+}
+
+const char* ThreadPools::getKindName (Kind kind) noexcept
+{
+    switch (kind)
+    {
+        case realtime:
+            return "realtime";
+        case worker:
+            return "worker";
+        case io:
+            return "io";
+        default:
+            break;
+    }
+    return "";
+}
+
+void ThreadPools::setOptions (Kind kind, const Options& newOptions)
+{
+    jassert (isPositiveAndBelow (kind, (int) numKinds));
+    {
+        const ScopedLock sl (lock);
+        if (options[kind] == newOptions)
+            return;
+        options[kind] = newOptions;
+        published[kind].store (newOptions);
+        generation[kind].fetch_add (1, std::memory_order_release);
+        if (pools[kind].threads.size() > 0)
+            resizePool (kind);
+    }
+
+    if (kind == io)
+        reapplyIOThreads();
+}
+
+ThreadPools::Options ThreadPools::getOptions (Kind kind) const
+{
+    const ScopedLock sl (lock);
+    return options[kind];
+}
+
+int ThreadPools::getNumThreads (Kind kind) const
+{
+    const ScopedLock sl (lock);
+    return options[kind].numThreads > 0 ? options[kind].numThreads : defaultNumThreads (kind);
+}
+
+void ThreadPools::applySettings (const Settings& settings)
+{
+    Options rt;
+    rt.priority = settings.getRealtimePriority();
+    rt.affinity = settings.getThreadAffinity (getKindName (realtime));
+    setOptions (realtime, rt);
+
+    Options wk;
+    wk.numThreads = settings.getWorkerThreads();
+    wk.affinity = settings.getThreadAffinity (getKindName (worker));
+    setOptions (worker, wk);
+
+    Options fs;
+    fs.numThreads = settings.getIOThreads();
+    fs.affinity = settings.getThreadAffinity (getKindName (io));
+    setOptions (io, fs);
+}
+
+bool ThreadPools::applyToCurrentThread (Kind kind) const
+{
+    const auto opts = published[kind].load();
+    bool ok = true;
+
+#if JUCE_LINUX
+    if (kind == realtime && opts.priority > 0)
+    {
+        sched_param param {};
+        param.sched_priority = jlimit (sched_get_priority_min (SCHED_FIFO),
+                                       sched_get_priority_max (SCHED_FIFO),
+                                       opts.priority);
+        ok = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param) == 0 && ok;
+    }
+
+    if (opts.affinity != 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO (&cpus);
+        for (int cpu = 0; cpu < jmin (64, (int) CPU_SETSIZE); ++cpu)
+            if ((opts.affinity & ((uint64) 1 << cpu)) != 0)
+                CPU_SET (cpu, &cpus);
+        ok = pthread_setaffinity_np (pthread_self(), sizeof (cpu_set_t), &cpus) == 0 && ok;
+    }
+#else
+    // JUCE only sets priorities when threads start, and masks of 32 cpus
+    if (opts.affinity != 0)
+        Thread::setCurrentThreadAffinityMask ((uint32) opts.affinity);
+#endif
+
+    return ok;
+}
+
+void ThreadPools::applyToCurrentThreadIfChanged (Kind kind)
+{
+    const int current = generation[kind].load (std::memory_order_acquire);
+    if (appliedGeneration[kind] == current)
+        return;
+    appliedGeneration[kind] = current;
+    applyToCurrentThread (kind);
+}
+
+void ThreadPools::addJob (Kind kind, std::function<void()> job)
+{
+    jassert (kind == worker || kind == io);
+    if (kind != worker && kind != io)
+        return;
+
+    const ScopedLock sl (lock);
+    auto& pool = pools[kind];
+    pool.jobs.push_back (std::move (job));
+    if (pool.threads.isEmpty())
+        resizePool (kind);
+    pool.jobAdded.signal();
+}
+
+bool ThreadPools::nextJob (Kind kind, std::function<void()>& job)
+{
+    auto& pool = pools[kind];
+    {
+        const ScopedLock sl (lock);
+        if (! pool.jobs.empty())
+        {
+            job = std::move (pool.jobs.front());
+            pool.jobs.pop_front();
+            // pass the wakeup on if there's more to do
+            if (! pool.jobs.empty())
+                pool.jobAdded.signal();
+            return true;
+        }
+    }
+
+    pool.jobAdded.wait (500);
+    return false;
+}
+
+void ThreadPools::resizePool (Kind kind)
+{
+    // called with the lock held
+    auto& pool = pools[kind];
+    const int numThreads = options[kind].numThreads > 0 ? options[kind].numThreads : defaultNumThreads (kind);
+
+    while (pool.threads.size() < numThreads)
+    {
+        auto* thread = pool.threads.add (new JobThread (*this, kind, pool.threads.size()));
+        thread->startThread (kind == io ? Thread::Priority::low : Thread::Priority::normal);
+    }
+
+    if (pool.threads.size() > numThreads)
+    {
+        // surplus threads finish their job and exit, deleting them
+        // happens outside the lock so they can take it to finish
+        OwnedArray<JobThread> surplus;
+        while (pool.threads.size() > numThreads)
+        {
+            auto* thread = pool.threads.removeAndReturn (pool.threads.size() - 1);
+            thread->signalThreadShouldExit();
+            surplus.add (thread);
+        }
+
+        pool.jobAdded.signal();
+        const ScopedUnlock sul (lock);
+        surplus.clear();
+    }
+}
+
+void ThreadPools::shutdown()
+{
+    for (int k = 0; k < numKinds; ++k)
+    {
+        OwnedArray<JobThread> stopping;
+        {
+            const ScopedLock sl (lock);
+            auto& pool = pools[k];
+            pool.jobs.clear();
+            stopping.swapWith (pool.threads);
+        }
+
+        for (auto* thread : stopping)
+            thread->signalThreadShouldExit();
+        pools[k].jobAdded.signal();
+        stopping.clear();
+    }
+}
+
+TimeSliceThread& ThreadPools::getIOThread()
+{
+    const ScopedLock sl (lock);
+    const int numThreads = options[io].numThreads > 0 ? options[io].numThreads : defaultNumThreads (io);
+
+    // io threads are shared by reference, so they only ever grow
+    while (ioThreads.size() < numThreads)
+    {
+        auto* thread = ioThreads.add (new TimeSliceThread ("element_io_" + String (ioThreads.size())));
+        thread->addTimeSliceClient (ioClients.add (new ApplyClient (*this)));
+        thread->startThread (Thread::Priority::low);
+    }
+
+    nextIOThread = (nextIOThread + 1) % ioThreads.size();
+    return *ioThreads.getUnchecked (nextIOThread);
+}
+
+void ThreadPools::reapplyIOThreads()
+{
+    const ScopedLock sl (lock);
+    for (int i = 0; i < ioThreads.size(); ++i)
+        ioThreads.getUnchecked (i)->addTimeSliceClient (ioClients.getUnchecked (i));
+}
+
+} // namespace element
@@ -0,0 +1,156 @@
+// Copyright 2023 Kushview, LLC <info@kushview.net>
+// SPDX-License-Identifier: GPL3-or-later
+
+#pragma once
+
+#include <element/atomic.hpp>
+#include <element/juce/core.hpp>
+#include <element/juce/events.hpp>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace element {
+
+class Settings;
+
+/** Shared threads and the scheduling options of every thread Element runs.
+
+    Threads come in three kinds. Realtime threads are owned by the engine
+    (the device callback and the lookahead renderer) and only take their
+    priority and CPU mask from here, once when they start. Worker threads run CPU bound background
+    work like LV2 worker requests and program loading. IO threads do disk
+    reads, for file players and indexes.
+
+    Worker and IO jobs can be queued here, e.g. program standby loads, and
+    file players share the IO time slice threads instead of starting their
+    own. Subsystems that keep their own threads call applyToCurrentThread()
+    when they start.
+
+    Contexts own the pools. Every Context in a process shares one set,
+    and the last Context to let go of it stops the threads, so none of
+    them outlive JUCE.
+
+    On Linux, realtime threads use SCHED_FIFO at the configured priority,
+    which needs rtprio permission. Affinity masks pin threads to CPUs, e.g.
+    to keep audio on isolated cores.
+ */
+class ThreadPools final
+{
+public:
+    enum Kind
+    {
+        realtime = 0,
+        worker,
+        io,
+        numKinds
+    };
+
+    /** Options for a kind of thread. */
+    struct Options
+    {
+        int numThreads = 0; ///< worker and io only, 0 picks a default
+        int priority = 0; ///< realtime only, SCHED_FIFO 1-99 or 0 to leave it to JUCE
+        juce::uint64 affinity = 0; ///< bit n allows CPU n, 0 leaves the mask alone
+
+        bool operator== (const Options& o) const noexcept
+        {
+            return numThreads == o.numThreads && priority == o.priority && affinity == o.affinity;
+        }
+
+        bool operator!= (const Options& o) const noexcept { return ! operator== (o); }
+    };
+
+    ~ThreadPools();
+
+    /** Returns the pools, creating them if nothing holds them yet. The
+        threads stop when the last holder lets go.
+     */
+    static std::shared_ptr<ThreadPools> acquire();
+
+    /** Returns the pools a Context holds, for code that can't reach the
+        Context, e.g. nodes and plugin formats. Only valid while something
+        holds them.
+     */
+    static ThreadPools& getInstance();
+
+    /** Returns the name of a kind as used in Settings. */
+    static const char* getKindName (Kind kind) noexcept;
+
+    /** Change the options of a kind. Running job threads pick up the new
+        priority and mask before their next job, realtime threads the next
+        time they start.
+     */
+    void setOptions (Kind kind, const Options& newOptions);
+
+    /** Returns the options of a kind as set. */
+    Options getOptions (Kind kind) const;
+
+    /** Returns the number of threads a kind runs, with the default
+        resolved.
+     */
+    int getNumThreads (Kind kind) const;
+
+    /** Set the options of every kind from the user's settings. */
+    void applySettings (const Settings& settings);
+
+    /** Apply a kind's priority and CPU mask to the calling thread. Returns
+        false if the system refused any of it. Reads the options without
+        locking, so a realtime thread can call it as it starts, but it makes
+        system calls and shouldn't be called per block.
+     */
+    bool applyToCurrentThread (Kind kind) const;
+
+    /** Like applyToCurrentThread but only does anything the first time a
+        thread calls it and after the options change, so job threads can
+        call it before every job.
+     */
+    void applyToCurrentThreadIfChanged (Kind kind);
+
+    /** Queue a job on the worker or io threads. Jobs of one kind run in
+        the order they were added when there is one thread.
+     */
+    void addJob (Kind kind, std::function<void()> job);
+
+    /** Returns one of the shared io time slice threads, already running.
+        Threads are handed out round robin and live as long as the pools.
+     */
+    juce::TimeSliceThread& getIOThread();
+
+    /** Stop the job threads, waiting for running jobs. Queued jobs are
+        dropped. Pools start again on the next job. The io threads keep
+        running until the pools are destroyed.
+     */
+    void shutdown();
+
+private:
+    ThreadPools();
+    class JobThread;
+    class ApplyClient;
+
+    struct JobPool
+    {
+        std::deque<std::function<void()>> jobs;
+        juce::OwnedArray<JobThread> threads;
+        juce::WaitableEvent jobAdded;
+    };
+
+    mutable juce::CriticalSection lock;
+    Options options[numKinds];
+    SeqLockValue<Options> published[numKinds]; // options for lock free readers
+    std::atomic<int> generation[numKinds];
+    JobPool pools[numKinds];
+    juce::OwnedArray<juce::TimeSliceThread> ioThreads;
+    juce::OwnedArray<ApplyClient> ioClients;
+    int nextIOThread = 0;
+
+    void resizePool (Kind kind);
+    void reapplyIOThreads();
+    bool nextJob (Kind kind, std::function<void()>& job);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPools)
+};
+
+} // namespace element
@@ -0,0 +1,97 @@
+#include <boost/test/unit_test.hpp>
+#include "fileindex.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+static ValueTree readText (const File& file)
+{
+    ValueTree info ("text");
+    info.setProperty ("text", file.loadFileAsString(), nullptr);
+    return info;
+}
+
+static String textFor (const FileIndex& index, const File& file)
+{
+    for (const auto& entry : *index.getEntries())
+        if (entry.file == file)
+            return entry.metadata["text"].toString();
+    return {};
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (FileIndexTests)
+
+BOOST_AUTO_TEST_CASE (IncrementalScan)
+{
+    TemporaryFile tempDir, tempCache;
+    const auto dir = tempDir.getFile();
+    BOOST_REQUIRE (dir.createDirectory().wasOk());
+    BOOST_REQUIRE (dir.getChildFile ("sub").createDirectory().wasOk());
+
+    const auto one = dir.getChildFile ("one.txt");
+    const auto two = dir.getChildFile ("sub/two.txt");
+    one.replaceWithText ("1");
+    two.replaceWithText ("2");
+    dir.getChildFile ("skip.dat").replaceWithText ("x");
+
+    {
+        FileIndex index ("test", tempCache.getFile(), "*.txt", readText);
+        index.setDirectories ({ dir });
+        BOOST_REQUIRE (index.scanNow());
+        BOOST_REQUIRE_EQUAL (index.getEntries()->size(), (size_t) 2);
+        BOOST_REQUIRE_EQUAL (index.getNumParsed(), 2);
+        BOOST_REQUIRE_EQUAL (textFor (index, two), String ("2"));
+
+        // nothing changed, nothing parsed
+        BOOST_REQUIRE (! index.scanNow());
+        BOOST_REQUIRE_EQUAL (index.getNumParsed(), 2);
+
+        // only the changed file is parsed again
+        two.replaceWithText ("two");
+        BOOST_REQUIRE (index.scanNow());
+        BOOST_REQUIRE_EQUAL (index.getNumParsed(), 3);
+        BOOST_REQUIRE_EQUAL (textFor (index, two), String ("two"));
+
+        BOOST_REQUIRE (one.deleteFile());
+        BOOST_REQUIRE (index.scanNow());
+        BOOST_REQUIRE_EQUAL (index.getEntries()->size(), (size_t) 1);
+        BOOST_REQUIRE_EQUAL (index.getNumParsed(), 3);
+    }
+
+    // a new index starts from the cache and parses nothing
+    {
+        FileIndex index ("test", tempCache.getFile(), "*.txt", readText);
+        BOOST_REQUIRE (index.loadCache());
+        BOOST_REQUIRE_EQUAL (index.getEntries()->size(), (size_t) 1);
+        BOOST_REQUIRE_EQUAL (textFor (index, two), String ("two"));
+        index.setDirectories ({ dir });
+        BOOST_REQUIRE (! index.scanNow());
+        BOOST_REQUIRE_EQUAL (index.getNumParsed(), 0);
+    }
+
+    dir.deleteRecursively();
+}
+
+BOOST_AUTO_TEST_CASE (WatchesInBackground)
+{
+    TemporaryFile tempDir, tempCache;
+    const auto dir = tempDir.getFile();
+    BOOST_REQUIRE (dir.createDirectory().wasOk());
+
+    FileIndex index ("test", tempCache.getFile(), "*.txt", readText);
+    index.setDirectories ({ dir });
+    index.start (100);
+
+    dir.getChildFile ("new.txt").replaceWithText ("new");
+    index.refresh();
+    for (int i = 0; i < 200 && index.getEntries()->size() != 1; ++i)
+        Thread::sleep (10);
+
+    BOOST_REQUIRE_EQUAL (index.getEntries()->size(), (size_t) 1);
+    index.stop();
+    dir.deleteRecursively();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,208 @@
+#include <boost/test/unit_test.hpp>
+#include <element/context.hpp>
+#include <element/engine.hpp>
+#include "fixture/PreparedGraph.h"
+#include "fixture/TestNode.h"
+#include "engine/graphnode.hpp"
+#include "graphdiff.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+/** Plugin-like state: mostly structured, some noise. */
+static MemoryBlock makeState (int size, Random& random)
+{
+    MemoryBlock block ((size_t) size);
+    auto* data = static_cast<uint8*> (block.getData());
+    for (int i = 0; i < size; ++i)
+        data[i] = (i % 64 == 0) ? (uint8) random.nextInt (256) : (uint8) (i % 16);
+    return block;
+}
+
+static bool hasArc (const Node& graph, uint32 s, uint32 sp, uint32 d, uint32 dp)
+{
+    const auto arcs = graph.getArcsValueTree();
+    for (int i = 0; i < arcs.getNumChildren(); ++i)
+    {
+        const auto arc = arcs.getChild (i);
+        if ((uint32) (int) arc[tags::sourceNode] == s && (uint32) (int) arc[tags::sourcePort] == sp
+            && (uint32) (int) arc[tags::destNode] == d && (uint32) (int) arc[tags::destPort] == dp)
+            return true;
+    }
+    return false;
+}
+
+/** A session with one default graph loaded by the engine service. Its MIDI
+    input (node 3) is connected to its MIDI output (node 4).
+ */
+struct SessionFixture
+{
+    SessionFixture()
+    {
+        session = context.session();
+        session->addGraph (Node::createDefaultGraph ("Graph 1"), true);
+        engine = context.services().find<EngineService>();
+        engine->activate();
+        graph = session->getGraph (0);
+        engine->addConnection (3, 0, 4, 0, graph);
+        MessageManager::getInstance()->runDispatchLoopUntil (10);
+    }
+
+    ~SessionFixture()
+    {
+        engine->deactivate();
+    }
+
+    Context context;
+    SessionPtr session;
+    EngineService* engine = nullptr;
+    Node graph;
+};
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (GraphDiffTests)
+
+BOOST_AUTO_TEST_CASE (StateDeltaRoundTrip)
+{
+    Random random (11);
+    const auto before = makeState (256 * 1024, random);
+    auto after = before;
+    static_cast<uint8*> (after.getData())[1000] ^= 0xff;
+    after.append ("tail", 4);
+
+    const StateDelta delta (before, after);
+    BOOST_REQUIRE (delta.getSize() < 256);
+
+    MemoryBlock result;
+    BOOST_REQUIRE (delta.apply (before, result, true));
+    BOOST_REQUIRE (result == after);
+    BOOST_REQUIRE (delta.apply (after, result, false));
+    BOOST_REQUIRE (result == before);
+
+    // applying to the wrong side is refused
+    BOOST_REQUIRE (! delta.apply (after, result, true));
+}
+
+BOOST_AUTO_TEST_CASE (SnapshotIsCompact)
+{
+    Random random (3);
+    const auto state = makeState (512 * 1024, random);
+    ValueTree node (types::Node);
+    node.setProperty (tags::uuid, Uuid().toString(), nullptr)
+        .setProperty (tags::name, "Big State", nullptr)
+        .setProperty (tags::state, state.toBase64Encoding(), nullptr)
+        .setProperty (tags::object, var (new DynamicObject()), nullptr);
+    node.getOrCreateChildWithName (tags::ports, nullptr);
+
+    const NodeSnapshot snapshot (node);
+    const auto copySize = (size_t) node[tags::state].toString().getNumBytesAsUTF8();
+    BOOST_TEST_MESSAGE ("512 KiB plugin state: copy " << (int) copySize << " bytes, snapshot "
+                                                      << (int) snapshot.getSize() << " bytes");
+    BOOST_REQUIRE (snapshot.getSize() * 4 < copySize);
+
+    const auto restored = snapshot.restore();
+    BOOST_REQUIRE (restored.hasType (types::Node));
+    BOOST_REQUIRE_EQUAL (restored[tags::name].toString(), String ("Big State"));
+    BOOST_REQUIRE_EQUAL (restored[tags::state].toString(), node[tags::state].toString());
+    BOOST_REQUIRE (! restored.hasProperty (tags::object));
+    BOOST_REQUIRE (restored.getChildWithName (tags::ports).isValid());
+}
+
+BOOST_AUTO_TEST_CASE (BatchRebuildsOnce)
+{
+    PreparedGraph fix;
+    GraphNode& graph = fix.graph;
+    ReferenceCountedArray<Processor> added;
+    for (int i = 0; i < 8; ++i)
+        added.add (graph.addNode (new TestNode (2, 2, 0, 0)));
+    MessageManager::getInstance()->runDispatchLoopUntil (10);
+
+    int numRebuilds = 0;
+    graph.renderingSequenceChanged.connect ([&numRebuilds]() { ++numRebuilds; });
+
+    bool released = false;
+    {
+        const GraphNode::ScopedBatch batch;
+        BOOST_REQUIRE (GraphNode::isBatching());
+        for (auto* node : added)
+            BOOST_REQUIRE (graph.removeNode (node->nodeId));
+        GraphNode::callAfterBatch ([&]() { released = numRebuilds == 1; });
+
+        BOOST_REQUIRE_EQUAL (graph.getNumNodes(), 0);
+        BOOST_REQUIRE_EQUAL (numRebuilds, 0);
+        // removed nodes render until the batch ends
+        BOOST_REQUIRE (added.getFirst()->getParentGraph() == &graph);
+    }
+
+    BOOST_REQUIRE (! GraphNode::isBatching());
+    BOOST_REQUIRE_EQUAL (numRebuilds, 1);
+    BOOST_REQUIRE (released);
+    BOOST_REQUIRE (added.getFirst()->getParentGraph() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE (RemoveNodeRoundTrip)
+{
+    SessionFixture fix;
+    auto midiOut = fix.graph.getNodeById (4);
+    BOOST_REQUIRE (midiOut.isValid());
+    BOOST_REQUIRE (hasArc (fix.graph, 3, 0, 4, 0));
+    midiOut.setProperty (tags::name, "Renamed Out");
+    const auto uuid = midiOut.getUuidString();
+    BOOST_REQUIRE (uuid.isNotEmpty());
+
+    std::unique_ptr<GraphDiff> diff;
+    {
+        GraphDiff::Recorder recorder (*fix.session);
+        fix.engine->removeNode (midiOut);
+        diff = recorder.finish();
+    }
+
+    BOOST_REQUIRE (! diff->isEmpty());
+    BOOST_REQUIRE (! fix.graph.getNodeById (4).isValid());
+    BOOST_REQUIRE (! hasArc (fix.graph, 3, 0, 4, 0));
+
+    diff->apply (*fix.engine, *fix.session, false);
+    MessageManager::getInstance()->runDispatchLoopUntil (10);
+    const auto restored = fix.graph.getNodeById (4);
+    BOOST_REQUIRE (restored.isValid());
+    BOOST_REQUIRE_EQUAL (restored.getUuidString(), uuid);
+    BOOST_REQUIRE_EQUAL (restored.getName(), String ("Renamed Out"));
+    BOOST_REQUIRE (hasArc (fix.graph, 3, 0, 4, 0));
+
+    diff->apply (*fix.engine, *fix.session, true);
+    MessageManager::getInstance()->runDispatchLoopUntil (10);
+    BOOST_REQUIRE (! fix.graph.getNodeById (4).isValid());
+    BOOST_REQUIRE (! fix.session->findNodeById (Uuid (uuid)).isValid());
+    BOOST_REQUIRE (! hasArc (fix.graph, 3, 0, 4, 0));
+}
+
+BOOST_AUTO_TEST_CASE (RemoveConnectionRoundTrip)
+{
+    SessionFixture fix;
+    BOOST_REQUIRE (hasArc (fix.graph, 3, 0, 4, 0));
+    const auto numNodes = fix.graph.getNumNodes();
+
+    std::unique_ptr<GraphDiff> diff;
+    {
+        GraphDiff::Recorder recorder (*fix.session);
+        fix.engine->removeConnection (3, 0, 4, 0, fix.graph);
+        diff = recorder.finish();
+    }
+
+    BOOST_REQUIRE (! diff->isEmpty());
+    BOOST_REQUIRE (! hasArc (fix.graph, 3, 0, 4, 0));
+
+    diff->apply (*fix.engine, *fix.session, false);
+    MessageManager::getInstance()->runDispatchLoopUntil (10);
+    BOOST_REQUIRE (hasArc (fix.graph, 3, 0, 4, 0));
+    BOOST_REQUIRE_EQUAL (fix.graph.getNumNodes(), numNodes);
+
+    diff->apply (*fix.engine, *fix.session, true);
+    MessageManager::getInstance()->runDispatchLoopUntil (10);
+    BOOST_REQUIRE (! hasArc (fix.graph, 3, 0, 4, 0));
+    BOOST_REQUIRE (fix.graph.getNodeById (3).isValid());
+    BOOST_REQUIRE (fix.graph.getNodeById (4).isValid());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
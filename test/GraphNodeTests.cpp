@@ -2,10 +2,137 @@
 #include "fixture/PreparedGraph.h"
 #include "fixture/TestNode.h"
 #include "engine/graphnode.hpp"
+#include "engine/ionode.hpp"
 #include "utils.hpp"
 
 using namespace element;
 
+namespace {
+class ControlTestNode : public TestNode
+{
+public:
+    ControlTestNode (float value) : TestNode (0, 0, 0, 0), outputValue (value)
+    {
+        ControlTestNode::refreshPorts();
+    }
+
+    bool wantsPortData() const override { return true; }
+    void setPortData (uint32 port, float* data) override { portData[port] = data; }
+
+    void render (AudioSampleBuffer& audio, MidiPipe&) override
+    {
+        const int numSamples = audio.getNumSamples();
+        controlIn = portData[0] != nullptr ? *portData[0] : -1.f;
+        cvIn.clearQuick();
+        if (portData[1] != nullptr)
+            cvIn.addArray (portData[1], numSamples);
+
+        *portData[2] = outputValue;
+        for (int i = 0; i < numSamples; ++i)
+            portData[3][i] = outputValue + (float) i;
+    }
+
+    void refreshPorts() override
+    {
+        PortList newPorts;
+        newPorts.add (PortType::Control, 0, 0, "control_in", "Control In", true);
+        newPorts.add (PortType::CV, 1, 0, "cv_in", "CV In", true);
+        newPorts.add (PortType::Control, 2, 0, "control_out", "Control Out", false);
+        newPorts.add (PortType::CV, 3, 0, "cv_out", "CV Out", false);
+        setPorts (newPorts);
+    }
+
+    float outputValue = 0.f;
+    float controlIn = 0.f;
+    float* portData[4] = { nullptr, nullptr, nullptr, nullptr };
+    Array<float> cvIn;
+};
+
+class GainTestNode : public TestNode
+{
+public:
+    GainTestNode (float g) : TestNode (2, 2, 0, 0), gain (g) {}
+    void render (AudioSampleBuffer& audio, MidiPipe&) override { audio.applyGain (gain); }
+    const float gain;
+};
+
+class DoubleGainTestNode : public GainTestNode
+{
+public:
+    DoubleGainTestNode (float g) : GainTestNode (g) {}
+    bool supportsDoublePrecision() const override { return true; }
+    void render64 (AudioBuffer<double>& audio, MidiPipe&) override
+    {
+        audio.applyGain ((double) gain);
+        ++numDoubleRenders;
+    }
+    int numDoubleRenders = 0;
+};
+
+/** Writes a note to its MIDI output and remembers which buffer it used. */
+class MidiSourceTestNode : public TestNode
+{
+public:
+    MidiSourceTestNode() : TestNode (0, 0, 0, 1) {}
+    void render (AudioSampleBuffer&, MidiPipe& midi) override
+    {
+        written = midi.getWriteBuffer (0);
+        written->addEvent (MidiMessage::noteOn (1, 60, 1.f), 0);
+    }
+    const MidiBuffer* written = nullptr;
+};
+
+/** Only reads its MIDI and remembers which buffer it was handed. */
+class MidiReaderTestNode : public TestNode
+{
+public:
+    MidiReaderTestNode() : TestNode (0, 0, 1, 0) {}
+    bool wantsReadOnlyMidi() const override { return true; }
+    void render (AudioSampleBuffer&, MidiPipe& midi) override { received = midi.getReadBuffer (0); }
+    const MidiBuffer* received = nullptr;
+};
+
+/** Wraps a node in a subgraph between audio IO nodes. */
+static GraphNode* makeSubgraph (Processor* inner)
+{
+    auto* child = new GraphNode();
+    auto* input = child->addNode (new IONode (IONode::audioInputNode));
+    auto* output = child->addNode (new IONode (IONode::audioOutputNode));
+    child->addNode (inner);
+    for (int c = 0; c < 2; ++c)
+    {
+        child->connectChannels (PortType::Audio, input->nodeId, c, inner->nodeId, c);
+        child->connectChannels (PortType::Audio, inner->nodeId, c, output->nodeId, c);
+    }
+    return child;
+}
+
+static void addBetweenIO (GraphNode& graph, Processor* node)
+{
+    auto* input = graph.addNode (new IONode (IONode::audioInputNode));
+    auto* output = graph.addNode (new IONode (IONode::audioOutputNode));
+    graph.addNode (node);
+    for (int c = 0; c < 2; ++c)
+    {
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, input->nodeId, c, node->nodeId, c));
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, node->nodeId, c, output->nodeId, c));
+    }
+}
+
+static float renderOnes (GraphNode& graph)
+{
+    AudioSampleBuffer audio (2, 512);
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    audio.clear();
+    for (int c = 0; c < 2; ++c)
+        FloatVectorOperations::fill (audio.getWritePointer (c), 1.f, 512);
+    graph.render (audio, pipe);
+    return audio.getSample (1, 511);
+}
+} // namespace
+
 BOOST_AUTO_TEST_SUITE (GraphNodeTests)
 
 BOOST_AUTO_TEST_CASE (IO)
@@ -74,4 +201,286 @@ BOOST_AUTO_TEST_CASE (AddRemove)
     BOOST_REQUIRE (graph.removeNode (node->nodeId));
 }
 
+BOOST_AUTO_TEST_CASE (ControlAndCVBuffers)
+{
+    GraphNode graph;
+    auto* src1 = new ControlTestNode (0.25f);
+    auto* src2 = new ControlTestNode (0.5f);
+    auto* dst = new ControlTestNode (0.f);
+    graph.addNode (src1);
+    graph.addNode (src2);
+    graph.addNode (dst);
+
+    BOOST_REQUIRE (graph.addConnection (src1->nodeId, 2, dst->nodeId, 0));
+    BOOST_REQUIRE (graph.addConnection (src1->nodeId, 3, dst->nodeId, 1));
+    BOOST_REQUIRE (graph.addConnection (src2->nodeId, 3, dst->nodeId, 1));
+    graph.prepareToRender (44100.0, 64);
+
+    AudioSampleBuffer audio (2, 64);
+    audio.clear();
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    graph.render (audio, pipe);
+
+    // unconnected ports
+    BOOST_REQUIRE_EQUAL (src1->controlIn, -1.f);
+    BOOST_REQUIRE_EQUAL (src1->cvIn.size(), 64);
+    for (auto sample : src1->cvIn)
+        BOOST_REQUIRE_EQUAL (sample, 0.f);
+
+    // per block control value and summed per sample CV
+    BOOST_REQUIRE_EQUAL (dst->controlIn, 0.25f);
+    BOOST_REQUIRE_EQUAL (dst->cvIn.size(), 64);
+    for (int i = 0; i < 64; ++i)
+        BOOST_REQUIRE_EQUAL (dst->cvIn[i], 0.75f + 2.f * (float) i);
+
+    graph.releaseResources();
+    graph.clear();
+}
+
+BOOST_AUTO_TEST_CASE (ScalingBenchmark)
+{
+    const int numNodes = 1500;
+    GraphNode graph;
+    Array<Processor*> added;
+
+    auto start = Time::getMillisecondCounterHiRes();
+    for (int i = 0; i < numNodes; ++i)
+        added.add (graph.addNode (new TestNode()));
+    const auto addTime = Time::getMillisecondCounterHiRes() - start;
+
+    // a chain with every node also feeding the one two steps ahead
+    start = Time::getMillisecondCounterHiRes();
+    for (int i = numNodes; --i >= 1;)
+    {
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, added[i - 1]->nodeId, 0, added[i]->nodeId, 0));
+        if (i >= 2)
+            BOOST_REQUIRE (graph.connectChannels (PortType::Audio, added[i - 2]->nodeId, 1, added[i]->nodeId, 1));
+    }
+    const auto connectTime = Time::getMillisecondCounterHiRes() - start;
+
+    start = Time::getMillisecondCounterHiRes();
+    for (auto* node : added)
+        BOOST_REQUIRE (graph.getNodeForId (node->nodeId) == node);
+    BOOST_REQUIRE (graph.isConnected (added[10]->nodeId, added[11]->nodeId));
+    BOOST_REQUIRE (! graph.isConnected (added[11]->nodeId, added[10]->nodeId));
+    const auto lookupTime = Time::getMillisecondCounterHiRes() - start;
+
+    start = Time::getMillisecondCounterHiRes();
+    graph.prepareToRender (44100.0, 512);
+    const auto buildTime = Time::getMillisecondCounterHiRes() - start;
+
+    ReferenceCountedArray<Processor> ordered;
+    graph.getOrderedNodes (ordered);
+    BOOST_REQUIRE_EQUAL (ordered.size(), numNodes);
+    for (int i = 1; i < numNodes; ++i)
+        BOOST_REQUIRE (ordered.indexOf (added[i - 1]) < ordered.indexOf (added[i]));
+
+    start = Time::getMillisecondCounterHiRes();
+    for (auto* node : added)
+        graph.disconnectNode (node->nodeId);
+    const auto disconnectTime = Time::getMillisecondCounterHiRes() - start;
+    BOOST_REQUIRE_EQUAL (graph.getNumConnections(), 0);
+
+    BOOST_TEST_MESSAGE ("graph of " << numNodes << " nodes: add " << addTime
+                                    << " ms, connect " << connectTime
+                                    << " ms, lookup " << lookupTime
+                                    << " ms, build " << buildTime
+                                    << " ms, disconnect " << disconnectTime << " ms");
+
+    graph.releaseResources();
+    graph.clear();
+}
+
+BOOST_AUTO_TEST_CASE (BufferReuse)
+{
+    const auto buildStats = [] (GraphNode& graph, GraphBuilder::Stats& before, GraphBuilder::Stats& after) {
+        ReferenceCountedArray<Processor> ordered;
+        graph.getOrderedNodes (ordered);
+        Array<void*> orderedNodes;
+        for (auto* node : ordered)
+            orderedNodes.add (node);
+
+        for (auto* stats : { &before, &after })
+        {
+            Array<void*> ops;
+            {
+                GraphBuilder builder (graph, orderedNodes, ops, stats == &after);
+                *stats = builder.getStats();
+            }
+            for (auto* op : ops)
+                delete static_cast<GraphOp*> (op);
+        }
+
+        BOOST_TEST_MESSAGE ("buffer reuse: audio buffers " << before.audioBuffers << " -> " << after.audioBuffers
+                                                           << ", copies " << before.copyOps << " -> " << after.copyOps
+                                                           << ", adds " << before.addOps << " -> " << after.addOps
+                                                           << ", clears " << before.clearOps << " -> " << after.clearOps);
+    };
+
+    GraphBuilder::Stats before, after;
+
+    // one source fanning out to a wide layer which is summed back down,
+    // followed by a chain
+    {
+        GraphNode graph;
+        auto* source = graph.addNode (new TestNode());
+        auto* sum = graph.addNode (new TestNode());
+        for (int i = 0; i < 32; ++i)
+        {
+            auto* node = graph.addNode (new TestNode());
+            for (int c = 0; c < 2; ++c)
+            {
+                BOOST_REQUIRE (graph.connectChannels (PortType::Audio, source->nodeId, c, node->nodeId, c));
+                BOOST_REQUIRE (graph.connectChannels (PortType::Audio, node->nodeId, c, sum->nodeId, c));
+            }
+        }
+
+        auto* last = sum;
+        for (int i = 0; i < 16; ++i)
+        {
+            auto* node = graph.addNode (new TestNode());
+            for (int c = 0; c < 2; ++c)
+                BOOST_REQUIRE (graph.connectChannels (PortType::Audio, last->nodeId, c, node->nodeId, c));
+            last = node;
+        }
+
+        buildStats (graph, before, after);
+        BOOST_REQUIRE (after.audioBuffers <= before.audioBuffers);
+        BOOST_REQUIRE (after.copyOps + after.addOps <= before.copyOps + before.addOps);
+        graph.clear();
+    }
+
+    // generators each feeding a sink: every generator can reuse the
+    // buffers the previous sink has finished with
+    {
+        GraphNode graph;
+        for (int i = 0; i < 8; ++i)
+        {
+            auto* generator = graph.addNode (new TestNode (0, 2, 0, 0));
+            auto* sink = graph.addNode (new TestNode (2, 0, 0, 0));
+            for (int c = 0; c < 2; ++c)
+                BOOST_REQUIRE (graph.connectChannels (PortType::Audio, generator->nodeId, c, sink->nodeId, c));
+        }
+
+        buildStats (graph, before, after);
+        BOOST_REQUIRE (after.audioBuffers < before.audioBuffers);
+        BOOST_REQUIRE_EQUAL (after.audioBuffers, 3);
+        graph.clear();
+    }
+}
+
+BOOST_AUTO_TEST_CASE (InlinedSubgraphs)
+{
+    {
+        GraphNode graph;
+        auto* child = makeSubgraph (new GainTestNode (0.5f));
+        addBetweenIO (graph, child);
+        graph.prepareToRender (44100.0, 512);
+        BOOST_REQUIRE_EQUAL (graph.getBuildStats().inlinedGraphs, 1);
+        BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.5f);
+
+        // the graph node's own gain still applies
+        child->setGain (0.5f);
+        renderOnes (graph);
+        BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.25f);
+
+        // graph level MIDI filters render it as a node, with the same result
+        child->setMidiChannel (2);
+        graph.prepareToRender (44100.0, 512);
+        BOOST_REQUIRE_EQUAL (graph.getBuildStats().inlinedGraphs, 0);
+        BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.25f);
+
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    {
+        GraphNode graph;
+        addBetweenIO (graph, makeSubgraph (makeSubgraph (new GainTestNode (0.5f))));
+        graph.prepareToRender (44100.0, 512);
+        BOOST_REQUIRE_EQUAL (graph.getBuildStats().inlinedGraphs, 2);
+        BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.5f);
+        graph.releaseResources();
+        graph.clear();
+    }
+}
+
+BOOST_AUTO_TEST_CASE (ReadOnlyMidiFanOut)
+{
+    GraphNode graph;
+    auto* source = new MidiSourceTestNode();
+    MidiReaderTestNode* readers[] = { new MidiReaderTestNode(), new MidiReaderTestNode() };
+    graph.addNode (source);
+    auto* output = graph.addNode (new IONode (IONode::midiOutputNode));
+    BOOST_REQUIRE (graph.connectChannels (PortType::Midi, source->nodeId, 0, output->nodeId, 0));
+    for (auto* reader : readers)
+    {
+        graph.addNode (reader);
+        BOOST_REQUIRE (graph.connectChannels (PortType::Midi, source->nodeId, 0, reader->nodeId, 0));
+    }
+
+    // default key range and omni: no filter, so nothing gets copied
+    graph.prepareToRender (44100.0, 512);
+    AudioSampleBuffer audio (2, 512);
+    MidiBuffer midi;
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    audio.clear();
+    graph.render (audio, pipe);
+
+    BOOST_REQUIRE (source->written != nullptr);
+    for (auto* reader : readers)
+        BOOST_REQUIRE (reader->received == source->written);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 1);
+
+    graph.releaseResources();
+    graph.clear();
+}
+
+BOOST_AUTO_TEST_CASE (DoublePrecision)
+{
+    GraphNode graph;
+    graph.setDoublePrecision (true);
+    auto* native = new DoubleGainTestNode (0.5f);
+    auto* converted = new GainTestNode (0.5f);
+    auto* input = graph.addNode (new IONode (IONode::audioInputNode));
+    auto* output = graph.addNode (new IONode (IONode::audioOutputNode));
+    auto* child = makeSubgraph (makeSubgraph (native));
+    graph.addNode (child);
+    graph.addNode (converted);
+    for (int c = 0; c < 2; ++c)
+    {
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, input->nodeId, c, child->nodeId, c));
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, child->nodeId, c, converted->nodeId, c));
+        BOOST_REQUIRE (graph.connectChannels (PortType::Audio, converted->nodeId, c, output->nodeId, c));
+    }
+
+    graph.prepareToRender (44100.0, 512);
+    BOOST_REQUIRE (graph.isUsingDoublePrecision());
+    BOOST_REQUIRE_EQUAL (graph.getBuildStats().inlinedGraphs, 2);
+    BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.25f);
+    BOOST_REQUIRE_EQUAL (native->numDoubleRenders, 1);
+
+    // a subgraph rendered as a node is handed the 64-bit buffers as is
+    child->setMidiChannel (2);
+    graph.prepareToRender (44100.0, 512);
+    BOOST_REQUIRE_EQUAL (graph.getBuildStats().inlinedGraphs, 0);
+    BOOST_REQUIRE (child->isUsingDoublePrecision());
+    BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.25f);
+    BOOST_REQUIRE_EQUAL (native->numDoubleRenders, 2);
+
+    // float graphs never call render64
+    graph.releaseResources();
+    graph.setDoublePrecision (false);
+    graph.prepareToRender (44100.0, 512);
+    BOOST_REQUIRE (! child->isUsingDoublePrecision());
+    BOOST_REQUIRE_EQUAL (renderOnes (graph), 0.25f);
+    BOOST_REQUIRE_EQUAL (native->numDoubleRenders, 2);
+
+    graph.releaseResources();
+    graph.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,75 @@
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include "fileindex.hpp"
+#include "lv2/world.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+static void writeBundle (const File& bundle)
+{
+    BOOST_REQUIRE (bundle.createDirectory().wasOk());
+    bundle.getChildFile ("manifest.ttl").replaceWithText (R"(
+@prefix lv2: <http://lv2plug.in/ns/lv2core#> .
+@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .
+
+<urn:element:test:index-one> a lv2:Plugin ; lv2:binary <test.so> ; rdfs:seeAlso <plugins.ttl> .
+<urn:element:test:index-two> a lv2:Plugin ; lv2:binary <test.so> ; rdfs:seeAlso <plugins.ttl> .
+)");
+    bundle.getChildFile ("plugins.ttl").replaceWithText (R"(
+@prefix doap: <http://usefulinc.com/ns/doap#> .
+@prefix lv2: <http://lv2plug.in/ns/lv2core#> .
+
+<urn:element:test:index-one> a lv2:Plugin ; doap:name "Index One" .
+<urn:element:test:index-two> a lv2:Plugin ; doap:name "Index Two" ;
+    lv2:requiredFeature <urn:element:test:unsupported> .
+)");
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (LV2WorldTests)
+
+#if ! JUCE_WINDOWS
+BOOST_AUTO_TEST_CASE (LoadsBundlesOnDemand)
+{
+    TemporaryFile tempDir;
+    const auto dir = tempDir.getFile();
+    BOOST_REQUIRE (dir.createDirectory().wasOk());
+    writeBundle (dir.getChildFile ("index-test.lv2"));
+
+    const auto oldPath = SystemStats::getEnvironmentVariable ("LV2_PATH", {});
+    setenv ("LV2_PATH", dir.getFullPathName().toRawUTF8(), 1);
+
+    {
+        World world;
+        BOOST_REQUIRE (! world.isFullyLoaded());
+
+        // listing reads the index as the background scan left it, the
+        // world itself stays empty
+        world.getBundleIndex().scanNow();
+        StringArray plugins;
+        world.getSupportedPlugins (plugins);
+        BOOST_REQUIRE (plugins.contains ("urn:element:test:index-one"));
+        BOOST_REQUIRE (! plugins.contains ("urn:element:test:index-two"));
+        BOOST_REQUIRE_EQUAL (world.getPluginName ("urn:element:test:index-two"), String ("Index Two"));
+        BOOST_REQUIRE_EQUAL (lilv_plugins_size (world.getAllPlugins()), 0u);
+
+        // only the plugin's bundle is loaded to find it
+        BOOST_REQUIRE (world.getPlugin ("urn:element:test:index-one") != nullptr);
+        BOOST_REQUIRE (! world.isFullyLoaded());
+
+        // unknown plugins fall back to loading everything
+        BOOST_REQUIRE (world.getPlugin ("urn:element:test:missing") == nullptr);
+        BOOST_REQUIRE (world.isFullyLoaded());
+    }
+
+    if (oldPath.isEmpty())
+        unsetenv ("LV2_PATH");
+    else
+        setenv ("LV2_PATH", oldPath.toRawUTF8(), 1);
+    dir.deleteRecursively();
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
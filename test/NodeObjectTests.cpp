@@ -3,6 +3,8 @@
 #include "fixture/TestNode.h"
 #include "engine/ionode.hpp"
 #include <element/processor.hpp>
+#include <atomic>
+#include <thread>
 
 using namespace element;
 
@@ -46,6 +48,54 @@ BOOST_AUTO_TEST_CASE (Enablement)
     node = nullptr;
 }
 
+BOOST_AUTO_TEST_CASE (RenderStateSnapshot)
+{
+    PreparedGraph fix;
+    ProcessorPtr node = fix.graph.addNode (new TestNode());
+
+    auto state = node->getRenderState();
+    BOOST_REQUIRE (state.isOmni());
+    BOOST_REQUIRE (! state.midiProgramsEnabled);
+
+    BigInteger channels;
+    channels.setBit (3);
+    node->setMidiChannels (channels);
+    node->setKeyRange (12, 60);
+    node->setTransposeOffset (-7);
+    node->setMidiProgramsEnabled (true);
+
+    state = node->getRenderState();
+    BOOST_REQUIRE (! state.isOmni());
+    BOOST_REQUIRE (! state.isChannelOff (3));
+    BOOST_REQUIRE (state.isChannelOff (4));
+    BOOST_REQUIRE (state.getKeyRange() == Range<int> (12, 60));
+    BOOST_REQUIRE_EQUAL (state.transposeOffset, -7);
+    BOOST_REQUIRE (state.midiProgramsEnabled);
+
+    // readers never see half of a write
+    node->setKeyRange (0, 63);
+    std::atomic<bool> done { false };
+    std::thread writer ([&]() {
+        for (int i = 0; i < 100000; ++i)
+        {
+            const int low = i % 64;
+            node->setKeyRange (low, low + 63);
+        }
+        done = true;
+    });
+
+    int numTorn = 0;
+    while (! done)
+    {
+        const auto range = node->getRenderState().getKeyRange();
+        numTorn += range.getLength() != 63 ? 1 : 0;
+    }
+    writer.join();
+    BOOST_REQUIRE_EQUAL (numTorn, 0);
+
+    node = nullptr;
+}
+
 BOOST_AUTO_TEST_CASE (PortChannelMapping)
 {
     PreparedGraph fix;
@@ -1,6 +1,7 @@
 #define BOOST_TEST_MODULE Element
 #include <boost/test/included/unit_test.hpp>
 #include <element/juce.hpp>
+#include "threadpools.hpp"
 using namespace juce;
 
 struct JuceMessageManagerFixture {
@@ -8,12 +9,17 @@ struct JuceMessageManagerFixture {
     {
         MessageManager::getInstance();
         juce::initialiseJuce_GUI();
+        // held like a Context would, for tests without one
+        threads = element::ThreadPools::acquire();
     }
 
     ~JuceMessageManagerFixture()
     {
+        threads = nullptr;
         juce::shutdownJuce_GUI();
     }
+
+    std::shared_ptr<element::ThreadPools> threads;
 };
 
 BOOST_GLOBAL_FIXTURE (JuceMessageManagerFixture);
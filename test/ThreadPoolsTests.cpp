@@ -0,0 +1,111 @@
+#include <boost/test/unit_test.hpp>
+#include "testutil.hpp"
+#include "threadpools.hpp"
+
+#if JUCE_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace element;
+using namespace juce;
+using test::waitFor;
+
+namespace {
+/** Restores the pools' options when a test is done with them. */
+struct ScopedOptions
+{
+    ScopedOptions()
+    {
+        for (int k = 0; k < ThreadPools::numKinds; ++k)
+            saved[k] = ThreadPools::getInstance().getOptions ((ThreadPools::Kind) k);
+    }
+
+    ~ScopedOptions()
+    {
+        for (int k = 0; k < ThreadPools::numKinds; ++k)
+            ThreadPools::getInstance().setOptions ((ThreadPools::Kind) k, saved[k]);
+    }
+
+    ThreadPools::Options saved[ThreadPools::numKinds];
+};
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (ThreadPoolsTests)
+
+BOOST_AUTO_TEST_CASE (RunsJobsOffTheCaller)
+{
+    auto& pools = ThreadPools::getInstance();
+    const auto caller = Thread::getCurrentThreadId();
+    Array<Thread::ThreadID, CriticalSection> ran;
+
+    for (int i = 0; i < 64; ++i)
+        pools.addJob (ThreadPools::worker, [&ran] { ran.add (Thread::getCurrentThreadId()); });
+
+    BOOST_REQUIRE (waitFor ([&ran] { return ran.size() == 64; }));
+    for (auto id : ran)
+        BOOST_REQUIRE (id != caller);
+}
+
+BOOST_AUTO_TEST_CASE (OneThreadRunsInOrder)
+{
+    ScopedOptions restore;
+    auto& pools = ThreadPools::getInstance();
+    ThreadPools::Options opts;
+    opts.numThreads = 1;
+    pools.setOptions (ThreadPools::io, opts);
+    BOOST_REQUIRE_EQUAL (pools.getNumThreads (ThreadPools::io), 1);
+
+    Array<int, CriticalSection> order;
+    for (int i = 0; i < 100; ++i)
+        pools.addJob (ThreadPools::io, [&order, i] { order.add (i); });
+
+    BOOST_REQUIRE (waitFor ([&order] { return order.size() == 100; }));
+    for (int i = 0; i < 100; ++i)
+        BOOST_REQUIRE_EQUAL (order[i], i);
+}
+
+BOOST_AUTO_TEST_CASE (SharedIOThreadsRun)
+{
+    auto& pools = ThreadPools::getInstance();
+    auto& a = pools.getIOThread();
+    BOOST_REQUIRE (a.isThreadRunning());
+
+    bool same = false;
+    for (int i = 0; i < pools.getNumThreads (ThreadPools::io); ++i)
+        same = same || &pools.getIOThread() == &a;
+    BOOST_REQUIRE (same);
+}
+
+#if JUCE_LINUX
+BOOST_AUTO_TEST_CASE (AppliesAffinity)
+{
+    ScopedOptions restore;
+    auto& pools = ThreadPools::getInstance();
+    // pin to the first cpu this process may use
+    cpu_set_t allowed;
+    CPU_ZERO (&allowed);
+    BOOST_REQUIRE_EQUAL (pthread_getaffinity_np (pthread_self(), sizeof (cpu_set_t), &allowed), 0);
+    int first = 0;
+    while (first < 64 && ! CPU_ISSET (first, &allowed))
+        ++first;
+    BOOST_REQUIRE (first < 64);
+
+    ThreadPools::Options opts;
+    opts.affinity = (uint64) 1 << first;
+    pools.setOptions (ThreadPools::worker, opts);
+
+    std::atomic<int> numCpus { -1 };
+    pools.addJob (ThreadPools::worker, [&numCpus, first] {
+        cpu_set_t cpus;
+        CPU_ZERO (&cpus);
+        pthread_getaffinity_np (pthread_self(), sizeof (cpu_set_t), &cpus);
+        numCpus = CPU_ISSET (first, &cpus) ? CPU_COUNT (&cpus) : 0;
+    });
+
+    BOOST_REQUIRE (waitFor ([&numCpus] { return numCpus.load() >= 0; }));
+    BOOST_REQUIRE_EQUAL (numCpus.load(), 1);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+#include <boost/test/unit_test.hpp>
+#include "lv2/workerpool.hpp"
+#include "testutil.hpp"
+
+using namespace element;
+using namespace juce;
+using test::waitFor;
+
+namespace {
+/** Records the ints it's sent, optionally holding on the first one. */
+class TestWorker : public WorkerBase
+{
+public:
+    TestWorker (WorkerPool& pool, bool holdFirst = false)
+        : WorkerBase (pool, 1024), hold (holdFirst) {}
+
+    void processRequest (uint32_t size, const void* data) override
+    {
+        jassert (size == sizeof (int));
+        if (hold)
+        {
+            hold = false;
+            started.signal();
+            release.wait (5000);
+        }
+
+        received.add (*static_cast<const int*> (data));
+        respondToWork (size, data);
+    }
+
+    void processResponse (uint32_t, const void* data) override
+    {
+        responded.add (*static_cast<const int*> (data));
+    }
+
+    bool schedule (int value) { return scheduleWork (sizeof (int), &value); }
+
+    bool hold;
+    WaitableEvent started, release;
+    Array<int, CriticalSection> received;
+    Array<int> responded;
+};
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (WorkerPoolTests)
+
+BOOST_AUTO_TEST_CASE (OrderedPerWorker)
+{
+    WorkerPool pool ("test_worker", 4, 4096);
+    OwnedArray<TestWorker> workers;
+    for (int i = 0; i < 4; ++i)
+        workers.add (new TestWorker (pool));
+
+    for (int value = 0; value < 100; ++value)
+        for (auto* worker : workers)
+            BOOST_REQUIRE (worker->schedule (value));
+
+    for (auto* worker : workers)
+    {
+        BOOST_REQUIRE (waitFor ([worker] { return worker->received.size() == 100; }));
+        for (int value = 0; value < 100; ++value)
+            BOOST_REQUIRE_EQUAL (worker->received[value], value);
+
+        worker->processWorkResponses();
+        BOOST_REQUIRE_EQUAL (worker->responded.size(), 100);
+        BOOST_REQUIRE_EQUAL (worker->responded.getLast(), 99);
+    }
+
+    const auto stats = pool.getStats();
+    BOOST_REQUIRE_EQUAL (stats.numProcessed, 400);
+    BOOST_REQUIRE_EQUAL (stats.queueDepth, 0);
+    BOOST_REQUIRE (stats.maxQueueDepth > 0 && stats.maxQueueDepth <= 400);
+    BOOST_REQUIRE (stats.maxLatencyMs >= stats.averageLatencyMs);
+    workers.clear();
+}
+
+BOOST_AUTO_TEST_CASE (SlowWorkerDoesNotBlockOthers)
+{
+    WorkerPool pool ("test_worker", 2, 4096);
+    TestWorker slow (pool, true), fast (pool);
+
+    BOOST_REQUIRE (slow.schedule (1));
+    BOOST_REQUIRE (slow.started.wait (2000));
+    BOOST_REQUIRE (slow.schedule (2));
+
+    // the slow worker's queue waits behind its first request, others don't
+    BOOST_REQUIRE (fast.schedule (3));
+    BOOST_REQUIRE (waitFor ([&fast] { return fast.received.size() == 1; }));
+    BOOST_REQUIRE (slow.received.isEmpty());
+    BOOST_REQUIRE_EQUAL (pool.getStats().queueDepth, 2);
+
+    slow.release.signal();
+    BOOST_REQUIRE (waitFor ([&slow] { return slow.received.size() == 2; }));
+    BOOST_REQUIRE_EQUAL (slow.received[0], 1);
+    BOOST_REQUIRE_EQUAL (slow.received[1], 2);
+}
+
+BOOST_AUTO_TEST_CASE (FullQueueRejects)
+{
+    WorkerPool pool ("test_worker", 1, 64);
+    TestWorker worker (pool, true);
+    BOOST_REQUIRE (worker.schedule (0));
+    BOOST_REQUIRE (worker.started.wait (2000));
+
+    int numScheduled = 0;
+    while (worker.schedule (numScheduled + 1))
+        ++numScheduled;
+
+    const auto stats = pool.getStats();
+    BOOST_REQUIRE_EQUAL (stats.numRejected, 1);
+    BOOST_REQUIRE_EQUAL (stats.queueDepth, numScheduled + 1);
+
+    worker.release.signal();
+    BOOST_REQUIRE (waitFor ([&] { return worker.received.size() == numScheduled + 1; }));
+    pool.resetStats();
+    BOOST_REQUIRE_EQUAL (pool.getStats().numRejected, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <thread>
+#include "engine/nodes/AudioMixerProcessor.h"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+/** Renders a block with track i's input set to (i + 1) / 10. */
+static void renderBlock (AudioMixerProcessor& mixer, AudioSampleBuffer& audio)
+{
+    MidiBuffer midi;
+    audio.clear();
+    for (int t = 0; t < mixer.getBusCount (true); ++t)
+    {
+        auto input (mixer.getBusBuffer<float> (audio, true, t));
+        for (int c = 0; c < input.getNumChannels(); ++c)
+            FloatVectorOperations::fill (input.getWritePointer (c), 0.1f * (float) (t + 1), input.getNumSamples());
+    }
+
+    mixer.processBlock (audio, midi);
+}
+
+static float renderSteady (AudioMixerProcessor& mixer, int outputBus, int blockSize = 256)
+{
+    const int numChannels = jmax (mixer.getTotalNumInputChannels(), mixer.getTotalNumOutputChannels());
+    AudioSampleBuffer audio (numChannels, blockSize);
+    // the first block ramps from the previous gains
+    renderBlock (mixer, audio);
+    renderBlock (mixer, audio);
+    auto output (mixer.getBusBuffer<float> (audio, false, outputBus));
+    return output.getSample (1, blockSize - 1);
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (AudioMixerTest)
+
+BOOST_AUTO_TEST_CASE (GainMuteAndGroups)
+{
+    AudioMixerProcessor mixer (4);
+    mixer.prepareToPlay (44100.0, 256);
+    BOOST_REQUIRE_EQUAL (mixer.getNumTracks(), 4);
+    BOOST_REQUIRE_CLOSE_FRACTION (renderSteady (mixer, 0), 1.f, 1.0e-5);
+
+    mixer.setTrackGain (0, 0.5f);
+    mixer.setTrackMuted (1, true);
+    BOOST_REQUIRE (mixer.isTrackMuted (1));
+    BOOST_REQUIRE_EQUAL (mixer.addGroup(), 0);
+    mixer.setTrackGroup (2, 0);
+    mixer.getGroupMonitor (0)->requestGain (2.f);
+    BOOST_REQUIRE_CLOSE_FRACTION (renderSteady (mixer, 0), 0.05f + 0.6f + 0.4f, 1.0e-5);
+    BOOST_REQUIRE_CLOSE_FRACTION (mixer.getMonitor (0)->getGain(), 0.5f, 1.0e-6);
+
+    mixer.getGroupMonitor (0)->requestMute (true);
+    mixer.setMasterVolume (-6.f);
+    BOOST_REQUIRE_CLOSE_FRACTION (renderSteady (mixer, 0), 0.45f * Decibels::decibelsToGain (-6.f), 1.0e-4);
+
+    mixer.setMasterMuted (true);
+    BOOST_REQUIRE_EQUAL (renderSteady (mixer, 0), 0.f);
+    mixer.releaseResources();
+}
+
+BOOST_AUTO_TEST_CASE (AuxSends)
+{
+    AudioMixerProcessor mixer (4);
+    BOOST_REQUIRE (mixer.addAuxBus());
+    BOOST_REQUIRE_EQUAL (mixer.getNumAuxBuses(), 1);
+    BOOST_REQUIRE (mixer.getAuxMonitor (0) != nullptr);
+    mixer.prepareToPlay (44100.0, 256);
+
+    // post fader follows the track gain, pre fader ignores it
+    mixer.setTrackGain (0, 0.5f);
+    mixer.setTrackSend (0, 0, 0.5f);
+    mixer.setTrackGain (1, 0.f);
+    mixer.setTrackSend (1, 0, 1.f, true);
+    BOOST_REQUIRE_CLOSE_FRACTION (renderSteady (mixer, 1), 0.025f + 0.2f, 1.0e-5);
+    BOOST_REQUIRE_CLOSE_FRACTION (renderSteady (mixer, 0), 0.05f + 0.3f + 0.4f, 1.0e-5);
+
+    // mutes silence pre fader sends too
+    mixer.setTrackMuted (1, true);
+    BOOST_REQUIRE_CLOSE_FRACTION (renderSteady (mixer, 1), 0.025f, 1.0e-5);
+
+    MemoryBlock state;
+    mixer.getStateInformation (state);
+    AudioMixerProcessor restored (4);
+    restored.addAuxBus();
+    restored.setStateInformation (state.getData(), (int) state.getSize());
+    BOOST_REQUIRE (restored.isTrackMuted (1));
+    BOOST_REQUIRE_CLOSE_FRACTION (restored.getMonitor (0)->getSend (0), 0.5f, 1.0e-6);
+    BOOST_REQUIRE (restored.getMonitor (1)->isSendPreFader (0));
+}
+
+BOOST_AUTO_TEST_CASE (LayoutChangesWhileRendering)
+{
+    AudioMixerProcessor mixer (4);
+    mixer.prepareToPlay (44100.0, 256);
+
+    // room for the master and every aux bus
+    AudioSampleBuffer audio (2 * (1 + AudioMixerProcessor::maxAuxBuses), 256);
+    std::atomic<bool> done { false };
+    std::atomic<int> numBlocks { 0 }, numSilent { 0 };
+    std::thread audioThread ([&]() {
+        MidiBuffer midi;
+        while (! done.load())
+        {
+            for (int c = 0; c < 8; ++c)
+                FloatVectorOperations::fill (audio.getWritePointer (c), 0.1f, audio.getNumSamples());
+            mixer.processBlock (audio, midi);
+            // every track reaches the master directly or through a group
+            if (audio.getSample (0, audio.getNumSamples() - 1) <= 0.f)
+                ++numSilent;
+            ++numBlocks;
+        }
+    });
+
+    for (int i = 0; i < AudioMixerProcessor::maxGroups; ++i)
+    {
+        BOOST_REQUIRE_EQUAL (mixer.addGroup(), i);
+        mixer.setTrackGroup (i % 4, i);
+        BOOST_REQUIRE (mixer.addAuxBus());
+        mixer.setTrackSend (i % 4, i, 0.5f);
+        Thread::sleep (2);
+    }
+
+    BOOST_REQUIRE_EQUAL (mixer.addGroup(), -1);
+    BOOST_REQUIRE (! mixer.addAuxBus());
+    done = true;
+    audioThread.join();
+
+    BOOST_REQUIRE (numBlocks.load() > 0);
+    BOOST_REQUIRE_EQUAL (numSilent.load(), 0);
+    BOOST_REQUIRE_EQUAL (mixer.getNumGroups(), (int) AudioMixerProcessor::maxGroups);
+    BOOST_REQUIRE_EQUAL (mixer.getNumAuxBuses(), (int) AudioMixerProcessor::maxAuxBuses);
+    BOOST_REQUIRE (mixer.getAuxMonitor (AudioMixerProcessor::maxAuxBuses - 1) != nullptr);
+    mixer.releaseResources();
+}
+
+BOOST_AUTO_TEST_CASE (Benchmark)
+{
+    const int blockSize = 512, numBlocks = 200;
+    AudioMixerProcessor mixer (64);
+    mixer.addAuxBus();
+    mixer.addAuxBus();
+    for (int t = 0; t < 64; ++t)
+        mixer.setTrackSend (t, t % 2, 0.25f);
+    mixer.prepareToPlay (44100.0, blockSize);
+
+    AudioSampleBuffer audio (mixer.getTotalNumInputChannels(), blockSize);
+    const auto run = [&] {
+        const auto start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numBlocks; ++i)
+            renderBlock (mixer, audio);
+        return (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+    };
+
+    const double quiet = run();
+    mixer.addMeterSubscriber();
+    const double metered = run();
+    mixer.removeMeterSubscriber();
+    BOOST_REQUIRE (mixer.getMonitor (0)->getLevel (0) > 0.f);
+    BOOST_TEST_MESSAGE ("64 tracks, 2 aux: " << quiet << " ms/block, metered " << metered << " ms/block");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
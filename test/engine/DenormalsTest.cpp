@@ -0,0 +1,146 @@
+#include <boost/test/unit_test.hpp>
+#include <cfloat>
+#include "engine/denormals.hpp"
+#include "engine/lookaheadrenderer.hpp"
+#include "engine/nodes/AllPassFilterNode.h"
+#include "engine/nodes/CombFilterProcessor.h"
+#include "engine/nodes/ReverbProcessor.h"
+#include "threadpools.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+struct TailStats
+{
+    double earlyMs = 0.0; ///< first quarter, the signal is loud
+    double lateMs = 0.0; ///< last quarter, the tail has decayed
+    int numDenormals = 0;
+    bool flushing = true; ///< the thread flushed denormals in every block
+};
+
+/** Feeds one block of noise then silence, timing the loud start against
+    the decayed end of the tail.
+ */
+static TailStats renderTail (AudioProcessor& proc, int numBlocks)
+{
+    const int blockSize = 512;
+    proc.prepareToPlay (44100.0, blockSize);
+    AudioSampleBuffer audio (2, blockSize);
+    MidiBuffer midi;
+    Random random (5);
+    TailStats stats;
+
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        audio.clear();
+        if (block == 0)
+            for (int c = 0; c < 2; ++c)
+                for (int i = 0; i < blockSize; ++i)
+                    audio.setSample (c, i, random.nextFloat() * 2.f - 1.f);
+
+        stats.flushing &= isFlushingDenormals();
+        const auto start = Time::getMillisecondCounterHiRes();
+        proc.processBlock (audio, midi);
+        const auto elapsed = Time::getMillisecondCounterHiRes() - start;
+
+        if (block < numBlocks / 4)
+            stats.earlyMs += elapsed;
+        else if (block >= numBlocks - numBlocks / 4)
+            stats.lateMs += elapsed;
+
+        for (int c = 0; c < 2; ++c)
+            for (int i = 0; i < blockSize; ++i)
+                if (const auto x = std::abs (audio.getSample (c, i)); x > 0.f && x < FLT_MIN)
+                    ++stats.numDenormals;
+    }
+
+    proc.releaseResources();
+    return stats;
+}
+
+/** Renders the tail on a shared worker thread, which plugin work runs on,
+    without a guard of its own.
+ */
+static void checkTailStaysClean (AudioProcessor& proc)
+{
+    TailStats stats;
+    WaitableEvent done;
+    ThreadPools::getInstance().addJob (ThreadPools::worker, [&] {
+        // ~20 seconds, long enough for the feedback to decay past FLT_MIN
+        stats = renderTail (proc, 1700);
+        done.signal();
+    });
+
+    BOOST_REQUIRE (done.wait (60000));
+    // timing depends on the machine, report it only
+    BOOST_TEST_MESSAGE (proc.getName() << ": loud " << stats.earlyMs << " ms, tail "
+                                       << stats.lateMs << " ms, " << stats.numDenormals << " denormals");
+    BOOST_REQUIRE (stats.flushing);
+    BOOST_REQUIRE_EQUAL (stats.numDenormals, 0);
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (DenormalsTest)
+
+#if JUCE_INTEL || JUCE_ARM
+BOOST_AUTO_TEST_CASE (GuardNestsAndRestores)
+{
+    const bool wasFlushing = isFlushingDenormals();
+    FloatVectorOperations::disableDenormalisedNumberSupport (false);
+    BOOST_REQUIRE (! isFlushingDenormals());
+
+    {
+        const ScopedFlushDenormals outer;
+        BOOST_REQUIRE (isFlushingDenormals());
+        {
+            const ScopedFlushDenormals inner;
+            BOOST_REQUIRE (isFlushingDenormals());
+        }
+        // the inner guard found it flushing and leaves it that way
+        BOOST_REQUIRE (isFlushingDenormals());
+
+        volatile float tiny = FLT_MIN;
+        volatile float half = tiny * 0.5f;
+        BOOST_REQUIRE_EQUAL ((float) half, 0.f);
+    }
+
+    BOOST_REQUIRE (! isFlushingDenormals());
+    FloatVectorOperations::disableDenormalisedNumberSupport (wasFlushing);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE (LookaheadThreadFlushes)
+{
+    std::atomic<int> flushing { -1 };
+    LookaheadRenderer lookahead;
+    lookahead.start (1, 64, 1, [&flushing] (AudioBuffer<float>&, MidiBuffer&) {
+        flushing = isFlushingDenormals() ? 1 : 0;
+    });
+    BOOST_REQUIRE (lookahead.isActive());
+
+    AudioBuffer<float> audio (1, 64);
+    MidiBuffer midi;
+    for (int i = 0; i < 2000 && flushing.load() < 0; ++i)
+    {
+        lookahead.process (audio, midi);
+        Thread::sleep (1);
+    }
+
+    lookahead.stop();
+    BOOST_REQUIRE_EQUAL (flushing.load(), 1);
+}
+
+BOOST_AUTO_TEST_CASE (DecayingTailsOnWorkers)
+{
+    ReverbProcessor reverb;
+    checkTailStaysClean (reverb);
+
+    CombFilterProcessor comb (true);
+    checkTailStaysClean (comb);
+
+    AllPassFilterProcessor allPass (true);
+    checkTailStaysClean (allPass);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/deviceio.hpp"
+#include "engine/gainkernel.hpp"
+#include "testutil.hpp"
+
+using namespace element;
+using namespace juce;
+using test::fillNoise;
+
+namespace {
+/** The device path before DeviceIO: copy and meter inputs separately, then
+    copy through the temp buffer and mix buffer of one graph and back.
+    Returns the bytes read and written.
+ */
+static size_t renderLegacy (const AudioSampleBuffer& ins, AudioSampleBuffer& outs,
+                            AudioSampleBuffer& temp, AudioSampleBuffer& mix)
+{
+    const int numSamples = outs.getNumSamples();
+    const auto blockBytes = sizeof (float) * (size_t) numSamples;
+    size_t bytes = 0;
+
+    for (int c = 0; c < ins.getNumChannels(); ++c)
+    {
+        memcpy (outs.getWritePointer (c), ins.getReadPointer (c), blockBytes);
+        bytes += blockBytes * 2;
+    }
+    for (int c = 0; c < ins.getNumChannels(); ++c)
+    {
+        ignoreUnused (ins.getMagnitude (c, 0, numSamples));
+        bytes += blockBytes;
+    }
+
+    for (int c = 0; c < outs.getNumChannels(); ++c)
+    {
+        mix.clear (c, 0, numSamples);
+        temp.copyFrom (c, 0, outs, c, 0, numSamples);
+        mix.addFrom (c, 0, temp, c, 0, numSamples);
+        outs.copyFrom (c, 0, mix, c, 0, numSamples);
+        bytes += blockBytes * 8;
+    }
+
+    for (int c = 0; c < outs.getNumChannels(); ++c)
+    {
+        ignoreUnused (outs.getMagnitude (c, 0, numSamples));
+        bytes += blockBytes;
+    }
+
+    return bytes;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (DeviceIOTest)
+
+BOOST_AUTO_TEST_CASE (CopyAndMeasureMatches)
+{
+    Random random (3);
+    for (const int numSamples : { 1, 7, 8, 63, 512 })
+    {
+        AudioSampleBuffer source (1, numSamples), dest (1, numSamples);
+        fillNoise (source, random);
+        const auto level = GainKernel::copyAndMeasure (dest.getWritePointer (0), source.getReadPointer (0), numSamples);
+        for (int i = 0; i < numSamples; ++i)
+            BOOST_REQUIRE_EQUAL (dest.getSample (0, i), source.getSample (0, i));
+        BOOST_REQUIRE_CLOSE_FRACTION (level.rms, source.getRMSLevel (0, 0, numSamples), 1.0e-4);
+        BOOST_REQUIRE_EQUAL (level.peak, source.getMagnitude (0, 0, numSamples));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (StagesDeviceChannels)
+{
+    Random random (5);
+    const int numSamples = 256;
+
+    for (const auto counts : { std::make_pair (2, 4), std::make_pair (4, 2), std::make_pair (0, 2) })
+    {
+        const int numIns = counts.first, numOuts = counts.second;
+        AudioSampleBuffer ins (jmax (1, numIns), numSamples), outs (numOuts, numSamples);
+        fillNoise (ins, random);
+        fillNoise (outs, random);
+
+        DeviceIO io;
+        io.prepare (numIns, numOuts, numSamples);
+        auto buffer = io.begin (ins.getArrayOfReadPointers(), numIns, outs.getArrayOfWritePointers(), numOuts, numSamples);
+        BOOST_REQUIRE_EQUAL (buffer.getNumChannels(), jmax (numIns, numOuts));
+
+        for (int c = 0; c < buffer.getNumChannels(); ++c)
+        {
+            // shared channels render in the device outputs
+            if (c < numOuts)
+                BOOST_REQUIRE (buffer.getReadPointer (c) == outs.getReadPointer (c));
+            if (c < numIns)
+            {
+                BOOST_REQUIRE_EQUAL (buffer.getSample (c, 17), ins.getSample (c, 17));
+                BOOST_REQUIRE_EQUAL (io.getPeak (c, true), ins.getMagnitude (c, 0, numSamples));
+            }
+            else
+            {
+                BOOST_REQUIRE_EQUAL (buffer.getMagnitude (c, 0, numSamples), 0.f);
+            }
+        }
+
+        io.end (outs.getArrayOfReadPointers(), numOuts, numSamples);
+        for (int c = 0; c < numOuts; ++c)
+            BOOST_REQUIRE_EQUAL (io.getPeak (c, false), outs.getMagnitude (c, 0, numSamples));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (BytesMovedBenchmark)
+{
+    const int numChans = 2, numSamples = 512, numBlocks = 20000;
+    Random random (7);
+    AudioSampleBuffer ins (numChans, numSamples), outs (numChans, numSamples);
+    AudioSampleBuffer temp (numChans, numSamples), mix (numChans, numSamples);
+    fillNoise (ins, random);
+
+    DeviceIO io;
+    io.prepare (numChans, numChans, numSamples);
+    size_t newBytes = 0, legacyBytes = 0;
+
+    auto start = Time::getMillisecondCounterHiRes();
+    for (int i = 0; i < numBlocks; ++i)
+    {
+        // a single graph renders in place between these
+        ignoreUnused (io.begin (ins.getArrayOfReadPointers(), numChans, outs.getArrayOfWritePointers(), numChans, numSamples));
+        io.end (outs.getArrayOfReadPointers(), numChans, numSamples);
+        newBytes = io.getBytesMoved();
+    }
+    const auto newMs = (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+
+    start = Time::getMillisecondCounterHiRes();
+    for (int i = 0; i < numBlocks; ++i)
+        legacyBytes = renderLegacy (ins, outs, temp, mix);
+    const auto legacyMs = (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+
+    BOOST_TEST_MESSAGE ("stereo 512 sample block: " << (int) newBytes << " bytes in " << newMs * 1000.0
+                                                    << " us, was " << (int) legacyBytes << " bytes in "
+                                                    << legacyMs * 1000.0 << " us");
+
+    // copy in and meter out, one read and one write per input, one read per output
+    const auto blockBytes = sizeof (float) * (size_t) numSamples;
+    BOOST_REQUIRE_EQUAL (newBytes, blockBytes * numChans * 3);
+    BOOST_REQUIRE (newBytes * 3 < legacyBytes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/lookaheadrenderer.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+static void addNote (MidiBuffer& midi, int note)
+{
+    midi.clear();
+    midi.addEvent (MidiMessage::noteOn (1, note, 1.f), 0);
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (LookaheadRendererTest)
+
+BOOST_AUTO_TEST_CASE (OverrunRendersDirectly)
+{
+    WaitableEvent entered, release;
+    LookaheadRenderer lookahead;
+    lookahead.start (2, 64, 2, [&] (AudioBuffer<float>&, MidiBuffer&) {
+        entered.signal();
+        release.wait (5000);
+    });
+    BOOST_REQUIRE (lookahead.isActive());
+
+    AudioBuffer<float> buffer (2, 64);
+    MidiBuffer midi;
+
+    // the worker stalls on the first block, three more fill the queue
+    addNote (midi, 0);
+    BOOST_REQUIRE (lookahead.process (buffer, midi));
+    BOOST_REQUIRE (entered.wait (5000));
+    for (int note = 1; note < 4; ++note)
+    {
+        addNote (midi, note);
+        BOOST_REQUIRE (lookahead.process (buffer, midi));
+    }
+    BOOST_REQUIRE_EQUAL (lookahead.getNumOverruns(), 0);
+
+    // the next block is kept, with unrendered MIDI ahead of its own
+    buffer.clear();
+    buffer.setSample (0, 0, 0.5f);
+    addNote (midi, 4);
+    BOOST_REQUIRE (! lookahead.process (buffer, midi));
+    BOOST_REQUIRE_EQUAL (lookahead.getNumOverruns(), 1);
+    BOOST_REQUIRE_EQUAL (buffer.getSample (0, 0), 0.5f);
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 4);
+
+    int expected = 1;
+    for (const auto meta : midi)
+    {
+        BOOST_REQUIRE_EQUAL (meta.samplePosition, 0);
+        BOOST_REQUIRE_EQUAL (meta.getMessage().getNoteNumber(), expected++);
+    }
+
+    release.signal();
+    lookahead.stop();
+}
+
+BOOST_AUTO_TEST_CASE (DeferredMidiGoesAhead)
+{
+    LookaheadRenderer lookahead;
+    lookahead.start (1, 64, 1, [] (AudioBuffer<float>&, MidiBuffer&) {});
+    BOOST_REQUIRE (lookahead.isActive());
+
+    AudioBuffer<float> buffer (1, 64);
+    MidiBuffer midi;
+    buffer.setSample (0, 0, 1.f);
+    addNote (midi, 1);
+    lookahead.defer (buffer, midi);
+    BOOST_REQUIRE_EQUAL (buffer.getMagnitude (0, 64), 0.f);
+    BOOST_REQUIRE (midi.isEmpty());
+
+    // the next block queued carries the deferred note first
+    addNote (midi, 2);
+    BOOST_REQUIRE (lookahead.process (buffer, midi));
+    for (int i = 0; i < 1000 && midi.isEmpty(); ++i)
+    {
+        Thread::sleep (1);
+        BOOST_REQUIRE (lookahead.process (buffer, midi));
+    }
+
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 2);
+    int expected = 1;
+    for (const auto meta : midi)
+        BOOST_REQUIRE_EQUAL (meta.getMessage().getNoteNumber(), expected++);
+
+    lookahead.stop();
+}
+
+BOOST_AUTO_TEST_CASE (SizeChangeFlushesQueue)
+{
+    LookaheadRenderer lookahead;
+    lookahead.start (1, 64, 1, [] (AudioBuffer<float>&, MidiBuffer&) {});
+    BOOST_REQUIRE (lookahead.isActive());
+
+    AudioBuffer<float> buffer (1, 64);
+    MidiBuffer midi;
+    for (int i = 0; i < 2; ++i)
+    {
+        buffer.clear();
+        BOOST_REQUIRE (lookahead.process (buffer, midi));
+    }
+
+    AudioBuffer<float> smaller (1, 32);
+    smaller.clear();
+    smaller.setSample (0, 0, 1.f);
+    BOOST_REQUIRE (! lookahead.process (smaller, midi));
+    BOOST_REQUIRE_EQUAL (smaller.getSample (0, 0), 1.f);
+
+    // nothing queued before the small block is output after it
+    buffer.clear();
+    buffer.setSample (0, 0, 1.f);
+    BOOST_REQUIRE (lookahead.process (buffer, midi));
+    BOOST_REQUIRE_EQUAL (buffer.getMagnitude (0, 64), 0.f);
+    BOOST_REQUIRE_EQUAL (lookahead.getNumOverruns(), 0);
+
+    lookahead.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
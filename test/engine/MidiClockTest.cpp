@@ -0,0 +1,132 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/midiclock.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+struct ClockListener : public MidiClock::Listener
+{
+    void midiClockSignalAcquired() override { ++acquired; }
+    void midiClockSignalDropped() override { ++dropped; }
+    void midiClockTempoChanged (const float bpm) override { tempos.add (bpm); }
+    void midiClockSongPositionChanged (const int beats) override { songPosition = beats; }
+
+    int acquired = 0, dropped = 0, songPosition = -1;
+    Array<float> tempos;
+};
+
+static double rms (const Array<double>& errors)
+{
+    double sum = 0.0;
+    for (auto e : errors)
+        sum += e * e;
+    return errors.isEmpty() ? 0.0 : std::sqrt (sum / errors.size());
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (MidiClockTest)
+
+BOOST_AUTO_TEST_CASE (MasterFractionalTicks)
+{
+    const double sampleRate = 44100.0;
+    const int blockSizes[] = { 1, 37, 480, 1001, 64, 4099 };
+
+    MidiClockMaster master;
+    master.setSampleRate (sampleRate);
+    master.setTempo (123.0);
+    master.reset();
+    const double samplesPerClock = master.getSamplesPerClock();
+    BOOST_REQUIRE_CLOSE (samplesPerClock, 60.0 * sampleRate / (24.0 * 123.0), 1.0e-9);
+
+    int64 position = 0, numTicks = 0;
+    double maxError = 0.0;
+    MidiBuffer midi;
+    for (int block = 0; position < 2000000; ++block)
+    {
+        const int numSamples = blockSizes[block % numElementsInArray (blockSizes)];
+        midi.clear();
+        master.render (midi, numSamples);
+        for (const auto m : midi)
+        {
+            BOOST_REQUIRE (m.getMessage().isMidiClock());
+            BOOST_REQUIRE (m.samplePosition < numSamples);
+            const double ideal = (double) numTicks * samplesPerClock;
+            maxError = jmax (maxError, std::abs ((double) (position + m.samplePosition) - ideal));
+            ++numTicks;
+        }
+        position += numSamples;
+    }
+
+    BOOST_TEST_MESSAGE ("master: " << numTicks << " ticks, max error " << maxError << " samples");
+    BOOST_REQUIRE (maxError < 1.0);
+    BOOST_REQUIRE_EQUAL (numTicks, (int64) std::ceil ((double) position / samplesPerClock));
+}
+
+BOOST_AUTO_TEST_CASE (SlaveJitterBenchmark)
+{
+    const double bpm = 120.0;
+    const double period = 60.0 / (bpm * 24.0);
+    const double jitterSeconds = 0.001;
+    const int numTicks = 24 * 2 * 60; // one minute
+
+    MidiClock clock;
+    ClockListener listener;
+    clock.addListener (&listener);
+    clock.reset (44100.0, 512);
+
+    Random random (1234);
+    Array<double> rawErrors, filteredErrors;
+    double lastTime = 0.0;
+
+    for (int i = 0; i < numTicks; ++i)
+    {
+        const double time = 10.0 + i * period + (random.nextDouble() * 2.0 - 1.0) * jitterSeconds;
+        auto msg = MidiMessage::midiClock();
+        msg.setTimeStamp (time);
+        clock.process (msg);
+
+        // only measure the second half, after the loop has settled
+        if (i > numTicks / 2)
+        {
+            rawErrors.add (60.0 / ((time - lastTime) * 24.0) - bpm);
+            filteredErrors.add (clock.getTempo() - bpm);
+        }
+
+        lastTime = time;
+    }
+
+    const double rawRms = rms (rawErrors);
+    const double filteredRms = rms (filteredErrors);
+    BOOST_TEST_MESSAGE ("slave: +/-" << jitterSeconds * 1000.0 << " ms input jitter, tempo error rms raw "
+                                     << rawRms << " bpm, filtered " << filteredRms << " bpm, "
+                                     << listener.tempos.size() << " tempo updates");
+
+    BOOST_REQUIRE_EQUAL (listener.acquired, 1);
+    BOOST_REQUIRE_EQUAL (listener.dropped, 0);
+    BOOST_REQUIRE (listener.tempos.size() > 1);
+    BOOST_REQUIRE (filteredRms < rawRms * 0.25);
+    BOOST_REQUIRE (std::abs (clock.getTempo() - bpm) < 0.5);
+
+    // a long gap drops the signal
+    auto msg = MidiMessage::midiClock();
+    msg.setTimeStamp (lastTime + 2.0);
+    clock.process (msg);
+    BOOST_REQUIRE_EQUAL (listener.dropped, 1);
+    BOOST_REQUIRE_EQUAL (clock.getTempo(), 0.0);
+
+    clock.removeListener (&listener);
+}
+
+BOOST_AUTO_TEST_CASE (SongPositionPointer)
+{
+    MidiClock clock;
+    ClockListener listener;
+    clock.addListener (&listener);
+    clock.reset (44100.0, 512);
+    clock.process (MidiMessage::songPositionPointer (64));
+    BOOST_REQUIRE_EQUAL (listener.songPosition, 64);
+    clock.removeListener (&listener);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,172 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/graphnode.hpp"
+#include "engine/ionode.hpp"
+#include "engine/midikernel.hpp"
+#include "fixture/TestNode.h"
+#include "testutil.hpp"
+
+using namespace element;
+using namespace juce;
+using test::addNotes;
+
+namespace {
+class MidiReaderNode : public TestNode
+{
+public:
+    MidiReaderNode() : TestNode (0, 0, 1, 0) {}
+
+    bool wantsReadOnlyMidi() const override { return true; }
+
+    void render (AudioSampleBuffer&, MidiPipe& midi) override
+    {
+        numEvents += midi.getReadBuffer (0)->getNumEvents();
+    }
+
+    int numEvents = 0;
+};
+
+static void render (GraphNode& graph, MidiBuffer& midi)
+{
+    AudioSampleBuffer audio (2, 512);
+    audio.clear();
+    MidiBuffer* buffers[] = { &midi };
+    MidiPipe pipe (buffers, 1);
+    graph.render (audio, pipe);
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (MidiKernelTest)
+
+BOOST_AUTO_TEST_CASE (MergeIsStable)
+{
+    MidiBuffer a, b, c, merged;
+    addNotes (a, 1, 4, 10);
+    addNotes (b, 2, 4, 10);
+    addNotes (c, 3, 2, 5);
+
+    const MidiBuffer* sources[] = { &a, &b, &c };
+    int cursors[3];
+    MidiKernel::merge (sources, 3, cursors, merged);
+    BOOST_REQUIRE_EQUAL (merged.getNumEvents(), 10);
+
+    // same order addEvents gives when summing a, b then c
+    MidiBuffer expected (a);
+    expected.addEvents (b, 0, -1, 0);
+    expected.addEvents (c, 0, -1, 0);
+    BOOST_REQUIRE (merged.data == expected.data);
+}
+
+BOOST_AUTO_TEST_CASE (FilterInPlace)
+{
+    MidiBuffer midi, scratch;
+    MidiKernel::reserve (midi);
+    MidiKernel::reserve (scratch);
+    addNotes (midi, 1, 16, 4);
+    const auto* storage = midi.data.begin();
+
+    // rewriting only touches the buffer itself
+    MidiKernel::filter (midi, scratch, [] (uint8* data, int, int) {
+        data[1] = (uint8) (data[1] + 12);
+        return true;
+    });
+    BOOST_REQUIRE (midi.data.begin() == storage);
+    for (const auto m : midi)
+        BOOST_REQUIRE (m.getMessage().getNoteNumber() >= 72);
+
+    // dropping compacts through scratch without growing either buffer
+    MidiKernel::filter (midi, scratch, [] (uint8*, int, int time) { return time % 8 == 0; });
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 8);
+    BOOST_REQUIRE (scratch.isEmpty());
+    BOOST_REQUIRE (midi.data.begin() != storage && scratch.data.begin() == storage);
+    for (const auto m : midi)
+        BOOST_REQUIRE_EQUAL (m.samplePosition % 8, 0);
+
+    MidiKernel::scaleTimes (midi, 2, 1);
+    BOOST_REQUIRE_EQUAL (midi.getLastEventTime(), 112);
+    MidiKernel::scaleTimes (midi, 1, 2);
+    BOOST_REQUIRE_EQUAL (midi.getLastEventTime(), 56);
+}
+
+BOOST_AUTO_TEST_CASE (FanOutAndFanIn)
+{
+    GraphNode graph;
+    auto* midiIn = graph.addNode (new IONode (IONode::midiInputNode));
+    auto* midiOut = graph.addNode (new IONode (IONode::midiOutputNode));
+    Array<MidiReaderNode*> readers;
+    for (int i = 0; i < 3; ++i)
+    {
+        readers.add (new MidiReaderNode());
+        graph.addNode (readers.getLast());
+        BOOST_REQUIRE (graph.connectChannels (PortType::Midi, midiIn->nodeId, 0, readers.getLast()->nodeId, 0));
+    }
+
+    Array<Processor*> thru;
+    for (int i = 0; i < 3; ++i)
+    {
+        thru.add (graph.addNode (new TestNode (0, 0, 1, 1)));
+        BOOST_REQUIRE (graph.connectChannels (PortType::Midi, midiIn->nodeId, 0, thru.getLast()->nodeId, 0));
+        BOOST_REQUIRE (graph.connectChannels (PortType::Midi, thru.getLast()->nodeId, 0, midiOut->nodeId, 0));
+    }
+
+    graph.prepareToRender (44100.0, 512);
+
+    // pass-through nodes render first and need their own copies, the readers share the input
+    const auto& stats = graph.getBuildStats();
+    BOOST_REQUIRE_EQUAL (stats.copyOps, 3);
+    BOOST_REQUIRE_EQUAL (stats.addOps, 1);
+
+    MidiBuffer midi;
+    addNotes (midi, 1, 32, 16);
+    render (graph, midi);
+
+    for (auto* reader : readers)
+        BOOST_REQUIRE_EQUAL (reader->numEvents, 32);
+
+    BOOST_REQUIRE_EQUAL (midi.getNumEvents(), 96);
+    int last = 0;
+    for (const auto m : midi)
+    {
+        BOOST_REQUIRE (m.samplePosition >= last);
+        last = m.samplePosition;
+    }
+
+    graph.releaseResources();
+    graph.clear();
+}
+
+BOOST_AUTO_TEST_CASE (MergeBenchmark)
+{
+    const int numSources = 8, numRuns = 2000;
+    OwnedArray<MidiBuffer> sources;
+    for (int i = 0; i < numSources; ++i)
+        addNotes (*sources.add (new MidiBuffer()), i + 1, 128, 4);
+
+    MidiBuffer dest;
+    MidiKernel::reserve (dest, 64 * 1024);
+    int sink = 0;
+
+    auto start = Time::getMillisecondCounterHiRes();
+    for (int run = 0; run < numRuns; ++run)
+    {
+        dest = *sources.getFirst();
+        for (int i = 1; i < numSources; ++i)
+            dest.addEvents (*sources.getUnchecked (i), 0, -1, 0);
+        sink += dest.getNumEvents();
+    }
+    const auto addEvents = Time::getMillisecondCounterHiRes() - start;
+
+    int cursors[numSources];
+    start = Time::getMillisecondCounterHiRes();
+    for (int run = 0; run < numRuns; ++run)
+    {
+        MidiKernel::merge (sources.getRawDataPointer(), numSources, cursors, dest);
+        sink += dest.getNumEvents();
+    }
+    const auto merged = Time::getMillisecondCounterHiRes() - start;
+
+    BOOST_TEST_MESSAGE ("merge " << numSources << " x 128 events, " << numRuns << " runs: addEvents "
+                                 << addEvents << " ms, k-way " << merged << " ms (" << sink << ")");
+    BOOST_REQUIRE_EQUAL (sink, 2 * numRuns * numSources * 128);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/midikernel.hpp"
+#include "engine/nodes/MidiRouterNode.h"
+#include "testutil.hpp"
+
+using namespace element;
+using namespace juce;
+using test::addNotes;
+
+namespace {
+static void render (MidiRouterNode& router, OwnedArray<MidiBuffer>& buffers)
+{
+    AudioSampleBuffer audio (1, 512);
+    MidiPipe pipe (buffers.getRawDataPointer(), buffers.size());
+    router.render (audio, pipe);
+}
+
+static void createBuffers (OwnedArray<MidiBuffer>& buffers, int size)
+{
+    while (buffers.size() < size)
+        buffers.add (new MidiBuffer());
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (MidiRouterTest)
+
+BOOST_AUTO_TEST_CASE (MergesSourcesInOrder)
+{
+    MidiRouterNode router (4, 4);
+    router.prepareToRender (44100.0, 512);
+    MatrixState matrix (4, 4);
+    matrix.set (0, 2, true);
+    matrix.set (1, 2, true);
+    matrix.set (1, 3, true);
+    router.setMatrixState (matrix);
+    BOOST_REQUIRE_EQUAL (router.getNumActiveRoutes(), 3);
+
+    OwnedArray<MidiBuffer> buffers;
+    createBuffers (buffers, 4);
+    addNotes (*buffers[0], 1, 4, 10);
+    addNotes (*buffers[1], 2, 4, 10, 5);
+
+    MidiBuffer expected (*buffers[0]);
+    expected.addEvents (*buffers[1], 0, -1, 0);
+    const MidiBuffer second (*buffers[1]);
+
+    render (router, buffers);
+    BOOST_REQUIRE (buffers[0]->isEmpty());
+    BOOST_REQUIRE (buffers[1]->isEmpty());
+    BOOST_REQUIRE (buffers[2]->data == expected.data);
+    BOOST_REQUIRE (buffers[3]->data == second.data);
+}
+
+BOOST_AUTO_TEST_CASE (FiltersPerRoute)
+{
+    MidiRouterNode router (2, 2);
+    router.prepareToRender (44100.0, 512);
+    MatrixState matrix (2, 2);
+    matrix.set (0, 0, true);
+    matrix.set (0, 1, true);
+    router.setMatrixState (matrix);
+
+    MidiRouteFilter filter;
+    filter.channels = (uint16) (1 << 1); // channel 2
+    filter.types = MidiRouteFilter::notes;
+    filter.lowNote = 62;
+    filter.highNote = 64;
+    router.setRouteFilter (0, 1, filter);
+    BOOST_REQUIRE (router.getRouteFilter (0, 1) == filter);
+    BOOST_REQUIRE (router.getRouteFilter (0, 0).passesAll());
+
+    OwnedArray<MidiBuffer> buffers;
+    createBuffers (buffers, 2);
+    addNotes (*buffers[0], 1, 12, 1);
+    addNotes (*buffers[0], 2, 12, 1, 20);
+    buffers[0]->addEvent (MidiMessage::controllerEvent (2, 7, 100), 40);
+    render (router, buffers);
+
+    BOOST_REQUIRE_EQUAL (buffers[0]->getNumEvents(), 25);
+    BOOST_REQUIRE_EQUAL (buffers[1]->getNumEvents(), 3);
+    for (const auto meta : *buffers[1])
+    {
+        const auto msg = meta.getMessage();
+        BOOST_REQUIRE_EQUAL (msg.getChannel(), 2);
+        BOOST_REQUIRE (msg.getNoteNumber() >= 62 && msg.getNoteNumber() <= 64);
+    }
+
+    // filters are saved with the matrix
+    MemoryBlock state;
+    router.getState (state);
+    MidiRouterNode restored (2, 2);
+    restored.setState (state.getData(), (int) state.getSize());
+    BOOST_REQUIRE (restored.getRouteFilter (0, 1) == filter);
+    BOOST_REQUIRE (restored.getMatrixState() == matrix);
+}
+
+BOOST_AUTO_TEST_CASE (Benchmark)
+{
+    const int size = 16, numBlocks = 500;
+    MidiRouterNode router (size, size);
+    router.prepareToRender (44100.0, 512);
+    MatrixState matrix (size, size);
+    for (int src = 0; src < size; ++src)
+    {
+        matrix.set (src, src, true);
+        matrix.set (src, (src + 1) % size, true);
+    }
+    router.setMatrixState (matrix);
+
+    MidiRouteFilter filter;
+    filter.lowNote = 48;
+    filter.highNote = 84;
+    for (int src = 0; src < size; ++src)
+        router.setRouteFilter (src, (src + 1) % size, filter);
+
+    OwnedArray<MidiBuffer> buffers, input;
+    createBuffers (buffers, size);
+    createBuffers (input, size);
+    for (int i = 0; i < size; ++i)
+    {
+        // a dense MPE stream: notes with per note pressure and bends
+        for (int e = 0; e < 64; ++e)
+        {
+            const int channel = 2 + (e % 15);
+            input[i]->addEvent (MidiMessage::noteOn (channel, 36 + e % 60, (uint8) 90), e * 8);
+            input[i]->addEvent (MidiMessage::pitchWheel (channel, 8192 + e), e * 8 + 1);
+            input[i]->addEvent (MidiMessage::channelPressureChange (channel, e), e * 8 + 2);
+        }
+        buffers[i]->ensureSize (8192);
+    }
+
+    const auto start = Time::getMillisecondCounterHiRes();
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        for (int i = 0; i < size; ++i)
+            MidiKernel::copy (*input[i], *buffers[i]);
+        render (router, buffers);
+    }
+    const auto ms = (Time::getMillisecondCounterHiRes() - start) / numBlocks;
+
+    BOOST_REQUIRE (buffers[1]->getNumEvents() > input[1]->getNumEvents());
+    BOOST_TEST_MESSAGE ("16x16 router, 32 routes, 192 events per input: " << ms << " ms/block");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
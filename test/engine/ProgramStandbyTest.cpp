@@ -0,0 +1,193 @@
+#include <boost/test/unit_test.hpp>
+#include <element/node.hpp>
+#include "engine/midiprogrambank.hpp"
+#include "engine/programstandby.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+/** Outputs its level as DC. The level is the whole state. */
+class LevelProcessor : public AudioProcessor
+{
+public:
+    LevelProcessor()
+        : AudioProcessor (BusesProperties().withOutput ("Output", AudioChannelSet::stereo())) {}
+
+    const String getName() const override { return "Level"; }
+    void prepareToPlay (double, int) override {}
+    void releaseResources() override {}
+    void processBlock (AudioBuffer<float>& audio, MidiBuffer&) override
+    {
+        for (int c = 0; c < audio.getNumChannels(); ++c)
+            FloatVectorOperations::fill (audio.getWritePointer (c), level.load(), audio.getNumSamples());
+    }
+
+    void reset() override { ++numResets; }
+    double getTailLengthSeconds() const override { return 0.0; }
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return false; }
+    AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram (int) override {}
+    const String getProgramName (int) override { return {}; }
+    void changeProgramName (int, const String&) override {}
+
+    void getStateInformation (MemoryBlock& block) override
+    {
+        const float value = level.load();
+        block.replaceAll (&value, sizeof (float));
+    }
+
+    void setStateInformation (const void* data, int size) override
+    {
+        if (size == (int) sizeof (float))
+            level.store (*static_cast<const float*> (data));
+    }
+
+    std::atomic<float> level { 0.f };
+    std::atomic<int> numResets { 0 };
+};
+
+static MemoryBlock levelState (float level)
+{
+    return MemoryBlock (&level, sizeof (float));
+}
+
+/** Render blocks until the standby swaps, returning the number of blocks.
+    Loads are queued from the message thread, so it keeps dispatching. */
+static int renderUntilSwapped (ProgramStandby& standby, AudioBuffer<float>& audio, MidiBuffer& midi)
+{
+    for (int block = 1; block <= 1000; ++block)
+    {
+        audio.clear();
+        if (standby.process (audio, midi, false))
+            return block;
+        MessageManager::getInstance()->runDispatchLoopUntil (1);
+    }
+    return -1;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (ProgramStandbyTest)
+
+BOOST_AUTO_TEST_CASE (BankStates)
+{
+    MidiProgramBank bank;
+    BOOST_REQUIRE_EQUAL (bank.size(), 0);
+    bank.setState (3, levelState (0.5f));
+    bank.setState (128, levelState (0.5f));
+    bank.setState (4, MemoryBlock());
+    BOOST_REQUIRE_EQUAL (bank.size(), 1);
+    BOOST_REQUIRE (bank.contains (3));
+    BOOST_REQUIRE (bank.getState (4) == nullptr);
+    BOOST_REQUIRE (*bank.getState (3) == levelState (0.5f));
+    BOOST_REQUIRE_EQUAL (MidiProgramBank::getProgramFileName ("plugin", 7), String ("plugin_007.eln"));
+    bank.removeState (3);
+    BOOST_REQUIRE_EQUAL (bank.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE (BankLoadsGlobalFiles)
+{
+    TemporaryFile tempDir;
+    const auto dir = tempDir.getFile();
+    BOOST_REQUIRE (dir.createDirectory().wasOk());
+
+    for (const int program : { 0, 9, 127 })
+    {
+        ValueTree data (types::Node);
+        data.setProperty (tags::state, levelState ((float) program).toBase64Encoding(), nullptr);
+        const auto file = dir.getChildFile (MidiProgramBank::getProgramFileName ("plugin", program));
+        BOOST_REQUIRE (data.createXml()->writeTo (file));
+    }
+
+    MidiProgramBank bank;
+    BOOST_REQUIRE_EQUAL (bank.loadGlobalPrograms (dir, "plugin"), 3);
+    BOOST_REQUIRE (*bank.getState (9) == levelState (9.f));
+    BOOST_REQUIRE (*bank.getState (127) == levelState (127.f));
+    BOOST_REQUIRE (! bank.contains (1));
+    BOOST_REQUIRE_EQUAL (bank.loadGlobalPrograms (dir, "other"), 0);
+
+    dir.deleteRecursively();
+}
+
+BOOST_AUTO_TEST_CASE (CrossfadesToStandby)
+{
+    const int blockSize = 64;
+    LevelProcessor first, second;
+    first.level = 1.f;
+
+    MidiProgramBank bank;
+    bank.setState (1, levelState (0.5f));
+    bank.setState (2, levelState (0.25f));
+
+    ProgramStandby standby (first, second, [&bank] (int program, MemoryBlock& state) {
+        if (auto* s = bank.getState (program))
+        {
+            state = *s;
+            return true;
+        }
+        return false;
+    });
+
+    BOOST_REQUIRE (! standby.requestProgram (1));
+    first.prepareToPlay (44100.0, blockSize);
+    standby.prepare (44100.0, blockSize);
+    BOOST_REQUIRE (standby.isActive());
+
+    AudioBuffer<float> audio (2, blockSize);
+    MidiBuffer midi;
+
+    BOOST_REQUIRE (standby.requestProgram (1));
+    BOOST_REQUIRE (renderUntilSwapped (standby, audio, midi) > 0);
+    BOOST_REQUIRE (standby.getLive() == &second);
+    BOOST_REQUIRE (standby.getSpare() == &first);
+    BOOST_REQUIRE_EQUAL (standby.getLiveProgram(), 1);
+
+    // the swap block fades from 1.0 to 0.5
+    BOOST_REQUIRE_CLOSE (audio.getSample (0, 0), 1.f, 0.001f);
+    for (int i = 1; i < blockSize; ++i)
+        BOOST_REQUIRE (audio.getSample (1, i) < audio.getSample (1, i - 1));
+    BOOST_REQUIRE_CLOSE (audio.getSample (1, blockSize - 1), 0.5f + 0.5f / (float) blockSize, 0.001f);
+
+    audio.clear();
+    BOOST_REQUIRE (! standby.process (audio, midi, false));
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, 0), 0.5f);
+
+    // the old instance is left alone until the owner has taken it back
+    const int resetsBefore = first.numResets.load();
+    BOOST_REQUIRE (standby.requestProgram (2));
+    for (int i = 0; i < 20; ++i)
+    {
+        BOOST_REQUIRE (! standby.process (audio, midi, false));
+        MessageManager::getInstance()->runDispatchLoopUntil (1);
+    }
+    BOOST_REQUIRE_EQUAL (first.numResets.load(), resetsBefore);
+
+    // then it's reset and reloaded in the background
+    standby.handoverComplete();
+    BOOST_REQUIRE (renderUntilSwapped (standby, audio, midi) > 0);
+    standby.handoverComplete();
+    BOOST_REQUIRE (standby.getLive() == &first);
+    BOOST_REQUIRE (first.numResets.load() > 0);
+    audio.clear();
+    standby.process (audio, midi, false);
+    BOOST_REQUIRE_EQUAL (audio.getSample (0, blockSize - 1), 0.25f);
+
+    // already live, or no state: nothing changes
+    BOOST_REQUIRE (standby.requestProgram (2));
+    BOOST_REQUIRE (standby.requestProgram (5));
+    for (int i = 0; i < 20; ++i)
+    {
+        BOOST_REQUIRE (! standby.process (audio, midi, false));
+        MessageManager::getInstance()->runDispatchLoopUntil (1);
+    }
+    BOOST_REQUIRE (standby.getLive() == &first);
+
+    standby.release();
+    BOOST_REQUIRE (! standby.isActive());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,104 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/renderadapter.hpp"
+
+using namespace element;
+using namespace juce;
+
+namespace {
+static const int hostBlockSizes[] = { 1, 7, 37, 64, 65, 127, 480, 1001, 4099 };
+
+static void fillRamp (AudioBuffer<float>& buffer, int64 start)
+{
+    for (int c = 0; c < buffer.getNumChannels(); ++c)
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            buffer.setSample (c, i, (float) (start + i + c));
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE (RenderAdapterTest)
+
+BOOST_AUTO_TEST_CASE (SplitsOddBlocks)
+{
+    RenderAdapter adapter;
+    adapter.prepare (2, 64, false);
+    BOOST_REQUIRE_EQUAL (adapter.getLatencySamples(), 0);
+
+    for (const int numSamples : hostBlockSizes)
+    {
+        AudioBuffer<float> buffer (2, numSamples);
+        fillRamp (buffer, 0);
+
+        MidiBuffer midi;
+        for (int i = 0; i < numSamples; i += 5)
+            midi.addEvent (MidiMessage::noteOn (1, i % 128, (uint8) 100), i);
+        const int numEvents = midi.getNumEvents();
+
+        int rendered = 0, seenEvents = 0;
+        adapter.process (buffer, midi, [&] (AudioBuffer<float>& block, MidiBuffer& blockMidi) {
+            BOOST_REQUIRE (block.getNumSamples() <= 64);
+            BOOST_REQUIRE_EQUAL (block.getSample (0, 0), (float) rendered);
+            for (const auto m : blockMidi)
+            {
+                BOOST_REQUIRE (m.samplePosition < block.getNumSamples());
+                BOOST_REQUIRE_EQUAL (m.getMessage().getNoteNumber(), (rendered + m.samplePosition) % 128);
+                ++seenEvents;
+            }
+
+            block.applyGain (2.f);
+            rendered += block.getNumSamples();
+        });
+
+        BOOST_REQUIRE_EQUAL (rendered, numSamples);
+        BOOST_REQUIRE_EQUAL (seenEvents, numEvents);
+        BOOST_REQUIRE_EQUAL (midi.getNumEvents(), numEvents);
+        for (const auto m : midi)
+            BOOST_REQUIRE_EQUAL (m.getMessage().getNoteNumber(), m.samplePosition % 128);
+        for (int i = 0; i < numSamples; ++i)
+            BOOST_REQUIRE_EQUAL (buffer.getSample (1, i), 2.f * (float) (i + 1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (FixedBlockLatency)
+{
+    const int blockSize = 64;
+    RenderAdapter adapter;
+    adapter.prepare (2, blockSize, true);
+    BOOST_REQUIRE_EQUAL (adapter.getLatencySamples(), blockSize);
+
+    int64 position = 0;
+    int numRenders = 0;
+    for (int round = 0; round < 3; ++round)
+    {
+        for (const int numSamples : hostBlockSizes)
+        {
+            AudioBuffer<float> buffer (2, numSamples);
+            fillRamp (buffer, position);
+
+            MidiBuffer midi;
+            if (numSamples > 3)
+                midi.addEvent (MidiMessage::noteOn (1, (int) ((position + 3) % 128), (uint8) 100), 3);
+
+            adapter.process (buffer, midi, [&] (AudioBuffer<float>& block, MidiBuffer&) {
+                BOOST_REQUIRE_EQUAL (block.getNumSamples(), blockSize);
+                ++numRenders;
+            });
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto expected = position + i - blockSize;
+                BOOST_REQUIRE_EQUAL (buffer.getSample (0, i), expected < 0 ? 0.f : (float) expected);
+            }
+
+            // every event comes back exactly one block later
+            for (const auto m : midi)
+                BOOST_REQUIRE_EQUAL (m.getMessage().getNoteNumber(),
+                                     (int) ((position + m.samplePosition - blockSize) % 128));
+
+            position += numSamples;
+        }
+    }
+
+    BOOST_REQUIRE_EQUAL ((int64) numRenders, position / blockSize);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
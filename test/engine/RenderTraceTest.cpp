@@ -0,0 +1,107 @@
+#include <boost/test/unit_test.hpp>
+#include "engine/rendertrace.hpp"
+
+#include <thread>
+
+using namespace element;
+using namespace juce;
+
+BOOST_AUTO_TEST_SUITE (RenderTraceTest)
+
+BOOST_AUTO_TEST_CASE (ChromeTrace)
+{
+    auto& trace = RenderTrace::getInstance();
+    BOOST_REQUIRE (trace.getTicksPerSecond() > 0.0);
+
+    const auto label = trace.registerLabel ("Test Node");
+    BOOST_REQUIRE_EQUAL (label, trace.registerLabel ("Test Node"));
+
+    trace.setEnabled (false);
+    trace.record (label, readRenderTicks(), readRenderTicks());
+
+    trace.setEnabled (true);
+    trace.clear();
+    {
+        ScopedRenderTrace scope (label);
+    }
+    trace.setEnabled (false);
+
+    MemoryOutputStream out;
+    BOOST_REQUIRE (trace.writeChromeTrace (out));
+
+    const auto json = JSON::parse (out.toString());
+    const auto* events = json["traceEvents"].getArray();
+    BOOST_REQUIRE (events != nullptr);
+    BOOST_REQUIRE_EQUAL (events->size(), 1);
+    BOOST_REQUIRE (events->getReference (0)["name"].toString() == "Test Node");
+    BOOST_REQUIRE (events->getReference (0)["ph"].toString() == "X");
+
+    // exporting drains the rings
+    MemoryOutputStream empty;
+    trace.writeChromeTrace (empty);
+    BOOST_REQUIRE_EQUAL (JSON::parse (empty.toString())["traceEvents"].getArray()->size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE (NodeLabels)
+{
+    auto& trace = RenderTrace::getInstance();
+    const auto first = trace.registerNode (1, 2, "Synth");
+    const auto second = trace.registerNode (1, 3, "Synth");
+    BOOST_REQUIRE (first != second);
+    BOOST_REQUIRE (first != trace.registerLabel ("Synth"));
+    BOOST_REQUIRE_EQUAL (first, trace.registerNode (1, 2, "Renamed"));
+
+    trace.setEnabled (true);
+    trace.clear();
+    trace.record (first, readRenderTicks(), readRenderTicks());
+    trace.setEnabled (false);
+
+    MemoryOutputStream out;
+    BOOST_REQUIRE (trace.writeChromeTrace (out));
+    const auto event = JSON::parse (out.toString())["traceEvents"][0];
+    BOOST_REQUIRE (event["name"].toString() == "Renamed");
+    BOOST_REQUIRE_EQUAL ((int) event["args"]["graph"], 1);
+    BOOST_REQUIRE_EQUAL ((int) event["args"]["node"], 2);
+}
+
+BOOST_AUTO_TEST_CASE (DroppedEvents)
+{
+    auto& trace = RenderTrace::getInstance();
+    const auto label = trace.registerLabel ("Dropped");
+
+    trace.setEnabled (true);
+    trace.clear();
+    for (int i = 0; i < RenderTrace::ringSize * 2; ++i)
+        trace.record (label, readRenderTicks(), readRenderTicks());
+    trace.setEnabled (false);
+    const int dropped = trace.getNumDroppedEvents();
+    BOOST_REQUIRE_GT (dropped, 0);
+
+    MemoryOutputStream out;
+    BOOST_REQUIRE (trace.writeChromeTrace (out));
+    const auto json = JSON::parse (out.toString());
+    BOOST_REQUIRE_EQUAL ((int) json["otherData"]["droppedEvents"], dropped);
+    BOOST_REQUIRE_EQUAL (trace.getNumDroppedEvents(), 0);
+}
+
+BOOST_AUTO_TEST_CASE (ThreadsReleaseRings)
+{
+    auto& trace = RenderTrace::getInstance();
+    const auto label = trace.registerLabel ("Worker");
+
+    trace.setEnabled (true);
+    trace.clear();
+    for (int i = 0; i < RenderTrace::maxThreads * 2; ++i)
+    {
+        std::thread worker ([&] { trace.record (label, readRenderTicks(), readRenderTicks()); });
+        worker.join();
+    }
+    trace.setEnabled (false);
+
+    BOOST_REQUIRE_EQUAL (trace.getNumDroppedEvents(), 0);
+    MemoryOutputStream out;
+    BOOST_REQUIRE (trace.writeChromeTrace (out));
+    BOOST_REQUIRE_EQUAL (JSON::parse (out.toString())["traceEvents"].getArray()->size(), RenderTrace::maxThreads * 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
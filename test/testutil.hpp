@@ -1,5 +1,9 @@
 #pragma once
 
+#include <element/juce/audio_basics.hpp>
+
+#include <functional>
+
 namespace element {
 namespace test {
 
@@ -12,5 +16,34 @@ inline static juce::File getSourceRoot()
 #endif
 }
 
+/** Fills every channel with white noise in [-1, 1). */
+inline static void fillNoise (juce::AudioSampleBuffer& buffer, juce::Random& random)
+{
+    for (int c = 0; c < buffer.getNumChannels(); ++c)
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            buffer.setSample (c, i, random.nextFloat() * 2.f - 1.f);
+}
+
+/** Polls condition every millisecond for up to two seconds. Returns true
+    as soon as it holds.
+ */
+inline static bool waitFor (std::function<bool()> condition)
+{
+    for (int i = 0; i < 2000; ++i)
+    {
+        if (condition())
+            return true;
+        juce::Thread::sleep (1);
+    }
+    return false;
+}
+
+/** Adds numEvents note ons on channel, step samples apart from offset. */
+inline static void addNotes (juce::MidiBuffer& midi, int channel, int numEvents, int step, int offset = 0)
+{
+    for (int i = 0; i < numEvents; ++i)
+        midi.addEvent (juce::MidiMessage::noteOn (channel, 60 + (i % 12), (juce::uint8) 100), offset + i * step);
+}
+
 } // namespace test
 } // namespace element